@@ -0,0 +1,231 @@
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <unistd.h>
+#include "../core/core.hpp"
+#include "../core/metadata.hpp"
+#include "../core/linereader.hpp"
+#include "./corpus.hpp"
+
+namespace fs = std::filesystem;
+
+// Micro-benchmarks of the engine's own hot paths, independent of interpreter
+// start-up. Run with `make bench`; results land in bin/bench.json.
+
+namespace {
+
+const size_t CORPUS_SIZE = 10000;
+
+const std::vector<std::string>& domainCorpus() {
+  static const std::vector<std::string> corpus = corpus::domains(CORPUS_SIZE);
+  return corpus;
+}
+
+const std::vector<std::string>& proxyCorpus() {
+  static const std::vector<std::string> corpus = corpus::proxies(CORPUS_SIZE);
+  return corpus;
+}
+
+const std::vector<std::string>& corpusFor(int which) {
+  return which == 0 ? domainCorpus() : proxyCorpus();
+}
+
+const char* formatFor(int which) {
+  return which == 0 ? "domain" : "proxy";
+}
+
+// corpus:0 runs over domains, corpus:1 over proxies.
+void corpusArgs(benchmark::internal::Benchmark* bench) {
+  bench->ArgName("corpus")->Arg(0)->Arg(1);
+}
+
+Storage storageOf(const std::vector<std::string>& values, const char* format) {
+  Storage storage;
+  FormatColumn& column = storage[format];
+  for (const auto& value : values) column.append(value);
+  return storage;
+}
+
+}
+
+static void BM_ParseBMOPLine(benchmark::State& state) {
+  const auto& values = corpusFor(state.range(0));
+  std::vector<std::string> lines = corpus::dataLines(formatFor(state.range(0)), values);
+  Storage storage;
+  size_t i = 0;
+  for (auto _ : state) {
+    parseBMOPLine(lines[i], storage);
+    if (++i == lines.size()) {
+      i = 0;
+      storage.clear();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseBMOPLine)->Apply(corpusArgs);
+
+static void BM_BmopDecode(benchmark::State& state) {
+  std::vector<std::string> lines = corpus::dataLines(formatFor(state.range(0)), corpusFor(state.range(0)));
+  BmopDecoder decoder;
+  BmopEvent event;
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(decoder.decode(lines[i], event));
+    if (++i == lines.size()) i = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BmopDecode)->Apply(corpusArgs);
+
+static void BM_TrimString(benchmark::State& state) {
+  std::vector<std::string> padded;
+  for (const auto& value : domainCorpus()) padded.push_back("  \t" + value + " \r");
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(trimString(padded[i]));
+    if (++i == padded.size()) i = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TrimString);
+
+// Stdout framing: a module's output arriving in 64 KiB reads.
+static void BM_LineReaderSplit(benchmark::State& state) {
+  std::vector<std::string> lines = corpus::dataLines(formatFor(state.range(0)), corpusFor(state.range(0)));
+  std::string stream;
+  for (const auto& line : lines) {
+    stream += line;
+    stream += '\n';
+  }
+  const size_t chunk = 64 * 1024;
+
+  LineReader reader;
+  for (auto _ : state) {
+    size_t framed = 0;
+    std::string_view line;
+    for (size_t pos = 0; pos < stream.size(); pos += chunk) {
+      reader.append(stream.data() + pos, std::min(chunk, stream.size() - pos));
+      while (reader.next(line)) framed += line.size();
+    }
+    benchmark::DoNotOptimize(framed);
+  }
+  state.SetBytesProcessed(state.iterations() * stream.size());
+  state.SetItemsProcessed(state.iterations() * lines.size());
+}
+BENCHMARK(BM_LineReaderSplit)->Apply(corpusArgs);
+
+// Stdin egress of a whole column, JSONL (0) or BMOP v2 binary (1).
+static void BM_EgressWriter(benchmark::State& state) {
+  Storage storage = storageOf(domainCorpus(), "domain");
+  BmopWire wire = state.range(0) == 0 ? BmopWire::JSONL : BmopWire::BINARY;
+  FILE* sink = fopen("/dev/null", "w");
+  for (auto _ : state) {
+    pipeDataToModule(sink, storage, "domain", wire);
+  }
+  fclose(sink);
+  state.SetItemsProcessed(state.iterations() * CORPUS_SIZE);
+}
+BENCHMARK(BM_EgressWriter)->ArgName("binary")->Arg(0)->Arg(1);
+
+static void BM_StorageInsert(benchmark::State& state) {
+  const auto& values = corpusFor(state.range(0));
+  const char* format = formatFor(state.range(0));
+  for (auto _ : state) {
+    Storage storage;
+    FormatId id = storage.intern(format);
+    for (const auto& value : values) storage.append(id, value);
+    benchmark::DoNotOptimize(storage.totalItems());
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_StorageInsert)->Apply(corpusArgs);
+
+static void BM_StorageIterate(benchmark::State& state) {
+  Storage storage = storageOf(domainCorpus(), "domain");
+  FormatColumn& proxies = storage["proxy"];
+  for (const auto& value : proxyCorpus()) proxies.append(value);
+  for (auto _ : state) {
+    size_t bytes = 0;
+    for (const auto& [format, items] : storage) {
+      for (const auto& item : items) bytes += item.value.size();
+    }
+    benchmark::DoNotOptimize(bytes);
+  }
+  state.SetItemsProcessed(state.iterations() * storage.totalItems());
+}
+BENCHMARK(BM_StorageIterate);
+
+// Header read + hash + cache hit: what every lookup of a changed file pays.
+static void BM_ParseModuleMetadata(benchmark::State& state) {
+  std::string path = "./modules/bench/meta_0.js";
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(parseModuleMetadata(path));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseModuleMetadata);
+
+// Directive parsing alone, on a header already in memory.
+static void BM_CompileModuleMetadata(benchmark::State& state) {
+  std::string header;
+  readModuleHeader("./modules/bench/meta_0.js", header);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(compileModuleMetadata(header));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CompileModuleMetadata);
+
+static void BM_FindModulePath(benchmark::State& state) {
+  size_t i = 0;
+  std::vector<std::string> names;
+  for (int n = 0; n < 200; ++n) names.push_back("meta_" + std::to_string(n) + ".js");
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(findModulePath(names[i]));
+    if (++i == names.size()) i = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FindModulePath);
+
+// A throwaway ./modules tree of 200 modules for the metadata and lookup
+// benchmarks, spread over a few directories like a real install.
+static fs::path createSandbox() {
+  fs::path dir = fs::temp_directory_path() / ("bahamut_bench_" + std::to_string(getpid()));
+  fs::create_directories(dir);
+  fs::current_path(dir);
+  for (int n = 0; n < 200; ++n) {
+    fs::path moduleDir = fs::path("modules") / (n == 0 ? "bench" : "group_" + std::to_string(n % 8));
+    fs::create_directories(moduleDir);
+    std::ofstream file(moduleDir / ("meta_" + std::to_string(n) + ".js"));
+    file << "#!/usr/bin/env node\n"
+         << "// Name: Benchmark module " << n << "\n"
+         << "// Description: Collects subdomains from a passive source\n"
+         << "// Type: collector\n"
+         << "// Stage: " << (n % 4 + 1) << "\n"
+         << "// Consumes: domain\n"
+         << "// Provides: subdomain\n"
+         << "// Install: npm install axios\n"
+         << "// InstallScope: shared\n"
+         << "// Args: --limit <n> Maximum results\n"
+         << "\n"
+         << "const axios = require('axios');\n"
+         << "console.log(JSON.stringify({bmop: '1.0', module: 'meta'}));\n";
+  }
+  return dir;
+}
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+  fs::path original = fs::current_path();
+  fs::path sandbox = createSandbox();
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  fs::current_path(original);
+  fs::remove_all(sandbox);
+  return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef BENCH_CORPUS_HPP
+#define BENCH_CORPUS_HPP
+
+#include <string>
+#include <vector>
+#include <random>
+#include <cstddef>
+
+// Deterministic corpora shaped like what recon modules move around: subdomain
+// lists (mixed depth and length, the odd dash or digit) and ip:port proxy
+// lists. Same seed, same corpus, so runs are comparable.
+namespace corpus {
+
+inline std::vector<std::string> domains(size_t count, unsigned seed = 1337) {
+  static const char* labels[] = {
+    "api", "www", "mail", "dev", "staging", "cdn", "vpn", "admin", "portal", "auth",
+    "static", "img", "m", "beta", "internal", "git", "jenkins", "grafana", "s3", "edge"
+  };
+  static const char* roots[] = {
+    "example.com", "example-corp.net", "shop.example.org", "bugbounty-target.io",
+    "acme.co.uk", "corp.example.com", "cloud-provider.dev"
+  };
+
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<size_t> label(0, std::size(labels) - 1);
+  std::uniform_int_distribution<size_t> root(0, std::size(roots) - 1);
+  std::uniform_int_distribution<int> depth(0, 3);
+  std::uniform_int_distribution<int> number(0, 99);
+
+  std::vector<std::string> out;
+  out.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    std::string domain;
+    for (int d = depth(rng); d > 0; --d) {
+      domain += labels[label(rng)];
+      if (number(rng) < 30) domain += "-" + std::to_string(number(rng));
+      domain += '.';
+    }
+    domain += labels[label(rng)];
+    domain += '.';
+    domain += roots[root(rng)];
+    out.push_back(std::move(domain));
+  }
+  return out;
+}
+
+inline std::vector<std::string> proxies(size_t count, unsigned seed = 7331) {
+  static const int ports[] = {80, 3128, 8080, 8000, 8888, 1080, 9050, 3129};
+
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> octet(1, 254);
+  std::uniform_int_distribution<size_t> port(0, std::size(ports) - 1);
+
+  std::vector<std::string> out;
+  out.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    out.push_back(std::to_string(octet(rng)) + "." + std::to_string(octet(rng)) + "." +
+      std::to_string(octet(rng)) + "." + std::to_string(octet(rng)) + ":" +
+      std::to_string(ports[port(rng)]));
+  }
+  return out;
+}
+
+// One BMOP data line per value, without the trailing newline.
+inline std::vector<std::string> dataLines(const std::string& format, const std::vector<std::string>& values) {
+  std::vector<std::string> out;
+  out.reserve(values.size());
+  for (const auto& value : values) {
+    out.push_back("{\"t\":\"d\",\"f\":\"" + format + "\",\"v\":\"" + value + "\"}");
+  }
+  return out;
+}
+
+}
+
+#endif
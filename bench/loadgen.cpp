@@ -0,0 +1,237 @@
+// bahamut-loadgen: a BMOP module that costs (almost) nothing, for measuring
+// the engine's own I/O paths. `emit` produces items at line rate, `sink`
+// consumes them and optionally passes them on. Wrapped by a one-line .sh
+// module (exec bahamut-loadgen ...) so the engine can run it.
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <unistd.h>
+#include "../core/bmop.hpp"
+
+namespace {
+
+struct Options {
+  std::string mode;
+  uint64_t items = 100000;
+  size_t size = 32;
+  size_t batch = 0;
+  std::string format = "load";
+  std::string echo;
+  uint64_t keepEvery = 1;
+  BmopWire wire = BmopWire::JSONL;
+};
+
+void usage() {
+  std::cerr << "Usage: bahamut-loadgen emit [--items N] [--size BYTES] [--format F] [--batch N] [--wire jsonl|binary]\n"
+            << "       bahamut-loadgen sink [--echo FORMAT] [--keep-every K] [--wire jsonl|binary]\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+  if (argc < 2) return false;
+  options.mode = argv[1];
+  if (options.mode != "emit" && options.mode != "sink") return false;
+
+  for (int i = 2; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) return false;
+    std::string value = argv[++i];
+    if (arg == "--items") options.items = std::strtoull(value.c_str(), nullptr, 10);
+    else if (arg == "--size") options.size = std::strtoull(value.c_str(), nullptr, 10);
+    else if (arg == "--batch") options.batch = std::strtoull(value.c_str(), nullptr, 10);
+    else if (arg == "--format") options.format = value;
+    else if (arg == "--echo") options.echo = value;
+    else if (arg == "--keep-every") options.keepEvery = std::max<uint64_t>(1, std::strtoull(value.c_str(), nullptr, 10));
+    else if (arg == "--wire") {
+      if (value == "binary") options.wire = BmopWire::BINARY;
+      else if (value == "jsonl") options.wire = BmopWire::JSONL;
+      else return false;
+    }
+    else return false;
+  }
+  return true;
+}
+
+// Buffered stdout; written in 1 MiB chunks.
+class Output {
+  public:
+    std::string buffer;
+
+    Output() { buffer.reserve(CAPACITY + 64 * 1024); }
+    ~Output() { flush(); }
+
+    void maybeFlush() {
+      if (buffer.size() >= CAPACITY) flush();
+    }
+
+    void flush() {
+      const char* data = buffer.data();
+      size_t left = buffer.size();
+      while (left > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, left);
+        if (n < 0) {
+          if (errno == EINTR) continue;
+          std::exit(1);
+        }
+        data += n;
+        left -= n;
+      }
+      buffer.clear();
+    }
+
+  private:
+    static constexpr size_t CAPACITY = 1024 * 1024;
+};
+
+void header(Output& out, BmopWire wire) {
+  out.buffer += wire == BmopWire::BINARY ? "{\"bmop\":\"2.0\",\"module\":\"loadgen\"}\n"
+                                         : "{\"bmop\":\"1.0\",\"module\":\"loadgen\"}\n";
+  // The engine holds our stdin until it has seen this line.
+  out.flush();
+}
+
+// "item-<n>" padded with 'x' to `size` bytes; never needs JSON escaping.
+void makeValue(std::string& value, uint64_t n, size_t size) {
+  value = "item-";
+  value += std::to_string(n);
+  if (value.size() < size) value.append(size - value.size(), 'x');
+}
+
+int emit(const Options& options) {
+  Output out;
+  header(out, options.wire);
+
+  BmopBinaryEncoder encoder;
+  std::string prefix = bmopDataPrefix(options.format);
+  uint32_t id = 0;
+  if (options.wire == BmopWire::BINARY) id = encoder.defineFormat(out.buffer, options.format);
+
+  std::string value;
+  uint64_t n = 0;
+  while (n < options.items) {
+    uint64_t count = options.batch ? std::min<uint64_t>(options.batch, options.items - n) : 1;
+    if (options.batch && options.wire == BmopWire::BINARY) {
+      encoder.writeBatchHeader(out.buffer, id, count);
+    } else if (options.batch) {
+      out.buffer += "{\"t\":\"batch\",\"f\":\"" + options.format + "\",\"c\":" + std::to_string(count) + "}\n";
+    }
+
+    for (uint64_t end = n + count; n < end; ++n) {
+      makeValue(value, n, options.size);
+      if (options.wire == BmopWire::BINARY) {
+        if (options.batch) encoder.writeBatchItem(out.buffer, value);
+        else encoder.writeData(out.buffer, id, value);
+      } else if (options.batch) {
+        out.buffer += value;
+        out.buffer += '\n';
+      } else {
+        out.buffer += prefix;
+        out.buffer += value;
+        out.buffer += "\"}\n";
+      }
+      out.maybeFlush();
+    }
+
+    if (options.batch && options.wire == BmopWire::JSONL) out.buffer += "{\"t\":\"batch_end\"}\n";
+  }
+  return 0;
+}
+
+int sink(const Options& options) {
+  Output out;
+  header(out, options.wire);
+
+  BmopDecoder decoder;
+  BmopBinaryDecoder binaryDecoder;
+  BmopBinaryEncoder encoder;
+  BmopEvent event;
+  std::string prefix = bmopDataPrefix(options.echo);
+  uint32_t echoId = 0;
+  if (!options.echo.empty() && options.wire == BmopWire::BINARY) {
+    echoId = encoder.defineFormat(out.buffer, options.echo);
+  }
+
+  uint64_t consumed = 0;
+  auto take = [&](std::string_view value) {
+    if (!options.echo.empty() && consumed % options.keepEvery == 0) {
+      if (options.wire == BmopWire::BINARY) {
+        encoder.writeData(out.buffer, echoId, value);
+      } else {
+        out.buffer += prefix;
+        appendJsonEscaped(out.buffer, value);
+        out.buffer += "\"}\n";
+      }
+      out.maybeFlush();
+    }
+    consumed++;
+  };
+
+  std::string input;
+  size_t pos = 0;
+  bool inBatch = false;
+  bool sawHeader = options.wire == BmopWire::JSONL;
+  char chunk[64 * 1024];
+  for (;;) {
+    ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    input.append(chunk, n);
+
+    if (!sawHeader) {
+      // Binary input opens with the text header line.
+      size_t newline = input.find('\n', pos);
+      if (newline == std::string::npos) continue;
+      pos = newline + 1;
+      sawHeader = true;
+    }
+
+    if (options.wire == BmopWire::BINARY) {
+      for (;;) {
+        size_t used = binaryDecoder.decode(std::string_view(input).substr(pos), event);
+        if (used == BmopBinaryDecoder::INCOMPLETE) break;
+        if (used == BmopBinaryDecoder::CORRUPT) return 1;
+        if (event.type == BmopEventType::DATA) take(event.value);
+        pos += used;
+      }
+    } else {
+      for (;;) {
+        const char* begin = input.data() + pos;
+        const char* newline = static_cast<const char*>(std::memchr(begin, '\n', input.size() - pos));
+        if (!newline) break;
+        std::string_view line(begin, newline - begin);
+        pos += line.size() + 1;
+        if (line.empty()) continue;
+        if (inBatch && line[0] != '{') {
+          take(line);
+          continue;
+        }
+        if (!decoder.decode(line, event)) continue;
+        if (event.type == BmopEventType::DATA) take(event.value);
+        else if (event.type == BmopEventType::BATCH_START) inBatch = true;
+        else if (event.type == BmopEventType::BATCH_END) inBatch = false;
+      }
+    }
+
+    input.erase(0, pos);
+    pos = 0;
+  }
+
+  std::string result = "{\"t\":\"result\",\"ok\":true,\"count\":" + std::to_string(consumed) + "}";
+  if (options.wire == BmopWire::BINARY) encoder.writeJson(out.buffer, result);
+  else out.buffer += result + "\n";
+  return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage();
+    return 2;
+  }
+  return options.mode == "emit" ? emit(options) : sink(options);
+}
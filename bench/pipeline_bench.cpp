@@ -0,0 +1,150 @@
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../core/core.hpp"
+
+namespace fs = std::filesystem;
+
+// End-to-end throughput of the engine's I/O paths: bahamut-loadgen stands in
+// for real modules, so what is measured is spawn, egress, the event loop,
+// BMOP decoding and storage, plus one bash exec per module.
+
+namespace {
+
+const int64_t ITEMS = 100000;
+
+fs::path loadgenPath() {
+  return fs::read_symlink("/proc/self/exe").parent_path() / "bahamut-loadgen";
+}
+
+// Creates the wrapper modules in the sandbox's ./modules on first use.
+bool ensureLoadgenModules(benchmark::State& state) {
+  static const bool ready = [] {
+    fs::path loadgen = loadgenPath();
+    if (!fs::exists(loadgen)) return false;
+    fs::create_directories("modules/loadgen");
+    std::ofstream emit("modules/loadgen/lg_emit.sh");
+    emit << "#!/bin/bash\n"
+         << "# Name: loadgen emit\n"
+         << "# Provides: load\n"
+         << "exec " << loadgen.string() << " emit \"$@\"\n";
+    std::ofstream sink("modules/loadgen/lg_sink.sh");
+    sink << "#!/bin/bash\n"
+         << "# Name: loadgen sink\n"
+         << "# Consumes: load\n"
+         << "# Provides: echoed\n"
+         << "# Stage: 2\n"
+         << "exec " << loadgen.string() << " sink \"$@\"\n";
+    return true;
+  }();
+  if (!ready) state.SkipWithError("bin/bahamut-loadgen not found; build it with `make loadgen`");
+  return ready;
+}
+
+// The engine reports each module on stdout; keep that out of the benchmark report.
+class QuietStdout {
+  public:
+    QuietStdout() {
+      std::cout.flush();
+      saved = dup(STDOUT_FILENO);
+      int devnull = open("/dev/null", O_WRONLY);
+      dup2(devnull, STDOUT_FILENO);
+      close(devnull);
+    }
+    ~QuietStdout() {
+      std::cout.flush();
+      dup2(saved, STDOUT_FILENO);
+      close(saved);
+    }
+
+  private:
+    int saved;
+};
+
+std::string wireName(int64_t binary) {
+  return binary ? "binary" : "jsonl";
+}
+
+}
+
+// Module output -> storage. Args: item size, batch size (0 = one `d` line
+// per item), wire (1 = BMOP v2 binary).
+static void BM_LoadgenEmit(benchmark::State& state) {
+  if (!ensureLoadgenModules(state)) return;
+  std::vector<std::string> args = {
+    "--items", std::to_string(ITEMS),
+    "--size", std::to_string(state.range(0)),
+    "--batch", std::to_string(state.range(1)),
+    "--wire", wireName(state.range(2)),
+  };
+
+  QuietStdout quiet;
+  Storage storage;
+  for (auto _ : state) {
+    runModuleWithPipe("lg_emit.sh", args, storage, "");
+    state.PauseTiming();
+    if (storage.count("load") == 0 || storage["load"].size() != static_cast<size_t>(ITEMS)) {
+      state.SkipWithError("loadgen items were lost");
+    }
+    storage.clear();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * ITEMS);
+  state.SetBytesProcessed(state.iterations() * ITEMS * state.range(0));
+}
+BENCHMARK(BM_LoadgenEmit)
+  ->ArgNames({"size", "batch", "binary"})
+  ->Args({32, 0, 0})->Args({256, 0, 0})->Args({32, 1000, 0})->Args({32, 1000, 1})
+  ->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Storage -> module stdin, and back when echoing. Args: wire (1 = binary),
+// echo every k-th item (0 = consume only).
+static void BM_LoadgenConsume(benchmark::State& state) {
+  if (!ensureLoadgenModules(state)) return;
+  Storage storage;
+  FormatColumn& load = storage["load"];
+  for (int64_t i = 0; i < ITEMS; ++i) load.append("item-" + std::to_string(i) + std::string(24, 'x'));
+
+  std::vector<std::string> args = {"--wire", wireName(state.range(0))};
+  if (state.range(1) > 0) {
+    args.insert(args.end(), {"--echo", "echoed", "--keep-every", std::to_string(state.range(1))});
+  }
+
+  QuietStdout quiet;
+  for (auto _ : state) {
+    runModuleWithPipe("lg_sink.sh", args, storage, "load");
+    state.PauseTiming();
+    storage.erase("echoed");
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * ITEMS);
+  state.SetBytesProcessed(state.iterations() * load.bytes());
+}
+BENCHMARK(BM_LoadgenConsume)
+  ->ArgNames({"binary", "echo"})
+  ->Args({0, 0})->Args({0, 1})->Args({1, 0})->Args({1, 1})->Args({0, 10})
+  ->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Both through the profile runner: scheduling, stage ordering, storage
+// merges and the run report, emit -> sink (echo) in one profile.
+static void BM_LoadgenProfile(benchmark::State& state) {
+  if (!ensureLoadgenModules(state)) return;
+  fs::create_directories("profiles");
+  {
+    std::ofstream profile("profiles/bahamut_loadgen.txt");
+    profile << "lg_emit.sh --items " << ITEMS << " --size 32 --batch " << state.range(0) << "\n"
+            << "lg_sink.sh --echo echoed\n";
+  }
+
+  QuietStdout quiet;
+  for (auto _ : state) {
+    runModulesFromProfile("loadgen", {});
+  }
+  state.SetItemsProcessed(state.iterations() * ITEMS * 2);
+}
+BENCHMARK(BM_LoadgenProfile)
+  ->ArgName("batch")->Arg(0)->Arg(1000)
+  ->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <cstdlib>
 #include <iomanip>
+#include <sstream>
 #include <vector>
 
 CLI cli;
@@ -37,6 +38,70 @@ int main(int argc, char* argv[]) {
 
   setDebugMode(debug);
 
+  if (cli.c["jobs"]) {
+    int jobs = std::atoi(cli.c["jobs"].toString().c_str());
+    if (jobs < 1) {
+      Error("--jobs expects a positive number");
+      return 1;
+    }
+    setMaxJobs(static_cast<size_t>(jobs));
+  }
+
+  setStreaming(cli.c["stream"]);
+
+  if (cli.c["parallel"]) {
+    int workers = parseParallelSpec(cli.c["parallel"].toString());
+    if (workers < 0) {
+      Error("--parallel expects a positive number or auto");
+      return 1;
+    }
+    setParallelOverride(workers);
+  }
+
+  setRunReport(cli.c["report"] ? cli.c["report"].toString() : "",
+      cli.c["prometheus"] ? cli.c["prometheus"].toString() : "");
+  setTraceFile(cli.c["trace"] ? cli.c["trace"].toString() : "");
+
+  if (cli.c["output"] && !setConsoleMode(cli.c["output"].toString())) {
+    Error("--output expects quiet, summary or raw");
+    return 1;
+  }
+
+  if (cli.c["log-file"] && !setModuleLogFile(cli.c["log-file"].toString())) {
+    Error("Cannot open log file: " + cli.c["log-file"].toString());
+    return 1;
+  }
+
+  if (cli.c["timeout"] && !setDefaultModuleTimeout(cli.c["timeout"].toString())) {
+    Error("--timeout expects a duration such as 10000, 500ms or 30s");
+    return 1;
+  }
+
+  if (cli.c["rate-limit"] && !setRateLimits(cli.c["rate-limit"].toString())) {
+    Error("--rate-limit expects bucket=rate pairs, e.g. dns=100,crt.sh=5");
+    return 1;
+  }
+
+  if (cli.c["cgroup"] && !setModuleCgroup(cli.c["cgroup"].toString())) {
+    Error("--cgroup expects a writable cgroup v2 directory: " + cli.c["cgroup"].toString());
+    return 1;
+  }
+
+  if (cli.c["warm"] && !setWarmInterpreters(cli.c["warm"].toString(), cli.c["preload"] ? cli.c["preload"].toString() : "")) {
+    Error("--warm expects python and/or node, --preload <language>:<library> for one of them");
+    return 1;
+  }
+
+  if (cli.c["record"] && cli.c["replay"]) {
+    Error("--record and --replay cannot be used together");
+    return 1;
+  }
+  if (cli.c["record"]) {
+    setCapture(CaptureMode::RECORD, cli.c["record"].toString());
+  } else if (cli.c["replay"]) {
+    setCapture(CaptureMode::REPLAY, cli.c["replay"].toString(), cli.c["replay-paced"]);
+  }
+
   if (cli.c["version"]) {
     PrintLogo("repoAssets/bahamut_landscape.png");
     std::cout << std::endl;
@@ -86,7 +151,13 @@ int main(int argc, char* argv[]) {
           }
         }
         
-        runModulesFromProfile(profileName, extraArgs);
+        // "recon,portscan" runs them one after another in this process, so
+        // persistent modules stay warm from one to the next.
+        std::stringstream profiles(profileName);
+        std::string profile;
+        while (std::getline(profiles, profile, ',')) {
+          if (!profile.empty()) runModulesFromProfile(profile, extraArgs);
+        }
       }
       else if (cli.o.size() < 2) {
         Error("Usage: run <module_name | all> [-- args...]");
@@ -112,6 +183,8 @@ int main(int argc, char* argv[]) {
           runModule(target, extraArgs);
         }
       }
+      shutdownPersistentWorkers();
+      shutdownWarmInterpreters();
     }
     else if (command == "describe") {
       if (cli.o.size() > 1) {
@@ -243,6 +316,7 @@ void ShowHelp() {
   std::cout << std::left << std::setw(40) << "  run <module> [-- args...]" << "Run a specific module with optional arguments" << std::endl;
   std::cout << std::left << std::setw(40) << "  run all [-- args...]" << "Run all modules by stage with global args" << std::endl;
   std::cout << std::left << std::setw(40) << "  run --profile <name> [-- args...]" << "Run modules from profile with optional args" << std::endl;
+  std::cout << std::left << std::setw(40) << "  run --profile <a,b,...>" << "Run several profiles in turn, keeping persistent modules warm" << std::endl;
   std::cout << std::left << std::setw(40) << "  list" << "List all available modules" << std::endl;
   std::cout << std::left << std::setw(40) << "  describe <module>" << "Show module details and arguments" << std::endl;
   std::cout << std::left << std::setw(40) << "  install <module>" << "Install dependencies for a module" << std::endl;
@@ -255,6 +329,22 @@ void ShowHelp() {
   std::cout << std::left << std::setw(40) << "  -d, --debug" << "Show debug logs" << std::endl;
   std::cout << std::left << std::setw(40) << "  --version" << "Show version" << std::endl;
   std::cout << std::left << std::setw(40) << "  --debug-module-args" << "Debug module argument parsing" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --jobs <n>" << "Run up to n independent modules at once" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --stream" << "Start consumers while their producers are still running" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --parallel <n|auto>" << "Shard every consuming module but outputs across n workers" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --report <file>" << "Write per-module resource usage as JSON" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --prometheus <file>" << "Write the same metrics as a Prometheus textfile" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --trace <file>" << "Write a Chrome/Perfetto trace of the run" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --output <quiet|summary|raw>" << "Module output on the console (default: summary)" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --log-file <file>" << "Append module logs and errors as JSON lines" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --timeout <duration>" << "Timeout for modules that declare none (e.g. 30s)" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --rate-limit <bucket=rate,...>" << "Pin shared rate limiter buckets (per second)" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --cgroup <dir>" << "Run each module in a cgroup v2 leaf under dir" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --warm <python,node>" << "Start modules on pre-booted interpreters" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --preload <lang:lib,...>" << "Libraries the warm interpreters load up front" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --record <dir>" << "Save every module's raw output to dir" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --replay <dir>" << "Replay recorded output instead of running modules" << std::endl;
+  std::cout << std::left << std::setw(40) << "  --replay-paced" << "Replay with the recorded timing" << std::endl;
 
   std::cout << "\n" << dim["yellow"]("Examples:") << std::endl;
   std::cout << "  " << cyan("./bahamut run checktor.js") << std::endl;
@@ -262,6 +352,11 @@ void ShowHelp() {
   std::cout << "  " << cyan("./bahamut run getrobotsfromurl.py -- -u google.com -v") << std::endl;
   std::cout << "  " << cyan("./bahamut -v run all -- --timeout 10") << std::endl;
   std::cout << "  " << cyan("./bahamut run --profile recon -- --depth 3") << std::endl;
+  std::cout << "  " << cyan("./bahamut run --profile recon --jobs 4") << std::endl;
+  std::cout << "  " << cyan("./bahamut run --profile recon --jobs 4 --stream") << std::endl;
+  std::cout << "  " << cyan("./bahamut run --profile recon --parallel auto") << std::endl;
+  std::cout << "  " << cyan("./bahamut run --profile recon --report run.json") << std::endl;
+  std::cout << "  " << cyan("./bahamut run --profile recon --replay captures/") << std::endl;
   std::cout << "  " << cyan("./bahamut describe getrobotsfromurl.py") << std::endl;
   std::cout << "  " << cyan("./bahamut --debug-module-args run scanner.py -- --test arg") << std::endl;
   std::cout << std::endl;
@@ -0,0 +1,498 @@
+#include "./bmop.hpp"
+#include "../include/rapidjson/document.h"
+#include "../include/rapidjson/error/en.h"
+#include <charconv>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const char* skipSpace(const char* p, const char* end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) ++p;
+  return p;
+}
+
+int hexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool readHex4(const char*& p, const char* end, unsigned& out) {
+  if (end - p < 4) return false;
+  out = 0;
+  for (int i = 0; i < 4; ++i) {
+    int digit = hexValue(p[i]);
+    if (digit < 0) return false;
+    out = (out << 4) | static_cast<unsigned>(digit);
+  }
+  p += 4;
+  return true;
+}
+
+void appendUtf8(std::string& out, unsigned cp) {
+  if (cp < 0x80) {
+    out.push_back(static_cast<char>(cp));
+  } else if (cp < 0x800) {
+    out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else if (cp < 0x10000) {
+    out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  } else {
+    out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+    out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+  }
+}
+
+// Scans a JSON string whose opening quote has already been consumed. Strings
+// without escapes are returned as a view into the line; escaped ones are
+// decoded into `scratch`, which the caller has reserved so it never moves.
+bool scanString(const char*& p, const char* end, std::string& scratch, std::string_view& out) {
+  const char* start = p;
+  while (p < end) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    if (c == '"') {
+      out = std::string_view(start, static_cast<size_t>(p - start));
+      ++p;
+      return true;
+    }
+    if (c == '\\') break;
+    if (c < 0x20) return false;
+    ++p;
+  }
+  if (p >= end) return false;
+
+  size_t begin = scratch.size();
+  scratch.append(start, static_cast<size_t>(p - start));
+  while (p < end) {
+    char c = *p++;
+    if (c == '"') {
+      out = std::string_view(scratch.data() + begin, scratch.size() - begin);
+      return true;
+    }
+    if (static_cast<unsigned char>(c) < 0x20) return false;
+    if (c != '\\') {
+      scratch.push_back(c);
+      continue;
+    }
+    if (p >= end) return false;
+    switch (*p++) {
+      case '"': scratch.push_back('"'); break;
+      case '\\': scratch.push_back('\\'); break;
+      case '/': scratch.push_back('/'); break;
+      case 'b': scratch.push_back('\b'); break;
+      case 'f': scratch.push_back('\f'); break;
+      case 'n': scratch.push_back('\n'); break;
+      case 'r': scratch.push_back('\r'); break;
+      case 't': scratch.push_back('\t'); break;
+      case 'u': {
+        unsigned cp;
+        if (!readHex4(p, end, cp)) return false;
+        if (cp >= 0xD800 && cp <= 0xDBFF) {
+          unsigned low;
+          if (end - p < 2 || p[0] != '\\' || p[1] != 'u') return false;
+          p += 2;
+          if (!readHex4(p, end, low) || low < 0xDC00 || low > 0xDFFF) return false;
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+          return false;
+        }
+        appendUtf8(scratch, cp);
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  return false;
+}
+
+void assignString(BmopEvent& event, std::string_view key, std::string_view value) {
+  if (key.size() == 1) {
+    switch (key[0]) {
+      case 't': event.kind = value; return;
+      case 'f': event.format = value; return;
+      case 'v': event.value = value; return;
+      case 'l': event.level = value; return;
+      case 'm': event.message = value; return;
+    }
+    return;
+  }
+  if (key == "code") event.code = value;
+  else if (key == "error") event.error = value;
+  else if (key == "bmop") event.version = value;
+  else if (key == "module") event.module = value;
+}
+
+void assignNumber(BmopEvent& event, std::string_view key, std::string_view text) {
+  int64_t* target = nullptr;
+  if (key == "c" || key == "count") target = &event.count;
+  else if (key == "T") target = &event.total;
+  if (!target) return;
+
+  int64_t parsed = 0;
+  auto result = std::from_chars(text.data(), text.data() + text.size(), parsed);
+  if (result.ec == std::errc() && result.ptr == text.data() + text.size()) *target = parsed;
+}
+
+void assignBool(BmopEvent& event, std::string_view key, bool value) {
+  if (key == "ok") event.ok = value;
+  else if (key == "fatal") event.fatal = value;
+}
+
+void finishEvent(BmopEvent& event) {
+  if (!event.kind.empty()) {
+    event.type = bmopEventType(event.kind);
+  } else if (!event.version.empty()) {
+    event.type = BmopEventType::HEADER;
+  } else {
+    event.type = BmopEventType::NONE;
+  }
+}
+
+}
+
+BmopEventType bmopEventType(std::string_view kind) {
+  if (kind == "d") return BmopEventType::DATA;
+  if (kind == "batch") return BmopEventType::BATCH_START;
+  if (kind == "batch_end") return BmopEventType::BATCH_END;
+  if (kind == "log") return BmopEventType::LOG;
+  if (kind == "progress") return BmopEventType::PROGRESS;
+  if (kind == "result") return BmopEventType::RESULT;
+  if (kind == "error") return BmopEventType::ERROR;
+  if (kind == "job_done") return BmopEventType::JOB_DONE;
+  return BmopEventType::UNKNOWN;
+}
+
+BmopDecoder::BmopDecoder() : lastErrorOffset(0), lastErrorReason("") {}
+
+bool BmopDecoder::decode(std::string_view line, BmopEvent& event) {
+  lastErrorOffset = 0;
+  lastErrorReason = "";
+  if (line.empty() || line[0] != '{') {
+    lastErrorReason = "Not a JSON object.";
+    return false;
+  }
+
+  // Decoded strings never outgrow their escaped form, so reserving the line
+  // length up front keeps every view handed out below stable.
+  scratch.clear();
+  if (scratch.capacity() < line.size()) scratch.reserve(line.size());
+
+  event = BmopEvent();
+  event.raw = line;
+  if (decodeFast(line, event)) return true;
+
+  event = BmopEvent();
+  event.raw = line;
+  return decodeDom(line, event);
+}
+
+bool BmopDecoder::decodeFast(std::string_view line, BmopEvent& event) {
+  const char* p = line.data() + 1;
+  const char* end = line.data() + line.size();
+
+  p = skipSpace(p, end);
+  if (p < end && *p == '}') {
+    p = skipSpace(p + 1, end);
+    if (p != end) return false;
+    finishEvent(event);
+    return true;
+  }
+
+  while (p < end) {
+    if (*p != '"') return false;
+    ++p;
+    std::string_view key;
+    if (!scanString(p, end, scratch, key)) return false;
+
+    p = skipSpace(p, end);
+    if (p >= end || *p != ':') return false;
+    p = skipSpace(p + 1, end);
+    if (p >= end) return false;
+
+    char c = *p;
+    if (c == '"') {
+      ++p;
+      std::string_view value;
+      if (!scanString(p, end, scratch, value)) return false;
+      assignString(event, key, value);
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+      const char* start = p;
+      while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) ++p;
+      assignNumber(event, key, std::string_view(start, static_cast<size_t>(p - start)));
+    } else if (end - p >= 4 && std::memcmp(p, "true", 4) == 0) {
+      assignBool(event, key, true);
+      p += 4;
+    } else if (end - p >= 5 && std::memcmp(p, "false", 5) == 0) {
+      assignBool(event, key, false);
+      p += 5;
+    } else if (end - p >= 4 && std::memcmp(p, "null", 4) == 0) {
+      p += 4;
+    } else {
+      // Nested objects/arrays and anything malformed take the DOM path.
+      return false;
+    }
+
+    p = skipSpace(p, end);
+    if (p >= end) return false;
+    if (*p == ',') {
+      p = skipSpace(p + 1, end);
+      continue;
+    }
+    if (*p != '}') return false;
+    p = skipSpace(p + 1, end);
+    if (p != end) return false;
+    finishEvent(event);
+    return true;
+  }
+  return false;
+}
+
+bool BmopDecoder::decodeDom(std::string_view line, BmopEvent& event) {
+  insitu.assign(line.begin(), line.end());
+  insitu.push_back('\0');
+
+  char poolBuffer[4096];
+  rapidjson::MemoryPoolAllocator<> allocator(poolBuffer, sizeof(poolBuffer));
+  rapidjson::Document doc(&allocator);
+  doc.ParseInsitu<rapidjson::kParseCommentsFlag | rapidjson::kParseTrailingCommasFlag>(insitu.data());
+
+  if (doc.HasParseError()) {
+    lastErrorOffset = doc.GetErrorOffset();
+    lastErrorReason = rapidjson::GetParseError_En(doc.GetParseError());
+    return false;
+  }
+  if (!doc.IsObject()) {
+    lastErrorReason = "Not a JSON object.";
+    return false;
+  }
+
+  // In-situ strings live in `insitu`, so the views survive the document.
+  for (auto it = doc.MemberBegin(); it != doc.MemberEnd(); ++it) {
+    std::string_view key(it->name.GetString(), it->name.GetStringLength());
+    const auto& value = it->value;
+    if (value.IsString()) {
+      assignString(event, key, std::string_view(value.GetString(), value.GetStringLength()));
+    } else if (value.IsInt64()) {
+      if (key == "c" || key == "count") event.count = value.GetInt64();
+      else if (key == "T") event.total = value.GetInt64();
+    } else if (value.IsBool()) {
+      assignBool(event, key, value.GetBool());
+    }
+  }
+  finishEvent(event);
+  return true;
+}
+
+int bmopMajorVersion(std::string_view version) {
+  int major = 0;
+  auto result = std::from_chars(version.data(), version.data() + version.size(), major);
+  return result.ec == std::errc() ? major : 0;
+}
+
+void appendVarint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+size_t readVarint(const char* p, const char* end, uint64_t& value) {
+  value = 0;
+  for (size_t i = 0; i < 10; ++i) {
+    if (p + i >= end) return BmopBinaryDecoder::INCOMPLETE;
+    unsigned char byte = static_cast<unsigned char>(p[i]);
+    value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+    if (!(byte & 0x80)) return i + 1;
+  }
+  return BmopBinaryDecoder::CORRUPT;
+}
+
+uint32_t BmopBinaryEncoder::defineFormat(std::string& out, std::string_view format) {
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (names[i] == format) return static_cast<uint32_t>(i);
+  }
+  uint32_t id = static_cast<uint32_t>(names.size());
+  names.emplace_back(format);
+  out.push_back(static_cast<char>(BMOP_FRAME_FORMAT));
+  appendVarint(out, id);
+  appendVarint(out, format.size());
+  out.append(format);
+  return id;
+}
+
+void BmopBinaryEncoder::writeData(std::string& out, uint32_t id, std::string_view value) {
+  out.push_back(static_cast<char>(BMOP_FRAME_DATA));
+  appendVarint(out, id);
+  appendVarint(out, value.size());
+  out.append(value);
+}
+
+void BmopBinaryEncoder::writeBatchHeader(std::string& out, uint32_t id, uint64_t count) {
+  out.push_back(static_cast<char>(BMOP_FRAME_BATCH));
+  appendVarint(out, id);
+  appendVarint(out, count);
+}
+
+void BmopBinaryEncoder::writeBatchItem(std::string& out, std::string_view value) {
+  appendVarint(out, value.size());
+  out.append(value);
+}
+
+void BmopBinaryEncoder::writeJson(std::string& out, std::string_view json) {
+  out.push_back(static_cast<char>(BMOP_FRAME_JSON));
+  appendVarint(out, json.size());
+  out.append(json);
+}
+
+size_t BmopBinaryDecoder::decode(std::string_view data, BmopEvent& event) {
+  const char* p = data.data();
+  const char* end = p + data.size();
+  uint64_t id = 0;
+  uint64_t length = 0;
+  size_t n;
+
+  event = BmopEvent();
+
+  if (batchRemaining > 0) {
+    if ((n = readVarint(p, end, length)) == INCOMPLETE || n == CORRUPT) return n;
+    if (static_cast<uint64_t>(end - p - n) < length) return INCOMPLETE;
+    event.type = BmopEventType::DATA;
+    event.formatId = batchId;
+    event.format = formats[batchId];
+    event.value = std::string_view(p + n, length);
+    batchRemaining--;
+    return n + length;
+  }
+
+  if (p == end) return INCOMPLETE;
+  unsigned char type = static_cast<unsigned char>(*p);
+  size_t used = 1;
+
+  switch (type) {
+    case BMOP_FRAME_FORMAT:
+    case BMOP_FRAME_DATA: {
+      if ((n = readVarint(p + used, end, id)) == INCOMPLETE || n == CORRUPT) return n;
+      used += n;
+      if ((n = readVarint(p + used, end, length)) == INCOMPLETE || n == CORRUPT) return n;
+      used += n;
+      if (static_cast<uint64_t>(end - p - used) < length) return INCOMPLETE;
+      std::string_view payload(p + used, length);
+      used += length;
+
+      if (type == BMOP_FRAME_FORMAT) {
+        if (id > formats.size()) return CORRUPT;
+        if (id == formats.size()) formats.emplace_back(payload);
+        // Ids are bound once per stream: readers cache what an id stands
+        // for, so rebinding it would file later items under the old name.
+        // Repeating the same binding is harmless.
+        else if (formats[id] != payload) return CORRUPT;
+        return used;
+      }
+      if (id >= formats.size()) return CORRUPT;
+      event.type = BmopEventType::DATA;
+      event.formatId = static_cast<uint32_t>(id);
+      event.format = formats[id];
+      event.value = payload;
+      return used;
+    }
+    case BMOP_FRAME_BATCH: {
+      uint64_t count = 0;
+      if ((n = readVarint(p + used, end, id)) == INCOMPLETE || n == CORRUPT) return n;
+      used += n;
+      if ((n = readVarint(p + used, end, count)) == INCOMPLETE || n == CORRUPT) return n;
+      used += n;
+      if (id >= formats.size()) return CORRUPT;
+      batchId = static_cast<uint32_t>(id);
+      batchRemaining = count;
+      event.type = BmopEventType::BATCH_START;
+      event.formatId = batchId;
+      event.format = formats[id];
+      event.count = static_cast<int64_t>(count);
+      return used;
+    }
+    case BMOP_FRAME_JSON: {
+      if ((n = readVarint(p + used, end, length)) == INCOMPLETE || n == CORRUPT) return n;
+      used += n;
+      if (static_cast<uint64_t>(end - p - used) < length) return INCOMPLETE;
+      if (!json.decode(std::string_view(p + used, length), event)) event = BmopEvent();
+      return used + length;
+    }
+    default:
+      return CORRUPT;
+  }
+}
+
+namespace {
+
+inline bool needsEscape(unsigned char c) {
+  return c == '"' || c == '\\' || c < 0x20;
+}
+
+// Index of the first byte in [p, end) that needs escaping, or end - p.
+size_t cleanPrefix(const char* p, const char* end) {
+  const char* start = p;
+#if defined(__SSE2__)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1F);
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i hits = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+    if (mask) return static_cast<size_t>(p - start) + __builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+  while (p < end && !needsEscape(static_cast<unsigned char>(*p))) ++p;
+  return static_cast<size_t>(p - start);
+}
+
+}
+
+void appendJsonEscaped(std::string& out, std::string_view value) {
+  static const char HEX[] = "0123456789abcdef";
+  const char* p = value.data();
+  const char* end = p + value.size();
+
+  while (p < end) {
+    size_t clean = cleanPrefix(p, end);
+    out.append(p, clean);
+    p += clean;
+    if (p == end) break;
+
+    unsigned char c = static_cast<unsigned char>(*p++);
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      case '\r': out += "\\r"; break;
+      case '\t': out += "\\t"; break;
+      case '\b': out += "\\b"; break;
+      case '\f': out += "\\f"; break;
+      default: {
+        char escaped[6] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0xF]};
+        out.append(escaped, 6);
+      }
+    }
+  }
+}
+
+std::string bmopDataPrefix(std::string_view format) {
+  std::string prefix = "{\"t\":\"d\",\"f\":\"";
+  appendJsonEscaped(prefix, format);
+  prefix += "\",\"v\":\"";
+  return prefix;
+}
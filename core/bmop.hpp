@@ -0,0 +1,145 @@
+#ifndef BMOP_HPP
+#define BMOP_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+enum class BmopEventType {
+  NONE,
+  DATA,
+  BATCH_START,
+  BATCH_END,
+  HEADER,
+  LOG,
+  PROGRESS,
+  RESULT,
+  ERROR,
+  // A persistent module finished the job it was given (see WorkerPool).
+  JOB_DONE,
+  UNKNOWN
+};
+
+enum class BmopWire {
+  JSONL,
+  BINARY
+};
+
+constexpr uint32_t BMOP_NO_FORMAT_ID = UINT32_MAX;
+
+// One decoded BMOP line. String fields are views into the line itself or into
+// the decoder's scratch buffer, and stay valid until the next decode() call.
+// Fields the message does not carry are left default: string views with a null
+// data() (so an explicit "" is still distinguishable), -1, or false.
+struct BmopEvent {
+  BmopEventType type = BmopEventType::NONE;
+  std::string_view kind;      // "t"
+  std::string_view format;    // "f"
+  std::string_view value;     // "v"
+  std::string_view level;     // "l"
+  std::string_view message;   // "m"
+  std::string_view code;      // "code"
+  std::string_view error;     // "error"
+  std::string_view version;   // "bmop"
+  std::string_view module;    // "module"
+  int64_t count = -1;         // "c" or "count"
+  int64_t total = -1;         // "T"
+  bool ok = false;
+  bool fatal = false;
+  uint32_t formatId = BMOP_NO_FORMAT_ID;  // wire id, binary streams only
+  std::string_view raw;       // the JSON text the event was decoded from
+};
+
+// Decodes BMOP lines into typed events. Flat objects (every message the
+// protocol defines) are handled by a single-pass scanner that only copies a
+// string when it has escapes to undo; anything else falls back to an in-situ
+// rapidjson parse that tolerates comments and trailing commas. Keep one
+// decoder per stream: its buffers are reused across lines.
+class BmopDecoder {
+  public:
+    BmopDecoder();
+
+    // False when the line is not a JSON object; errorOffset()/errorReason()
+    // then describe why.
+    bool decode(std::string_view line, BmopEvent& event);
+
+    size_t errorOffset() const { return lastErrorOffset; }
+    const char* errorReason() const { return lastErrorReason; }
+
+  private:
+    bool decodeFast(std::string_view line, BmopEvent& event);
+    bool decodeDom(std::string_view line, BmopEvent& event);
+
+    std::string scratch;
+    std::vector<char> insitu;
+    size_t lastErrorOffset;
+    const char* lastErrorReason;
+};
+
+// BMOP v2 binary framing. A stream switches to it after a text header line
+// announcing version 2 ({"bmop":"2.0",...}); every frame after that newline is
+// a type byte followed by LEB128 varints and raw bytes:
+//   FORMAT  id, len, name      binds a stream-local id to a format name,
+//                              once: rebinding an id is corrupt
+//   DATA    id, len, value     one data item
+//   BATCH   id, count          followed by `count` items of (len, value)
+//   JSON    len, json          any other BMOP message, as its JSON text
+constexpr unsigned char BMOP_FRAME_FORMAT = 0x01;
+constexpr unsigned char BMOP_FRAME_DATA = 0x02;
+constexpr unsigned char BMOP_FRAME_BATCH = 0x03;
+constexpr unsigned char BMOP_FRAME_JSON = 0x04;
+
+constexpr const char* BMOP_BINARY_HEADER = "{\"bmop\":\"2.0\"}\n";
+
+void appendVarint(std::string& out, uint64_t value);
+
+class BmopBinaryEncoder {
+  public:
+    // Stream-local id for `format`; emits its FORMAT frame the first time.
+    uint32_t defineFormat(std::string& out, std::string_view format);
+    void writeData(std::string& out, uint32_t id, std::string_view value);
+    void writeBatchHeader(std::string& out, uint32_t id, uint64_t count);
+    void writeBatchItem(std::string& out, std::string_view value);
+    void writeJson(std::string& out, std::string_view json);
+
+  private:
+    std::vector<std::string> names;
+};
+
+// Incremental frame decoder. Batch items are returned one at a time as DATA
+// events, so a batch never has to be buffered whole. Views point into the
+// input passed to decode() or into the format table.
+class BmopBinaryDecoder {
+  public:
+    static constexpr size_t INCOMPLETE = 0;
+    static constexpr size_t CORRUPT = SIZE_MAX;
+
+    // Bytes consumed from `data` for one event, INCOMPLETE when more input is
+    // needed, CORRUPT when the stream cannot be resynchronised.
+    size_t decode(std::string_view data, BmopEvent& event);
+
+  private:
+    std::vector<std::string> formats;
+    uint32_t batchId = BMOP_NO_FORMAT_ID;
+    uint64_t batchRemaining = 0;
+    BmopDecoder json;
+};
+
+// Bytes used by the LEB128 varint at `p`; BmopBinaryDecoder::INCOMPLETE when
+// it runs past `end`, CORRUPT when it is too long.
+size_t readVarint(const char* p, const char* end, uint64_t& value);
+
+BmopEventType bmopEventType(std::string_view kind);
+int bmopMajorVersion(std::string_view version);
+
+// Appends `value` as the body of a JSON string (no quotes). Clean 16-byte runs
+// are found with SSE2 and copied in one go; only quotes, backslashes and
+// control bytes are rewritten.
+void appendJsonEscaped(std::string& out, std::string_view value);
+// `{"t":"d","f":"<format>","v":"` - compute once per format, then append
+// value + "\"}\n" per item.
+std::string bmopDataPrefix(std::string_view format);
+
+#endif
@@ -0,0 +1,119 @@
+#include "./capture.hpp"
+#include "./bmop.hpp"
+#include <filesystem>
+#include <iterator>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Writes are batched; a capture of a chatty module is many small chunks.
+const size_t FLUSH_BYTES = 256 * 1024;
+
+}
+
+bool CaptureWriter::open(const std::string& path) {
+  std::error_code ec;
+  fs::path parent = fs::path(path).parent_path();
+  if (!parent.empty()) fs::create_directories(parent, ec);
+  file.open(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) return false;
+  buffer = CAPTURE_MAGIC;
+  origin = std::chrono::steady_clock::now();
+  return true;
+}
+
+void CaptureWriter::record(size_t shard, CaptureStream stream, uint64_t length) {
+  auto offset = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin);
+  buffer.push_back(static_cast<char>(stream));
+  appendVarint(buffer, shard);
+  appendVarint(buffer, offset.count());
+  appendVarint(buffer, length);
+}
+
+void CaptureWriter::write(size_t shard, CaptureStream stream, std::string_view data) {
+  if (!file.is_open() || data.empty()) return;
+  record(shard, stream, data.size());
+  buffer.append(data);
+  if (buffer.size() >= FLUSH_BYTES) {
+    file.write(buffer.data(), buffer.size());
+    buffer.clear();
+  }
+}
+
+void CaptureWriter::exit(size_t shard, int exitCode) {
+  if (!file.is_open()) return;
+  record(shard, CaptureStream::EXIT, static_cast<uint64_t>(exitCode));
+}
+
+bool CaptureWriter::close() {
+  if (!file.is_open()) return false;
+  file.write(buffer.data(), buffer.size());
+  buffer.clear();
+  bool ok = static_cast<bool>(file);
+  file.close();
+  return ok;
+}
+
+bool loadCapture(const std::string& path, Capture& capture, std::string& error) {
+  capture = Capture();
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    error = "no capture at " + path;
+    return false;
+  }
+  std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+  size_t magic = std::strlen(CAPTURE_MAGIC);
+  if (content.compare(0, magic, CAPTURE_MAGIC) != 0) {
+    error = path + " is not a capture file";
+    return false;
+  }
+
+  const char* p = content.data() + magic;
+  const char* end = content.data() + content.size();
+  while (p < end) {
+    CaptureChunk chunk;
+    unsigned char stream = static_cast<unsigned char>(*p++);
+    uint64_t shard = 0;
+    uint64_t length = 0;
+    size_t used;
+    bool valid = stream >= 1 && stream <= 3;
+    for (uint64_t* field : {&shard, &chunk.offsetUs, &length}) {
+      if (!valid) break;
+      used = readVarint(p, end, *field);
+      valid = used != BmopBinaryDecoder::INCOMPLETE && used != BmopBinaryDecoder::CORRUPT;
+      if (valid) p += used;
+    }
+    chunk.stream = static_cast<CaptureStream>(stream);
+    if (valid && chunk.stream != CaptureStream::EXIT) valid = length <= static_cast<uint64_t>(end - p);
+    if (!valid || shard > 4096) {
+      error = path + " is truncated or corrupt";
+      return false;
+    }
+
+    chunk.shard = static_cast<uint32_t>(shard);
+    capture.shards = std::max<size_t>(capture.shards, shard + 1);
+    if (capture.exitCodes.size() < capture.shards) capture.exitCodes.resize(capture.shards, 0);
+
+    if (chunk.stream == CaptureStream::EXIT) {
+      capture.exitCodes[shard] = static_cast<int>(length);
+      continue;
+    }
+    chunk.data.assign(p, length);
+    p += length;
+    (chunk.stream == CaptureStream::STDOUT ? capture.stdoutBytes : capture.stderrBytes) += length;
+    capture.chunks.push_back(std::move(chunk));
+  }
+
+  if (capture.shards == 0) {
+    error = path + " is empty";
+    return false;
+  }
+  return true;
+}
+
+std::string captureFilePath(const std::string& dir, const std::string& moduleName, int occurrence) {
+  return (fs::path(dir) / (moduleName + "." + std::to_string(occurrence) + ".cap")).string();
+}
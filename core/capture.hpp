@@ -0,0 +1,66 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Recorded stdout/stderr of one module invocation, byte for byte as the
+// engine read it, so a run can be replayed through the same ingestion path
+// without the module (or its network). File layout: CAPTURE_MAGIC, then
+// records of
+//   stream byte, shard, offset in µs since spawn, length   (varints)
+// followed by `length` bytes. EXIT records carry the exit code in the length
+// field and no bytes.
+constexpr const char* CAPTURE_MAGIC = "BAHAMUT-CAPTURE 1\n";
+
+enum class CaptureStream : unsigned char {
+  STDOUT = 1,
+  STDERR = 2,
+  EXIT = 3
+};
+
+struct CaptureChunk {
+  CaptureStream stream;
+  uint32_t shard;
+  uint64_t offsetUs;
+  std::string data;
+};
+
+struct Capture {
+  size_t shards = 0;
+  std::vector<CaptureChunk> chunks;
+  std::vector<int> exitCodes;
+  uint64_t stdoutBytes = 0;
+  uint64_t stderrBytes = 0;
+};
+
+class CaptureWriter {
+  public:
+    // Creates missing directories; offsets count from this call.
+    bool open(const std::string& path);
+    bool isOpen() const { return file.is_open(); }
+
+    void write(size_t shard, CaptureStream stream, std::string_view data);
+    void exit(size_t shard, int exitCode);
+    // False if anything failed to reach the file.
+    bool close();
+
+  private:
+    void record(size_t shard, CaptureStream stream, uint64_t length);
+
+    std::ofstream file;
+    std::string buffer;
+    std::chrono::steady_clock::time_point origin;
+};
+
+bool loadCapture(const std::string& path, Capture& capture, std::string& error);
+
+// `<dir>/<module>.<occurrence>.cap`; occurrence counts from 1 within a run.
+std::string captureFilePath(const std::string& dir, const std::string& moduleName, int occurrence);
+
+#endif
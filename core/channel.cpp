@@ -0,0 +1,120 @@
+#include "./channel.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+StreamChannel::StreamChannel(std::string consumesFormat, size_t producers, size_t capacity)
+    : consumes(std::move(consumesFormat)), producersLeft(producers), capacity(capacity),
+      eventFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  if (eventFd < 0) {
+    throw std::runtime_error(std::string("eventfd failed: ") + strerror(errno));
+  }
+}
+
+StreamChannel::~StreamChannel() {
+  close(eventFd);
+}
+
+bool StreamChannel::accepts(std::string_view format) const {
+  return consumes == "*" || format == consumes;
+}
+
+void StreamChannel::wake() {
+  uint64_t one = 1;
+  ssize_t n = write(eventFd, &one, sizeof(one));
+  (void)n;
+}
+
+void StreamChannel::push(Storage& batch) {
+  size_t bytes = batch.totalBytes();
+  std::unique_lock<std::mutex> lock(mutex);
+  spaceCv.wait(lock, [&]() { return !attached || detached || pendingBytes < capacity; });
+
+  if (!attached && !spilled && pendingBytes + bytes > capacity) {
+    spilled = true;
+    pending.clear();
+    pendingBytes = 0;
+  }
+
+  if (!detached && !spilled) {
+    bool wasEmpty = pending.empty();
+    for (const auto& [format, items] : batch) {
+      if (!items.empty()) pending[format].append(items);
+    }
+    pendingBytes += bytes;
+    if (wasEmpty) wake();
+  }
+  lock.unlock();
+  batch.clear();
+}
+
+void StreamChannel::producerDone() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (producersLeft > 0) producersLeft--;
+  if (producersLeft == 0) {
+    doneCv.notify_all();
+    wake();
+  }
+}
+
+bool StreamChannel::attach() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (spilled) return false;
+  attached = true;
+  return true;
+}
+
+void StreamChannel::detach() {
+  std::lock_guard<std::mutex> lock(mutex);
+  detached = true;
+  pending.clear();
+  pendingBytes = 0;
+  spaceCv.notify_all();
+}
+
+bool StreamChannel::take(Storage& out) {
+  out.clear();
+  std::lock_guard<std::mutex> lock(mutex);
+  uint64_t counter;
+  ssize_t n = read(eventFd, &counter, sizeof(counter));
+  (void)n;
+  if (pending.empty()) return false;
+
+  std::swap(out, pending);
+  pendingBytes = 0;
+  spaceCv.notify_all();
+  return true;
+}
+
+bool StreamChannel::finished() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return producersLeft == 0 && pending.empty();
+}
+
+size_t StreamChannel::queuedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return pendingBytes;
+}
+
+void StreamChannel::waitProducers() {
+  std::unique_lock<std::mutex> lock(mutex);
+  doneCv.wait(lock, [&]() { return producersLeft == 0; });
+}
+
+void StreamChannel::fixSnapshot(const Storage& storage) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (snapshotFixed) return;
+  snapshotFixed = true;
+  for (const auto& [format, items] : storage) {
+    if (accepts(format)) limits[format] = items.size();
+  }
+}
+
+size_t StreamChannel::snapshotLimit(std::string_view format) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = limits.find(format);
+  return it != limits.end() ? it->second : 0;
+}
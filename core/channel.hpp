@@ -0,0 +1,77 @@
+#ifndef CHANNEL_HPP
+#define CHANNEL_HPP
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include "./storage.hpp"
+
+// Carries data items from running producer modules to one streaming consumer
+// (--stream). Producers push batches as they parse them; the consumer takes
+// everything queued so far in one swap and is woken through an eventfd, so it
+// can wait in its epoll loop. Once the consumer is attached, push() blocks
+// while more than `capacity` bytes are queued: a slow consumer throttles its
+// producers instead of growing the queue. Before that, blocking could
+// deadlock (the consumer may itself wait on a module that waits on our
+// producers), so a queue that would outgrow `capacity` spills instead: it is
+// dropped along with everything pushed after it, and the consumer, refused
+// by attach(), reads the producers' complete output from storage once they
+// are done. After the consumer detaches, nothing blocks.
+class StreamChannel {
+  public:
+    static constexpr size_t DEFAULT_CAPACITY = 4 * 1024 * 1024;
+
+    StreamChannel(std::string consumesFormat, size_t producers, size_t capacity = DEFAULT_CAPACITY);
+    ~StreamChannel();
+
+    StreamChannel(const StreamChannel&) = delete;
+    StreamChannel& operator=(const StreamChannel&) = delete;
+
+    bool accepts(std::string_view format) const;
+
+    // Producer side. push() moves the items out of `batch`.
+    void push(Storage& batch);
+    void producerDone();
+
+    // Consumer side. attach() is false if the channel spilled before it; the
+    // consumer then waits for the producers and reads storage instead.
+    // take() swaps the queued items into `out` (cleared first); false when
+    // nothing is queued.
+    bool attach();
+    void detach();
+    bool take(Storage& out);
+    bool finished() const;
+    void waitProducers();
+    int wakeFd() const { return eventFd; }
+    size_t queuedBytes() const;
+
+    // Items the consumer reads from shared storage instead of the channel:
+    // column sizes from before the first producer merged its output. Fixed
+    // by whichever comes first, the consumer starting or a producer merging;
+    // both happen under the storage lock.
+    void fixSnapshot(const Storage& storage);
+    size_t snapshotLimit(std::string_view format) const;
+
+  private:
+    void wake();
+
+    std::string consumes;
+    size_t producersLeft;
+    size_t capacity;
+    bool attached = false;
+    bool detached = false;
+    bool spilled = false;
+    Storage pending;
+    size_t pendingBytes = 0;
+    bool snapshotFixed = false;
+    std::map<std::string, size_t, std::less<>> limits;
+    int eventFd;
+    mutable std::mutex mutex;
+    std::condition_variable spaceCv;
+    std::condition_variable doneCv;
+};
+
+#endif
@@ -0,0 +1,191 @@
+#include "./console.hpp"
+#include "./modulelog.hpp"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <unistd.h>
+
+namespace {
+
+double secondsSince(ConsoleRenderer::Clock::time_point start) {
+  return std::chrono::duration<double>(ConsoleRenderer::Clock::now() - start).count();
+}
+
+std::string describe(const ConsoleRenderer::Activity& activity) {
+  uint64_t items = activity.items.load(std::memory_order_relaxed);
+  double seconds = secondsSince(activity.startedAt);
+  std::ostringstream line;
+  line << "[~] " << activity.moduleName;
+  if (activity.workers > 1) line << " x" << activity.workers;
+  line << ": " << items << " items, " << std::fixed << std::setprecision(0)
+       << (seconds > 0 ? items / seconds : 0.0) << "/s";
+
+  ModuleProgress progress = ModuleLog::shared().lastProgress(activity.moduleName);
+  if (progress.total > 0 && progress.current >= 0) {
+    line << ", " << progress.current * 100 / progress.total << "% (" << progress.current << "/" << progress.total << ")";
+  }
+  if (!progress.message.empty()) line << " " << progress.message;
+  return line.str();
+}
+
+}
+
+bool parseConsoleMode(const std::string& name, ConsoleMode& mode) {
+  if (name == "quiet") mode = ConsoleMode::QUIET;
+  else if (name == "summary") mode = ConsoleMode::SUMMARY;
+  else if (name == "raw") mode = ConsoleMode::RAW;
+  else return false;
+  return true;
+}
+
+ConsoleRenderer& ConsoleRenderer::shared() {
+  static ConsoleRenderer renderer;
+  return renderer;
+}
+
+ConsoleRenderer::ConsoleRenderer() : live(isatty(STDERR_FILENO)) {}
+
+ConsoleRenderer::~ConsoleRenderer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  if (thread.joinable()) thread.join();
+}
+
+void ConsoleRenderer::setMode(ConsoleMode mode) {
+  flush();
+  currentMode = mode;
+  live = mode == ConsoleMode::SUMMARY && isatty(STDERR_FILENO);
+}
+
+bool ConsoleRenderer::showsProgress() const {
+  return currentMode == ConsoleMode::RAW || (currentMode == ConsoleMode::SUMMARY && !live);
+}
+
+void ConsoleRenderer::ensureThread() {
+  if (!thread.joinable()) thread = std::thread(&ConsoleRenderer::run, this);
+}
+
+void ConsoleRenderer::write(std::string&& text) {
+  if (text.empty()) return;
+  std::unique_lock<std::mutex> lock(mutex);
+  ensureThread();
+  room.wait(lock, [this] { return queuedBytes < QUEUE_LIMIT; });
+  queuedBytes += text.size();
+  queue.push_back(std::move(text));
+  lock.unlock();
+  wake.notify_one();
+}
+
+void ConsoleRenderer::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  drained.wait(lock, [this] { return queue.empty() && !writing; });
+}
+
+void ConsoleRenderer::print(std::ostream& stream, std::string_view text) {
+  std::lock_guard<std::mutex> screen(screenMutex);
+  clearLive();
+  stream << text;
+  stream.flush();
+}
+
+std::shared_ptr<ConsoleRenderer::Activity> ConsoleRenderer::beginModule(const std::string& moduleName, size_t workers) {
+  auto activity = std::make_shared<Activity>();
+  activity->moduleName = moduleName;
+  activity->workers = workers;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (live) ensureThread();
+  activities.push_back(activity);
+  return activity;
+}
+
+void ConsoleRenderer::endModule(const std::shared_ptr<Activity>& activity, int exitCode) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::erase(activities, activity);
+  }
+  if (currentMode == ConsoleMode::RAW) {
+    // The next "Running" line must not overtake this module's output.
+    flush();
+    return;
+  }
+
+  uint64_t items = activity->items.load(std::memory_order_relaxed);
+  double seconds = secondsSince(activity->startedAt);
+  std::ostringstream line;
+  line << (exitCode == 0 ? "[+] " : "[-] ") << activity->moduleName << ": " << items << " items in "
+       << std::fixed << std::setprecision(2) << seconds << "s";
+  if (seconds > 0 && items > 0) line << " (" << std::setprecision(0) << items / seconds << " items/s)";
+  if (exitCode != 0) line << ", exit code " << exitCode;
+  line << "\n";
+  print(std::cout, line.str());
+}
+
+void ConsoleRenderer::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  auto nextDraw = Clock::now();
+  while (true) {
+    auto ready = [this] { return !queue.empty() || stopping; };
+    if (live) wake.wait_until(lock, nextDraw, ready);
+    else wake.wait(lock, ready);
+
+    while (!queue.empty()) {
+      std::string chunk = std::move(queue.front());
+      queue.pop_front();
+      queuedBytes -= chunk.size();
+      writing = true;
+      lock.unlock();
+      room.notify_all();
+      {
+        std::lock_guard<std::mutex> screen(screenMutex);
+        std::cout.write(chunk.data(), chunk.size());
+      }
+      lock.lock();
+    }
+    if (writing) {
+      lock.unlock();
+      std::cout.flush();
+      lock.lock();
+      writing = false;
+    }
+    drained.notify_all();
+
+    if (stopping) break;
+    if (live && Clock::now() >= nextDraw) {
+      lock.unlock();
+      redraw();
+      lock.lock();
+      nextDraw = Clock::now() + RENDER_INTERVAL;
+    }
+  }
+
+  std::lock_guard<std::mutex> screen(screenMutex);
+  clearLive();
+}
+
+void ConsoleRenderer::redraw() {
+  std::vector<std::shared_ptr<Activity>> running;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = activities;
+  }
+  std::string block;
+  for (const auto& activity : running) {
+    block += describe(*activity);
+    block += "\33[K\n";
+  }
+
+  std::lock_guard<std::mutex> screen(screenMutex);
+  clearLive();
+  std::cerr << block;
+  std::cerr.flush();
+  drawnLines = running.size();
+}
+
+void ConsoleRenderer::clearLive() {
+  if (drawnLines == 0) return;
+  std::cerr << "\33[" << drawnLines << "F\33[J";
+  drawnLines = 0;
+}
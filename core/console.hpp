@@ -0,0 +1,100 @@
+#ifndef CONSOLE_HPP
+#define CONSOLE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+// What the console shows of module stdout:
+//   QUIET    one line per module with its item count
+//   SUMMARY  the same, plus (on a terminal) a live line per running module
+//            with items/s and BMOP progress
+//   RAW      every line the module prints, as it prints it
+enum class ConsoleMode {
+  QUIET,
+  SUMMARY,
+  RAW
+};
+
+bool parseConsoleMode(const std::string& name, ConsoleMode& mode);
+
+// Owns the terminal while modules run, from a thread of its own, so writing
+// to it never holds up ingestion. Raw output goes through a bounded queue
+// (writers block only when it is full); the summary is redrawn at most
+// every RENDER_INTERVAL from counters the collectors bump. Engine and log
+// lines printed through print() clear the live lines first.
+class ConsoleRenderer {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // One module invocation on the live display. Collectors add to `items`.
+    struct Activity {
+      std::string moduleName;
+      size_t workers = 1;
+      Clock::time_point startedAt = Clock::now();
+      std::atomic<uint64_t> items{0};
+    };
+
+    static ConsoleRenderer& shared();
+    ~ConsoleRenderer();
+
+    void setMode(ConsoleMode mode);
+    ConsoleMode mode() const { return currentMode; }
+    // False when something else (summary lines or QUIET) stands in for
+    // per-message progress output.
+    bool showsProgress() const;
+
+    // Queues module output for RAW mode. Blocks while QUEUE_LIMIT bytes are
+    // already waiting.
+    void write(std::string&& text);
+    // Returns once everything queued has reached the terminal.
+    void flush();
+    // Writes `text` (whole lines) to `stream` right away.
+    void print(std::ostream& stream, std::string_view text);
+
+    std::shared_ptr<Activity> beginModule(const std::string& moduleName, size_t workers);
+    // Takes the module off the live display and, unless RAW, prints its
+    // final count.
+    void endModule(const std::shared_ptr<Activity>& activity, int exitCode);
+
+    static constexpr size_t QUEUE_LIMIT = 4 * 1024 * 1024;
+    static constexpr std::chrono::milliseconds RENDER_INTERVAL{100};
+
+  private:
+    ConsoleRenderer();
+
+    void ensureThread();
+    void run();
+    void redraw();
+    // Caller holds screenMutex.
+    void clearLive();
+
+    ConsoleMode currentMode = ConsoleMode::SUMMARY;
+    bool live = false;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable room;
+    std::condition_variable drained;
+    std::deque<std::string> queue;
+    size_t queuedBytes = 0;
+    bool writing = false;
+    bool stopping = false;
+    std::thread thread;
+    std::vector<std::shared_ptr<Activity>> activities;
+
+    std::mutex screenMutex;
+    size_t drawnLines = 0;
+};
+
+#endif
@@ -1,4 +1,20 @@
 #include "./core.hpp"
+#include "./eventloop.hpp"
+#include "./bmop.hpp"
+#include "./scheduler.hpp"
+#include "./channel.hpp"
+#include "./registry.hpp"
+#include "./metadata.hpp"
+#include "./metrics.hpp"
+#include "./capture.hpp"
+#include "./modulelog.hpp"
+#include "./console.hpp"
+#include "./limits.hpp"
+#include "./ratelimit.hpp"
+#include "./workerpool.hpp"
+#include "./zygote.hpp"
+#include "./launcher.hpp"
+#include "./toolchain.hpp"
 #include "../include/rapidjson/document.h"
 #include "../include/rapidjson/error/en.h"
 #include <iostream>
@@ -11,25 +27,252 @@
 #include <algorithm>
 #include <cstdlib>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
 
 namespace fs = std::filesystem;
 
 const std::string MODULES_ROOT = "./modules";
 const std::string SHARED_DEPS = "./modules/shared_deps";
 const std::string PROFILES_DIR = "./profiles";
+const std::string MODULE_INDEX_CACHE = "./.bahamut_cache/modules.json";
+const std::string TOOLCHAIN_CACHE = "./.bahamut_cache/toolchains.json";
 
 static bool g_debugMode = false;
+static size_t g_maxJobs = 1;
+static bool g_streaming = false;
+static int g_parallelOverride = -1;
+static int g_defaultTimeoutMs = 0;
+static std::string g_cgroupRoot;
+static std::atomic<uint64_t> g_cgroupSerial{0};
+static RunReport g_runReport;
+static std::string g_reportPath;
+static std::string g_prometheusPath;
+static std::string g_tracePath;
+static CaptureMode g_captureMode = CaptureMode::NONE;
+static std::string g_captureDir;
+static bool g_replayPaced = false;
+static std::mutex g_captureMutex;
+static std::map<std::string, int> g_captureCounts;
+static const int BMOP_HEADER_WAIT_MS = 250;
+
+// With --jobs > 1 several runModuleWithPipe calls share one process: dependency
+// setup (installs, node_modules/python_libs links) is serialized, storage is
+// only touched under g_storageMutex, and console output goes through the
+// ConsoleRenderer, line-whole.
+static std::mutex g_spawnMutex;
+static std::mutex g_storageMutex;
 
 void setDebugMode(bool enabled) {
   g_debugMode = enabled;
+  ModuleLog::shared().setConsoleLevel(enabled ? LogLevel::DEBUG : LogLevel::INFO);
 }
 
 bool isDebugEnabled() {
   return g_debugMode;
 }
 
+void setMaxJobs(size_t jobs) {
+  g_maxJobs = jobs > 0 ? jobs : 1;
+}
+
+size_t getMaxJobs() {
+  return g_maxJobs;
+}
+
+void setStreaming(bool enabled) {
+  g_streaming = enabled;
+}
+
+bool isStreaming() {
+  return g_streaming;
+}
+
+// "auto" is 0 (one worker per CPU), a positive count is itself, anything
+// else is -1.
+int parseParallelSpec(const std::string& spec) {
+  std::string value = trimString(spec);
+  if (value == "auto") return 0;
+  if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) return -1;
+  try {
+    int workers = std::stoi(value);
+    return workers > 0 ? workers : -1;
+  } catch (...) {
+    return -1;
+  }
+}
+
+void setParallelOverride(int workers) {
+  g_parallelOverride = workers;
+}
+
+// Worker processes a module is sharded across. Only consumers are sharded:
+// copies of a pure producer would just emit the same items N times. Output
+// modules neither: they write files, and copies would each write a header
+// and interleave their appends.
+size_t moduleParallelism(const ModuleMetadata& meta) {
+  if (meta.consumes.empty()) return 1;
+  if (meta.type == "output" || meta.type.starts_with("output-")) return 1;
+  int workers = g_parallelOverride >= 0 ? g_parallelOverride : meta.parallel;
+  if (workers == 0) {
+    workers = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  return workers > 1 ? static_cast<size_t>(workers) : 1;
+}
+
+bool setDefaultModuleTimeout(const std::string& spec) {
+  int ms = 0;
+  if (!spec.empty() && !parseDuration(spec, ms)) return false;
+  g_defaultTimeoutMs = ms;
+  return true;
+}
+
+bool setRateLimits(const std::string& specs) {
+  std::vector<std::pair<std::string, double>> parsed;
+  std::istringstream list(specs);
+  std::string spec;
+  while (std::getline(list, spec, ',')) {
+    std::string bucket;
+    double rate;
+    if (!parseRateLimitSpec(trimString(spec), bucket, rate)) return false;
+    parsed.emplace_back(bucket, rate);
+  }
+  for (const auto& [bucket, rate] : parsed) RateLimiter::shared().configure(bucket, rate);
+  return true;
+}
+
+bool setModuleCgroup(const std::string& dir) {
+  if (!dir.empty() && !ModuleCgroup::usableParent(dir)) return false;
+  g_cgroupRoot = dir;
+  return true;
+}
+
+void shutdownPersistentWorkers() {
+  WorkerPool::shared().shutdown();
+}
+
+bool setWarmInterpreters(const std::string& languages, const std::string& preloads) {
+  std::map<std::string, std::vector<std::string>> libraries;
+  std::istringstream list(languages);
+  std::string language;
+  while (std::getline(list, language, ',')) {
+    language = trimString(language);
+    if (language != "python" && language != "node") return false;
+    libraries[language];
+  }
+  std::istringstream preloadList(preloads);
+  std::string preload;
+  while (std::getline(preloadList, preload, ',')) {
+    preload = trimString(preload);
+    size_t colon = preload.find(':');
+    if (colon == std::string::npos || !libraries.count(preload.substr(0, colon))) return false;
+    libraries[preload.substr(0, colon)].push_back(preload.substr(colon + 1));
+  }
+  for (const auto& [name, modules] : libraries) InterpreterPool::shared().enable(name, modules);
+  return true;
+}
+
+void shutdownWarmInterpreters() {
+  InterpreterPool::shared().shutdown();
+}
+
+// The watchdog and rlimits for one invocation of a module.
+static ModuleLimits moduleLimits(const ModuleMetadata& meta) {
+  ModuleLimits limits;
+  int timeout = meta.timeoutMs > 0 ? meta.timeoutMs : g_defaultTimeoutMs;
+  limits.idleTimeoutMs = timeout > INT32_MAX / IDLE_TIMEOUT_FACTOR ? INT32_MAX : timeout * IDLE_TIMEOUT_FACTOR;
+  limits.maxMemoryBytes = meta.maxMemoryBytes;
+  limits.maxCpuSeconds = meta.maxCpuSeconds;
+  return limits;
+}
+
+void setRunReport(const std::string& jsonPath, const std::string& prometheusPath) {
+  g_reportPath = jsonPath;
+  g_prometheusPath = prometheusPath;
+}
+
+void setTraceFile(const std::string& path) {
+  g_tracePath = path;
+}
+
+void setCapture(CaptureMode mode, const std::string& dir, bool paced) {
+  g_captureMode = mode;
+  g_captureDir = dir;
+  g_replayPaced = paced;
+  std::lock_guard<std::mutex> lock(g_captureMutex);
+  g_captureCounts.clear();
+}
+
+bool setModuleLogFile(const std::string& path) {
+  return ModuleLog::shared().setFile(path);
+}
+
+bool setConsoleMode(const std::string& name) {
+  ConsoleMode mode;
+  if (!parseConsoleMode(name, mode)) return false;
+  ConsoleRenderer::shared().setMode(mode);
+  return true;
+}
+
+bool isReplaying() {
+  return g_captureMode == CaptureMode::REPLAY;
+}
+
+// Invocations are numbered per module within a run, so a profile that runs
+// a module twice records (and replays) both.
+static std::string nextCapturePath(const std::string& moduleName) {
+  std::lock_guard<std::mutex> lock(g_captureMutex);
+  return captureFilePath(g_captureDir, moduleName, ++g_captureCounts[moduleName]);
+}
+
+static void beginRun(const std::string& label) {
+  g_runReport.begin(label);
+  ModuleLog::shared().begin();
+  {
+    std::lock_guard<std::mutex> lock(g_captureMutex);
+    g_captureCounts.clear();
+  }
+  if (!g_tracePath.empty()) TraceRecorder::shared().start();
+}
+
+static void finishRun() {
+  LogCounts logged = ModuleLog::shared().totals();
+  uint64_t errors = logged[LogLevel::ERROR] + logged[LogLevel::CRITICAL];
+  if (logged[LogLevel::WARN] > 0 || errors > 0) {
+    std::cout << "[!] Modules reported " << logged[LogLevel::WARN] << " warnings and " << errors << " errors";
+    if (logged[LogLevel::CRITICAL] > 0) std::cout << " (" << logged[LogLevel::CRITICAL] << " fatal)";
+    std::cout << std::endl;
+  }
+
+  if (!g_tracePath.empty()) {
+    TraceRecorder::shared().stop();
+    if (TraceRecorder::shared().write(g_tracePath)) {
+      std::cout << "[+] Trace written to " << g_tracePath << std::endl;
+    } else {
+      std::cout << "[-] Failed to write trace: " << g_tracePath << std::endl;
+    }
+  }
+
+  if (!g_reportPath.empty()) {
+    if (g_runReport.writeJson(g_reportPath)) {
+      std::cout << "[+] Run report written to " << g_reportPath << std::endl;
+    } else {
+      std::cout << "[-] Failed to write run report: " << g_reportPath << std::endl;
+    }
+  }
+  if (!g_prometheusPath.empty() && !g_runReport.writePrometheus(g_prometheusPath)) {
+    std::cout << "[-] Failed to write Prometheus metrics: " << g_prometheusPath << std::endl;
+  }
+}
+
 void DebugLog(const std::string& msg) {
   if (g_debugMode) {
     std::cout << "[DEBUG] " << msg << std::endl;
@@ -45,43 +288,34 @@ void ensurePackageJson(const std::string& path) {
   }
 }
 
-std::string findModulePath(const std::string& moduleName) {
-  if (!fs::exists(MODULES_ROOT)) return "";
-  for (const auto& entry : fs::recursive_directory_iterator(MODULES_ROOT)) {
-    if (entry.is_regular_file() && entry.path().filename() == moduleName) {
-      return entry.path().string();
-    }
-  }
-  return "";
+// Name -> path + metadata index of ./modules, persisted across runs. See
+// ModuleRegistry for how it stays in sync with the tree.
+static ModuleRegistry& moduleRegistry() {
+  static ModuleRegistry registry(MODULES_ROOT, MODULE_INDEX_CACHE);
+  return registry;
 }
 
-std::vector<std::string> getModules() {
-  std::vector<std::string> modules;
-  if (!fs::exists(MODULES_ROOT)) return modules;
-
-  std::set<std::string> allowedExtensions = {".js", ".py", ".sh"};
+static ToolchainCache& toolchainCache() {
+  static ToolchainCache cache(TOOLCHAIN_CACHE);
+  return cache;
+}
 
-  for (const auto& entry : fs::recursive_directory_iterator(MODULES_ROOT)) {
-    if (entry.is_regular_file()) {
-      std::string path = entry.path().string();
-      std::string ext = entry.path().extension().string();
+bool findModule(const std::string& moduleName, ModuleEntry& entry) {
+  TraceSpan span("discover", "registry", moduleName);
+  return moduleRegistry().lookup(moduleName, entry);
+}
 
-      if (path.find("node_modules") != std::string::npos ||
-          path.find("python_libs") != std::string::npos ||
-          path.find("shared_deps") != std::string::npos) {
-        continue;
-      }
+std::string findModulePath(const std::string& moduleName) {
+  ModuleEntry entry;
+  return findModule(moduleName, entry) ? entry.path : "";
+}
 
-      if (allowedExtensions.count(ext)) {
-        modules.push_back(entry.path().filename().string());
-      }
-    }
-  }
-  return modules;
+std::vector<std::string> getModules() {
+  return moduleRegistry().names();
 }
 
-std::string trimString(const std::string& str) {
-  if (str.empty()) return "";
+std::string_view trimView(std::string_view str) {
+  if (str.empty()) return {};
 
   size_t first = 0;
   while (first < str.size()) {
@@ -98,7 +332,7 @@ std::string trimString(const std::string& str) {
     }
   }
 
-  if (first >= str.size()) return "";
+  if (first >= str.size()) return {};
 
   size_t last = str.size() - 1;
   while (last > first) {
@@ -119,67 +353,12 @@ std::string trimString(const std::string& str) {
   return str.substr(first, last - first + 1);
 }
 
-ModuleMetadata parseModuleMetadata(const std::string& modulePath) {
-  ModuleMetadata meta;
-  meta.name = "";
-  meta.description = "";
-  meta.type = "";
-  meta.stage = 999;
-  meta.consumes = "";
-  meta.provides = "";
-  meta.storageBehavior = "add";
-  meta.installCmd = "";
-  meta.installScope = "shared";
-
-  std::ifstream file(modulePath);
-  if (!file.is_open()) return meta;
-
-  std::string line;
-  while (std::getline(file, line)) {
-    if (line.find("Name:") != std::string::npos) {
-      meta.name = trimString(line.substr(line.find("Name:") + 5));
-    }
-    else if (line.find("Description:") != std::string::npos) {
-      meta.description = trimString(line.substr(line.find("Description:") + 12));
-    }
-    else if (line.find("Type:") != std::string::npos) {
-      meta.type = trimString(line.substr(line.find("Type:") + 5));
-    }
-    else if (line.find("Stage:") != std::string::npos) {
-      std::string stageStr = trimString(line.substr(line.find("Stage:") + 6));
-      try {
-        meta.stage = std::stoi(stageStr);
-      } catch (...) {}
-    }
-    else if (line.find("Consumes:") != std::string::npos) {
-      meta.consumes = trimString(line.substr(line.find("Consumes:") + 9));
-    }
-    else if (line.find("Provides:") != std::string::npos) {
-      meta.provides = trimString(line.substr(line.find("Provides:") + 9));
-    }
-    else if (line.find("Install:") != std::string::npos) {
-      meta.installCmd = trimString(line.substr(line.find("Install:") + 8));
-    }
-    else if (line.find("InstallScope:") != std::string::npos) {
-      std::string scope = trimString(line.substr(line.find("InstallScope:") + 13));
-      if (scope.find("isolated") != std::string::npos) meta.installScope = "isolated";
-      else if (scope.find("global") != std::string::npos) meta.installScope = "global";
-      else meta.installScope = "shared";
-    } else if (line.find("Storage:") != std::string::npos) {
-      std::string behavior = trimString(line.substr(line.find("Storage:") + 8));
-      if (behavior == "replace" || behavior == "delete") {
-        meta.storageBehavior = behavior;
-      } else {
-        meta.storageBehavior = "add";
-      }
-    } else if (line.find("Args:") != std::string::npos) {
-      std::string argSpec = trimString(line.substr(line.find("Args:") + 5));
-      meta.argSpecs.push_back(argSpec);
-    }
-  }
-  file.close();
+std::string trimString(const std::string& str) {
+  return std::string(trimView(str));
+}
 
-  return meta;
+ModuleMetadata parseModuleMetadata(const std::string& modulePath) {
+  return MetadataCache::shared().load(modulePath);
 }
 
 std::string getPythonVersion(const std::string& modulePath) {
@@ -191,7 +370,10 @@ std::string getPythonVersion(const std::string& modulePath) {
 
     if (line.find("python3.") != std::string::npos) {
       size_t pos = line.find("python3.");
+      // The result is an executable name, so stop at the version's end.
       std::string version = line.substr(pos + 6, 4);
+      version.erase(std::find_if(version.begin(), version.end(),
+        [](char c) { return c != '.' && !std::isdigit(static_cast<unsigned char>(c)); }), version.end());
       return "python" + version;
     }
     if (line.find("python3") != std::string::npos) {
@@ -204,11 +386,18 @@ std::string getPythonVersion(const std::string& modulePath) {
   return "python3";
 }
 
+// Interpreters pip could not be installed for. Only for this run: someone
+// may install it by hand before the next one.
+static std::mutex g_pipFailedMutex;
+static std::set<std::string> g_pipFailed;
+
 bool ensurePipInstalled(const std::string& pythonCmd) {
-  std::string testCmd = pythonCmd + " -m pip --version >/dev/null 2>&1";
-  if (std::system(testCmd.c_str()) == 0) {
+  std::lock_guard<std::mutex> failedLock(g_pipFailedMutex);
+  Toolchain python;
+  if (toolchainCache().python(pythonCmd, python) && python.pip) {
     return true;
   }
+  if (g_pipFailed.count(pythonCmd)) return false;
 
   std::cout << "[!] pip not found. Installing pip..." << std::endl;
 
@@ -217,6 +406,7 @@ bool ensurePipInstalled(const std::string& pythonCmd) {
 
   if (result == 0) {
     std::cout << "[+] pip installed successfully" << std::endl;
+    toolchainCache().setPip(pythonCmd, true);
     return true;
   }
 
@@ -228,21 +418,18 @@ bool ensurePipInstalled(const std::string& pythonCmd) {
 
     if (result == 0) {
       std::cout << "[+] pip installed successfully" << std::endl;
+      toolchainCache().setPip(pythonCmd, true);
       return true;
     }
   }
 
+  g_pipFailed.insert(pythonCmd);
   std::cout << "[-] Failed to install pip. Install it manually with:" << std::endl;
   std::cout << "    sudo apt-get install " << pythonCmd << "-pip" << std::endl;
   return false;
 }
 
 std::string getPipCommand(const std::string& pythonCmd) {
-  std::string testCmd = pythonCmd + " -m pip --version >/dev/null 2>&1";
-  if (std::system(testCmd.c_str()) == 0) {
-    return pythonCmd + " -m pip";
-  }
-
   if (!ensurePipInstalled(pythonCmd)) {
     return "";
   }
@@ -251,13 +438,15 @@ std::string getPipCommand(const std::string& pythonCmd) {
 }
 
 void installModule(std::string moduleName) {
-  std::string fullPath = findModulePath(moduleName);
-  if (fullPath.empty()) {
+  TraceSpan span("installModule", "setup", moduleName);
+  ModuleEntry module;
+  if (!findModule(moduleName, module)) {
     std::cout << "[-] Error: Module " << moduleName << " not found." << std::endl;
     return;
   }
 
-  ModuleMetadata meta = parseModuleMetadata(fullPath);
+  const std::string& fullPath = module.path;
+  const ModuleMetadata& meta = module.meta;
   std::string moduleDir = fs::path(fullPath).parent_path().string();
 
   if (meta.installCmd.empty()) {
@@ -266,6 +455,7 @@ void installModule(std::string moduleName) {
   }
 
   std::string finalInstall;
+  std::string pipCmd;
   bool isPython = fullPath.ends_with(".py");
   bool isNode = fullPath.ends_with(".js");
 
@@ -273,8 +463,7 @@ void installModule(std::string moduleName) {
     if (isNode) {
       finalInstall = meta.installCmd + " -g";
     } else if (isPython) {
-      std::string pythonCmd = getPythonVersion(fullPath);
-      std::string pipCmd = getPipCommand(pythonCmd);
+      pipCmd = getPipCommand(getPythonVersion(fullPath));
 
       if (pipCmd.empty()) {
         std::cout << "[-] Cannot install: pip not available" << std::endl;
@@ -299,8 +488,7 @@ void installModule(std::string moduleName) {
       ensurePackageJson(targetDir);
       finalInstall = "cd " + targetDir + " && " + meta.installCmd + " --silent";
     } else if (isPython) {
-      std::string pythonCmd = getPythonVersion(fullPath);
-      std::string pipCmd = getPipCommand(pythonCmd);
+      pipCmd = getPipCommand(getPythonVersion(fullPath));
 
       if (pipCmd.empty()) {
         std::cout << "[-] Cannot install: pip not available" << std::endl;
@@ -323,12 +511,8 @@ void installModule(std::string moduleName) {
   }
 
   std::cout << "[+] Installing dependencies (" << meta.installScope << ") for " << moduleName << "..." << std::endl;
-  if (isPython) {
-    std::string pythonCmd = getPythonVersion(fullPath);
-    std::string pipCmd = getPipCommand(pythonCmd);
-    if (!pipCmd.empty()) {
-      std::cout << "[+] Using " << pipCmd << " for installation" << std::endl;
-    }
+  if (!pipCmd.empty()) {
+    std::cout << "[+] Using " << pipCmd << " for installation" << std::endl;
   }
 
   int result = std::system(finalInstall.c_str());
@@ -340,13 +524,14 @@ void installModule(std::string moduleName) {
 }
 
 void uninstallModule(std::string moduleName) {
-  std::string fullPath = findModulePath(moduleName);
-  if (fullPath.empty()) {
+  ModuleEntry module;
+  if (!findModule(moduleName, module)) {
     std::cout << "[-] Error: Module " << moduleName << " not found." << std::endl;
     return;
   }
 
-  ModuleMetadata meta = parseModuleMetadata(fullPath);
+  const std::string& fullPath = module.path;
+  const ModuleMetadata& meta = module.meta;
   std::string moduleDir = fs::path(fullPath).parent_path().string();
 
   try {
@@ -387,6 +572,7 @@ void purgeSharedDeps() {
 }
 
 std::string setupNodeEnvironment(const std::string& fullPath, const std::string& scope, const std::string& moduleDir) {
+  TraceSpan span("setupNodeEnvironment", "setup", fs::path(fullPath).filename().string());
   std::string sourceNodeDir;
 
   if (scope == "global") {
@@ -395,14 +581,9 @@ std::string setupNodeEnvironment(const std::string& fullPath, const std::string&
     else if (fs::exists("/usr/lib/node_modules"))
       sourceNodeDir = "/usr/lib/node_modules";
 
-    if (sourceNodeDir.empty()) {
-      char buffer[128];
-      std::unique_ptr<FILE, decltype(&pclose)> pipe(popen("npm root -g", "r"), pclose);
-      if (pipe && fgets(buffer, sizeof(buffer), pipe.get())) {
-        sourceNodeDir = buffer;
-        if (!sourceNodeDir.empty() && sourceNodeDir.back() == '\n')
-          sourceNodeDir.pop_back();
-      }
+    Toolchain npm;
+    if (sourceNodeDir.empty() && toolchainCache().npm(npm)) {
+      sourceNodeDir = npm.modulesRoot;
     }
   } else if (scope == "isolated") {
     sourceNodeDir = moduleDir + "/node_modules";
@@ -420,25 +601,17 @@ std::string setupNodeEnvironment(const std::string& fullPath, const std::string&
     }
   }
 
-  if (!sourceNodeDir.empty()) {
-    setenv("NODE_PATH", fs::absolute(sourceNodeDir).c_str(), 1);
-  }
-
   return sourceNodeDir;
 }
 
 std::string setupPythonEnvironment(const std::string& fullPath, const std::string& scope, const std::string& moduleDir) {
+  TraceSpan span("setupPythonEnvironment", "setup", fs::path(fullPath).filename().string());
   std::string pythonLibsPath;
 
   if (scope == "global") {
-    std::string pythonCmd = getPythonVersion(fullPath);
-    char buffer[256];
-    std::string cmd = pythonCmd + " -c \"import site; print(site.getsitepackages()[0])\" 2>/dev/null";
-    std::unique_ptr<FILE, decltype(&pclose)> pipe(popen(cmd.c_str(), "r"), pclose);
-    if (pipe && fgets(buffer, sizeof(buffer), pipe.get())) {
-      pythonLibsPath = buffer;
-      if (!pythonLibsPath.empty() && pythonLibsPath.back() == '\n')
-        pythonLibsPath.pop_back();
+    Toolchain python;
+    if (toolchainCache().python(getPythonVersion(fullPath), python)) {
+      pythonLibsPath = python.modulesRoot;
     }
   } else if (scope == "isolated") {
     pythonLibsPath = moduleDir + "/python_libs";
@@ -446,522 +619,1213 @@ std::string setupPythonEnvironment(const std::string& fullPath, const std::strin
     pythonLibsPath = SHARED_DEPS + "/python_libs";
   }
 
-  if (!pythonLibsPath.empty() && fs::exists(pythonLibsPath)) {
-    char* oldPy = std::getenv("PYTHONPATH");
-    std::string newPy = fs::absolute(pythonLibsPath).string() +
-      (oldPy ? ":" + std::string(oldPy) : "");
-    setenv("PYTHONPATH", newPy.c_str(), 1);
+  return pythonLibsPath;
+}
+
+// Module environments by variable, library directory and persistence: a
+// long profile builds each one once, however often its modules run.
+static std::mutex g_environmentMutex;
+static std::map<std::string, std::shared_ptr<const std::vector<std::string>>> g_environments;
+
+std::shared_ptr<const std::vector<std::string>> moduleEnvironment(const std::string& fullPath,
+    const std::string& libsPath, bool persistent) {
+  std::string variable = fullPath.ends_with(".js") ? "NODE_PATH" : fullPath.ends_with(".py") ? "PYTHONPATH" : "";
+  std::string libs;
+  // Python only gets a library directory that exists.
+  if (!variable.empty() && !libsPath.empty() && (variable == "NODE_PATH" || fs::exists(libsPath))) {
+    libs = fs::absolute(libsPath).string();
+  }
+  std::string key = variable + "\n" + libs + "\n" + (persistent ? "persistent" : "");
+
+  std::lock_guard<std::mutex> lock(g_environmentMutex);
+  if (auto it = g_environments.find(key); it != g_environments.end()) return it->second;
+
+  auto env = std::make_shared<std::vector<std::string>>(currentEnvironment());
+  if (!libs.empty()) {
+    // Ahead of what the user's own PYTHONPATH lists, as the module's own.
+    const char* inherited = variable == "PYTHONPATH" ? findEnvironment(*env, variable) : nullptr;
+    if (inherited && *inherited) libs += ":" + std::string(inherited);
+    setEnvironment(*env, variable, libs);
+  }
+  setEnvironment(*env, "BMOP_ACCEPT", "2");
+  if (persistent) setEnvironment(*env, "BMOP_PERSISTENT", "1");
+  g_environments[key] = env;
+  return env;
+}
+
+static void storeDataEvent(const BmopEvent& event, Storage& storage) {
+  if (!event.format.data() || !event.value.data()) return;
+  storage.append(event.format, event.value);
+
+  if (g_debugMode) {
+    std::string valuePreview = event.value.length() > 50 ? std::string(event.value.substr(0, 47)) + "..." : std::string(event.value);
+    DebugLog("parseBMOPLine] Stored: format=" + std::string(event.format) + ", value=" + valuePreview);
+  }
+}
+
+static bool parseBMOPLine(std::string_view line, Storage& storage, BmopDecoder& decoder, BmopEvent& event) {
+  if (line.empty() || line[0] != '{') {
+    event = BmopEvent();
+    return false;
+  }
+
+  if (!decoder.decode(line, event)) {
+    std::cerr << "[Warn] BMOP parse error. Offset: " << decoder.errorOffset()
+      << ", Reason: " << decoder.errorReason() << std::endl;
+    return false;
   }
 
-  return pythonLibsPath;
+  if (event.type == BmopEventType::DATA) {
+    storeDataEvent(event, storage);
+  }
+  else if (event.type == BmopEventType::BATCH_START) {
+    DebugLog("parseBMOPLine] Batch START: format=" + std::string(event.format));
+  }
+  else if (event.type == BmopEventType::BATCH_END) {
+    DebugLog("parseBMOPLine] Batch END marker received");
+  }
+  return true;
+}
+
+void parseBMOPLine(std::string_view line, Storage& storage) {
+  thread_local BmopDecoder decoder;
+  BmopEvent event;
+  parseBMOPLine(line, storage, decoder, event);
 }
 
-void parseBMOPLine(const std::string& line, std::map<std::string, std::vector<DataItem>>& storage) {
-  if (line.empty() || line[0] != '{') return;
+struct ModuleOutputCollector {
+  Storage& storage;
+  std::string logPrefix;
+  BmopDecoder decoder;
+  BmopBinaryDecoder binaryDecoder;
+  BmopEvent event;
+  BmopWire wire = BmopWire::JSONL;
+  std::vector<FormatId> wireFormats;
+  std::function<void(BmopWire)> onWire;
+  // Persistent workers: called once the job's job_done arrives, after which
+  // nothing more is read.
+  std::function<void()> onJobDone;
+  bool jobDone = false;
+  std::vector<StreamChannel*> outputs;
+  std::vector<Storage> outbox;
+  bool echo = false;
+  std::string echoBuffer;
+  // Live item count for the console summary, shared by a module's shards.
+  std::atomic<uint64_t>* liveItems = nullptr;
+  int itemsReported = 0;
+  bool corrupt = false;
+  std::string batchFormat;
+  FormatId batchId = 0;
+  bool inBatch = false;
+  int itemsCollected = 0;
+  int linesRead = 0;
 
-  rapidjson::Document doc;
-  rapidjson::ParseResult ok = doc.Parse(line.c_str());
+  ModuleOutputCollector(Storage& storage, const std::string& logPrefix) : storage(storage), logPrefix(logPrefix) {}
 
-  if (!ok) {
-    rapidjson::Document doc2;
-    rapidjson::ParseResult ok2 = doc2.Parse<rapidjson::kParseDefaultFlags |
-      rapidjson::kParseCommentsFlag |
-      rapidjson::kParseTrailingCommasFlag>(line.c_str());
+  void announceWire(BmopWire selected) {
+    wire = selected;
+    if (onWire) {
+      onWire(selected);
+      onWire = nullptr;
+    }
+  }
 
-    if (!ok2) {
-      std::cerr << "[Warn] BMOP parse error. Offset: " << ok.Offset()
-        << ", Reason: " << rapidjson::GetParseError_En(ok.Code()) << std::endl;
-      return;
+  void publish(std::string_view format, std::string_view value) {
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      if (outputs[i]->accepts(format)) outbox[i].append(format, value);
+    }
+  }
+
+  // Hands what this read produced to streaming consumers; may block on a
+  // full channel, which in turn stops us reading the module's stdout.
+  void flushOutbox() {
+    for (size_t i = 0; i < outbox.size(); ++i) {
+      if (!outbox[i].empty()) outputs[i]->push(outbox[i]);
     }
-    doc.Swap(doc2);
   }
 
-  if (!doc.HasMember("t") || !doc["t"].IsString()) return;
+  void flushEcho() {
+    if (liveItems && itemsCollected != itemsReported) {
+      liveItems->fetch_add(itemsCollected - itemsReported, std::memory_order_relaxed);
+      itemsReported = itemsCollected;
+    }
+    if (echoBuffer.empty()) return;
+    ConsoleRenderer::shared().write(std::move(echoBuffer));
+    echoBuffer.clear();
+  }
 
-  std::string type = doc["t"].GetString();
+  void finishJob() {
+    jobDone = true;
+    if (onJobDone) onJobDone();
+  }
 
-  if (type == "d") {
-    if (!doc.HasMember("f") || !doc.HasMember("v") ||
-        !doc["f"].IsString() || !doc["v"].IsString()) {
+  void feed(LineReader& reader, bool eof) {
+    std::string_view line;
+    while (wire == BmopWire::JSONL && !jobDone && reader.next(line)) {
+      processLine(line);
+    }
+    if (wire == BmopWire::BINARY && !jobDone) {
+      processFrames(reader);
+    }
+    if (!eof) {
+      flushOutbox();
+      flushEcho();
       return;
     }
 
-    DataItem item;
-    item.format = doc["f"].GetString();
-    item.value = doc["v"].GetString();
-    storage[item.format].push_back(item);
+    if (wire == BmopWire::JSONL) {
+      if (reader.takeRemainder(line)) processLine(line);
+    } else if (reader.buffered() > 0 && !corrupt) {
+      std::cerr << "[Warn] " << logPrefix << "BMOP binary stream ended mid-frame ("
+        << reader.buffered() << " bytes dropped)" << std::endl;
+    }
+    flushOutbox();
+    flushEcho();
+    announceWire(wire);
+  }
+
+  void processFrames(LineReader& reader) {
+    while (!corrupt && !jobDone) {
+      std::string_view pending = reader.pending();
+      size_t used = binaryDecoder.decode(pending, event);
+      if (used == BmopBinaryDecoder::INCOMPLETE) return;
+      if (used == BmopBinaryDecoder::CORRUPT) {
+        std::cerr << "[Warn] " << logPrefix << "BMOP binary stream is corrupt, ignoring the rest of it" << std::endl;
+        corrupt = true;
+        reader.consume(pending.size());
+        return;
+      }
 
-    std::string valuePreview = item.value.length() > 50 ? item.value.substr(0, 47) + "..." : item.value;
-    DebugLog("parseBMOPLine] Stored: format=" + item.format + ", value=" + valuePreview);
-  }
-  else if (type == "batch") {
-    if (doc.HasMember("f") && doc["f"].IsString()) {
-      DataItem batchInfo;
-      batchInfo.format = doc["f"].GetString();
-      batchInfo.value = batchInfo.format;
-      storage["__batch_format__"].push_back(batchInfo);
-      DebugLog("parseBMOPLine] Batch START: format=" + batchInfo.format);
+      if (event.type == BmopEventType::DATA && event.formatId == BMOP_NO_FORMAT_ID) {
+        storeDataEvent(event, storage);
+        if (event.format.data() && event.value.data()) {
+          publish(event.format, event.value);
+          itemsCollected++;
+        }
+      } else if (event.type == BmopEventType::DATA) {
+        if (event.formatId >= wireFormats.size()) {
+          wireFormats.resize(event.formatId + 1, BMOP_NO_FORMAT_ID);
+        }
+        FormatId& id = wireFormats[event.formatId];
+        if (id == BMOP_NO_FORMAT_ID) id = storage.intern(event.format);
+        storage.append(id, event.value);
+        publish(event.format, event.value);
+        itemsCollected++;
+      } else if (event.type == BmopEventType::JOB_DONE) {
+        reader.consume(used);
+        finishJob();
+        return;
+      } else if (echo && !event.raw.empty()) {
+        echoBuffer.append(event.raw);
+        echoBuffer += '\n';
+      }
+      reader.consume(used);
     }
   }
-  else if (type == "batch_end") {
-    DebugLog("parseBMOPLine] Batch END marker received");
-  }
-}
 
-void collectModuleOutput(const std::string& moduleName, FILE* pipe, std::map<std::string, std::vector<DataItem>>& storage) {
-  char buffer[4096];
-  std::string lineBuffer;
-  std::string batchFormat;
-  bool inBatch = false;
+  void processLine(std::string_view rawLine) {
+    linesRead++;
+    if (echo) {
+      echoBuffer.append(rawLine);
+      echoBuffer += '\n';
+    }
+    std::string_view line = trimView(rawLine);
+    if (line.empty()) return;
+
+    if (line[0] == '{') {
+      if (!parseBMOPLine(line, storage, decoder, event)) return;
+      if (event.type == BmopEventType::DATA && event.format.data() && event.value.data()) {
+        publish(event.format, event.value);
+        itemsCollected++;
+      }
 
-  while (fgets(buffer, sizeof(buffer), pipe)) {
-    std::string chunk(buffer);
-    lineBuffer += chunk;
+      if (event.type == BmopEventType::HEADER) {
+        announceWire(bmopMajorVersion(event.version) >= 2 ? BmopWire::BINARY : BmopWire::JSONL);
+        DebugLog(logPrefix + "Module speaks BMOP " + std::string(event.version));
+        return;
+      }
+      announceWire(wire);
 
-    size_t pos;
-    while ((pos = lineBuffer.find('\n')) != std::string::npos) {
-      std::string line = lineBuffer.substr(0, pos);
-      lineBuffer = lineBuffer.substr(pos + 1);
+      if (event.type == BmopEventType::JOB_DONE) {
+        finishJob();
+        return;
+      }
 
-      line = trimString(line);
-      if (line.empty()) continue;
+      if (event.type == BmopEventType::BATCH_START && !event.format.empty()) {
+        inBatch = true;
+        batchFormat = event.format;
+        batchId = storage.intern(batchFormat);
+        DebugLog(logPrefix + "Batch START detected. Format: " + batchFormat);
+      }
+      else if (event.type == BmopEventType::BATCH_END) {
+        inBatch = false;
+        DebugLog(logPrefix + "Batch END detected. Total " + batchFormat +
+                 " items: " + std::to_string(storage.count(batchFormat) ? storage[batchFormat].size() : 0));
+        batchFormat.clear();
+      }
+      return;
+    }
 
-      if (line[0] == '{') {
-        parseBMOPLine(line, storage);
+    announceWire(wire);
+    if (inBatch && !batchFormat.empty()) {
+      storage.append(batchId, line);
+      publish(batchFormat, line);
+      itemsCollected++;
 
-        if (line.find("\"t\":\"batch\"") != std::string::npos) {
-          inBatch = true;
-          if (!storage["__batch_format__"].empty()) {
-            batchFormat = storage["__batch_format__"][0].format;
-            storage["__batch_format__"].clear();
-          }
-        } else if (line.find("\"t\":\"batch_end\"") != std::string::npos) {
-          inBatch = false;
-          batchFormat.clear();
+      if (g_debugMode && itemsCollected % 1000 == 0) {
+        std::cout << "[DEBUG] " << logPrefix << "Collected " << itemsCollected
+          << " " << batchFormat << " items so far..." << std::endl;
+      }
+    }
+    else {
+      if (g_debugMode) {
+        DebugLog("Line ignored - Not JSON and not in batch: '" + std::string(line) + "'");
+      }
+    }
+  }
+};
+
+struct StorageFeeder {
+  std::vector<const FormatColumn*> columns;
+  // Sharded feeders send only these item indices of each column; empty
+  // means the whole column.
+  std::vector<std::vector<uint32_t>> picks;
+  size_t columnIndex = 0;
+  size_t itemIndex = 0;
+  int itemsSent = 0;
+  int formatsSent = 0;
+  BmopWire wire = BmopWire::JSONL;
+  BmopBinaryEncoder encoder;
+  std::string prefix;
+  bool started = false;
+  // Persistent workers: the job this input is framed as (see WorkerPool);
+  // 0 for a module that reads until EOF.
+  uint64_t job = 0;
+  bool jobStarted = false;
+
+  static constexpr size_t EGRESS_CHUNK = 64 * 1024;
+
+  StorageFeeder(const Storage& storage, const std::string& consumesFormat) {
+    if (consumesFormat.empty()) return;
+
+    if (consumesFormat == "*") {
+      DebugLog("PARENT: Sending ALL formats from storage");
+      for (const auto& [format, items] : storage) {
+        if (g_debugMode) {
+          std::cout << "[DEBUG] PARENT:   Format '" << format << "' has "
+            << items.size() << " items" << std::endl;
         }
-      } else if (inBatch && !batchFormat.empty()) {
-        DataItem item;
-        item.format = batchFormat;
-        item.value = line;
-        storage[batchFormat].push_back(item);
+        if (!items.empty()) columns.push_back(&items);
+      }
+    } else {
+      DebugLog("PARENT: Sending specific format: '" + consumesFormat + "'");
+      auto it = storage.find(consumesFormat);
+      if (it != storage.end() && !it->second.empty()) {
+        columns.push_back(&it->second);
+      } else {
+        DebugLog("PARENT: No data found for format '" + consumesFormat + "'");
       }
     }
+    formatsSent = static_cast<int>(columns.size());
   }
-}
 
-void pipeDataToModule(FILE* pipe, const std::map<std::string, std::vector<DataItem>>& storage, const std::string& consumesFormat) {
-  if (consumesFormat == "*") {
-    for (const auto& [format, items] : storage) {
-      if (format == "__batch_format__") continue;
-      for (const auto& item : items) {
-        fprintf(pipe, "{\"t\":\"d\",\"f\":\"%s\",\"v\":\"%s\"}\n",
-            item.format.c_str(), item.value.c_str());
-        fflush(pipe);
-      }
+  StorageFeeder() = default;
+
+  // Deals this feeder's items out to `shards` feeders by value hash, so a
+  // value always lands on the same worker. Hashing happens once here rather
+  // than in every shard's produce().
+  std::vector<StorageFeeder> split(size_t shards) const {
+    std::vector<StorageFeeder> parts(shards);
+    for (auto& part : parts) {
+      part.columns = columns;
+      part.picks.resize(columns.size());
     }
-  } else {
-    auto it = storage.find(consumesFormat);
-    if (it != storage.end()) {
-      for (const auto& item : it->second) {
-        fprintf(pipe, "{\"t\":\"d\",\"f\":\"%s\",\"v\":\"%s\"}\n",
-            item.format.c_str(), item.value.c_str());
-        fflush(pipe);
+
+    std::hash<std::string_view> hasher;
+    for (size_t c = 0; c < columns.size(); ++c) {
+      const FormatColumn& column = *columns[c];
+      for (size_t i = 0; i < column.size(); ++i) {
+        parts[hasher(column.value(i)) % shards].picks[c].push_back(static_cast<uint32_t>(i));
       }
     }
+
+    for (auto& part : parts) {
+      part.formatsSent = static_cast<int>(std::count_if(part.picks.begin(), part.picks.end(),
+          [](const auto& indices) { return !indices.empty(); }));
+    }
+    return parts;
+  }
+
+  // Streaming: carries on with the next batch from the channel, which only
+  // holds formats the module consumes.
+  void reset(const Storage& batch) {
+    columns.clear();
+    picks.clear();
+    columnIndex = 0;
+    itemIndex = 0;
+    prefix.clear();
+    for (const auto& [format, items] : batch) {
+      if (!items.empty()) columns.push_back(&items);
+    }
   }
-}
 
-void runModuleWithPipe(const std::string& moduleName, const std::vector<std::string>& args,
-    std::map<std::string, std::vector<DataItem>>& storage,
-    const std::string& consumesFormat) {
-  std::string fullPath = findModulePath(moduleName);
-  if (fullPath.empty()) {
-    std::cout << "[-] Error: Module " << moduleName << " not found." << std::endl;
-    return;
+  // Fills `out` with roughly EGRESS_CHUNK bytes of input: batch frames on a
+  // binary wire, otherwise a run of `d` lines sharing one escaped prefix.
+  bool produce(std::string& out) {
+    if (!started) {
+      started = true;
+      if (wire == BmopWire::BINARY) out += BMOP_BINARY_HEADER;
+    }
+    if (job && !jobStarted) {
+      jobStarted = true;
+      appendJobControl(out, "job");
+    }
+
+    while (columnIndex < columns.size()) {
+      const FormatColumn& column = *columns[columnIndex];
+      const std::vector<uint32_t>* indices = picks.empty() ? nullptr : &picks[columnIndex];
+      size_t itemCount = indices ? indices->size() : column.size();
+      auto valueAt = [&](size_t i) { return column.value(indices ? (*indices)[i] : i); };
+      if (itemIndex >= itemCount) {
+        columnIndex++;
+        itemIndex = 0;
+        prefix.clear();
+        continue;
+      }
+
+      size_t chunkEnd = itemIndex;
+      size_t chunkBytes = 0;
+      while (chunkEnd < itemCount && chunkBytes < EGRESS_CHUNK) {
+        chunkBytes += valueAt(chunkEnd).size() + 8;
+        chunkEnd++;
+      }
+
+      if (wire == BmopWire::BINARY) {
+        uint32_t id = encoder.defineFormat(out, column.name());
+        encoder.writeBatchHeader(out, id, chunkEnd - itemIndex);
+        out.reserve(out.size() + chunkBytes + (chunkEnd - itemIndex) * 2);
+      } else {
+        if (prefix.empty()) prefix = bmopDataPrefix(column.name());
+        out.reserve(out.size() + chunkBytes + (chunkEnd - itemIndex) * (prefix.size() + 3));
+      }
+
+      for (; itemIndex < chunkEnd; ++itemIndex) {
+        if (wire == BmopWire::BINARY) {
+          encoder.writeBatchItem(out, valueAt(itemIndex));
+        } else {
+          out += prefix;
+          appendJsonEscaped(out, valueAt(itemIndex));
+          out += "\"}\n";
+        }
+        itemsSent++;
+
+        if (g_debugMode && itemsSent % 1000 == 0) {
+          std::cout << "[DEBUG] PARENT: Sent " << itemsSent << " items so far..." << std::endl;
+        }
+      }
+      return true;
+    }
+    return false;
   }
 
-  ModuleMetadata meta = parseModuleMetadata(fullPath);
-  std::string moduleDir = fs::path(fullPath).parent_path().string();
+  // Stands in for EOF once the job's input has all been produced.
+  void endJob(std::string& out) {
+    appendJobControl(out, "job_end");
+  }
 
-  DebugLog("====== START " + moduleName + " ======");
-  DebugLog("Before execution - storage contents:");
-  
-  int total_items_before = 0;
-  if (g_debugMode) {
-    for (const auto& [format, items] : storage) {
-      if (format == "__batch_format__") continue;
-      std::cout << "[DEBUG]   " << format << ": " << items.size() << " items" << std::endl;
-      total_items_before += items.size();
+  void appendJobControl(std::string& out, std::string_view kind) {
+    std::string json = "{\"t\":\"" + std::string(kind) + "\",\"id\":" + std::to_string(job) + "}";
+    if (wire == BmopWire::BINARY) {
+      encoder.writeJson(out, json);
+    } else {
+      out += json;
+      out += '\n';
     }
   }
-  
-  DebugLog("Total items in storage: " + std::to_string(total_items_before));
-  DebugLog("Module consumes format: '" + consumesFormat + "'");
+};
+
+// One worker process of a module run. A sharded module has several, each
+// fed its own slice of the input and staging its own output until the
+// module as a whole is merged.
+struct ModuleShard {
+  pid_t pid = -1;
+  int stdinFd = -1;
+  int stdoutFd = -1;
+  int stderrFd = -1;
+  size_t channel = 0;
+  StorageFeeder feeder;
+  Storage staging;
+  ModuleOutputCollector collector;
+  StderrParser logParser;
+  // Signalled by the engine (fatal error or watchdog), not exiting on its own.
+  bool stopped = false;
+  // Its RateLimiter connection, or -1.
+  int rateConnection = -1;
+  // Set for a Persistent module: the warm process this shard runs a job on,
+  // which owns the pipes.
+  std::unique_ptr<PersistentWorker> worker;
+  // Stdin/stdout activity, stamped only while tracing.
+  TraceRecorder::Clock::time_point feedStart, feedEnd, readStart, readEnd;
+
+  ModuleShard(const std::string& moduleName, const std::string& logPrefix)
+    : collector(staging, logPrefix), logParser(moduleName) {}
+};
+
+static pid_t spawnModuleProcess(const std::vector<std::string>& argv, const std::vector<std::string>& env,
+    bool withStdin, const ModuleLimits& limits, const char* cgroupProcs, int rateLimitFd,
+    int& stdinFd, int& stdoutFd, int& stderrFd) {
+  int stdin_pipe[2] = {-1, -1};
+  int stdout_pipe[2] = {-1, -1};
+  int stderr_pipe[2] = {-1, -1};
+
+  auto closeAll = [&]() {
+    for (int fd : {stdin_pipe[0], stdin_pipe[1], stdout_pipe[0], stdout_pipe[1], stderr_pipe[0], stderr_pipe[1]}) {
+      if (fd >= 0) close(fd);
+    }
+  };
+
+  if ((withStdin && pipe2(stdin_pipe, O_CLOEXEC) != 0) ||
+      pipe2(stdout_pipe, O_CLOEXEC) != 0 ||
+      pipe2(stderr_pipe, O_CLOEXEC) != 0) {
+    std::cout << "[-] Failed to create pipes: " << strerror(errno) << std::endl;
+    closeAll();
+    return -1;
+  }
+
+#ifdef F_SETPIPE_SZ
+  // Bigger stdin pipe, fewer wakeups per egress chunk. Best effort: capped by
+  // /proc/sys/fs/pipe-max-size.
+  if (withStdin) fcntl(stdin_pipe[1], F_SETPIPE_SZ, 1024 * 1024);
+#endif
+
+  DebugLog("Pipes created successfully");
+
+  ProcessSpec spec;
+  spec.argv = argv;
+  spec.env = env;
+  if (withStdin) spec.fds.emplace_back(stdin_pipe[0], STDIN_FILENO);
+  spec.fds.emplace_back(stdout_pipe[1], STDOUT_FILENO);
+  spec.fds.emplace_back(stderr_pipe[1], STDERR_FILENO);
+  if (rateLimitFd >= 0) spec.fds.emplace_back(rateLimitFd, RATELIMIT_CHILD_FD);
+  spec.limits = limits;
+  spec.cgroupProcs = cgroupProcs;
+
+  pid_t pid = launchProcess(spec);
+  if (pid < 0) {
+    std::cout << "[-] Cannot start " << argv[0] << ": " << strerror(errno) << std::endl;
+    closeAll();
+    return -1;
+  }
+
+  if (withStdin) close(stdin_pipe[0]);
+  close(stdout_pipe[1]);
+  close(stderr_pipe[1]);
+
+  stdinFd = withStdin ? stdin_pipe[1] : -1;
+  stdoutFd = stdout_pipe[0];
+  stderrFd = stderr_pipe[0];
+  return pid;
+}
+
+void collectModuleOutput(const std::string& moduleName, FILE* pipe, Storage& storage) {
+  DebugLog("Collecting output from " + moduleName);
+  ModuleOutputCollector collector(storage, "");
+  LineReader reader;
+  size_t available = 0;
+  char* dst;
+  size_t n;
+  while (dst = reader.prepare(ModuleIOLoop::READ_CHUNK, available), (n = fread(dst, 1, available, pipe)) > 0) {
+    reader.commit(n);
+    collector.feed(reader, false);
+  }
+  collector.feed(reader, true);
+}
+
+void pipeDataToModule(FILE* pipe, const Storage& storage, const std::string& consumesFormat, BmopWire wire) {
+  ScopedSigpipeBlock sigpipe;
+  StorageFeeder feeder(storage, consumesFormat);
+  feeder.wire = wire;
+  std::string chunk;
+  bool more = true;
+  while (more) {
+    chunk.clear();
+    more = feeder.produce(chunk);
+    if (!chunk.empty()) fwrite(chunk.data(), 1, chunk.size(), pipe);
+  }
+  fflush(pipe);
+}
+
+// Installs/links the module's dependencies and builds its argv from `args`
+// as they are (no shell splits or expands them), and `env`, the environment
+// it gets. Empty when there is no runner for the module's language. Called
+// with g_spawnMutex held: installs and node_modules links must not race.
+static std::vector<std::string> prepareModuleArgv(const std::string& moduleName, const ModuleEntry& module,
+    const std::vector<std::string>& args, std::shared_ptr<const std::vector<std::string>>& env) {
+  const std::string& fullPath = module.path;
+  const ModuleMetadata& meta = module.meta;
+  std::string moduleDir = fs::path(fullPath).parent_path().string();
+  std::string libsPath;
 
   if (fullPath.ends_with(".js")) {
     if (!meta.installCmd.empty() && meta.installScope != "global") {
-      std::string nodeDir = setupNodeEnvironment(fullPath, meta.installScope, moduleDir);
-      if (!fs::exists(nodeDir)) {
+      libsPath = setupNodeEnvironment(fullPath, meta.installScope, moduleDir);
+      if (!fs::exists(libsPath)) {
         std::cout << "[!] Dependencies not found. Installing..." << std::endl;
         installModule(moduleName);
-        setupNodeEnvironment(fullPath, meta.installScope, moduleDir);
+        libsPath = setupNodeEnvironment(fullPath, meta.installScope, moduleDir);
       }
     } else {
-      setupNodeEnvironment(fullPath, meta.installScope, moduleDir);
+      libsPath = setupNodeEnvironment(fullPath, meta.installScope, moduleDir);
     }
   }
   else if (fullPath.ends_with(".py")) {
     if (!meta.installCmd.empty() && meta.installScope != "global") {
-      std::string pythonLibs = setupPythonEnvironment(fullPath, meta.installScope, moduleDir);
-      if (!fs::exists(pythonLibs)) {
+      libsPath = setupPythonEnvironment(fullPath, meta.installScope, moduleDir);
+      if (!fs::exists(libsPath)) {
         std::cout << "[!] Dependencies not found. Installing..." << std::endl;
         installModule(moduleName);
-        setupPythonEnvironment(fullPath, meta.installScope, moduleDir);
+        libsPath = setupPythonEnvironment(fullPath, meta.installScope, moduleDir);
       }
     } else {
-      setupPythonEnvironment(fullPath, meta.installScope, moduleDir);
+      libsPath = setupPythonEnvironment(fullPath, meta.installScope, moduleDir);
     }
   }
+  env = moduleEnvironment(fullPath, libsPath, meta.persistent);
 
-  std::string runner;
+  std::vector<std::string> argv;
   if (fullPath.ends_with(".js")) {
-    runner = "node";
+    argv = {"node"};
   } else if (fullPath.ends_with(".py")) {
-    runner = getPythonVersion(fullPath) + " -u";
-    DebugLog("Using Python runner with -u flag: " + runner);
+    argv = {getPythonVersion(fullPath), "-u"};
+    DebugLog("Using Python runner with -u flag: " + argv[0]);
   } else if (fullPath.ends_with(".sh")) {
-    runner = "bash";
+    argv = {"bash"};
   }
 
-  if (runner.empty()) {
+  if (argv.empty()) {
     std::cout << "[-] No runner found for module: " << moduleName << std::endl;
-    return;
+    return argv;
   }
 
-  std::cout << "------------------------------------------" << std::endl;
-  std::cout << "Running (" << meta.installScope << "): " << moduleName;
-  if (!consumesFormat.empty()) {
-    std::cout << " [consumes: " << consumesFormat << "]";
+  argv.push_back(fullPath);
+  argv.insert(argv.end(), args.begin(), args.end());
+  if (g_debugMode) {
+    std::string cmd;
+    for (const auto& arg : argv) cmd += (cmd.empty() ? "" : " ") + arg;
+    DebugLog("Full command: " + cmd);
   }
-  std::cout << std::endl;
+  return argv;
+}
 
-  std::string cmd = runner + " " + fullPath;
-  for (const auto& arg : args) {
-    cmd += " " + arg;
+// Hands recorded stdout to the shards' collectors and stderr to their log
+// parsers as if it had just been read from the module.
+static void replayCapture(const Capture& capture, std::vector<std::unique_ptr<ModuleShard>>& shards, bool paced) {
+  std::vector<std::unique_ptr<LineReader>> readers;
+  std::vector<std::unique_ptr<LineReader>> errReaders;
+  for (size_t i = 0; i < shards.size(); ++i) {
+    readers.push_back(std::make_unique<LineReader>());
+    errReaders.push_back(std::make_unique<LineReader>(ModuleIOLoop::READ_CHUNK));
+  }
+  std::string_view line;
+
+  auto start = std::chrono::steady_clock::now();
+  for (const CaptureChunk& chunk : capture.chunks) {
+    if (paced) std::this_thread::sleep_until(start + std::chrono::microseconds(chunk.offsetUs));
+    if (chunk.stream == CaptureStream::STDOUT) {
+      readers[chunk.shard]->append(chunk.data.data(), chunk.data.size());
+      shards[chunk.shard]->collector.feed(*readers[chunk.shard], false);
+    } else {
+      errReaders[chunk.shard]->append(chunk.data.data(), chunk.data.size());
+      while (errReaders[chunk.shard]->next(line)) shards[chunk.shard]->logParser.feed(line);
+    }
   }
-  DebugLog("Full command: " + cmd);
-
-  if (!consumesFormat.empty()) {
-    DebugLog("====== MODULE CONSUMES DATA ======");
-    DebugLog("Setting up bidirectional pipes...");
-
-    int stdin_pipe[2];
-    int stdout_pipe[2];
+  for (size_t i = 0; i < shards.size(); ++i) {
+    shards[i]->collector.feed(*readers[i], true);
+    if (errReaders[i]->takeRemainder(line)) shards[i]->logParser.feed(line);
+  }
+}
 
-    if (pipe(stdin_pipe) != 0) {
-      std::cout << "[-] Failed to create stdin pipe" << std::endl;
-      return;
-    }
-    if (pipe(stdout_pipe) != 0) {
-      std::cout << "[-] Failed to create stdout pipe" << std::endl;
-      close(stdin_pipe[0]);
-      close(stdin_pipe[1]);
-      return;
-    }
+// wait4 for our own children; a fork server's report for the ones it
+// forked.
+static bool reapModuleProcess(pid_t pid, int& status, struct rusage& usage, int timeoutMs) {
+  InterpreterPool& interpreters = InterpreterPool::shared();
+  if (interpreters.forked(pid)) return interpreters.reap(pid, status, usage, timeoutMs);
+  return reapProcess(pid, status, usage, timeoutMs);
+}
 
-    DebugLog("Pipes created successfully");
-    DebugLog("Forking process...");
+void runModuleWithPipe(const std::string& moduleName, const std::vector<std::string>& args,
+    Storage& storage,
+    const std::string& consumesFormat,
+    const ModuleStreams* streams) {
+  TraceSpan moduleSpan(moduleName, "module", moduleName);
+  bool tracing = TraceRecorder::shared().enabled();
+  ModuleEntry module;
+  if (!findModule(moduleName, module)) {
+    std::cout << "[-] Error: Module " << moduleName << " not found." << std::endl;
+    return;
+  }
 
-    pid_t pid = fork();
-    if (pid == 0) {
-      close(stdin_pipe[1]);
-      dup2(stdin_pipe[0], STDIN_FILENO);
-      close(stdin_pipe[0]);
+  const ModuleMetadata& meta = module.meta;
 
-      close(stdout_pipe[0]);
-      dup2(stdout_pipe[1], STDOUT_FILENO);
-      close(stdout_pipe[1]);
+  DebugLog("====== START " + moduleName + " ======");
+  DebugLog("Before execution - storage contents:");
+  
+  int total_items_before = 0;
+  if (g_debugMode) {
+    std::lock_guard<std::mutex> storageLock(g_storageMutex);
+    for (const auto& [format, items] : storage) {
+      std::cout << "[DEBUG]   " << format << ": " << items.size() << " items" << std::endl;
+      total_items_before += items.size();
+    }
+  }
+  
+  DebugLog("Total items in storage: " + std::to_string(total_items_before));
+  DebugLog("Module consumes format: '" + consumesFormat + "'");
 
-      std::vector<char*> exec_args;
-      std::istringstream iss(cmd);
-      std::string token;
+  // A streaming consumer takes its input from one channel, so it is never
+  // sharded (the scheduler does not stream into parallel modules either).
+  StreamChannel* input = (!consumesFormat.empty() && streams) ? streams->input : nullptr;
+  size_t workers = input ? 1 : moduleParallelism(meta);
+  if (workers > 1) {
+    // Idle workers would only cost a process start. Nothing writes our format
+    // while we run, so this count still holds when the input is split.
+    std::lock_guard<std::mutex> storageLock(g_storageMutex);
+    size_t available = 0;
+    if (consumesFormat == "*") {
+      available = storage.totalItems();
+    } else if (auto it = storage.find(consumesFormat); it != storage.end()) {
+      available = it->second.size();
+    }
+    workers = std::max<size_t>(1, std::min(workers, available));
+  }
 
-      while (iss >> token) {
-        char* arg = new char[token.size() + 1];
-        strcpy(arg, token.c_str());
-        exec_args.push_back(arg);
+  std::string capturePath = g_captureMode == CaptureMode::NONE ? "" : nextCapturePath(moduleName);
+  bool replaying = g_captureMode == CaptureMode::REPLAY;
+  Capture capture;
+  if (replaying) {
+    std::string error;
+    if (!loadCapture(capturePath, capture, error)) {
+      std::cout << "[-] Cannot replay " << moduleName << ": " << error << std::endl;
+      return;
+    }
+    // Output is merged per worker, so replay with as many as were recorded.
+    workers = capture.shards;
+  }
+
+  std::vector<std::string> argv;
+  std::shared_ptr<const std::vector<std::string>> env;
+  if (!replaying) {
+    // Only dependency setup is serialized: each child gets its environment
+    // explicitly, so modules can be started concurrently.
+    auto lockRequestedAt = TraceRecorder::Clock::now();
+    std::lock_guard<std::mutex> spawnLock(g_spawnMutex);
+    TraceRecorder::shared().span("spawn lock", "process", lockRequestedAt, TraceRecorder::Clock::now(), moduleName);
+    argv = prepareModuleArgv(moduleName, module, args, env);
+    if (argv.empty()) return;
+  }
+  // Warm workers are only reused for the same command line and module file.
+  bool persistent = meta.persistent && !replaying;
+  std::string workerKey;
+  if (persistent) {
+    for (const auto& arg : argv) workerKey += arg + '\0';
+    workerKey += std::to_string(module.mtime);
+  }
+
+  {
+    std::ostringstream banner;
+    banner << "------------------------------------------\n";
+    banner << "Running (" << (replaying ? "replay" : meta.installScope) << "): " << moduleName;
+    if (!consumesFormat.empty()) {
+      banner << " [consumes: " << consumesFormat << "]";
+    }
+    if (workers > 1) {
+      banner << " [workers: " << workers << "]";
+    }
+    banner << "\n";
+    ConsoleRenderer::shared().print(std::cout, banner.str());
+  }
+
+  bool consumes = !consumesFormat.empty();
+  DebugLog(consumes ? "====== MODULE CONSUMES DATA ======" : "====== MODULE GENERATES DATA ONLY ======");
+
+  ModuleLimits limits = moduleLimits(meta);
+  ModuleCgroup cgroup;
+  // A persistent worker outlives this invocation's leaf, so it only gets
+  // the rlimits.
+  if (!replaying && !persistent && !g_cgroupRoot.empty()) {
+    std::string leaf = "bahamut-" + std::to_string(getpid()) + "-" + std::to_string(g_cgroupSerial++) + "-";
+    for (char c : moduleName) leaf += std::isalnum(static_cast<unsigned char>(c)) || c == '.' ? c : '_';
+    if (!cgroup.create(g_cgroupRoot, leaf, limits.maxMemoryBytes * workers)) {
+      std::cout << "[!] Cannot create cgroup " << leaf << " under " << g_cgroupRoot << ": " << strerror(errno) << std::endl;
+    }
+  }
+  const char* cgroupProcs = cgroup.active() ? cgroup.procsFile().c_str() : nullptr;
+
+  // Workers get a rate limiter socket if the module declares a rate or the
+  // run pins any; a module may draw from any bucket.
+  RateLimiter& rateLimiter = RateLimiter::shared();
+  std::string rateBucket = meta.rateLimitKey.empty() ? moduleName : meta.rateLimitKey;
+  if (meta.rateLimit > 0) rateLimiter.declare(rateBucket, meta.rateLimit);
+  bool rateLimited = !replaying && (meta.rateLimit > 0 || rateLimiter.anyConfigured());
+
+  // --warm: start on a pre-booted interpreter where one is free.
+  InterpreterPool& interpreters = InterpreterPool::shared();
+  InterpreterPool::Launch warmLaunch;
+  warmLaunch.language = module.path.ends_with(".py") ? "python" : module.path.ends_with(".js") ? "node" : "";
+  bool warmStart = !replaying && !persistent && !warmLaunch.language.empty() && interpreters.enabled(warmLaunch.language);
+  if (warmStart) {
+    warmLaunch.interpreter = warmLaunch.language == "python" ? getPythonVersion(module.path) : "node";
+    warmLaunch.path = module.path;
+    warmLaunch.args = args;
+    warmLaunch.cwd = fs::current_path().string();
+    warmLaunch.limits = limits;
+    warmLaunch.cgroupProcs = cgroupProcs;
+    warmLaunch.withStdin = consumes;
+  }
+
+  auto spawnBegin = TraceRecorder::Clock::now();
+  std::vector<std::unique_ptr<ModuleShard>> shards;
+  for (size_t i = 0; i < workers; ++i) {
+    auto shard = std::make_unique<ModuleShard>(moduleName, workers > 1 ? "PARENT[" + std::to_string(i) + "]: " : "PARENT: ");
+    if (persistent) shard->worker = WorkerPool::shared().acquire(workerKey);
+    if (shard->worker) {
+      DebugLog("Reusing warm worker " + std::to_string(shard->worker->pid) + " for " + moduleName);
+    } else if (!replaying) {
+      int rateLimitFd = -1;
+      if (rateLimited) shard->rateConnection = rateLimiter.connect(rateBucket, rateLimitFd);
+      std::vector<std::string> shardEnv;
+      if (rateLimitFd >= 0) {
+        shardEnv = *env;
+        setEnvironment(shardEnv, "BMOP_RATELIMIT_FD", std::to_string(RATELIMIT_CHILD_FD));
       }
-      exec_args.push_back(nullptr);
-
-      execvp(exec_args[0], exec_args.data());
-
-      std::cerr << "[DEBUG] CHILD: execvp FAILED! Error: " << strerror(errno) << std::endl;
-
-      for (auto& arg : exec_args) {
-        if (arg) delete[] arg;
+      const std::vector<std::string>& childEnv = rateLimitFd >= 0 ? shardEnv : *env;
+      shard->pid = -1;
+      if (warmStart) {
+        InterpreterPool::Launch launch = warmLaunch;
+        launch.rateLimitFd = rateLimitFd;
+        launch.env = childEnv;
+        shard->pid = interpreters.launch(launch, shard->stdinFd, shard->stdoutFd, shard->stderrFd);
+        if (shard->pid >= 0) DebugLog("Started " + moduleName + " on a warm " + launch.language + " interpreter");
       }
-
-      exit(EXIT_FAILURE);
-    }
-    else if (pid > 0) {
-      DebugLog("PARENT PROCESS: Child PID = " + std::to_string(pid));
-
-      close(stdin_pipe[0]);
-      close(stdout_pipe[1]);
-
-      DebugLog("PARENT: Writing data to module's stdin...");
-      FILE* writePipe = fdopen(stdin_pipe[1], "w");
-      if (!writePipe) {
-        std::cout << "[-] Failed to open write pipe" << std::endl;
-        close(stdin_pipe[1]);
-        close(stdout_pipe[0]);
-        return;
+      // A persistent module always gets stdin: its jobs arrive there.
+      if (shard->pid < 0) {
+        shard->pid = spawnModuleProcess(argv, childEnv, consumes || persistent,
+          limits, cgroupProcs, rateLimitFd, shard->stdinFd, shard->stdoutFd, shard->stderrFd);
       }
-
-      int items_sent = 0;
-      int formats_sent = 0;
-
-      if (consumesFormat == "*") {
-        DebugLog("PARENT: Sending ALL formats from storage");
-        
-        if (g_debugMode) {
-          for (const auto& [format, items] : storage) {
-            if (format == "__batch_format__") continue;
-            std::cout << "[DEBUG] PARENT:   Format '" << format << "' has "
-              << items.size() << " items" << std::endl;
-
-            if (items.empty()) continue;
-
-            formats_sent++;
-            for (const auto& item : items) {
-              fprintf(writePipe, "{\"t\":\"d\",\"f\":\"%s\",\"v\":\"%s\"}\n",
-                  item.format.c_str(), item.value.c_str());
-              items_sent++;
-
-              if (items_sent % 1000 == 0) {
-                std::cout << "[DEBUG] PARENT: Sent " << items_sent << " items so far..." << std::endl;
-              }
-            }
-          }
-        } else {
-          for (const auto& [format, items] : storage) {
-            if (format == "__batch_format__") continue;
-            if (items.empty()) continue;
-
-            formats_sent++;
-            for (const auto& item : items) {
-              fprintf(writePipe, "{\"t\":\"d\",\"f\":\"%s\",\"v\":\"%s\"}\n",
-                  item.format.c_str(), item.value.c_str());
-              items_sent++;
-            }
-          }
-        }
-      } else {
-        DebugLog("PARENT: Sending specific format: '" + consumesFormat + "'");
-        auto it = storage.find(consumesFormat);
-        if (it != storage.end() && !it->second.empty()) {
-          formats_sent = 1;
-          for (const auto& item : it->second) {
-            fprintf(writePipe, "{\"t\":\"d\",\"f\":\"%s\",\"v\":\"%s\"}\n",
-                item.format.c_str(), item.value.c_str());
-            items_sent++;
-          }
-        } else {
-          DebugLog("PARENT: No data found for format '" + consumesFormat + "'");
-        }
+      if (rateLimitFd >= 0) close(rateLimitFd);
+      if (shard->pid < 0) {
+        if (shard->rateConnection >= 0) rateLimiter.disconnect(shard->rateConnection);
+        break;
       }
-
-      DebugLog("PARENT: Finished writing. Total: " + std::to_string(items_sent) + 
-               " items from " + std::to_string(formats_sent) + " formats");
-
-      fflush(writePipe);
-      fclose(writePipe);
-      DebugLog("PARENT: Write pipe closed (EOF sent to module)");
-
-      DebugLog("PARENT: Reading module output from stdout...");
-
-      if (!consumesFormat.empty() && consumesFormat != "*") {
-        std::string currentModulePath = findModulePath(moduleName);
-        if (!currentModulePath.empty()) {
-          ModuleMetadata currentMeta = parseModuleMetadata(currentModulePath);
-          if (currentMeta.provides == consumesFormat) {
-            if (currentMeta.storageBehavior == "replace") {
-              DebugLog("STORAGE BEHAVIOR: REPLACE for '" + consumesFormat + "'");
-              DebugLog("  Clearing " + std::to_string(storage[consumesFormat].size()) + " existing items.");
-              storage[consumesFormat].clear();
-
-            } else if (currentMeta.storageBehavior == "delete") {
-              DebugLog("STORAGE BEHAVIOR: DELETE for '" + consumesFormat + "'");
-              DebugLog("  Removing key and " + std::to_string(storage[consumesFormat].size()) + " items.");
-              storage.erase(consumesFormat);
-            }
-          }
-        }
+      if (persistent) {
+        shard->worker = std::make_unique<PersistentWorker>();
+        shard->worker->pid = shard->pid;
+        shard->worker->stdinFd = shard->stdinFd;
+        shard->worker->stdoutFd = shard->stdoutFd;
+        shard->worker->stderrFd = shard->stderrFd;
+        shard->worker->rateConnection = shard->rateConnection;
       }
-
-      FILE* readPipe = fdopen(stdout_pipe[0], "r");
-      if (!readPipe) {
-        std::cout << "[-] Failed to open read pipe" << std::endl;
-        close(stdout_pipe[0]);
-        return;
+    }
+    if (shard->worker) {
+      shard->pid = shard->worker->pid;
+      shard->stdinFd = shard->worker->stdinFd;
+      shard->stdoutFd = shard->worker->stdoutFd;
+      shard->stderrFd = shard->worker->stderrFd;
+      shard->rateConnection = shard->worker->rateConnection;
+    }
+    shards.push_back(std::move(shard));
+  }
+  if (shards.size() < workers) {
+    std::cout << "[-] Failed to execute module" << std::endl;
+    for (auto& shard : shards) {
+      for (int fd : {shard->stdinFd, shard->stdoutFd, shard->stderrFd}) {
+        if (fd >= 0) close(fd);
       }
+      kill(shard->pid, SIGKILL);
+      int status;
+      struct rusage usage;
+      reapModuleProcess(shard->pid, status, usage, 0);
+      if (shard->rateConnection >= 0) rateLimiter.disconnect(shard->rateConnection);
+    }
+    return;
+  }
+  auto spawnedAt = RunReport::Clock::now();
+  TraceRecorder::shared().span("spawn", "process", spawnBegin, spawnedAt, moduleName);
+  for (const auto& shard : shards) {
+    if (!replaying) DebugLog("PARENT PROCESS: Child PID = " + std::to_string(shard->pid));
+  }
 
-      char buffer[4096];
-      std::string lineBuffer;
-      std::string batchFormat;
-      bool inBatch = false;
-      int items_collected = 0;
-      int lines_read = 0;
-
-      while (fgets(buffer, sizeof(buffer), readPipe)) {
-        lines_read++;
-
-        std::cout << buffer;
+  auto activity = ConsoleRenderer::shared().beginModule(moduleName, shards.size());
 
-        std::string chunk(buffer);
-        lineBuffer += chunk;
+  CaptureWriter recorder;
+  if (g_captureMode == CaptureMode::RECORD && !recorder.open(capturePath)) {
+    std::cout << "[-] Cannot record " << moduleName << " to " << capturePath << std::endl;
+  }
 
-        size_t pos;
-        while ((pos = lineBuffer.find('\n')) != std::string::npos) {
-          std::string line = lineBuffer.substr(0, pos);
-          lineBuffer = lineBuffer.substr(pos + 1);
+  Storage snapshot;
+  Storage streamed;
 
-          line = trimString(line);
-          if (line.empty()) continue;
+  if (input && !replaying && !input->attach()) {
+    // The channel spilled before we got here; our whole input is in storage
+    // once the producers have merged, as if we had waited for them.
+    DebugLog("Stream channel spilled, reading input from storage after the producers finish");
+    input->waitProducers();
+    input = nullptr;
+  }
 
-          if (line[0] == '{') {
-            parseBMOPLine(line, storage);
+  std::unique_lock<std::mutex> storageLock(g_storageMutex);
+  if (input && !replaying) {
+    // Streamed writers keep appending to storage while we run, so feed from a
+    // private copy of what was there before them; their items arrive through
+    // the channel.
+    input->fixSnapshot(storage);
+    for (const auto& [format, items] : storage) {
+      size_t limit = std::min(items.size(), input->snapshotLimit(format));
+      if (limit == 0) continue;
+      FormatColumn& copy = snapshot[format];
+      for (size_t i = 0; i < limit; ++i) copy.append(items.value(i));
+    }
+  }
+  StorageFeeder feeder(input ? snapshot : storage, consumesFormat);
+  if (workers > 1) {
+    std::vector<StorageFeeder> parts = feeder.split(workers);
+    for (size_t i = 0; i < workers; ++i) shards[i]->feeder = std::move(parts[i]);
+  } else {
+    shards[0]->feeder = std::move(feeder);
+  }
+  storageLock.unlock();
+
+  for (auto& shard : shards) {
+    PersistentWorker* worker = shard->worker.get();
+    if (!worker) continue;
+    shard->feeder.job = ++worker->jobs;
+    // Both ends keep their format tables across jobs.
+    shard->feeder.encoder = std::move(worker->encoder);
+    shard->collector.binaryDecoder = std::move(worker->decoder);
+    if (worker->jobs > 1) {
+      // The header came with the first job.
+      shard->feeder.started = true;
+      shard->feeder.wire = worker->wire;
+      shard->collector.wire = worker->wire;
+    }
+  }
 
-            if (!storage["__batch_format__"].empty()) {
-              inBatch = true;
-              batchFormat = storage["__batch_format__"][0].format;
-              storage["__batch_format__"].clear();
-              DebugLog("PARENT: Batch START detected. Format: " + batchFormat);
-            }
-            else if (line.find("batch_end") != std::string::npos) {
-              inBatch = false;
-              DebugLog("PARENT: Batch END detected. Total collected: " + 
-                       std::to_string(storage[batchFormat].size()) + " items");
-              batchFormat.clear();
-            }
-          }
-          else if (inBatch && !batchFormat.empty()) {
-            DataItem item;
-            item.format = batchFormat;
-            item.value = line;
-            storage[batchFormat].push_back(item);
-            items_collected++;
-
-            if (g_debugMode && items_collected % 1000 == 0) {
-              std::cout << "[DEBUG] PARENT: Collected " << items_collected
-                << " items from batch" << std::endl;
-            }
-          }
+  ModuleIOLoop loop;
+  bool terminated = false;
+  std::string killed;
+  for (size_t i = 0; i < shards.size(); ++i) {
+    ModuleShard& shard = *shards[i];
+    ModuleOutputCollector& collector = shard.collector;
+    collector.echo = ConsoleRenderer::shared().mode() == ConsoleMode::RAW;
+    collector.liveItems = &activity->items;
+    if (streams && !streams->outputs.empty()) {
+      collector.outputs = streams->outputs;
+      collector.outbox.resize(collector.outputs.size());
+    }
+    if (replaying) continue;
+
+    ModuleIOLoop::Handlers handlers;
+    if (input) {
+      handlers.produce = [&shard, &streamed, input](std::string& out) {
+        if (shard.feeder.produce(out)) return true;
+        if (input->take(streamed)) {
+          shard.feeder.reset(streamed);
+          shard.feeder.produce(out);
+          return true;
         }
+        return !input->finished();
+      };
+      handlers.inputWakeFd = input->wakeFd();
+    } else if (consumes) {
+      handlers.produce = [&shard](std::string& out) { return shard.feeder.produce(out); };
+    }
+    if (shard.worker) {
+      handlers.borrowed = true;
+      handlers.produce = [&shard, produce = std::move(handlers.produce)](std::string& out) {
+        if (produce ? produce(out) : shard.feeder.produce(out)) return true;
+        shard.feeder.endJob(out);
+        return false;
+      };
+      collector.onJobDone = [&loop, &shard]() { loop.release(shard.channel); };
+    }
+    if (tracing && handlers.produce) {
+      handlers.produce = [&shard, produce = std::move(handlers.produce)](std::string& out) {
+        if (produce(out)) return true;
+        if (shard.feedEnd == TraceRecorder::Clock::time_point{}) shard.feedEnd = TraceRecorder::Clock::now();
+        return false;
+      };
+    }
+    handlers.stdoutReader = [&collector, &shard, &recorder, i, tracing](LineReader& reader, bool eof) {
+      if (tracing) {
+        auto now = TraceRecorder::Clock::now();
+        if (shard.readStart == TraceRecorder::Clock::time_point{}) shard.readStart = now;
+        if (eof) shard.readEnd = now;
       }
-
-      DebugLog("PARENT: Finished reading module output");
-      DebugLog("PARENT: Lines read: " + std::to_string(lines_read));
-      DebugLog("PARENT: Items collected: " + std::to_string(items_collected));
-
-      fclose(readPipe);
-
-      DebugLog("PARENT: Waiting for module to finish...");
-      int status;
-      waitpid(pid, &status, 0);
-
-      if (WIFEXITED(status)) {
-        DebugLog("PARENT: Module exited with status: " + std::to_string(WEXITSTATUS(status)));
-      } else if (WIFSIGNALED(status)) {
-        DebugLog("PARENT: Module terminated by signal: " + std::to_string(WTERMSIG(status)));
+      if (recorder.isOpen() && !eof) recorder.write(i, CaptureStream::STDOUT, reader.lastChunk());
+      collector.feed(reader, eof);
+    };
+    if (recorder.isOpen()) {
+      handlers.stderrChunk = [&recorder, i](const char* data, size_t len) {
+        recorder.write(i, CaptureStream::STDERR, std::string_view(data, len));
+      };
+    }
+    handlers.stderrLine = [&shard, &shards, &loop, &terminated, &moduleName](std::string_view line) {
+      if (!shard.logParser.feed(line) || terminated) return;
+      // The module has given up; stop every worker rather than wait for it.
+      terminated = true;
+      ConsoleRenderer::shared().print(std::cout, "[-] " + moduleName + " reported a fatal error, terminating it\n");
+      for (const auto& worker : shards) {
+        if (worker->stopped) continue;
+        worker->stopped = true;
+        kill(worker->pid, SIGTERM);
+        loop.abandon(worker->channel);
       }
+    };
+    shard.channel = loop.addChild(shard.stdinFd, shard.stdoutFd, shard.stderrFd, std::move(handlers));
+
+    if (limits.idleTimeoutMs > 0) {
+      // Only the hung worker goes; the others may still finish their share.
+      std::string worker = shards.size() > 1 ? " [worker " + std::to_string(i) + "]" : "";
+      loop.watchIdle(shard.channel, limits.idleTimeoutMs, [&shard, &loop, &killed, &moduleName, &limits, worker]() {
+        if (shard.stopped) return;
+        shard.stopped = true;
+        if (killed.empty()) killed = "timeout";
+        std::ostringstream message;
+        message << "[-] " << moduleName << worker << " idle for " << limits.idleTimeoutMs / 1000.0 << "s, killing it\n";
+        ConsoleRenderer::shared().print(std::cout, message.str());
+        kill(shard.pid, SIGTERM);
+        loop.abandon(shard.channel);
+      });
+    }
 
-      DebugLog("PARENT: Data sent to module: " + std::to_string(items_sent) + " items");
-      DebugLog("PARENT: Data received from module: " + std::to_string(items_collected) + " items");
-
-    } else {
-      std::cout << "[-] Fork failed" << std::endl;
-      close(stdin_pipe[0]);
-      close(stdin_pipe[1]);
-      close(stdout_pipe[0]);
-      close(stdout_pipe[1]);
-      return;
+    if (shard.worker && shard.worker->jobs > 1) {
+      if (tracing) shard.feedStart = TraceRecorder::Clock::now();
+    } else if (consumes || shard.worker) {
+      // The wire format for stdin follows the module's header line, so hold the
+      // input until the first line arrives (or briefly, for silent modules).
+      collector.onWire = [&loop, &shard, tracing](BmopWire wire) {
+        if (tracing) shard.feedStart = TraceRecorder::Clock::now();
+        shard.feeder.wire = wire;
+        DebugLog(shard.collector.logPrefix + "Sending " + (wire == BmopWire::BINARY ? "BMOP v2 binary" : "JSONL") + " input");
+        loop.releaseInput(shard.channel);
+      };
+      loop.holdInput(shard.channel, BMOP_HEADER_WAIT_MS);
     }
   }
-  else {
-    DebugLog("====== MODULE GENERATES DATA ONLY ======");
 
-    FILE* pipe = popen(cmd.c_str(), "r");
-    if (!pipe) {
-      std::cout << "[-] Failed to execute module" << std::endl;
-      return;
+  if (replaying) {
+    DebugLog("PARENT: Replaying " + capturePath);
+    replayCapture(capture, shards, g_replayPaced);
+  } else {
+    DebugLog("PARENT: Streaming stdin/stdout/stderr through event loop...");
+    loop.run();
+  }
+  std::cout.flush();
+
+  if (tracing) {
+    for (size_t i = 0; i < shards.size(); ++i) {
+      const ModuleShard& shard = *shards[i];
+      std::string track = moduleName + (shards.size() > 1 ? "[" + std::to_string(i) + "]" : "");
+      if (consumes && shard.feedEnd != TraceRecorder::Clock::time_point{}) {
+        auto start = shard.feedStart != TraceRecorder::Clock::time_point{} ? shard.feedStart : spawnedAt;
+        TraceRecorder::shared().span("stdin feed", "io", start, shard.feedEnd, moduleName, track + " stdin");
+      }
+      if (shard.readEnd != TraceRecorder::Clock::time_point{}) {
+        TraceRecorder::shared().span("stdout ingestion", "io", shard.readStart, shard.readEnd, moduleName, track + " stdout");
+      }
     }
+  }
 
-    char buffer[4096];
-    std::string lineBuffer;
-    std::string batchFormat;
-    bool inBatch = false;
-    int items_collected = 0;
-    int lines_read = 0;
-
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-      lines_read++;
+  if (input) {
+    // Merging before the producers have would reorder their output behind
+    // ours (and a replace would clear what they add after it).
+    input->detach();
+    input->waitProducers();
+  }
+
+  ModuleRunStats stats;
+  stats.moduleName = moduleName;
+  stats.stage = meta.stage;
+  stats.workers = shards.size();
+
+  int itemsSent = 0;
+  int formatsSent = 0;
+  int linesRead = 0;
+  int itemsCollected = 0;
+  for (const auto& shard : shards) {
+    itemsSent += shard->feeder.itemsSent;
+    formatsSent = std::max(formatsSent, shard->feeder.formatsSent);
+    linesRead += shard->collector.linesRead;
+    itemsCollected += shard->collector.itemsCollected;
+    const LogCounts& logged = shard->logParser.counts();
+    stats.warnings += logged[LogLevel::WARN];
+    stats.errors += logged[LogLevel::ERROR] + logged[LogLevel::CRITICAL];
+    stats.fatal = stats.fatal || shard->logParser.sawFatal();
+    if (consumes && !replaying && loop.stats(shard->channel).inputTruncated) {
+      DebugLog(shard->collector.logPrefix + "Module closed stdin before consuming all input");
+    }
+  }
 
-      std::cout << buffer;
+  if (consumes) {
+    DebugLog("PARENT: Finished writing. Total: " + std::to_string(itemsSent) +
+             " items from " + std::to_string(formatsSent) + " formats");
+  }
+  DebugLog("PARENT: Finished reading module output");
+  DebugLog("PARENT: Lines read: " + std::to_string(linesRead));
+  DebugLog("PARENT: Items collected: " + std::to_string(itemsCollected));
 
-      std::string chunk(buffer);
-      lineBuffer += chunk;
+  stats.itemsIn = itemsSent;
+  stats.itemsOut = itemsCollected;
 
-      size_t pos;
-      while ((pos = lineBuffer.find('\n')) != std::string::npos) {
-        std::string line = lineBuffer.substr(0, pos);
-        lineBuffer = lineBuffer.substr(pos + 1);
+  DebugLog("PARENT: Waiting for module to finish...");
+  auto waitBegin = TraceRecorder::Clock::now();
+  if (replaying) {
+    stats.bytesOut = capture.stdoutBytes;
+    stats.bytesErr = capture.stderrBytes;
+    for (int code : capture.exitCodes) {
+      if (stats.exitCode == 0) stats.exitCode = code;
+    }
+  }
+  for (size_t i = 0; i < shards.size() && !replaying; ++i) {
+    const auto& shard = shards[i];
+    PersistentWorker* worker = shard->worker.get();
+    // Job done: the worker stays up for the next one.
+    bool warm = worker && shard->collector.jobDone && !shard->stopped;
+    ProcessUsage used;
+    RateLimiter::Usage drawn;
+    int exitCode = 0;
+
+    if (warm) {
+      sampleProcessUsage(shard->pid, used);
+      if (shard->rateConnection >= 0) drawn = rateLimiter.usage(shard->rateConnection);
+    } else {
+      // A persistent worker that died or was stopped mid-job: its pipes
+      // were never the loop's to close.
+      if (worker) {
+        for (int fd : {worker->stdinFd, worker->stdoutFd, worker->stderrFd}) {
+          if (fd >= 0) close(fd);
+        }
+      }
+      int status = 0;
+      struct rusage usage{};
+      // A worker still alive a whole idle timeout after closing its pipes is
+      // as hung as a silent one; one already signalled gets the grace period.
+      bool forced = reapModuleProcess(shard->pid, status, usage, shard->stopped ? KILL_GRACE_MS : limits.idleTimeoutMs);
 
-        line = trimString(line);
-        if (line.empty()) continue;
+      used.userCpuMs = usage.ru_utime.tv_sec * 1000.0 + usage.ru_utime.tv_usec / 1000.0;
+      used.sysCpuMs = usage.ru_stime.tv_sec * 1000.0 + usage.ru_stime.tv_usec / 1000.0;
+      used.peakRssKb = usage.ru_maxrss;
+      if (shard->rateConnection >= 0) drawn = rateLimiter.disconnect(shard->rateConnection);
 
-        if (line[0] == '{') {
-          parseBMOPLine(line, storage);
+      if (WIFEXITED(status)) {
+        DebugLog(shard->collector.logPrefix + "Module exited with status: " + std::to_string(WEXITSTATUS(status)));
+        exitCode = WEXITSTATUS(status);
+      } else if (WIFSIGNALED(status)) {
+        DebugLog(shard->collector.logPrefix + "Module terminated by signal: " + std::to_string(WTERMSIG(status)));
+        exitCode = 128 + WTERMSIG(status);
+      }
 
-          if (!storage["__batch_format__"].empty()) {
-            inBatch = true;
-            batchFormat = storage["__batch_format__"][0].format;
-            storage["__batch_format__"].clear();
-            DebugLog("Batch START detected. Format: " + batchFormat);
-          }
-          else if (line.find("batch_end") != std::string::npos) {
-            inBatch = false;
-            DebugLog("Batch END detected. Total " + batchFormat + 
-                     " items: " + std::to_string(storage[batchFormat].size()));
-            batchFormat.clear();
-          }
-        }
-        else if (inBatch && !batchFormat.empty()) {
-          DataItem item;
-          item.format = batchFormat;
-          item.value = line;
-          storage[batchFormat].push_back(item);
-          items_collected++;
-
-          if (g_debugMode && items_collected % 1000 == 0) {
-            std::cout << "[DEBUG] Collected " << items_collected
-              << " " << batchFormat << " items so far..." << std::endl;
-          }
-        }
-        else if (!line.empty()) {
-          DebugLog("Line ignored - Not JSON and not in batch: '" + line + "'");
-        }
+      // By exit code rather than signal: under `sh -c` the shell reports its
+      // child's death as 128 + signal.
+      double cpuSeconds = (used.userCpuMs + used.sysCpuMs) / 1000.0;
+      if (exitCode == 128 + SIGXCPU ||
+          (exitCode == 128 + SIGKILL && limits.maxCpuSeconds > 0 && cpuSeconds >= limits.maxCpuSeconds)) {
+        killed = "cpu";
+      } else if (exitCode == 128 + SIGKILL && cgroup.oomKilled()) {
+        killed = "memory";
+      } else if (forced && !shard->stopped && killed.empty()) {
+        killed = "timeout";
       }
     }
 
-    int pclose_status = pclose(pipe);
-    if (pclose_status != 0) {
-      DebugLog("Module exited with non-zero status: " + std::to_string(pclose_status));
+    // A persistent worker's counters run across its jobs; charge this one
+    // only what it added.
+    double userCpuMs = used.userCpuMs;
+    double sysCpuMs = used.sysCpuMs;
+    uint64_t tokens = drawn.granted;
+    double waitMs = drawn.waitMs;
+    if (worker) {
+      userCpuMs -= worker->usage.userCpuMs;
+      sysCpuMs -= worker->usage.sysCpuMs;
+      tokens -= worker->rateTokens;
+      waitMs -= worker->rateWaitMs;
+    }
+    stats.userCpuMs += userCpuMs;
+    stats.sysCpuMs += sysCpuMs;
+    stats.peakRssKb = std::max(stats.peakRssKb, used.peakRssKb);
+    stats.rateLimitTokens += tokens;
+    stats.rateLimitWaitMs += waitMs;
+    const ModuleIOLoop::Stats& io = loop.stats(shard->channel);
+    stats.bytesIn += io.bytesIn;
+    stats.bytesOut += io.bytesOut;
+    stats.bytesErr += io.bytesErr;
+
+    if (stats.exitCode == 0) stats.exitCode = exitCode;
+    recorder.exit(i, exitCode);
+
+    if (warm) {
+      worker->usage = used;
+      worker->rateTokens = drawn.granted;
+      worker->rateWaitMs = drawn.waitMs;
+      worker->wire = shard->collector.wire;
+      worker->encoder = std::move(shard->feeder.encoder);
+      worker->decoder = std::move(shard->collector.binaryDecoder);
+      WorkerPool::shared().release(workerKey, std::move(shard->worker));
+    }
+  }
+  if (recorder.isOpen() && !recorder.close()) {
+    std::cout << "[-] Failed to write capture: " << capturePath << std::endl;
+  }
+
+  ConsoleRenderer::shared().endModule(activity, stats.exitCode);
+  if (!killed.empty()) {
+    std::ostringstream message;
+    message << "[!] " << moduleName << " was killed (" << killed << "); keeping the "
+            << itemsCollected << " items it produced\n";
+    ConsoleRenderer::shared().print(std::cout, message.str());
+  }
+  stats.killed = killed;
+
+  auto exitedAt = RunReport::Clock::now();
+  TraceRecorder::shared().span("wait", "process", waitBegin, exitedAt, moduleName);
+  stats.startMs = g_runReport.elapsedMs(spawnedAt);
+  stats.endMs = g_runReport.elapsedMs(exitedAt);
+  stats.wallMs = stats.endMs - stats.startMs;
+  g_runReport.record(std::move(stats));
+
+  storageLock.lock();
+  if (streams) {
+    for (StreamChannel* output : streams->outputs) output->fixSnapshot(storage);
+  }
+  // A killed module's output is partial: add it, but never let it stand in
+  // for the input it did not get through.
+  if (consumes && consumesFormat != "*" && meta.provides == consumesFormat && killed.empty()) {
+    if (meta.storageBehavior == "replace") {
+      DebugLog("STORAGE BEHAVIOR: REPLACE for '" + consumesFormat + "'");
+      DebugLog("  Clearing " + std::to_string(storage[consumesFormat].size()) + " existing items.");
+      storage[consumesFormat].clear();
+    } else if (meta.storageBehavior == "delete") {
+      DebugLog("STORAGE BEHAVIOR: DELETE for '" + consumesFormat + "'");
+      DebugLog("  Removing key and " + std::to_string(storage.count(consumesFormat) ? storage[consumesFormat].size() : 0) + " items.");
+      storage.erase(consumesFormat);
     }
+  }
 
-    DebugLog("Total lines read: " + std::to_string(lines_read));
-    DebugLog("Total items collected: " + std::to_string(items_collected));
+  // Workers' output goes in worker order, after the storage behavior has
+  // been applied once for the module as a whole.
+  for (const auto& shard : shards) {
+    for (const auto& [format, items] : shard->staging) {
+      storage[format].append(items);
+    }
   }
+  if (tracing) {
+    std::vector<std::pair<std::string, double>> sizes;
+    for (const auto& [format, items] : storage) sizes.emplace_back(format, items.size());
+    TraceRecorder::shared().counter("storage items", TraceRecorder::Clock::now(), sizes);
+  }
+
+  DebugLog("PARENT: Data sent to module: " + std::to_string(itemsSent) + " items");
+  DebugLog("PARENT: Data received from module: " + std::to_string(itemsCollected) + " items");
 
   DebugLog("====== END " + moduleName + " ======");
   DebugLog("After execution - storage contents:");
@@ -969,7 +1833,6 @@ void runModuleWithPipe(const std::string& moduleName, const std::vector<std::str
   int total_items_after = 0;
   if (g_debugMode) {
     for (const auto& [format, items] : storage) {
-      if (format == "__batch_format__") continue;
       std::cout << "[DEBUG]   " << format << ": " << items.size() << " items" << std::endl;
       total_items_after += items.size();
     }
@@ -980,7 +1843,6 @@ void runModuleWithPipe(const std::string& moduleName, const std::vector<std::str
 
   if (g_debugMode) {
     for (const auto& [format, items] : storage) {
-      if (format == "__batch_format__") continue;
       if (!items.empty()) {
         std::cout << "[DEBUG] Sample of " << format << " items (first 3):" << std::endl;
         for (size_t i = 0; i < std::min(items.size(), size_t(3)); i++) {
@@ -992,8 +1854,10 @@ void runModuleWithPipe(const std::string& moduleName, const std::vector<std::str
 }
 
 void runModule(const std::string& moduleName, const std::vector<std::string>& args) {
-  std::map<std::string, std::vector<DataItem>> dummyStorage;
+  Storage dummyStorage;
+  beginRun("module:" + moduleName);
   runModuleWithPipe(moduleName, args, dummyStorage, "");
+  finishRun();
 }
 
 std::vector<ProfileModule> loadProfile(const std::string& profileName) {
@@ -1072,6 +1936,24 @@ std::vector<ProfileModule> loadProfile(const std::string& profileName) {
   return modules;
 }
 
+// loadProfile keeps an argument as written, quotes included. No shell sees
+// it on the way to the module, so drop the quotes here as sh would:
+// `'/tmp/test path'` reaches it as one argument without them.
+static std::string unquoteProfileArg(const std::string& arg) {
+  std::string value;
+  char quoteChar = '\0';
+  for (char c : arg) {
+    if (quoteChar == '\0' && (c == '"' || c == '\'')) {
+      quoteChar = c;
+    } else if (c == quoteChar) {
+      quoteChar = '\0';
+    } else {
+      value += c;
+    }
+  }
+  return value;
+}
+
 void runModulesFromProfile(const std::string& profileName, const std::vector<std::string>& globalArgs) {
   std::vector<ProfileModule> modules = loadProfile(profileName);
 
@@ -1080,25 +1962,26 @@ void runModulesFromProfile(const std::string& profileName, const std::vector<std
     return;
   }
 
+  beginRun("profile:" + profileName);
   std::cout << "[+] Executing profile: " << profileName << std::endl;
   std::cout << "[+] Total modules: " << modules.size() << std::endl;
 
-  std::map<std::string, std::vector<DataItem>> storage;
-  int count = 0;
+  Storage storage;
+  ModuleScheduler scheduler(g_maxJobs, g_streaming);
 
   for (const auto& profileModule : modules) {
-    std::string fullPath = findModulePath(profileModule.moduleName);
-    if (fullPath.empty()) {
+    ModuleEntry module;
+    if (!findModule(profileModule.moduleName, module)) {
       std::cout << "[-] Module not found: " << profileModule.moduleName << std::endl;
       continue;
     }
 
-    ModuleMetadata meta = parseModuleMetadata(fullPath);
+    const ModuleMetadata& meta = module.meta;
     
     std::vector<std::string> combinedArgs;
     
     for (const auto& arg : profileModule.args) {
-      combinedArgs.push_back(arg);
+      combinedArgs.push_back(unquoteProfileArg(arg));
     }
     
     for (const auto& arg : globalArgs) {
@@ -1113,16 +1996,26 @@ void runModulesFromProfile(const std::string& profileName, const std::vector<std
       std::cout << std::endl;
     }
     
-    runModuleWithPipe(profileModule.moduleName, combinedArgs, storage, meta.consumes);
-    count++;
+    scheduler.add({profileModule.moduleName, combinedArgs, meta, {}});
+  }
+
+  if (g_maxJobs > 1) {
+    std::cout << "[+] Running up to " << g_maxJobs << " independent modules at once" << std::endl;
+  }
+  if (g_streaming) {
+    std::cout << "[+] Streaming items to consuming modules as they are produced" << std::endl;
   }
+  scheduler.run([&storage](const ScheduledModule& module) {
+    runModuleWithPipe(module.moduleName, module.args, storage, module.meta.consumes, &module.streams);
+  });
 
   std::cout << "------------------------------------------" << std::endl;
-  std::cout << "[+] Profile execution finished. Modules executed: " << count << std::endl;
+  std::cout << "[+] Profile execution finished. Modules executed: " << scheduler.size() << std::endl;
+  finishRun();
 }
 
 void runModulesByStage(const std::vector<std::string>& args) {
-  std::vector<std::string> allModules = getModules();
+  std::vector<ModuleEntry> allModules = moduleRegistry().entries();
 
   if (allModules.empty()) {
     std::cout << "[-] No modules found" << std::endl;
@@ -1131,39 +2024,45 @@ void runModulesByStage(const std::vector<std::string>& args) {
 
   std::map<int, std::vector<std::pair<std::string, ModuleMetadata>>> stageModules;
 
-  for (const auto& moduleName : allModules) {
-    std::string fullPath = findModulePath(moduleName);
-    if (fullPath.empty()) continue;
-
-    ModuleMetadata meta = parseModuleMetadata(fullPath);
-    stageModules[meta.stage].push_back({moduleName, meta});
+  for (const auto& module : allModules) {
+    stageModules[module.meta.stage].push_back({module.name, module.meta});
   }
 
+  beginRun("all");
   std::cout << "[+] Executing modules by stage..." << std::endl;
 
-  std::map<std::string, std::vector<DataItem>> storage;
-  int totalCount = 0;
+  Storage storage;
+  ModuleScheduler scheduler(g_maxJobs, g_streaming);
 
+  // Stages only fix program order now: a later-stage module waits for the
+  // earlier modules it shares formats with, not for the whole previous stage.
   for (auto& [stage, modules] : stageModules) {
     if (modules.empty()) continue;
 
-    std::cout << "------------------------------------------" << std::endl;
     std::cout << "[+] Stage " << stage << ": " << modules.size() << " modules" << std::endl;
-
     for (const auto& [moduleName, meta] : modules) {
-      runModuleWithPipe(moduleName, args, storage, meta.consumes);
-      totalCount++;
+      scheduler.add({moduleName, args, meta, {}});
     }
   }
 
+  if (g_maxJobs > 1) {
+    std::cout << "[+] Running up to " << g_maxJobs << " independent modules at once" << std::endl;
+  }
+  if (g_streaming) {
+    std::cout << "[+] Streaming items to consuming modules as they are produced" << std::endl;
+  }
+  scheduler.run([&storage](const ScheduledModule& module) {
+    runModuleWithPipe(module.moduleName, module.args, storage, module.meta.consumes, &module.streams);
+  });
+
   std::cout << "------------------------------------------" << std::endl;
-  std::cout << "[+] All stages completed. Total modules: " << totalCount << std::endl;
+  std::cout << "[+] All stages completed. Total modules: " << scheduler.size() << std::endl;
 
   std::cout << "[+] Storage summary:" << std::endl;
   for (const auto& [format, items] : storage) {
-    if (format == "__batch_format__") continue;
     std::cout << "    " << format << ": " << items.size() << " items" << std::endl;
   }
+  finishRun();
 }
 
 void runModules(const std::vector<std::string>& args) {
@@ -1171,11 +2070,9 @@ void runModules(const std::vector<std::string>& args) {
 }
 
 void listModules() {
-  std::vector<std::string> modules = getModules();
-
-  for (const auto& modName : modules) {
-    std::string path = findModulePath(modName);
-    ModuleMetadata meta = parseModuleMetadata(path);
+  for (const auto& module : moduleRegistry().entries()) {
+    const std::string& modName = module.name;
+    const ModuleMetadata& meta = module.meta;
 
     std::cout << "------------------------------------------" << std::endl;
     std::cout << "Module: " << modName << std::endl;
@@ -1198,13 +2095,13 @@ void listModules() {
 }
 
 void describeModule(const std::string& moduleName) {
-  std::string fullPath = findModulePath(moduleName);
-  if (fullPath.empty()) {
+  ModuleEntry module;
+  if (!findModule(moduleName, module)) {
     std::cout << "[-] Module not found: " << moduleName << std::endl;
     return;
   }
 
-  ModuleMetadata meta = parseModuleMetadata(fullPath);
+  const ModuleMetadata& meta = module.meta;
 
   std::cout << "\n━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━" << std::endl;
   std::cout << "MODULE: " << moduleName << std::endl;
@@ -1225,6 +2122,23 @@ void describeModule(const std::string& moduleName) {
   if (!meta.provides.empty()) {
     std::cout << "Provides:    " << meta.provides << std::endl;
   }
+  if (meta.parallel != 1) {
+    std::cout << "Parallel:    " << (meta.parallel == 0 ? "auto" : std::to_string(meta.parallel)) << std::endl;
+  }
+  if (meta.timeoutMs > 0) {
+    std::cout << "Timeout:     " << meta.timeoutMs << " ms" << std::endl;
+  }
+  if (meta.rateLimit > 0) {
+    std::cout << "RateLimit:   " << meta.rateLimit << "/s";
+    if (!meta.rateLimitKey.empty()) std::cout << " (bucket " << meta.rateLimitKey << ")";
+    std::cout << std::endl;
+  }
+  if (meta.maxMemoryBytes > 0) {
+    std::cout << "MaxMemory:   " << (meta.maxMemoryBytes >> 20) << " MiB per worker" << std::endl;
+  }
+  if (meta.maxCpuSeconds > 0) {
+    std::cout << "MaxCPU:      " << meta.maxCpuSeconds << " s per worker" << std::endl;
+  }
   if (!meta.installCmd.empty()) {
     std::cout << "Install:     " << meta.installCmd << std::endl;
   }
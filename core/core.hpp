@@ -2,13 +2,13 @@
 #define CORE_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
-
-struct DataItem {
-  std::string format;
-  std::string value;
-};
+#include <memory>
+#include <cstdint>
+#include "./storage.hpp"
+#include "./bmop.hpp"
 
 struct ModuleMetadata {
   std::string name;
@@ -21,6 +21,40 @@ struct ModuleMetadata {
   std::string installCmd;
   std::string installScope;
   std::vector<std::string> argSpecs;
+  int parallel = 1;
+  // Zero is unset/unlimited. timeoutMs is per unit of work (see
+  // IDLE_TIMEOUT_FACTOR); rateLimit is operations per second on the
+  // rateLimitKey bucket (the module's file name unless it names one).
+  int timeoutMs = 0;
+  int rateLimit = 0;
+  std::string rateLimitKey;
+  uint64_t maxMemoryBytes = 0;
+  int maxCpuSeconds = 0;
+  // Kept running between invocations and fed one job at a time (see
+  // WorkerPool).
+  bool persistent = false;
+};
+
+// A module found under ./modules, as indexed by the ModuleRegistry. mtime
+// (ns) and size identify the file version `meta` was parsed from; hash is
+// that of its header (see MetadataCache).
+struct ModuleEntry {
+  std::string name;
+  std::string path;
+  int64_t mtime = 0;
+  uint64_t size = 0;
+  uint64_t hash = 0;
+  ModuleMetadata meta;
+};
+
+class StreamChannel;
+
+// Channels a module is wired to under --stream: the one its input arrives on
+// while upstream modules are still running, and the ones its output is
+// published to as it is parsed.
+struct ModuleStreams {
+  StreamChannel* input = nullptr;
+  std::vector<StreamChannel*> outputs;
 };
 
 struct ProfileModule {
@@ -30,6 +64,46 @@ struct ProfileModule {
 
 void setDebugMode(bool enabled);
 bool isDebugEnabled();
+void setMaxJobs(size_t jobs);
+size_t getMaxJobs();
+void setStreaming(bool enabled);
+bool isStreaming();
+void setParallelOverride(int workers);
+size_t moduleParallelism(const ModuleMetadata& meta);
+int parseParallelSpec(const std::string& spec);
+// JSON run report / Prometheus textfile written after each run; empty
+// paths disable them.
+void setRunReport(const std::string& jsonPath, const std::string& prometheusPath);
+// Chrome trace-event file of each run's phases; empty disables tracing.
+void setTraceFile(const std::string& path);
+// --record saves every module's raw output under `dir`; --replay feeds it
+// back through the same ingestion path instead of running the module.
+enum class CaptureMode { NONE, RECORD, REPLAY };
+void setCapture(CaptureMode mode, const std::string& dir, bool paced = false);
+bool isReplaying();
+// Appends every BMOP log and error modules report to `path` as JSON lines;
+// empty closes it. False if the file cannot be opened.
+bool setModuleLogFile(const std::string& path);
+// What the console shows of module output: "quiet", "summary" (default) or
+// "raw". False for any other name.
+bool setConsoleMode(const std::string& name);
+// `Timeout:` for modules that do not declare one ("30s", "500ms"; empty for
+// none). False if it does not parse.
+bool setDefaultModuleTimeout(const std::string& spec);
+// --rate-limit "dns=100,crt.sh=5": token bucket rates (per second) that
+// override what modules declare. False if any entry does not parse.
+bool setRateLimits(const std::string& specs);
+// Runs every module invocation in a cgroup v2 leaf under `dir`, which must
+// be delegated to us; empty disables. False if `dir` is not usable.
+bool setModuleCgroup(const std::string& dir);
+// Ends the warm processes of `Persistent: true` modules; the next
+// invocation starts them again.
+void shutdownPersistentWorkers();
+// --warm "python,node" and --preload "python:requests,node:axios": keep
+// pre-booted interpreters with those libraries loaded for modules to start
+// on. False for an unknown language or a preload of one not warmed.
+bool setWarmInterpreters(const std::string& languages, const std::string& preloads);
+void shutdownWarmInterpreters();
 
 void installModule(std::string moduleName);
 void uninstallModule(std::string moduleName);
@@ -41,19 +115,27 @@ void runModulesFromProfile(const std::string& profileName, const std::vector<std
 void runModulesByStage(const std::vector<std::string>& args);
 void listModules();
 
-void parseBMOPLine(const std::string& line, std::map<std::string, std::vector<DataItem>>& storage);
-void collectModuleOutput(const std::string& moduleName, FILE* pipe, std::map<std::string, std::vector<DataItem>>& storage);
+void parseBMOPLine(std::string_view line, Storage& storage);
+void collectModuleOutput(const std::string& moduleName, FILE* pipe, Storage& storage);
 std::string trimString(const std::string& str);
-void pipeDataToModule(FILE* pipe, const std::map<std::string, std::vector<DataItem>>& storage, const std::string& consumesFormat);
+std::string_view trimView(std::string_view str);
+void pipeDataToModule(FILE* pipe, const Storage& storage, const std::string& consumesFormat, BmopWire wire = BmopWire::JSONL);
 
 ModuleMetadata parseModuleMetadata(const std::string& modulePath);
 void ensurePackageJson(const std::string& path);
 std::vector<std::string> getModules();
 std::string findModulePath(const std::string& moduleName);
+bool findModule(const std::string& moduleName, ModuleEntry& entry);
 std::string getPythonVersion(const std::string& modulePath);
 std::vector<ProfileModule> loadProfile(const std::string& profileName); 
-void runModuleWithPipe(const std::string& moduleName, const std::vector<std::string>& args, std::map<std::string, std::vector<DataItem>>& storage, const std::string& consumesFormat);
+void runModuleWithPipe(const std::string& moduleName, const std::vector<std::string>& args, Storage& storage, const std::string& consumesFormat, const ModuleStreams* streams = nullptr);
 std::string setupNodeEnvironment(const std::string& fullPath, const std::string& scope, const std::string& moduleDir);
 std::string setupPythonEnvironment(const std::string& fullPath, const std::string& scope, const std::string& moduleDir);
+// The environment a module at `fullPath` starts with: ours, plus NODE_PATH or
+// PYTHONPATH naming `libsPath` (what the setup above returned) and the BMOP
+// variables. Built once per library directory and cached; the core's own
+// environment is never changed.
+std::shared_ptr<const std::vector<std::string>> moduleEnvironment(const std::string& fullPath,
+    const std::string& libsPath, bool persistent);
 
 #endif
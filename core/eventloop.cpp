@@ -0,0 +1,408 @@
+#include "./eventloop.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+
+namespace {
+
+enum Slot { SLOT_STDIN = 0, SLOT_STDOUT = 1, SLOT_STDERR = 2, SLOT_WAKE = 3 };
+
+void setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags >= 0) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+uint64_t encodeKey(size_t child, int slot) {
+  return (static_cast<uint64_t>(child) << 2) | static_cast<uint64_t>(slot);
+}
+
+}
+
+ScopedSigpipeBlock::ScopedSigpipeBlock() {
+  sigset_t pipe, old, pending;
+  sigemptyset(&pipe);
+  sigaddset(&pipe, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe, &old);
+  wasBlocked = sigismember(&old, SIGPIPE) == 1;
+  wasPending = sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE) == 1;
+}
+
+ScopedSigpipeBlock::~ScopedSigpipeBlock() {
+  sigset_t pipe, pending;
+  sigemptyset(&pipe);
+  sigaddset(&pipe, SIGPIPE);
+  if (!wasPending && sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE) == 1) {
+    struct timespec now = {0, 0};
+    while (sigtimedwait(&pipe, nullptr, &now) < 0 && errno == EINTR) {}
+  }
+  if (!wasBlocked) pthread_sigmask(SIG_UNBLOCK, &pipe, nullptr);
+}
+
+ModuleIOLoop::ModuleIOLoop() : epfd(epoll_create1(EPOLL_CLOEXEC)), openFds(0), readBuffer(READ_CHUNK) {
+  if (epfd < 0) {
+    throw std::runtime_error(std::string("epoll_create1 failed: ") + strerror(errno));
+  }
+}
+
+ModuleIOLoop::~ModuleIOLoop() {
+  for (auto& child : children) {
+    for (int slot = 0; slot < 3; ++slot) closeFd(child, slot);
+  }
+  close(epfd);
+}
+
+size_t ModuleIOLoop::addChild(int stdinFd, int stdoutFd, int stderrFd, Handlers handlers) {
+  size_t index = children.size();
+  children.emplace_back();
+  Child& child = children.back();
+  child.fds[SLOT_STDIN] = stdinFd;
+  child.fds[SLOT_STDOUT] = stdoutFd;
+  child.fds[SLOT_STDERR] = stderrFd;
+  child.handlers = std::move(handlers);
+  child.producerDone = !child.handlers.produce;
+  if (child.handlers.stdoutLine || child.handlers.stdoutReader) {
+    child.readers[SLOT_STDOUT] = std::make_unique<LineReader>();
+  }
+  if (child.handlers.stderrLine) {
+    child.readers[SLOT_STDERR] = std::make_unique<LineReader>(READ_CHUNK);
+  }
+
+  for (int slot = 0; slot < 3; ++slot) {
+    int fd = child.fds[slot];
+    if (fd < 0) continue;
+    setNonBlocking(fd);
+
+    epoll_event ev{};
+    ev.events = (slot == SLOT_STDIN) ? EPOLLOUT : EPOLLIN;
+    ev.data.u64 = encodeKey(index, slot);
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      throw std::runtime_error(std::string("epoll_ctl failed: ") + strerror(errno));
+    }
+    openFds++;
+  }
+
+  return index;
+}
+
+void ModuleIOLoop::holdInput(size_t index, int timeoutMs) {
+  Child& child = children[index];
+  if (child.fds[SLOT_STDIN] < 0 || child.inputHeld) return;
+
+  epoll_event ev{};
+  ev.events = 0;
+  ev.data.u64 = encodeKey(index, SLOT_STDIN);
+  epoll_ctl(epfd, EPOLL_CTL_MOD, child.fds[SLOT_STDIN], &ev);
+  child.inputHeld = true;
+  child.holdDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+}
+
+void ModuleIOLoop::releaseInput(size_t index) {
+  Child& child = children[index];
+  if (!child.inputHeld) return;
+  child.inputHeld = false;
+  if (child.fds[SLOT_STDIN] < 0) return;
+
+  epoll_event ev{};
+  ev.events = EPOLLOUT;
+  ev.data.u64 = encodeKey(index, SLOT_STDIN);
+  epoll_ctl(epfd, EPOLL_CTL_MOD, child.fds[SLOT_STDIN], &ev);
+}
+
+void ModuleIOLoop::abandon(size_t index) {
+  Child& child = children[index];
+  while (child.fds[SLOT_STDOUT] >= 0) {
+    size_t before = child.stats.bytesOut;
+    handleReadable(child, SLOT_STDOUT);
+    if (child.stats.bytesOut == before) break;
+  }
+  if (child.fds[SLOT_STDOUT] >= 0) handleEof(child, SLOT_STDOUT);
+  if (child.fds[SLOT_STDIN] >= 0) child.stats.inputTruncated = !child.producerDone || child.inputPending > 0;
+  child.inputHeld = false;
+  child.producerDone = true;
+  for (int slot = 0; slot < 3; ++slot) closeFd(child, slot);
+}
+
+void ModuleIOLoop::release(size_t index) {
+  Child& child = children[index];
+  while (child.fds[SLOT_STDERR] >= 0) {
+    size_t before = child.stats.bytesErr;
+    handleReadable(child, SLOT_STDERR);
+    if (child.stats.bytesErr == before) break;
+  }
+  if (child.fds[SLOT_STDIN] >= 0) child.stats.inputTruncated = !child.producerDone || child.inputPending > 0;
+  child.inputHeld = false;
+  child.producerDone = true;
+  for (int slot = 0; slot < 3; ++slot) closeFd(child, slot);
+}
+
+void ModuleIOLoop::watchIdle(size_t index, int timeoutMs, std::function<void()> onIdle) {
+  Child& child = children[index];
+  child.idleTimeout = std::chrono::milliseconds(timeoutMs);
+  child.lastActivity = std::chrono::steady_clock::now();
+  child.onIdle = std::move(onIdle);
+}
+
+void ModuleIOLoop::checkIdle(std::chrono::steady_clock::time_point now) {
+  for (auto& child : children) {
+    if (!child.onIdle) continue;
+    if (child.inputParked) {
+      child.lastActivity = now;
+    } else if (now - child.lastActivity >= child.idleTimeout) {
+      auto onIdle = std::move(child.onIdle);
+      child.onIdle = nullptr;
+      onIdle();
+    }
+  }
+}
+
+int ModuleIOLoop::nextTimeout() {
+  bool any = false;
+  auto earliest = std::chrono::steady_clock::time_point::max();
+  for (const auto& child : children) {
+    if (child.inputHeld && child.holdDeadline < earliest) {
+      earliest = child.holdDeadline;
+      any = true;
+    }
+    if (child.onIdle && !child.inputParked && child.lastActivity + child.idleTimeout < earliest) {
+      earliest = child.lastActivity + child.idleTimeout;
+      any = true;
+    }
+  }
+  if (!any) return -1;
+
+  auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(earliest - std::chrono::steady_clock::now());
+  return remaining.count() > 0 ? static_cast<int>(remaining.count()) + 1 : 0;
+}
+
+void ModuleIOLoop::closeFd(Child& child, int slot) {
+  int fd = child.fds[slot];
+  if (fd < 0) return;
+  if (slot == SLOT_STDIN && child.wakeRegistered) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, child.handlers.inputWakeFd, nullptr);
+    child.wakeRegistered = false;
+    child.inputParked = false;
+  }
+  epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+  if (!child.handlers.borrowed) close(fd);
+  child.fds[slot] = -1;
+  openFds--;
+  if (child.fds[SLOT_STDIN] < 0 && child.fds[SLOT_STDOUT] < 0 && child.fds[SLOT_STDERR] < 0) child.onIdle = nullptr;
+}
+
+bool ModuleIOLoop::refillInput(Child& child) {
+  while (!child.producerDone && child.inputPending < INPUT_HIGH_WATER) {
+    std::string chunk;
+    if (!child.spare.empty()) {
+      chunk = std::move(child.spare.back());
+      child.spare.pop_back();
+    }
+    if (!child.handlers.produce(chunk)) child.producerDone = true;
+    if (chunk.empty()) {
+      child.spare.push_back(std::move(chunk));
+      if (!child.producerDone && child.handlers.inputWakeFd >= 0) break;
+      continue;
+    }
+    child.inputPending += chunk.size();
+    child.input.push_back(std::move(chunk));
+  }
+  return child.inputPending > 0;
+}
+
+void ModuleIOLoop::parkInput(Child& child) {
+  size_t index = static_cast<size_t>(&child - children.data());
+  epoll_event ev{};
+  ev.events = 0;
+  ev.data.u64 = encodeKey(index, SLOT_STDIN);
+  epoll_ctl(epfd, EPOLL_CTL_MOD, child.fds[SLOT_STDIN], &ev);
+
+  ev.events = EPOLLIN;
+  ev.data.u64 = encodeKey(index, SLOT_WAKE);
+  epoll_ctl(epfd, child.wakeRegistered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, child.handlers.inputWakeFd, &ev);
+  child.wakeRegistered = true;
+  child.inputParked = true;
+}
+
+void ModuleIOLoop::unparkInput(Child& child) {
+  size_t index = static_cast<size_t>(&child - children.data());
+  child.inputParked = false;
+  // The producer resets the wake fd when it is next called; until then it
+  // stays readable, so stop watching it.
+  epoll_event ev{};
+  ev.events = 0;
+  ev.data.u64 = encodeKey(index, SLOT_WAKE);
+  epoll_ctl(epfd, EPOLL_CTL_MOD, child.handlers.inputWakeFd, &ev);
+
+  if (child.fds[SLOT_STDIN] < 0 || child.inputHeld) return;
+  ev.events = EPOLLOUT;
+  ev.data.u64 = encodeKey(index, SLOT_STDIN);
+  epoll_ctl(epfd, EPOLL_CTL_MOD, child.fds[SLOT_STDIN], &ev);
+}
+
+void ModuleIOLoop::handleWritable(Child& child) {
+  while (child.fds[SLOT_STDIN] >= 0) {
+    if (child.inputPending == 0 && !refillInput(child)) {
+      if (child.producerDone) {
+        closeFd(child, SLOT_STDIN);
+      } else {
+        parkInput(child);
+      }
+      return;
+    }
+
+    iovec iov[MAX_IOVECS];
+    int count = 0;
+    for (auto it = child.input.begin(); it != child.input.end() && count < MAX_IOVECS; ++it, ++count) {
+      size_t offset = (count == 0) ? child.inputPos : 0;
+      iov[count].iov_base = const_cast<char*>(it->data() + offset);
+      iov[count].iov_len = it->size() - offset;
+    }
+
+    ssize_t n = writev(child.fds[SLOT_STDIN], iov, count);
+    if (n > 0) {
+      size_t written = static_cast<size_t>(n);
+      child.stats.bytesIn += written;
+      if (child.onIdle) child.lastActivity = std::chrono::steady_clock::now();
+      child.inputPending -= written;
+      while (written > 0) {
+        size_t left = child.input.front().size() - child.inputPos;
+        if (written < left) {
+          child.inputPos += written;
+          break;
+        }
+        written -= left;
+        child.inputPos = 0;
+        child.input.front().clear();
+        child.spare.push_back(std::move(child.input.front()));
+        child.input.pop_front();
+      }
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    } else {
+      // EPIPE: the module stopped reading. Drop the rest of the input.
+      child.stats.inputTruncated = true;
+      child.producerDone = true;
+      child.input.clear();
+      child.spare.clear();
+      child.inputPos = 0;
+      child.inputPending = 0;
+      closeFd(child, SLOT_STDIN);
+      return;
+    }
+  }
+}
+
+void ModuleIOLoop::handleLines(Child& child, int slot) {
+  LineReader& reader = *child.readers[slot];
+  const LineSink& sink = (slot == SLOT_STDOUT) ? child.handlers.stdoutLine : child.handlers.stderrLine;
+  std::string_view line;
+  while (reader.next(line)) {
+    sink(line);
+  }
+}
+
+void ModuleIOLoop::handleEof(Child& child, int slot) {
+  LineReader* reader = child.readers[slot].get();
+  if (slot == SLOT_STDOUT && child.handlers.stdoutReader) {
+    child.handlers.stdoutReader(*reader, true);
+  } else if (reader) {
+    std::string_view rest;
+    if (reader->takeRemainder(rest)) {
+      (slot == SLOT_STDOUT ? child.handlers.stdoutLine : child.handlers.stderrLine)(rest);
+    }
+  }
+}
+
+void ModuleIOLoop::handleReadable(Child& child, int slot) {
+  LineReader* reader = child.readers[slot].get();
+  const Sink& chunkSink = (slot == SLOT_STDOUT) ? child.handlers.stdoutChunk : child.handlers.stderrChunk;
+  size_t& counter = (slot == SLOT_STDOUT) ? child.stats.bytesOut : child.stats.bytesErr;
+
+  // One read per readiness event: epoll is level-triggered, so anything left
+  // in the pipe is reported again on the next wait.
+  while (child.fds[slot] >= 0) {
+    ssize_t n;
+    const char* data;
+    if (reader) {
+      n = reader->fill(child.fds[slot]);
+      data = reader->lastChunk().data();
+    } else {
+      n = read(child.fds[slot], readBuffer.data(), readBuffer.size());
+      data = readBuffer.data();
+    }
+
+    if (n > 0) {
+      counter += static_cast<size_t>(n);
+      if (child.onIdle) child.lastActivity = std::chrono::steady_clock::now();
+      if (chunkSink) chunkSink(data, static_cast<size_t>(n));
+      if (slot == SLOT_STDOUT && child.handlers.stdoutReader) {
+        child.handlers.stdoutReader(*reader, false);
+      } else if (reader) {
+        handleLines(child, slot);
+      }
+      return;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    } else {
+      handleEof(child, slot);
+      closeFd(child, slot);
+      if (slot == SLOT_STDOUT) releaseInput(static_cast<size_t>(&child - children.data()));
+      return;
+    }
+  }
+}
+
+void ModuleIOLoop::run() {
+  // A module that exits without draining stdin must surface as EPIPE on our
+  // side, not kill the orchestrator.
+  ScopedSigpipeBlock sigpipe;
+  epoll_event events[16];
+
+  while (openFds > 0) {
+    int ready = epoll_wait(epfd, events, 16, nextTimeout());
+    if (ready < 0) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error(std::string("epoll_wait failed: ") + strerror(errno));
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < children.size(); ++index) {
+      if (children[index].inputHeld && children[index].holdDeadline <= now) releaseInput(index);
+    }
+
+    for (int i = 0; i < ready; ++i) {
+      size_t index = static_cast<size_t>(events[i].data.u64 >> 2);
+      int slot = static_cast<int>(events[i].data.u64 & 3);
+      Child& child = children[index];
+      if (slot == SLOT_WAKE) {
+        if (child.inputParked) unparkInput(child);
+        continue;
+      }
+      if (child.fds[slot] < 0) continue;
+
+      if (slot == SLOT_STDIN) {
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+          child.stats.inputTruncated = !child.producerDone || child.inputPending > 0;
+          child.producerDone = true;
+          closeFd(child, SLOT_STDIN);
+        } else if (!child.inputHeld) {
+          handleWritable(child);
+        }
+      } else {
+        handleReadable(child, slot);
+      }
+    }
+    // After the events, so data that just arrived counts as activity.
+    checkIdle(std::chrono::steady_clock::now());
+  }
+}
@@ -0,0 +1,140 @@
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <cstddef>
+#include "./linereader.hpp"
+
+// Blocks SIGPIPE in the calling thread while alive, so writing to a pipe
+// whose module has exited fails with EPIPE instead of killing us. A SIGPIPE
+// raised meanwhile is consumed before unblocking. The disposition stays
+// untouched, so children (installs, pip, modules) still get the default.
+class ScopedSigpipeBlock {
+  public:
+    ScopedSigpipeBlock();
+    ScopedSigpipeBlock(const ScopedSigpipeBlock&) = delete;
+    ScopedSigpipeBlock& operator=(const ScopedSigpipeBlock&) = delete;
+    ~ScopedSigpipeBlock();
+
+  private:
+    bool wasBlocked = false;
+    bool wasPending = false;
+};
+
+// Drives the stdin/stdout/stderr pipes of one or more module processes from a
+// single epoll set, so feeding input, ingesting output and forwarding logs all
+// overlap. Input is pulled from a producer in bounded chunks, each into its own
+// reused buffer, and flushed with writev; output is handed
+// to the handlers as it arrives, either as raw chunks or framed into lines in
+// place by a LineReader. Pass -1 for any fd the child does not have.
+class ModuleIOLoop {
+  public:
+    // Appends the next chunk of input to `out`. Returns false once exhausted.
+    // With inputWakeFd set, returning true without appending anything means
+    // "nothing yet": stdin is parked until that fd becomes readable.
+    using Producer = std::function<bool(std::string& out)>;
+    using Sink = std::function<void(const char* data, size_t len)>;
+    using LineSink = std::function<void(std::string_view line)>;
+    // Gets the stdout LineReader after every read and once more at EOF, for
+    // callers that do their own framing.
+    using ReaderSink = std::function<void(LineReader& reader, bool eof)>;
+
+    struct Handlers {
+      Producer produce;
+      Sink stdoutChunk;
+      LineSink stdoutLine;
+      ReaderSink stdoutReader;
+      Sink stderrChunk;
+      LineSink stderrLine;
+      int inputWakeFd = -1;
+      // The caller keeps the pipes (a persistent worker's): the loop stops
+      // polling them when it is done instead of closing them.
+      bool borrowed = false;
+    };
+
+    struct Stats {
+      size_t bytesIn = 0;
+      size_t bytesOut = 0;
+      size_t bytesErr = 0;
+      bool inputTruncated = false;
+    };
+
+    ModuleIOLoop();
+    ~ModuleIOLoop();
+
+    ModuleIOLoop(const ModuleIOLoop&) = delete;
+    ModuleIOLoop& operator=(const ModuleIOLoop&) = delete;
+
+    size_t addChild(int stdinFd, int stdoutFd, int stderrFd, Handlers handlers);
+    void run();
+
+    // Keeps stdin unwritten until releaseInput() or until timeoutMs elapse,
+    // whichever comes first. Stdout EOF also releases it.
+    void holdInput(size_t child, int timeoutMs);
+    void releaseInput(size_t child);
+
+    // Calls `onIdle` once if the child goes `timeoutMs` without a byte moving
+    // on any of its pipes. Time spent waiting for streamed input does not
+    // count: the child has nothing to do then.
+    void watchIdle(size_t child, int timeoutMs, std::function<void()> onIdle);
+
+    // Stops servicing a child that is being killed: hands over what its
+    // stdout already holds, then closes all its pipes instead of waiting for
+    // EOF, which descendants that outlive it could hold off indefinitely.
+    // Safe to call from the child's own handlers.
+    void abandon(size_t child);
+
+    // Stops servicing a borrowed child whose job is done, after handing over
+    // what its stderr already holds. Safe to call from its own handlers.
+    void release(size_t child);
+
+    const Stats& stats(size_t child) const { return children[child].stats; }
+
+    static constexpr size_t INPUT_HIGH_WATER = 256 * 1024;
+    static constexpr size_t READ_CHUNK = 64 * 1024;
+    static constexpr int MAX_IOVECS = 64;
+
+  private:
+    struct Child {
+      int fds[3] = {-1, -1, -1};
+      Handlers handlers;
+      std::unique_ptr<LineReader> readers[3];
+      std::deque<std::string> input;
+      std::vector<std::string> spare;
+      size_t inputPos = 0;
+      size_t inputPending = 0;
+      bool producerDone = false;
+      bool inputHeld = false;
+      bool inputParked = false;
+      bool wakeRegistered = false;
+      std::chrono::steady_clock::time_point holdDeadline;
+      std::chrono::milliseconds idleTimeout{0};
+      std::chrono::steady_clock::time_point lastActivity;
+      std::function<void()> onIdle;
+      Stats stats;
+    };
+
+    void closeFd(Child& child, int slot);
+    void handleWritable(Child& child);
+    bool refillInput(Child& child);
+    void parkInput(Child& child);
+    void unparkInput(Child& child);
+    void handleReadable(Child& child, int slot);
+    void handleLines(Child& child, int slot);
+    void handleEof(Child& child, int slot);
+    int nextTimeout();
+    void checkIdle(std::chrono::steady_clock::time_point now);
+
+    int epfd;
+    size_t openFds;
+    std::vector<Child> children;
+    std::vector<char> readBuffer;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#include "./fileio.hpp"
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+int64_t statPath(const std::string& path, uint64_t* size) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return -1;
+  if (size) *size = static_cast<uint64_t>(st.st_size);
+  return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+std::string getString(const rapidjson::Value& object, const char* key) {
+  auto it = object.FindMember(key);
+  return (it != object.MemberEnd() && it->value.IsString()) ? std::string(it->value.GetString(), it->value.GetStringLength()) : "";
+}
+
+int64_t getInt(const rapidjson::Value& object, const char* key, int64_t fallback) {
+  auto it = object.FindMember(key);
+  return (it != object.MemberEnd() && it->value.IsInt64()) ? it->value.GetInt64() : fallback;
+}
+
+bool writeAtomically(const std::string& path, std::string_view content) {
+  std::error_code ec;
+  fs::path target(path);
+  if (target.has_parent_path()) fs::create_directories(target.parent_path(), ec);
+
+  std::string temp = path + ".tmp." + std::to_string(getpid());
+  {
+    std::ofstream out(temp, std::ios::trunc);
+    if (!out.is_open()) return false;
+    out.write(content.data(), static_cast<std::streamsize>(content.size()));
+    if (!out) {
+      out.close();
+      std::remove(temp.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,23 @@
+#ifndef FILEIO_HPP
+#define FILEIO_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include "../include/rapidjson/document.h"
+
+// File helpers shared by the on-disk caches (module index, toolchains) and
+// the run reports.
+
+// Nanosecond mtime of what `path` points to, or -1 when it is gone.
+int64_t statPath(const std::string& path, uint64_t* size = nullptr);
+
+// Members of a parsed cache entry; "" / `fallback` when missing or mistyped.
+std::string getString(const rapidjson::Value& object, const char* key);
+int64_t getInt(const rapidjson::Value& object, const char* key, int64_t fallback);
+
+// Write-then-rename (creating the parent directory), so a concurrent run
+// never reads half a file. False if nothing was written.
+bool writeAtomically(const std::string& path, std::string_view content);
+
+#endif
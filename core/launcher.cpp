@@ -0,0 +1,175 @@
+#include "./launcher.hpp"
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+extern char** environ;
+
+namespace {
+
+// What execvp searches when there is no PATH.
+constexpr const char* DEFAULT_PATH = "/bin:/usr/bin";
+
+std::mutex resolvedMutex;
+std::map<std::pair<std::string, std::string>, std::string> resolved;
+
+bool isExecutable(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(path.c_str(), X_OK) == 0;
+}
+
+void closeStaged(const std::vector<int>& staged) {
+  for (int fd : staged) close(fd);
+}
+
+}
+
+std::string resolveExecutable(const std::string& name, std::string_view path) {
+  if (name.empty()) return "";
+  if (name.find('/') != std::string::npos) return name;
+
+  std::pair<std::string, std::string> key(std::string(path), name);
+  {
+    std::lock_guard<std::mutex> lock(resolvedMutex);
+    if (auto it = resolved.find(key); it != resolved.end()) return it->second;
+  }
+
+  std::string found;
+  size_t start = 0;
+  for (;;) {
+    size_t end = path.find(':', start);
+    std::string_view dir = path.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+    std::string candidate = (dir.empty() ? std::string(".") : std::string(dir)) + "/" + name;
+    if (isExecutable(candidate)) {
+      found = candidate;
+      break;
+    }
+    if (end == std::string_view::npos) break;
+    start = end + 1;
+  }
+
+  // Misses are not remembered: the tool may be installed later in the run.
+  if (!found.empty()) {
+    std::lock_guard<std::mutex> lock(resolvedMutex);
+    resolved[key] = found;
+  }
+  return found;
+}
+
+std::vector<std::string> currentEnvironment() {
+  std::vector<std::string> env;
+  for (char** entry = environ; *entry; ++entry) env.emplace_back(*entry);
+  return env;
+}
+
+void setEnvironment(std::vector<std::string>& env, std::string_view name, std::string_view value) {
+  std::string entry = std::string(name) + "=" + std::string(value);
+  for (auto& existing : env) {
+    if (existing.size() > name.size() && existing[name.size()] == '=' && existing.starts_with(name)) {
+      existing = std::move(entry);
+      return;
+    }
+  }
+  env.push_back(std::move(entry));
+}
+
+const char* findEnvironment(const std::vector<std::string>& env, std::string_view name) {
+  for (const auto& entry : env) {
+    if (entry.size() > name.size() && entry[name.size()] == '=' && entry.starts_with(name)) {
+      return entry.c_str() + name.size() + 1;
+    }
+  }
+  return nullptr;
+}
+
+pid_t launchProcess(const ProcessSpec& spec) {
+  if (spec.argv.empty()) {
+    errno = EINVAL;
+    return -1;
+  }
+  const char* path = findEnvironment(spec.env, "PATH");
+  std::string program = resolveExecutable(spec.argv[0], path ? path : DEFAULT_PATH);
+  if (program.empty()) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  std::vector<char*> argv;
+  for (const auto& arg : spec.argv) argv.push_back(const_cast<char*>(arg.c_str()));
+  argv.push_back(nullptr);
+  std::vector<char*> envp;
+  for (const auto& entry : spec.env) envp.push_back(const_cast<char*>(entry.c_str()));
+  envp.push_back(nullptr);
+
+  // The mappings are applied in order, so a source that is also some target
+  // is first copied above all targets; dup2 onto a different fd then also
+  // clears O_CLOEXEC.
+  int highestTarget = -1;
+  for (const auto& [from, to] : spec.fds) highestTarget = std::max(highestTarget, to);
+  std::vector<std::pair<int, int>> fds = spec.fds;
+  std::vector<int> staged;
+  for (auto& mapping : fds) {
+    if (mapping.first > highestTarget) continue;
+    int copy = fcntl(mapping.first, F_DUPFD_CLOEXEC, highestTarget + 1);
+    if (copy < 0) {
+      int error = errno;
+      closeStaged(staged);
+      errno = error;
+      return -1;
+    }
+    staged.push_back(copy);
+    mapping.first = copy;
+  }
+
+  pid_t pid = -1;
+  if (spec.limits.maxMemoryBytes == 0 && spec.limits.maxCpuSeconds == 0 && !spec.cgroupProcs) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for (const auto& [from, to] : fds) posix_spawn_file_actions_adddup2(&actions, from, to);
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    // The calling thread may be inside a ScopedSigpipeBlock.
+    sigset_t empty;
+    sigemptyset(&empty);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+    int result = posix_spawn(&pid, program.c_str(), &actions, &attr, argv.data(), envp.data());
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (result != 0) {
+      pid = -1;
+      errno = result;
+    }
+  } else {
+    // posix_spawn has no hook for rlimits or joining a cgroup. The child
+    // shares our memory until it execs, so it only makes async-signal-safe
+    // calls and touches nothing but what was prepared above.
+    sigset_t empty;
+    sigemptyset(&empty);
+    pid = vfork();
+    if (pid == 0) {
+      signal(SIGPIPE, SIG_DFL);
+      sigprocmask(SIG_SETMASK, &empty, nullptr);
+      for (size_t i = 0; i < fds.size(); ++i) dup2(fds[i].first, fds[i].second);
+      applyLimitsInChild(spec.limits, spec.cgroupProcs);
+      execve(program.c_str(), argv.data(), envp.data());
+      _exit(127);
+    }
+  }
+
+  int error = errno;
+  closeStaged(staged);
+  errno = error;
+  return pid;
+}
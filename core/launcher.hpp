@@ -0,0 +1,44 @@
+#ifndef LAUNCHER_HPP
+#define LAUNCHER_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <sys/types.h>
+#include "./limits.hpp"
+
+// A child process described up front: its argv, its whole environment and
+// which of our fds it gets. No shell is involved, so an argument is passed
+// as one argv entry whatever it holds, and the child is started with
+// posix_spawn (vfork+exec when it needs limits applied) instead of fork, so
+// the cost stays flat however much storage the core holds.
+struct ProcessSpec {
+  // argv[0] is looked up in the PATH of `env` unless it holds a '/'.
+  std::vector<std::string> argv;
+  // "NAME=value", the whole environment the child gets.
+  std::vector<std::string> env;
+  // {our fd, its number in the child}. Ours may be O_CLOEXEC; everything
+  // else O_CLOEXEC stays behind. Inheritable fds we hold are inherited.
+  std::vector<std::pair<int, int>> fds;
+  ModuleLimits limits;
+  // cgroup.procs of the leaf it joins before exec, or nullptr.
+  const char* cgroupProcs = nullptr;
+};
+
+// Starts `spec` with SIGPIPE back to default. -1 (errno set) if it could not
+// be started, including argv[0] not being found.
+pid_t launchProcess(const ProcessSpec& spec);
+
+// PATH lookup as execvp does it, cached per PATH and name. Empty if nothing
+// executable is found.
+std::string resolveExecutable(const std::string& name, std::string_view path);
+
+// Our environment, as a starting point for ProcessSpec::env.
+std::vector<std::string> currentEnvironment();
+// Sets `name` in `env`, replacing an earlier value.
+void setEnvironment(std::vector<std::string>& env, std::string_view name, std::string_view value);
+// Its value in `env`, or nullptr.
+const char* findEnvironment(const std::vector<std::string>& env, std::string_view name);
+
+#endif
@@ -0,0 +1,165 @@
+#include "./limits.hpp"
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Digits, then an optional unit; false if there are no digits or they do
+// not fit.
+bool splitNumber(std::string_view text, uint64_t& value, std::string_view& unit) {
+  size_t i = 0;
+  value = 0;
+  while (i < text.size() && text[i] >= '0' && text[i] <= '9') {
+    if (value > (UINT64_MAX - 9) / 10) return false;
+    value = value * 10 + static_cast<uint64_t>(text[i] - '0');
+    ++i;
+  }
+  if (i == 0) return false;
+  unit = text.substr(i);
+  while (!unit.empty() && unit.front() == ' ') unit.remove_prefix(1);
+  return true;
+}
+
+bool writeFile(const std::string& path, const std::string& content) {
+  std::ofstream out(path);
+  if (!out.is_open()) return false;
+  out << content;
+  out.flush();
+  return static_cast<bool>(out);
+}
+
+}
+
+bool parseDuration(std::string_view text, int& ms) {
+  uint64_t value;
+  std::string_view unit;
+  if (!splitNumber(text, value, unit)) return false;
+
+  uint64_t scale;
+  if (unit.empty() || unit == "ms") scale = 1;
+  else if (unit == "s") scale = 1000;
+  else if (unit == "m" || unit == "min") scale = 60 * 1000;
+  else return false;
+
+  if (value > static_cast<uint64_t>(INT32_MAX) / scale) return false;
+  ms = static_cast<int>(value * scale);
+  return true;
+}
+
+bool parseByteSize(std::string_view text, uint64_t& bytes) {
+  uint64_t value;
+  std::string_view unit;
+  if (!splitNumber(text, value, unit)) return false;
+  if (unit.ends_with("iB")) unit.remove_suffix(2);
+  else if (unit.size() > 1 && unit.back() == 'B') unit.remove_suffix(1);
+
+  int shift;
+  if (unit.empty() || unit == "B") shift = 0;
+  else if (unit == "K" || unit == "k") shift = 10;
+  else if (unit == "M" || unit == "m") shift = 20;
+  else if (unit == "G" || unit == "g") shift = 30;
+  else return false;
+
+  if (value > (UINT64_MAX >> shift)) return false;
+  bytes = value << shift;
+  return true;
+}
+
+void applyLimitsInChild(const ModuleLimits& limits, const char* cgroupProcs) {
+  if (cgroupProcs) {
+    int fd = open(cgroupProcs, O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+      // "0" moves the writing process.
+      ssize_t ignored = write(fd, "0", 1);
+      (void)ignored;
+      close(fd);
+    }
+  }
+  if (limits.maxMemoryBytes > 0) {
+    // RLIMIT_AS would also count the address space V8 and friends reserve
+    // without touching; RLIMIT_DATA only what is actually allocated.
+    struct rlimit memory = {limits.maxMemoryBytes, limits.maxMemoryBytes};
+    setrlimit(RLIMIT_DATA, &memory);
+  }
+  if (limits.maxCpuSeconds > 0) {
+    struct rlimit cpu = {static_cast<rlim_t>(limits.maxCpuSeconds), static_cast<rlim_t>(limits.maxCpuSeconds) + 1};
+    setrlimit(RLIMIT_CPU, &cpu);
+  }
+}
+
+bool ModuleCgroup::usableParent(const std::string& dir) {
+  std::error_code ec;
+  return fs::is_regular_file(fs::path(dir) / "cgroup.controllers", ec) &&
+    access(dir.c_str(), W_OK) == 0;
+}
+
+ModuleCgroup::~ModuleCgroup() {
+  if (path.empty()) return;
+  // Fails while a straggler is still inside; the kernel drops the leaf
+  // once it is empty and nobody holds it.
+  rmdir(path.c_str());
+}
+
+bool ModuleCgroup::create(const std::string& parent, const std::string& name, uint64_t memoryMax) {
+  std::string dir = (fs::path(parent) / name).string();
+  if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return false;
+  if (memoryMax > 0 && !writeFile(dir + "/memory.max", std::to_string(memoryMax))) {
+    rmdir(dir.c_str());
+    return false;
+  }
+  path = dir;
+  procs = dir + "/cgroup.procs";
+  return true;
+}
+
+bool ModuleCgroup::oomKilled() const {
+  if (path.empty()) return false;
+  std::ifstream events(path + "/memory.events");
+  std::string key;
+  uint64_t count;
+  while (events >> key >> count) {
+    if (key == "oom_kill") return count > 0;
+  }
+  return false;
+}
+
+bool reapProcess(pid_t pid, int& status, struct rusage& usage, int timeoutMs) {
+  if (timeoutMs <= 0) {
+    while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {}
+    return false;
+  }
+
+  using Clock = std::chrono::steady_clock;
+  auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+  bool signalled = false;
+  auto step = std::chrono::milliseconds(1);
+  for (;;) {
+    pid_t done = wait4(pid, &status, WNOHANG, &usage);
+    if (done == pid || (done < 0 && errno != EINTR)) return signalled;
+
+    auto now = Clock::now();
+    if (now >= deadline) {
+      // SIGTERM first, so the module can flush; SIGKILL if it will not go.
+      kill(pid, signalled ? SIGKILL : SIGTERM);
+      deadline = now + std::chrono::milliseconds(KILL_GRACE_MS);
+      if (signalled) {
+        while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR) {}
+        return true;
+      }
+      signalled = true;
+      continue;
+    }
+    std::this_thread::sleep_for(std::min<Clock::duration>(step, deadline - now));
+    step = std::min(step * 2, std::chrono::milliseconds(50));
+  }
+}
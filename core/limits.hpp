@@ -0,0 +1,69 @@
+#ifndef LIMITS_HPP
+#define LIMITS_HPP
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+// What one module invocation may use, from its `Timeout:`, `MaxMemory:` and
+// `MaxCPU:` directives (or the --timeout default). Zero means unlimited.
+struct ModuleLimits {
+  // The watchdog kills a module that has gone this long without a byte
+  // moving on its stdin, stdout or stderr, or that is still alive this long
+  // after closing them: IDLE_TIMEOUT_FACTOR times its `Timeout:`.
+  int idleTimeoutMs = 0;
+  // Per worker process: RLIMIT_DATA, plus memory.max of its cgroup leaf.
+  uint64_t maxMemoryBytes = 0;
+  // Per worker process, RLIMIT_CPU: SIGXCPU, then SIGKILL a second later.
+  int maxCpuSeconds = 0;
+};
+
+// "10000" (ms), "250ms", "30s", "5m". False for anything else.
+bool parseDuration(std::string_view text, int& ms);
+// "1048576" (bytes), "512K", "256M", "2G" (binary units, `B`/`iB` optional).
+bool parseByteSize(std::string_view text, uint64_t& bytes);
+
+// Called in the child between fork and exec: sets the rlimits and joins the
+// cgroup whose cgroup.procs is `cgroupProcs` (nullptr for none). Only
+// async-signal-safe calls.
+void applyLimitsInChild(const ModuleLimits& limits, const char* cgroupProcs);
+
+// A cgroup v2 leaf for one module invocation, under a parent delegated to
+// us (--cgroup). Its workers join it before exec; memory.events then tells
+// an OOM kill apart from any other SIGKILL. Removed when destroyed.
+class ModuleCgroup {
+  public:
+    // True if `dir` is a cgroup v2 directory we can create leaves in.
+    static bool usableParent(const std::string& dir);
+
+    ModuleCgroup() = default;
+    ModuleCgroup(const ModuleCgroup&) = delete;
+    ModuleCgroup& operator=(const ModuleCgroup&) = delete;
+    ~ModuleCgroup();
+
+    // `memoryMax` 0 leaves memory.max at "max".
+    bool create(const std::string& parent, const std::string& name, uint64_t memoryMax);
+    bool active() const { return !path.empty(); }
+    const std::string& procsFile() const { return procs; }
+
+    bool oomKilled() const;
+
+  private:
+    std::string path;
+    std::string procs;
+};
+
+// wait4 with a deadline: past `timeoutMs` (<= 0: none) the process is sent
+// SIGTERM, and SIGKILL if it is still alive KILL_GRACE_MS later. Returns
+// true if it had to be signalled.
+bool reapProcess(pid_t pid, int& status, struct rusage& usage, int timeoutMs);
+
+constexpr int KILL_GRACE_MS = 2000;
+// `Timeout:` bounds one unit of work (a lookup, a request), and a module
+// works on many at once, so the first results of a slow wave can take about
+// that long to show. Silence for this many times it means a hang.
+constexpr int IDLE_TIMEOUT_FACTOR = 4;
+
+#endif
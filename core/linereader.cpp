@@ -0,0 +1,122 @@
+#include "./linereader.hpp"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+const char* findNewline(const char* begin, const char* end) {
+  const char* p = begin;
+
+#if defined(__AVX2__)
+  const __m256i nl32 = _mm256_set1_epi8('\n');
+  while (end - p >= 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl32)));
+    if (mask) return p + __builtin_ctz(mask);
+    p += 32;
+  }
+#endif
+
+#if defined(__SSE2__)
+  const __m128i nl16 = _mm_set1_epi8('\n');
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl16)));
+    if (mask) return p + __builtin_ctz(mask);
+    p += 16;
+  }
+#endif
+
+  const void* hit = std::memchr(p, '\n', static_cast<size_t>(end - p));
+  return hit ? static_cast<const char*>(hit) : nullptr;
+}
+
+LineReader::LineReader(size_t capacity)
+  : buffer(capacity > 0 ? capacity : DEFAULT_CAPACITY), head(0), scan(0), tail(0), chunkStart(0), chunkLength(0) {}
+
+void LineReader::compact(size_t minBytes) {
+  if (head > 0) {
+    size_t pending = tail - head;
+    if (pending > 0) std::memmove(buffer.data(), buffer.data() + head, pending);
+    scan -= head;
+    tail = pending;
+    head = 0;
+  }
+  if (buffer.size() - tail < minBytes) {
+    size_t grown = buffer.size() * 2;
+    while (grown - tail < minBytes) grown *= 2;
+    buffer.resize(grown);
+  }
+}
+
+char* LineReader::prepare(size_t minBytes, size_t& available) {
+  if (minBytes == 0) minBytes = 1;
+  if (head == tail) {
+    head = scan = tail = 0;
+  }
+  if (buffer.size() - tail < minBytes) {
+    compact(minBytes);
+  }
+  available = buffer.size() - tail;
+  return buffer.data() + tail;
+}
+
+void LineReader::commit(size_t n) {
+  chunkStart = tail;
+  chunkLength = n;
+  tail += n;
+}
+
+void LineReader::append(const char* data, size_t len) {
+  size_t available = 0;
+  char* dst = prepare(len, available);
+  std::memcpy(dst, data, len);
+  commit(len);
+}
+
+ssize_t LineReader::fill(int fd) {
+  // Keep reads large: only compact/grow when less than a quarter is free.
+  size_t available = 0;
+  char* dst = prepare(buffer.size() / 4, available);
+
+  ssize_t n;
+  do {
+    n = read(fd, dst, available);
+  } while (n < 0 && errno == EINTR);
+
+  if (n > 0) {
+    commit(static_cast<size_t>(n));
+  } else {
+    chunkLength = 0;
+  }
+  return n;
+}
+
+bool LineReader::next(std::string_view& line) {
+  const char* base = buffer.data();
+  const char* nl = findNewline(base + scan, base + tail);
+  if (!nl) {
+    scan = tail;
+    return false;
+  }
+
+  size_t end = static_cast<size_t>(nl - base);
+  line = std::string_view(base + head, end - head);
+  head = scan = end + 1;
+  return true;
+}
+
+void LineReader::consume(size_t n) {
+  head += n;
+  if (scan < head) scan = head;
+}
+
+bool LineReader::takeRemainder(std::string_view& line) {
+  if (head == tail) return false;
+  line = std::string_view(buffer.data() + head, tail - head);
+  head = scan = tail;
+  return true;
+}
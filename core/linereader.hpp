@@ -0,0 +1,53 @@
+#ifndef LINEREADER_HPP
+#define LINEREADER_HPP
+
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <sys/types.h>
+
+const char* findNewline(const char* begin, const char* end);
+
+// Reusable line framer over a single growable buffer. Bytes are read straight
+// into the buffer with read(2) and lines are handed out as string_views into
+// it, so framing a line costs one newline scan and no allocation. A view stays
+// valid until the next prepare()/fill() call.
+class LineReader {
+  public:
+    static constexpr size_t DEFAULT_CAPACITY = 1024 * 1024;
+
+    explicit LineReader(size_t capacity = DEFAULT_CAPACITY);
+
+    // Reads once from fd. Returns bytes read, 0 on EOF, -1 on error (errno set).
+    ssize_t fill(int fd);
+
+    // Low-level access for callers that produce bytes themselves (fread, tests).
+    char* prepare(size_t minBytes, size_t& available);
+    void commit(size_t n);
+    void append(const char* data, size_t len);
+
+    // Next complete line without its '\n'. False when no full line is buffered.
+    bool next(std::string_view& line);
+    // Unterminated bytes left at EOF, consumed by this call.
+    bool takeRemainder(std::string_view& line);
+
+    // Raw access for callers that switch to their own framing mid-stream.
+    std::string_view pending() const { return std::string_view(buffer.data() + head, tail - head); }
+    void consume(size_t n);
+
+    // Bytes produced by the last fill()/commit().
+    std::string_view lastChunk() const { return std::string_view(buffer.data() + chunkStart, chunkLength); }
+    size_t buffered() const { return tail - head; }
+
+  private:
+    void compact(size_t minBytes);
+
+    std::vector<char> buffer;
+    size_t head;
+    size_t scan;
+    size_t tail;
+    size_t chunkStart;
+    size_t chunkLength;
+};
+
+#endif
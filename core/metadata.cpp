@@ -0,0 +1,238 @@
+#include "./metadata.hpp"
+#include "./metrics.hpp"
+#include "./limits.hpp"
+#include <fstream>
+#include <algorithm>
+
+namespace {
+
+enum class Directive {
+  NAME,
+  DESCRIPTION,
+  TYPE,
+  STAGE,
+  CONSUMES,
+  PROVIDES,
+  INSTALL,
+  INSTALL_SCOPE,
+  STORAGE,
+  ARGS,
+  PARALLEL,
+  TIMEOUT,
+  RATE_LIMIT,
+  MAX_MEMORY,
+  MAX_CPU,
+  PERSISTENT,
+};
+
+const std::unordered_map<std::string_view, Directive> DIRECTIVES = {
+  {"Name", Directive::NAME},
+  {"Description", Directive::DESCRIPTION},
+  {"Type", Directive::TYPE},
+  {"Stage", Directive::STAGE},
+  {"Consumes", Directive::CONSUMES},
+  {"Provides", Directive::PROVIDES},
+  {"Install", Directive::INSTALL},
+  {"InstallScope", Directive::INSTALL_SCOPE},
+  {"Storage", Directive::STORAGE},
+  {"Args", Directive::ARGS},
+  {"Parallel", Directive::PARALLEL},
+  {"Timeout", Directive::TIMEOUT},
+  {"RateLimit", Directive::RATE_LIMIT},
+  {"MaxMemory", Directive::MAX_MEMORY},
+  {"MaxCPU", Directive::MAX_CPU},
+  {"Persistent", Directive::PERSISTENT},
+};
+
+ModuleMetadata defaultMetadata() {
+  ModuleMetadata meta;
+  meta.stage = 999;
+  meta.storageBehavior = "add";
+  meta.installScope = "shared";
+  meta.parallel = 1;
+  return meta;
+}
+
+// Text after the comment marker of a header line; false for a line of code.
+bool commentBody(std::string_view line, std::string_view& body) {
+  if (line.starts_with("//")) {
+    body = line.substr(2);
+  } else if (line.starts_with("#")) {
+    body = line.substr(1);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void applyDirective(ModuleMetadata& meta, Directive directive, std::string_view value) {
+  switch (directive) {
+    case Directive::NAME:
+      meta.name = value;
+      break;
+    case Directive::DESCRIPTION:
+      meta.description = value;
+      break;
+    case Directive::TYPE:
+      meta.type = value;
+      break;
+    case Directive::STAGE:
+      try {
+        meta.stage = std::stoi(std::string(value));
+      } catch (...) {}
+      break;
+    case Directive::CONSUMES:
+      meta.consumes = value;
+      break;
+    case Directive::PROVIDES:
+      meta.provides = value;
+      break;
+    case Directive::INSTALL:
+      meta.installCmd = value;
+      break;
+    case Directive::INSTALL_SCOPE:
+      if (value.find("isolated") != std::string_view::npos) meta.installScope = "isolated";
+      else if (value.find("global") != std::string_view::npos) meta.installScope = "global";
+      else meta.installScope = "shared";
+      break;
+    case Directive::STORAGE:
+      meta.storageBehavior = (value == "replace" || value == "delete") ? std::string(value) : "add";
+      break;
+    case Directive::ARGS:
+      meta.argSpecs.emplace_back(value);
+      break;
+    case Directive::PARALLEL: {
+      int workers = parseParallelSpec(std::string(value));
+      meta.parallel = workers >= 0 ? workers : 1;
+      break;
+    }
+    case Directive::TIMEOUT:
+      parseDuration(value, meta.timeoutMs);
+      break;
+    case Directive::RATE_LIMIT: {
+      // "200", or "dns 200" to share a bucket with other modules.
+      size_t space = value.rfind(' ');
+      std::string_view rate = space == std::string_view::npos ? value : value.substr(space + 1);
+      try {
+        meta.rateLimit = std::max(0, std::stoi(std::string(rate)));
+        meta.rateLimitKey = space == std::string_view::npos ? "" : std::string(trimView(value.substr(0, space)));
+      } catch (...) {}
+      break;
+    }
+    case Directive::MAX_MEMORY:
+      parseByteSize(value, meta.maxMemoryBytes);
+      break;
+    case Directive::MAX_CPU: {
+      // A bare number is seconds; "90s" or "2m" work too. Rounded up.
+      std::string text(value);
+      if (!text.empty() && text.back() >= '0' && text.back() <= '9') text += 's';
+      int ms;
+      if (parseDuration(text, ms)) meta.maxCpuSeconds = (ms + 999) / 1000;
+      break;
+    }
+    case Directive::PERSISTENT:
+      meta.persistent = value == "true" || value == "yes";
+      break;
+  }
+}
+
+}
+
+bool readModuleHeader(const std::string& modulePath, std::string& header) {
+  header.clear();
+  std::ifstream file(modulePath);
+  if (!file.is_open()) return false;
+
+  std::string line;
+  std::string_view body;
+  bool first = true;
+  while (std::getline(file, line)) {
+    std::string_view trimmed = trimView(line);
+    // The first line is the interpreter line, even a broken one.
+    bool interpreter = first;
+    first = false;
+    if (!interpreter && !trimmed.empty() && !commentBody(trimmed, body)) break;
+    header.append(trimmed);
+    header += '\n';
+  }
+  return true;
+}
+
+// FNV-1a; only has to tell headers of the same install apart.
+uint64_t hashModuleHeader(std::string_view header) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : header) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+ModuleMetadata compileModuleMetadata(std::string_view header) {
+  ModuleMetadata meta = defaultMetadata();
+
+  size_t pos = 0;
+  while (pos < header.size()) {
+    size_t end = header.find('\n', pos);
+    if (end == std::string_view::npos) end = header.size();
+    std::string_view line = header.substr(pos, end - pos);
+    pos = end + 1;
+
+    std::string_view body;
+    if (line.starts_with("#!") || !commentBody(line, body)) continue;
+    body = trimView(body);
+
+    size_t colon = body.find(':');
+    if (colon == std::string_view::npos) continue;
+    auto it = DIRECTIVES.find(body.substr(0, colon));
+    if (it == DIRECTIVES.end()) continue;
+    applyDirective(meta, it->second, trimView(body.substr(colon + 1)));
+  }
+  return meta;
+}
+
+MetadataCache& MetadataCache::shared() {
+  static MetadataCache cache;
+  return cache;
+}
+
+ModuleMetadata MetadataCache::load(const std::string& modulePath, uint64_t* hash) {
+  TraceSpan span("metadata", "registry", modulePath);
+  std::string header;
+  if (!readModuleHeader(modulePath, header)) {
+    if (hash) *hash = 0;
+    return defaultMetadata();
+  }
+
+  uint64_t key = hashModuleHeader(header);
+  if (hash) *hash = key;
+
+  ModuleMetadata meta;
+  if (find(key, meta)) return meta;
+  meta = compileModuleMetadata(header);
+  insert(key, meta);
+  return meta;
+}
+
+bool MetadataCache::find(uint64_t hash, ModuleMetadata& meta) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries.find(hash);
+  if (it == entries.end()) return false;
+  meta = it->second;
+  return true;
+}
+
+void MetadataCache::insert(uint64_t hash, const ModuleMetadata& meta) {
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.insert_or_assign(hash, meta);
+}
+
+size_t MetadataCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+void MetadataCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+}
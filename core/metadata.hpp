@@ -0,0 +1,42 @@
+#ifndef METADATA_HPP
+#define METADATA_HPP
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "./core.hpp"
+
+// The module header is the leading comment block: the first (interpreter)
+// line, then `//` or `#` comment lines (blank lines allowed), up to the
+// first line of code.
+// Directives are only read from there, so a "Name:" in a string further down
+// cannot override them. Lines are joined with '\n', markers kept.
+bool readModuleHeader(const std::string& modulePath, std::string& header);
+uint64_t hashModuleHeader(std::string_view header);
+ModuleMetadata compileModuleMetadata(std::string_view header);
+
+// Compiled metadata keyed by the hash of the header it came from. Hits skip
+// the directive parsing, and the ModuleRegistry seeds it from its cache
+// file, so a module that was touched but not edited is not parsed again in
+// the next run either. Thread-safe.
+class MetadataCache {
+  public:
+    static MetadataCache& shared();
+
+    // Reads the header of `modulePath` and returns its metadata, compiled at
+    // most once per distinct header. `hash` receives the header hash.
+    ModuleMetadata load(const std::string& modulePath, uint64_t* hash = nullptr);
+
+    bool find(uint64_t hash, ModuleMetadata& meta) const;
+    void insert(uint64_t hash, const ModuleMetadata& meta);
+    size_t size() const;
+    void clear();
+
+  private:
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, ModuleMetadata> entries;
+};
+
+#endif
@@ -0,0 +1,308 @@
+#include "./metrics.hpp"
+#include "./fileio.hpp"
+#include "../include/rapidjson/stringbuffer.h"
+#include "../include/rapidjson/prettywriter.h"
+#include "../include/rapidjson/writer.h"
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <ctime>
+
+namespace {
+
+std::string escapeLabel(const std::string& value) {
+  std::string out;
+  out.reserve(value.size());
+  for (char c : value) {
+    if (c == '\\' || c == '"') {
+      out += '\\';
+      out += c;
+    } else if (c == '\n') {
+      out += "\\n";
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+}
+
+void RunReport::begin(const std::string& runLabel) {
+  std::lock_guard<std::mutex> lock(mutex);
+  label = runLabel;
+  origin = Clock::now();
+  startedAt = std::chrono::system_clock::now();
+  entries.clear();
+}
+
+double RunReport::elapsedMs(Clock::time_point at) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return std::chrono::duration<double, std::milli>(at - origin).count();
+}
+
+void RunReport::record(ModuleRunStats stats) {
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.push_back(std::move(stats));
+}
+
+std::vector<ModuleRunStats> RunReport::modules() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries;
+}
+
+std::string RunReport::toJson() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::time_t started = std::chrono::system_clock::to_time_t(startedAt);
+  std::tm utc{};
+  gmtime_r(&started, &utc);
+  std::ostringstream timestamp;
+  timestamp << std::put_time(&utc, "%Y-%m-%dT%H:%M:%SZ");
+
+  double wallMs = 0;
+  for (const auto& module : entries) wallMs = std::max(wallMs, module.endMs);
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+  writer.SetIndent(' ', 2);
+  writer.StartObject();
+  writer.Key("run"); writer.String(label.c_str(), label.size());
+  writer.Key("started_at"); writer.String(timestamp.str().c_str());
+  writer.Key("wall_ms"); writer.Double(wallMs);
+  writer.Key("modules");
+  writer.StartArray();
+  for (const auto& module : entries) {
+    writer.StartObject();
+    writer.Key("module"); writer.String(module.moduleName.c_str(), module.moduleName.size());
+    writer.Key("stage"); writer.Int(module.stage);
+    writer.Key("workers"); writer.Uint64(module.workers);
+    writer.Key("start_ms"); writer.Double(module.startMs);
+    writer.Key("end_ms"); writer.Double(module.endMs);
+    writer.Key("wall_ms"); writer.Double(module.wallMs);
+    writer.Key("user_cpu_ms"); writer.Double(module.userCpuMs);
+    writer.Key("sys_cpu_ms"); writer.Double(module.sysCpuMs);
+    writer.Key("peak_rss_kb"); writer.Int64(module.peakRssKb);
+    writer.Key("bytes_in"); writer.Uint64(module.bytesIn);
+    writer.Key("bytes_out"); writer.Uint64(module.bytesOut);
+    writer.Key("bytes_err"); writer.Uint64(module.bytesErr);
+    writer.Key("items_in"); writer.Uint64(module.itemsIn);
+    writer.Key("items_out"); writer.Uint64(module.itemsOut);
+    writer.Key("exit_code"); writer.Int(module.exitCode);
+    writer.Key("warnings"); writer.Uint64(module.warnings);
+    writer.Key("errors"); writer.Uint64(module.errors);
+    writer.Key("fatal"); writer.Bool(module.fatal);
+    writer.Key("rate_limit_tokens"); writer.Uint64(module.rateLimitTokens);
+    writer.Key("rate_limit_wait_ms"); writer.Double(module.rateLimitWaitMs);
+    writer.Key("killed");
+    if (module.killed.empty()) writer.Null();
+    else writer.String(module.killed.c_str(), module.killed.size());
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+  return std::string(buffer.GetString(), buffer.GetSize()) + "\n";
+}
+
+std::string RunReport::toPrometheus() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  struct Metric {
+    const char* name;
+    const char* help;
+    double (*value)(const ModuleRunStats&);
+  };
+  static const Metric metrics[] = {
+    {"bahamut_module_wall_seconds", "Wall-clock time from spawn to exit.",
+      [](const ModuleRunStats& m) { return m.wallMs / 1000.0; }},
+    {"bahamut_module_cpu_user_seconds", "User CPU time of all workers.",
+      [](const ModuleRunStats& m) { return m.userCpuMs / 1000.0; }},
+    {"bahamut_module_cpu_system_seconds", "System CPU time of all workers.",
+      [](const ModuleRunStats& m) { return m.sysCpuMs / 1000.0; }},
+    {"bahamut_module_peak_rss_bytes", "Peak resident set size of the largest worker.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.peakRssKb) * 1024.0; }},
+    {"bahamut_module_stdin_bytes", "Bytes written to the module's stdin.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.bytesIn); }},
+    {"bahamut_module_stdout_bytes", "Bytes read from the module's stdout.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.bytesOut); }},
+    {"bahamut_module_stderr_bytes", "Bytes read from the module's stderr.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.bytesErr); }},
+    {"bahamut_module_items_in", "Items fed to the module.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.itemsIn); }},
+    {"bahamut_module_items_out", "Items the module produced.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.itemsOut); }},
+    {"bahamut_module_workers", "Worker processes the module ran as.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.workers); }},
+    {"bahamut_module_exit_code", "Exit code (128 + signal when killed).",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.exitCode); }},
+    {"bahamut_module_warnings", "BMOP warnings the module logged on stderr.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.warnings); }},
+    {"bahamut_module_errors", "BMOP errors the module reported on stderr.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.errors); }},
+    {"bahamut_module_fatal", "1 if a fatal error made the engine terminate the module.",
+      [](const ModuleRunStats& m) { return m.fatal ? 1.0 : 0.0; }},
+    {"bahamut_module_rate_limit_tokens", "Rate limiter tokens granted to the module.",
+      [](const ModuleRunStats& m) { return static_cast<double>(m.rateLimitTokens); }},
+    {"bahamut_module_rate_limit_wait_seconds", "Time the module's requests waited for rate limiter tokens, summed.",
+      [](const ModuleRunStats& m) { return m.rateLimitWaitMs / 1000.0; }},
+    {"bahamut_module_killed", "1 if the watchdog killed the module for a timeout or resource limit.",
+      [](const ModuleRunStats& m) { return m.killed.empty() ? 0.0 : 1.0; }},
+  };
+
+  std::ostringstream out;
+  out << std::setprecision(17);
+  std::string run = escapeLabel(label);
+  for (const auto& metric : metrics) {
+    out << "# HELP " << metric.name << " " << metric.help << "\n";
+    out << "# TYPE " << metric.name << " gauge\n";
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const ModuleRunStats& module = entries[i];
+      out << metric.name << "{run=\"" << run << "\",module=\"" << escapeLabel(module.moduleName)
+        << "\",stage=\"" << module.stage << "\",invocation=\"" << i << "\"} " << metric.value(module) << "\n";
+    }
+  }
+  return out.str();
+}
+
+bool RunReport::writeJson(const std::string& path) const {
+  return writeAtomically(path, toJson());
+}
+
+bool RunReport::writePrometheus(const std::string& path) const {
+  return writeAtomically(path, toPrometheus());
+}
+
+TraceRecorder& TraceRecorder::shared() {
+  static TraceRecorder recorder;
+  return recorder;
+}
+
+void TraceRecorder::start() {
+  std::lock_guard<std::mutex> lock(mutex);
+  origin = Clock::now();
+  events.clear();
+  tracks.clear();
+  threads.clear();
+  trackNames.clear();
+  active.store(true, std::memory_order_relaxed);
+}
+
+void TraceRecorder::stop() {
+  active.store(false, std::memory_order_relaxed);
+}
+
+// Caller holds the mutex. Track ids double as Chrome "tid"s, numbered from 1
+// in order of first use.
+int TraceRecorder::trackId(const std::string& track) {
+  if (track.empty()) {
+    auto [it, added] = threads.try_emplace(std::this_thread::get_id(), 0);
+    if (added) {
+      trackNames.push_back("thread " + std::to_string(threads.size()));
+      it->second = trackNames.size();
+    }
+    return it->second;
+  }
+  auto [it, added] = tracks.try_emplace(track, 0);
+  if (added) {
+    trackNames.push_back(track);
+    it->second = trackNames.size();
+  }
+  return it->second;
+}
+
+double TraceRecorder::micros(Clock::time_point at) const {
+  return std::chrono::duration<double, std::micro>(at - origin).count();
+}
+
+void TraceRecorder::span(const std::string& name, const char* category,
+    Clock::time_point begin, Clock::time_point end,
+    const std::string& module, const std::string& track) {
+  if (!enabled()) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  double ts = micros(begin);
+  events.push_back({'X', name, category, trackId(track), ts, std::max(0.0, micros(end) - ts), module, {}});
+}
+
+void TraceRecorder::counter(const std::string& name, Clock::time_point at,
+    const std::vector<std::pair<std::string, double>>& values) {
+  if (!enabled()) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  events.push_back({'C', name, "storage", 0, micros(at), 0, "", values});
+}
+
+size_t TraceRecorder::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return events.size();
+}
+
+std::string TraceRecorder::toJson() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  writer.StartObject();
+  writer.Key("displayTimeUnit"); writer.String("ms");
+  writer.Key("traceEvents");
+  writer.StartArray();
+
+  writer.StartObject();
+  writer.Key("ph"); writer.String("M");
+  writer.Key("name"); writer.String("process_name");
+  writer.Key("pid"); writer.Int(1);
+  writer.Key("args"); writer.StartObject(); writer.Key("name"); writer.String("bahamut"); writer.EndObject();
+  writer.EndObject();
+  for (size_t i = 0; i < trackNames.size(); ++i) {
+    writer.StartObject();
+    writer.Key("ph"); writer.String("M");
+    writer.Key("name"); writer.String("thread_name");
+    writer.Key("pid"); writer.Int(1);
+    writer.Key("tid"); writer.Int(i + 1);
+    writer.Key("args"); writer.StartObject(); writer.Key("name"); writer.String(trackNames[i].c_str()); writer.EndObject();
+    writer.EndObject();
+  }
+
+  for (const Event& event : events) {
+    char phase[2] = {event.phase, '\0'};
+    writer.StartObject();
+    writer.Key("ph"); writer.String(phase);
+    writer.Key("name"); writer.String(event.name.c_str(), event.name.size());
+    writer.Key("cat"); writer.String(event.category);
+    writer.Key("pid"); writer.Int(1);
+    writer.Key("tid"); writer.Int(event.tid);
+    writer.Key("ts"); writer.Double(event.ts);
+    if (event.phase == 'X') {
+      writer.Key("dur"); writer.Double(event.dur);
+    }
+    writer.Key("args");
+    writer.StartObject();
+    if (!event.module.empty()) {
+      writer.Key("module"); writer.String(event.module.c_str(), event.module.size());
+    }
+    for (const auto& [key, value] : event.values) {
+      writer.Key(key.c_str(), key.size()); writer.Double(value);
+    }
+    writer.EndObject();
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+  return std::string(buffer.GetString(), buffer.GetSize()) + "\n";
+}
+
+bool TraceRecorder::write(const std::string& path) const {
+  return writeAtomically(path, toJson());
+}
+
+TraceSpan::TraceSpan(std::string name, const char* category, std::string module)
+  : active(TraceRecorder::shared().enabled()), category(category) {
+  if (!active) return;
+  this->name = std::move(name);
+  this->module = std::move(module);
+  begin = TraceRecorder::Clock::now();
+}
+
+TraceSpan::~TraceSpan() {
+  if (active) {
+    TraceRecorder::shared().span(name, category, begin, TraceRecorder::Clock::now(), module);
+  }
+}
@@ -0,0 +1,145 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <map>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+// Resources used by one module invocation, summed over its workers (peak
+// RSS is the largest worker's). Times are milliseconds; start/end are
+// offsets from the beginning of the run. Bytes are what went through the
+// module's pipes: stdin written, stdout and stderr read.
+struct ModuleRunStats {
+  std::string moduleName;
+  int stage = 999;
+  size_t workers = 1;
+  double startMs = 0;
+  double endMs = 0;
+  double wallMs = 0;
+  double userCpuMs = 0;
+  double sysCpuMs = 0;
+  long peakRssKb = 0;
+  uint64_t bytesIn = 0;
+  uint64_t bytesOut = 0;
+  uint64_t bytesErr = 0;
+  uint64_t itemsIn = 0;
+  uint64_t itemsOut = 0;
+  // First failing worker's exit code, or 128 + signal like a shell.
+  int exitCode = 0;
+  // BMOP warnings and errors the module reported on stderr; fatal when one
+  // of its errors made the engine terminate it.
+  uint64_t warnings = 0;
+  uint64_t errors = 0;
+  bool fatal = false;
+  // Rate limiter tokens the workers were granted, and how long they waited
+  // for them in total.
+  uint64_t rateLimitTokens = 0;
+  double rateLimitWaitMs = 0;
+  // Why the watchdog killed the module ("timeout", "cpu", "memory"), or
+  // empty. Its output up to then is kept.
+  std::string killed;
+};
+
+// Collects ModuleRunStats for one bahamut run and renders them as a JSON
+// report or a Prometheus textfile (for node_exporter's textfile collector).
+// record() may be called from several scheduler threads.
+class RunReport {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    void begin(const std::string& label);
+    double elapsedMs(Clock::time_point at) const;
+    void record(ModuleRunStats stats);
+
+    std::vector<ModuleRunStats> modules() const;
+    std::string toJson() const;
+    std::string toPrometheus() const;
+
+    // Written to a temporary file and renamed into place, so readers never
+    // see half a report. Returns false if it could not be written.
+    bool writeJson(const std::string& path) const;
+    bool writePrometheus(const std::string& path) const;
+
+  private:
+    mutable std::mutex mutex;
+    std::string label;
+    Clock::time_point origin = Clock::now();
+    std::chrono::system_clock::time_point startedAt = std::chrono::system_clock::now();
+    std::vector<ModuleRunStats> entries;
+};
+
+// Chrome trace-event recorder (load the file in ui.perfetto.dev or
+// chrome://tracing). Spans are complete ("X") events on a named track; an
+// empty track means the calling thread, so nested spans on one thread stack
+// up. I/O that overlaps on one thread (a module's stdin and stdout) goes on
+// tracks of its own. Costs one atomic load per call while disabled.
+class TraceRecorder {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static TraceRecorder& shared();
+
+    // Clears what was recorded and starts timestamps from now.
+    void start();
+    void stop();
+    bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+    void span(const std::string& name, const char* category,
+        Clock::time_point begin, Clock::time_point end,
+        const std::string& module = "", const std::string& track = "");
+    void counter(const std::string& name, Clock::time_point at,
+        const std::vector<std::pair<std::string, double>>& values);
+
+    size_t size() const;
+    std::string toJson() const;
+    bool write(const std::string& path) const;
+
+  private:
+    struct Event {
+      char phase;
+      std::string name;
+      const char* category;
+      int tid;
+      double ts;
+      double dur;
+      std::string module;
+      std::vector<std::pair<std::string, double>> values;
+    };
+
+    int trackId(const std::string& track);
+    double micros(Clock::time_point at) const;
+
+    std::atomic<bool> active{false};
+    mutable std::mutex mutex;
+    Clock::time_point origin = Clock::now();
+    std::vector<Event> events;
+    std::map<std::string, int> tracks;
+    std::map<std::thread::id, int> threads;
+    std::vector<std::string> trackNames;
+};
+
+// Records its own lifetime as a span on the calling thread.
+class TraceSpan {
+  public:
+    TraceSpan(std::string name, const char* category, std::string module = "");
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+  private:
+    bool active;
+    std::string name;
+    const char* category;
+    std::string module;
+    TraceRecorder::Clock::time_point begin;
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include "./modulelog.hpp"
+#include "./console.hpp"
+#include "../include/rapidjson/stringbuffer.h"
+#include "../include/rapidjson/writer.h"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+namespace {
+
+const char* const CONSOLE_TAGS[LOG_LEVELS] = {"[DEBUG]", "[Info]", "[Warn]", "[Error]", "[Fatal]"};
+
+bool iequals(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    char c = a[i];
+    if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    if (c != b[i]) return false;
+  }
+  return true;
+}
+
+// Progress is kept for every message but only printed when it moves to
+// another tenth of the total, finishes, or changes its status text.
+bool worthPrinting(const ModuleProgress& last, int64_t current, int64_t total, std::string_view message) {
+  if (!message.empty() && message != last.message) return true;
+  if (total <= 0) return false;
+  if (current >= total) return last.current < total;
+  return last.total != total || last.current < 0 || current * 10 / total != last.current * 10 / total;
+}
+
+}
+
+const char* logLevelName(LogLevel level) {
+  static const char* const names[LOG_LEVELS] = {"debug", "info", "warn", "error", "critical"};
+  return names[static_cast<size_t>(level)];
+}
+
+LogLevel parseLogLevel(std::string_view level) {
+  if (iequals(level, "debug") || iequals(level, "trace")) return LogLevel::DEBUG;
+  if (iequals(level, "warn") || iequals(level, "warning")) return LogLevel::WARN;
+  if (iequals(level, "error")) return LogLevel::ERROR;
+  if (iequals(level, "critical") || iequals(level, "fatal")) return LogLevel::CRITICAL;
+  return LogLevel::INFO;
+}
+
+void LogCounts::add(const LogCounts& other) {
+  for (size_t i = 0; i < LOG_LEVELS; ++i) levels[i] += other.levels[i];
+  progress += other.progress;
+  raw += other.raw;
+}
+
+ModuleLog& ModuleLog::shared() {
+  static ModuleLog log;
+  return log;
+}
+
+void ModuleLog::begin() {
+  std::lock_guard<std::mutex> lock(mutex);
+  modules.clear();
+  progressByModule.clear();
+}
+
+void ModuleLog::setConsoleLevel(LogLevel level) {
+  std::lock_guard<std::mutex> lock(mutex);
+  consoleLevel = level;
+}
+
+bool ModuleLog::setFile(const std::string& path) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (file.is_open()) file.close();
+  if (path.empty()) return true;
+  file.open(path, std::ios::app);
+  return file.is_open();
+}
+
+void ModuleLog::log(const std::string& module, LogLevel level, std::string_view message, std::string_view code) {
+  std::lock_guard<std::mutex> lock(mutex);
+  modules[module].levels[static_cast<size_t>(level)]++;
+
+  if (level >= consoleLevel) {
+    std::ostringstream line;
+    line << CONSOLE_TAGS[static_cast<size_t>(level)] << " " << module << ": ";
+    if (!code.empty()) line << code << ": ";
+    line << message << "\n";
+    ConsoleRenderer::shared().print(std::cerr, line.str());
+  }
+
+  if (file.is_open()) {
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+    writer.StartObject();
+    writer.Key("ts_ms"); writer.Int64(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+    writer.Key("module"); writer.String(module.c_str(), module.size());
+    writer.Key("level"); writer.String(logLevelName(level));
+    if (!code.empty()) {
+      writer.Key("code"); writer.String(code.data(), code.size());
+    }
+    writer.Key("m"); writer.String(message.data(), message.size());
+    writer.EndObject();
+    file.write(buffer.GetString(), buffer.GetSize());
+    file.put('\n');
+    file.flush();
+  }
+}
+
+void ModuleLog::progress(const std::string& module, int64_t current, int64_t total, std::string_view message) {
+  std::lock_guard<std::mutex> lock(mutex);
+  modules[module].progress++;
+  ModuleProgress& last = progressByModule[module];
+  bool print = worthPrinting(last, current, total, message);
+  last.current = current;
+  last.total = total;
+  if (!message.empty()) last.message.assign(message);
+
+  if (print && consoleLevel <= LogLevel::INFO && ConsoleRenderer::shared().showsProgress()) {
+    std::ostringstream line;
+    line << "[Progress] " << module << ": " << current;
+    if (total > 0) line << "/" << total << " (" << current * 100 / total << "%)";
+    if (!message.empty()) line << " " << message;
+    line << "\n";
+    ConsoleRenderer::shared().print(std::cerr, line.str());
+  }
+}
+
+void ModuleLog::raw(const std::string& module, std::string_view line) {
+  std::lock_guard<std::mutex> lock(mutex);
+  modules[module].raw++;
+  std::string text(line);
+  text += '\n';
+  ConsoleRenderer::shared().print(std::cerr, text);
+}
+
+LogCounts ModuleLog::counts(const std::string& module) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = modules.find(module);
+  return it == modules.end() ? LogCounts() : it->second;
+}
+
+LogCounts ModuleLog::totals() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  LogCounts total;
+  for (const auto& [module, counts] : modules) total.add(counts);
+  return total;
+}
+
+ModuleProgress ModuleLog::lastProgress(const std::string& module) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = progressByModule.find(module);
+  return it == progressByModule.end() ? ModuleProgress() : it->second;
+}
+
+bool StderrParser::feed(std::string_view line) {
+  ModuleLog& sink = ModuleLog::shared();
+  if (line.empty() || line[0] != '{' || !decoder.decode(line, event)) {
+    seen.raw++;
+    sink.raw(module, line);
+    return false;
+  }
+
+  switch (event.type) {
+    case BmopEventType::LOG: {
+      LogLevel level = parseLogLevel(event.level);
+      seen.levels[static_cast<size_t>(level)]++;
+      sink.log(module, level, event.message.data() ? event.message : event.error);
+      return false;
+    }
+    case BmopEventType::PROGRESS:
+      seen.progress++;
+      sink.progress(module, event.count, event.total, event.message);
+      return false;
+    case BmopEventType::ERROR: {
+      LogLevel level = event.fatal ? LogLevel::CRITICAL : LogLevel::ERROR;
+      seen.levels[static_cast<size_t>(level)]++;
+      sink.log(module, level, event.message.data() ? event.message : event.error, event.code);
+      if (!event.fatal) return false;
+      fatal = true;
+      return true;
+    }
+    default:
+      seen.raw++;
+      sink.raw(module, line);
+      return false;
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef MODULELOG_HPP
+#define MODULELOG_HPP
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+#include "./bmop.hpp"
+
+enum class LogLevel {
+  DEBUG,
+  INFO,
+  WARN,
+  ERROR,
+  CRITICAL
+};
+
+constexpr size_t LOG_LEVELS = 5;
+
+const char* logLevelName(LogLevel level);
+// BMOP `l` values; "warning" and "fatal"/"critical" are accepted as aliases.
+// Anything else (or no level at all) is INFO.
+LogLevel parseLogLevel(std::string_view level);
+
+struct LogCounts {
+  uint64_t levels[LOG_LEVELS] = {};
+  uint64_t progress = 0;
+  // Lines that were not BMOP, passed through to the console as they were.
+  uint64_t raw = 0;
+
+  uint64_t operator[](LogLevel level) const { return levels[static_cast<size_t>(level)]; }
+  void add(const LogCounts& other);
+};
+
+struct ModuleProgress {
+  int64_t current = -1;
+  int64_t total = -1;
+  std::string message;
+};
+
+// Where the engine routes what modules report on stderr. Keeps per-module
+// and per-level counters and the last progress of each module, renders
+// messages on the console (debug only when asked for), and optionally
+// appends every log and error as a JSON line to a file. Thread-safe: the
+// scheduler runs modules on several threads.
+class ModuleLog {
+  public:
+    static ModuleLog& shared();
+
+    // Clears counters and progress. Console level and file stay as set.
+    void begin();
+    void setConsoleLevel(LogLevel level);
+    // Appends to `path`; an empty path closes the file.
+    bool setFile(const std::string& path);
+
+    void log(const std::string& module, LogLevel level, std::string_view message, std::string_view code = {});
+    void progress(const std::string& module, int64_t current, int64_t total, std::string_view message);
+    void raw(const std::string& module, std::string_view line);
+
+    LogCounts counts(const std::string& module) const;
+    LogCounts totals() const;
+    ModuleProgress lastProgress(const std::string& module) const;
+
+  private:
+    mutable std::mutex mutex;
+    LogLevel consoleLevel = LogLevel::INFO;
+    std::ofstream file;
+    std::map<std::string, LogCounts> modules;
+    std::map<std::string, ModuleProgress> progressByModule;
+};
+
+// One stderr stream of one module worker: decodes its lines as BMOP and
+// routes `log`, `progress` and `error` messages to the ModuleLog. Anything
+// else is passed through untouched. A fatal error is logged as CRITICAL.
+class StderrParser {
+  public:
+    explicit StderrParser(std::string moduleName) : module(std::move(moduleName)) {}
+
+    // True when the line was a fatal error.
+    bool feed(std::string_view line);
+
+    const LogCounts& counts() const { return seen; }
+    bool sawFatal() const { return fatal; }
+
+  private:
+    std::string module;
+    BmopDecoder decoder;
+    BmopEvent event;
+    LogCounts seen;
+    bool fatal = false;
+};
+
+#endif
@@ -0,0 +1,338 @@
+#include "./ratelimit.hpp"
+#include "../include/rapidjson/document.h"
+#include "../include/rapidjson/stringbuffer.h"
+#include "../include/rapidjson/writer.h"
+#include <algorithm>
+#include <cmath>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+namespace {
+
+constexpr uint64_t WAKE_EVENT = UINT64_MAX;
+// A worker sending this much without a newline is not speaking the protocol.
+constexpr size_t MAX_LINE = 64 * 1024;
+
+double seconds(TokenBucket::Clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+}
+
+TokenBucket::TokenBucket(double rate, Clock::time_point now)
+  : ceilingRate(rate), currentRate(rate), balance(std::max(rate, 1.0)), updated(now) {}
+
+void TokenBucket::refill(Clock::time_point now) {
+  if (now <= updated) return;
+  double elapsed = seconds(now - updated);
+  updated = now;
+  if (currentRate < ceilingRate) {
+    currentRate = std::min(ceilingRate, currentRate + ceilingRate * RECOVERY * elapsed);
+  }
+  // One second's worth of burst.
+  balance = std::min(std::max(currentRate, 1.0), balance + currentRate * elapsed);
+}
+
+TokenBucket::Clock::time_point TokenBucket::reserve(double tokens, Clock::time_point now) {
+  refill(now);
+  balance -= tokens;
+  if (balance >= 0) return now;
+  return now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(-balance / currentRate));
+}
+
+void TokenBucket::backoff(Clock::time_point now) {
+  refill(now);
+  currentRate = std::max(ceilingRate * MIN_FRACTION, currentRate / 2);
+}
+
+void TokenBucket::setCeiling(double rate, Clock::time_point now) {
+  refill(now);
+  ceilingRate = rate;
+  currentRate = std::min(currentRate, rate);
+}
+
+RateLimiter& RateLimiter::shared() {
+  static RateLimiter limiter;
+  return limiter;
+}
+
+RateLimiter::~RateLimiter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  if (thread.joinable()) {
+    uint64_t one = 1;
+    ssize_t ignored = write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+    thread.join();
+  }
+  for (auto& [id, connection] : connections) {
+    if (connection.fd >= 0) close(connection.fd);
+  }
+  if (epfd >= 0) close(epfd);
+  if (wakeFd >= 0) close(wakeFd);
+}
+
+void RateLimiter::configure(const std::string& bucket, double rate) {
+  std::lock_guard<std::mutex> lock(mutex);
+  pinned[bucket] = rate;
+  if (auto it = buckets.find(bucket); it != buckets.end()) it->second.setCeiling(rate, Clock::now());
+}
+
+bool RateLimiter::anyConfigured() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return !pinned.empty();
+}
+
+void RateLimiter::declare(const std::string& bucket, double rate) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto [it, inserted] = declared.try_emplace(bucket, rate);
+  if (!inserted && rate >= it->second) return;
+  it->second = rate;
+  if (pinned.count(bucket)) return;
+  if (auto existing = buckets.find(bucket); existing != buckets.end()) existing->second.setCeiling(rate, Clock::now());
+}
+
+double RateLimiter::rate(const std::string& bucket) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (auto it = pinned.find(bucket); it != pinned.end()) return it->second;
+  if (auto it = declared.find(bucket); it != declared.end()) return it->second;
+  return 0;
+}
+
+void RateLimiter::reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  pinned.clear();
+  declared.clear();
+  buckets.clear();
+}
+
+TokenBucket* RateLimiter::bucket(const std::string& name) {
+  if (auto it = buckets.find(name); it != buckets.end()) return &it->second;
+  double rate = 0;
+  if (auto it = pinned.find(name); it != pinned.end()) rate = it->second;
+  else if (auto it = declared.find(name); it != declared.end()) rate = it->second;
+  if (rate <= 0) return nullptr;
+  return &buckets.try_emplace(name, rate, Clock::now()).first->second;
+}
+
+void RateLimiter::ensureThread() {
+  if (thread.joinable()) return;
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  struct epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.u64 = WAKE_EVENT;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd, &ev);
+  thread = std::thread(&RateLimiter::run, this);
+}
+
+int RateLimiter::connect(const std::string& defaultBucket, int& childFd) {
+  childFd = -1;
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0) return -1;
+  fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  ensureThread();
+  int id = nextConnection++;
+  Connection& connection = connections[id];
+  connection.fd = fds[0];
+  connection.bucket = defaultBucket;
+
+  struct epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.u64 = static_cast<uint64_t>(id);
+  epoll_ctl(epfd, EPOLL_CTL_ADD, fds[0], &ev);
+  childFd = fds[1];
+  return id;
+}
+
+RateLimiter::Usage RateLimiter::disconnect(int id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = connections.find(id);
+  if (it == connections.end()) return Usage();
+  Usage usage = it->second.usage;
+  closeConnection(it->second);
+  connections.erase(it);
+  return usage;
+}
+
+RateLimiter::Usage RateLimiter::usage(int id) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = connections.find(id);
+  return it == connections.end() ? Usage() : it->second.usage;
+}
+
+void RateLimiter::closeConnection(Connection& connection) {
+  if (connection.fd >= 0) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, connection.fd, nullptr);
+    close(connection.fd);
+    connection.fd = -1;
+  }
+  connection.open = false;
+}
+
+void RateLimiter::send(int id, Connection& connection, const std::string& reply) {
+  if (!connection.open) return;
+  connection.output += reply;
+  flushOutput(id, connection);
+}
+
+void RateLimiter::flushOutput(int id, Connection& connection) {
+  while (!connection.output.empty()) {
+    ssize_t n = ::send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+    if (n > 0) {
+      connection.output.erase(0, static_cast<size_t>(n));
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    closeConnection(connection);
+    return;
+  }
+
+  bool wantWrite = !connection.output.empty();
+  if (wantWrite == connection.writing) return;
+  connection.writing = wantWrite;
+  struct epoll_event ev{};
+  ev.events = EPOLLIN | (wantWrite ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+  ev.data.u64 = static_cast<uint64_t>(id);
+  epoll_ctl(epfd, EPOLL_CTL_MOD, connection.fd, &ev);
+}
+
+void RateLimiter::handleInput(int id, Connection& connection) {
+  char buffer[4096];
+  bool closed = false;
+  for (;;) {
+    ssize_t n = read(connection.fd, buffer, sizeof(buffer));
+    if (n > 0) {
+      connection.input.append(buffer, static_cast<size_t>(n));
+      continue;
+    }
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    // The worker exited or closed its end.
+    closed = true;
+    break;
+  }
+
+  // Lines written just before that still count (a last backoff); send()
+  // drops grants once the connection is closed.
+  size_t start = 0;
+  size_t end;
+  while ((end = connection.input.find('\n', start)) != std::string::npos) {
+    handleLine(id, connection, std::string_view(connection.input).substr(start, end - start));
+    start = end + 1;
+  }
+  connection.input.erase(0, start);
+  if (closed || connection.input.size() > MAX_LINE) closeConnection(connection);
+}
+
+void RateLimiter::handleLine(int id, Connection& connection, std::string_view line) {
+  rapidjson::Document doc;
+  if (doc.Parse(line.data(), line.size()).HasParseError() || !doc.IsObject()) return;
+  auto type = doc.FindMember("t");
+  if (type == doc.MemberEnd() || !type->value.IsString()) return;
+  std::string_view kind(type->value.GetString(), type->value.GetStringLength());
+
+  std::string name = connection.bucket;
+  if (auto k = doc.FindMember("k"); k != doc.MemberEnd() && k->value.IsString()) {
+    name.assign(k->value.GetString(), k->value.GetStringLength());
+  }
+  auto now = Clock::now();
+  TokenBucket* tokens = bucket(name);
+
+  if (kind == "backoff") {
+    if (tokens) tokens->backoff(now);
+    return;
+  }
+  if (kind != "acquire") return;
+
+  double count = 1;
+  if (auto n = doc.FindMember("n"); n != doc.MemberEnd() && n->value.IsNumber() && n->value.GetDouble() > 0) {
+    count = n->value.GetDouble();
+  }
+
+  rapidjson::StringBuffer reply;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(reply);
+  writer.StartObject();
+  writer.Key("t"); writer.String("grant");
+  if (auto request = doc.FindMember("id"); request != doc.MemberEnd()) {
+    writer.Key("id");
+    request->value.Accept(writer);
+  }
+  writer.EndObject();
+  std::string text(reply.GetString(), reply.GetSize());
+  text += '\n';
+
+  connection.usage.granted += static_cast<uint64_t>(std::ceil(count));
+  Clock::time_point at = tokens ? tokens->reserve(count, now) : now;
+  if (at <= now) {
+    send(id, connection, text);
+  } else {
+    grants.push(Grant{at, id, std::move(text), std::chrono::duration<double, std::milli>(at - now).count()});
+  }
+}
+
+void RateLimiter::run() {
+  struct epoll_event events[64];
+  for (;;) {
+    int timeout = -1;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (stopping) return;
+      if (!grants.empty()) {
+        auto wait = grants.top().at - Clock::now();
+        timeout = wait <= Clock::duration::zero() ? 0 :
+          static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(wait).count());
+      }
+    }
+
+    int n = epoll_wait(epfd, events, 64, timeout);
+    if (n < 0 && errno != EINTR) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) return;
+    for (int i = 0; i < n; ++i) {
+      if (events[i].data.u64 == WAKE_EVENT) {
+        uint64_t value;
+        ssize_t ignored = read(wakeFd, &value, sizeof(value));
+        (void)ignored;
+        continue;
+      }
+      auto it = connections.find(static_cast<int>(events[i].data.u64));
+      if (it == connections.end() || !it->second.open) continue;
+      if (events[i].events & EPOLLOUT) flushOutput(it->first, it->second);
+      if (it->second.open && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) handleInput(it->first, it->second);
+    }
+
+    auto now = Clock::now();
+    while (!grants.empty() && grants.top().at <= now) {
+      Grant grant = grants.top();
+      grants.pop();
+      auto it = connections.find(grant.connection);
+      if (it == connections.end() || !it->second.open) continue;
+      it->second.usage.waitMs += grant.waitMs;
+      send(grant.connection, it->second, grant.reply);
+    }
+  }
+}
+
+bool parseRateLimitSpec(std::string_view spec, std::string& bucket, double& rate) {
+  size_t eq = spec.find('=');
+  if (eq == std::string_view::npos || eq == 0) return false;
+  std::string value(spec.substr(eq + 1));
+  char* end = nullptr;
+  double parsed = std::strtod(value.c_str(), &end);
+  if (value.empty() || *end != '\0' || !(parsed > 0)) return false;
+  bucket.assign(spec.substr(0, eq));
+  rate = parsed;
+  return true;
+}
@@ -0,0 +1,140 @@
+#ifndef RATELIMIT_HPP
+#define RATELIMIT_HPP
+
+#include <string>
+#include <string_view>
+#include <map>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// Tokens refill at `rate` per second, up to one second's worth (at least
+// one token). A reservation always
+// succeeds: the balance goes negative and the caller waits until it would
+// be back at zero, so reservations are served in the order they were made.
+// backoff() halves the rate (not below MIN_FRACTION of the ceiling); it
+// creeps back up by RECOVERY of the ceiling per second.
+class TokenBucket {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr double MIN_FRACTION = 1.0 / 16;
+    static constexpr double RECOVERY = 0.05;
+
+    TokenBucket(double rate, Clock::time_point now);
+
+    // When `tokens` may be used.
+    Clock::time_point reserve(double tokens, Clock::time_point now);
+    void backoff(Clock::time_point now);
+    // Lowers or raises the ceiling; the current rate follows it down.
+    void setCeiling(double rate, Clock::time_point now);
+
+    double rate() const { return currentRate; }
+    double ceiling() const { return ceilingRate; }
+
+  private:
+    void refill(Clock::time_point now);
+
+    double ceilingRate;
+    double currentRate;
+    double balance;
+    Clock::time_point updated;
+};
+
+// Token buckets shared by every module of the run, keyed by name ("dns",
+// "crt.sh"). Each worker that may need one gets a socket as fd 3
+// (BMOP_RATELIMIT_FD) and asks for tokens with BMOP-style JSON lines:
+//
+//   {"t":"acquire","id":7,"k":"dns","n":1}  ->  {"t":"grant","id":7}
+//   {"t":"backoff","k":"dns"}                   (the provider pushed back)
+//
+// `id` is echoed, `k` defaults to the bucket the module declared and `n`
+// to 1. A bucket nobody gave a rate grants at once. Requests are answered
+// from one thread, so workers of every module running at the time (--jobs,
+// shards) draw from the same buckets.
+class RateLimiter {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // What one connection (worker) drew.
+    struct Usage {
+      uint64_t granted = 0;
+      double waitMs = 0;
+    };
+
+    static RateLimiter& shared();
+    ~RateLimiter();
+
+    // --rate-limit: pins a bucket's rate over whatever modules declare.
+    void configure(const std::string& bucket, double rate);
+    bool anyConfigured() const;
+    // A module's `RateLimit:`. The lowest declared rate wins.
+    void declare(const std::string& bucket, double rate);
+    double rate(const std::string& bucket) const;
+
+    // A socket pair for one worker; the child end goes to `childFd`. Returns
+    // the connection, or -1 (with childFd -1) if none could be made.
+    int connect(const std::string& defaultBucket, int& childFd);
+    // Stops serving the connection and returns what it drew.
+    Usage disconnect(int connection);
+    // What it has drawn so far.
+    Usage usage(int connection) const;
+
+    // Drops all buckets and pinned rates.
+    void reset();
+
+  private:
+    struct Grant {
+      Clock::time_point at;
+      int connection;
+      std::string reply;
+      double waitMs;
+      bool operator>(const Grant& other) const { return at > other.at; }
+    };
+
+    struct Connection {
+      int fd = -1;
+      std::string bucket;
+      std::string input;
+      std::string output;
+      bool open = true;
+      bool writing = false;
+      Usage usage;
+    };
+
+    RateLimiter() = default;
+    void ensureThread();
+    void run();
+    // Caller holds mutex.
+    void handleInput(int id, Connection& connection);
+    void handleLine(int id, Connection& connection, std::string_view line);
+    void send(int id, Connection& connection, const std::string& reply);
+    void flushOutput(int id, Connection& connection);
+    void closeConnection(Connection& connection);
+    // nullptr for a bucket without a rate.
+    TokenBucket* bucket(const std::string& name);
+
+    mutable std::mutex mutex;
+    std::map<std::string, double, std::less<>> pinned;
+    std::map<std::string, double, std::less<>> declared;
+    std::map<std::string, TokenBucket, std::less<>> buckets;
+    std::map<int, Connection> connections;
+    std::priority_queue<Grant, std::vector<Grant>, std::greater<Grant>> grants;
+    int nextConnection = 0;
+    int epfd = -1;
+    int wakeFd = -1;
+    bool stopping = false;
+    std::thread thread;
+};
+
+// Where workers find their end of the socket.
+constexpr int RATELIMIT_CHILD_FD = 3;
+
+// "dns=200" for --rate-limit. False if it does not parse.
+bool parseRateLimitSpec(std::string_view spec, std::string& bucket, double& rate);
+
+#endif
@@ -0,0 +1,312 @@
+#include "./registry.hpp"
+#include "./metadata.hpp"
+#include "./fileio.hpp"
+#include "../include/rapidjson/document.h"
+#include "../include/rapidjson/stringbuffer.h"
+#include "../include/rapidjson/writer.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <system_error>
+#include <cstdio>
+#include <cstdlib>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::set<std::string, std::less<>> PRUNED_DIRS = {"node_modules", "python_libs", "shared_deps"};
+const std::set<std::string, std::less<>> MODULE_EXTENSIONS = {".js", ".py", ".sh"};
+
+void writeMetadata(rapidjson::Writer<rapidjson::StringBuffer>& writer, const ModuleMetadata& meta) {
+  writer.StartObject();
+  writer.Key("name"); writer.String(meta.name.c_str(), meta.name.size());
+  writer.Key("description"); writer.String(meta.description.c_str(), meta.description.size());
+  writer.Key("type"); writer.String(meta.type.c_str(), meta.type.size());
+  writer.Key("stage"); writer.Int(meta.stage);
+  writer.Key("consumes"); writer.String(meta.consumes.c_str(), meta.consumes.size());
+  writer.Key("provides"); writer.String(meta.provides.c_str(), meta.provides.size());
+  writer.Key("storage"); writer.String(meta.storageBehavior.c_str(), meta.storageBehavior.size());
+  writer.Key("install"); writer.String(meta.installCmd.c_str(), meta.installCmd.size());
+  writer.Key("installScope"); writer.String(meta.installScope.c_str(), meta.installScope.size());
+  writer.Key("parallel"); writer.Int(meta.parallel);
+  writer.Key("timeout"); writer.Int(meta.timeoutMs);
+  writer.Key("rateLimit"); writer.Int(meta.rateLimit);
+  writer.Key("rateLimitKey"); writer.String(meta.rateLimitKey.c_str(), meta.rateLimitKey.size());
+  writer.Key("maxMemory"); writer.Uint64(meta.maxMemoryBytes);
+  writer.Key("maxCpu"); writer.Int(meta.maxCpuSeconds);
+  writer.Key("persistent"); writer.Bool(meta.persistent);
+  writer.Key("args");
+  writer.StartArray();
+  for (const auto& spec : meta.argSpecs) writer.String(spec.c_str(), spec.size());
+  writer.EndArray();
+  writer.EndObject();
+}
+
+bool readMetadata(const rapidjson::Value& object, ModuleMetadata& meta) {
+  if (!object.IsObject()) return false;
+  meta.name = getString(object, "name");
+  meta.description = getString(object, "description");
+  meta.type = getString(object, "type");
+  meta.stage = static_cast<int>(getInt(object, "stage", 999));
+  meta.consumes = getString(object, "consumes");
+  meta.provides = getString(object, "provides");
+  meta.storageBehavior = getString(object, "storage");
+  meta.installCmd = getString(object, "install");
+  meta.installScope = getString(object, "installScope");
+  meta.parallel = static_cast<int>(getInt(object, "parallel", 1));
+  meta.timeoutMs = static_cast<int>(getInt(object, "timeout", 0));
+  meta.rateLimit = static_cast<int>(getInt(object, "rateLimit", 0));
+  meta.rateLimitKey = getString(object, "rateLimitKey");
+  meta.maxMemoryBytes = static_cast<uint64_t>(getInt(object, "maxMemory", 0));
+  meta.maxCpuSeconds = static_cast<int>(getInt(object, "maxCpu", 0));
+  auto persistent = object.FindMember("persistent");
+  meta.persistent = persistent != object.MemberEnd() && persistent->value.IsBool() && persistent->value.GetBool();
+  meta.argSpecs.clear();
+  auto args = object.FindMember("args");
+  if (args != object.MemberEnd() && args->value.IsArray()) {
+    for (const auto& spec : args->value.GetArray()) {
+      if (spec.IsString()) meta.argSpecs.emplace_back(spec.GetString(), spec.GetStringLength());
+    }
+  }
+  return true;
+}
+
+}
+
+ModuleRegistry::ModuleRegistry(std::string root, std::string cacheFile)
+    : root(std::move(root)), cacheFile(std::move(cacheFile)) {}
+
+bool ModuleRegistry::lookup(std::string_view name, ModuleEntry& entry) {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensureFresh();
+
+  auto it = byName.find(name);
+  if (it == byName.end()) return false;
+  if (refreshEntry(modules[it->second])) {
+    // The file vanished without its directory's mtime moving (same tick).
+    if (modules[it->second].mtime < 0) scan();
+    save();
+    it = byName.find(name);
+    if (it == byName.end()) return false;
+  }
+
+  entry = modules[it->second];
+  return true;
+}
+
+std::vector<ModuleEntry> ModuleRegistry::entries() {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensureFresh();
+
+  bool changed = false;
+  bool vanished = false;
+  for (auto& entry : modules) {
+    changed = refreshEntry(entry) || changed;
+    vanished = vanished || entry.mtime < 0;
+  }
+  if (vanished) scan();
+  if (changed) save();
+  return modules;
+}
+
+std::vector<std::string> ModuleRegistry::names() {
+  std::lock_guard<std::mutex> lock(mutex);
+  ensureFresh();
+
+  std::vector<std::string> result;
+  result.reserve(modules.size());
+  for (const auto& entry : modules) result.push_back(entry.name);
+  return result;
+}
+
+void ModuleRegistry::invalidate() {
+  std::lock_guard<std::mutex> lock(mutex);
+  loaded = false;
+}
+
+void ModuleRegistry::ensureFresh() {
+  // The root is relative to the working directory, which may move.
+  std::error_code ec;
+  std::string absoluteRoot = fs::absolute(root, ec).lexically_normal().string();
+
+  if (!loaded || absoluteRoot != indexedRoot) {
+    loaded = true;
+    indexedRoot = absoluteRoot;
+    modules.clear();
+    directories.clear();
+    if (load() && directoriesFresh()) {
+      reindex();
+      return;
+    }
+    scan();
+    save();
+    return;
+  }
+
+  if (!directoriesFresh()) {
+    scan();
+    save();
+  }
+}
+
+bool ModuleRegistry::directoriesFresh() const {
+  if (directories.empty()) return false;
+  for (const auto& directory : directories) {
+    if (statPath(directory.path) != directory.mtime) return false;
+  }
+  return true;
+}
+
+// Re-reads the metadata of a module whose file changed in place. Returns
+// true when the entry changed; a file that is gone is left with mtime -1
+// for the caller to rescan.
+bool ModuleRegistry::refreshEntry(ModuleEntry& entry) {
+  uint64_t size = 0;
+  int64_t mtime = statPath(entry.path, &size);
+  if (mtime == entry.mtime && size == entry.size) return false;
+
+  entry.mtime = mtime;
+  if (mtime < 0) return true;
+  entry.size = size;
+  entry.meta = MetadataCache::shared().load(entry.path, &entry.hash);
+  return true;
+}
+
+void ModuleRegistry::scan() {
+  std::map<std::string, ModuleEntry> previous;
+  for (auto& entry : modules) {
+    previous.emplace(entry.path, std::move(entry));
+  }
+  modules.clear();
+  directories.clear();
+
+  // Record the root even when it does not exist yet, so creating it
+  // invalidates the (empty) index.
+  directories.push_back({root, statPath(root)});
+  std::error_code ec;
+  if (directories.back().mtime < 0 || !fs::is_directory(root, ec)) {
+    reindex();
+    return;
+  }
+
+  fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec);
+  for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+    const fs::directory_entry& file = *it;
+    std::string name = file.path().filename().string();
+
+    if (file.is_directory(ec)) {
+      if (PRUNED_DIRS.count(name)) {
+        it.disable_recursion_pending();
+        continue;
+      }
+      std::string path = file.path().string();
+      directories.push_back({path, statPath(path)});
+      continue;
+    }
+
+    if (!file.is_regular_file(ec) || !MODULE_EXTENSIONS.count(file.path().extension().string())) continue;
+
+    ModuleEntry entry;
+    entry.name = name;
+    entry.path = file.path().string();
+    entry.mtime = statPath(entry.path, &entry.size);
+
+    auto known = previous.find(entry.path);
+    if (known != previous.end() && known->second.mtime == entry.mtime && known->second.size == entry.size) {
+      entry.hash = known->second.hash;
+      entry.meta = std::move(known->second.meta);
+    } else {
+      entry.meta = MetadataCache::shared().load(entry.path, &entry.hash);
+    }
+    modules.push_back(std::move(entry));
+  }
+
+  reindex();
+}
+
+// First module with a given name wins, like the directory walk it replaces.
+void ModuleRegistry::reindex() {
+  byName.clear();
+  for (size_t i = 0; i < modules.size(); ++i) {
+    byName.emplace(modules[i].name, i);
+  }
+}
+
+bool ModuleRegistry::load() {
+  std::ifstream file(cacheFile);
+  if (!file.is_open()) return false;
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string json = buffer.str();
+
+  rapidjson::Document doc;
+  doc.Parse(json.c_str(), json.size());
+  if (doc.HasParseError() || !doc.IsObject()) return false;
+  if (getInt(doc, "version", 0) != CACHE_VERSION || getString(doc, "root") != indexedRoot) return false;
+
+  auto dirs = doc.FindMember("directories");
+  auto mods = doc.FindMember("modules");
+  if (dirs == doc.MemberEnd() || !dirs->value.IsArray() || mods == doc.MemberEnd() || !mods->value.IsArray()) {
+    return false;
+  }
+
+  for (const auto& dir : dirs->value.GetArray()) {
+    if (!dir.IsObject()) return false;
+    directories.push_back({getString(dir, "path"), getInt(dir, "mtime", -2)});
+  }
+  for (const auto& mod : mods->value.GetArray()) {
+    if (!mod.IsObject()) return false;
+    ModuleEntry entry;
+    entry.name = getString(mod, "name");
+    entry.path = getString(mod, "path");
+    entry.mtime = getInt(mod, "mtime", -2);
+    entry.size = static_cast<uint64_t>(getInt(mod, "size", 0));
+    entry.hash = std::strtoull(getString(mod, "hash").c_str(), nullptr, 16);
+    auto meta = mod.FindMember("meta");
+    if (meta == mod.MemberEnd() || !readMetadata(meta->value, entry.meta)) return false;
+    if (entry.hash != 0) MetadataCache::shared().insert(entry.hash, entry.meta);
+    modules.push_back(std::move(entry));
+  }
+  return true;
+}
+
+// Best effort: a missing or unwritable cache only costs a rescan next run.
+void ModuleRegistry::save() const {
+  if (directories.empty() || directories.front().mtime < 0) return;
+
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  writer.StartObject();
+  writer.Key("version"); writer.Int(CACHE_VERSION);
+  writer.Key("root"); writer.String(indexedRoot.c_str(), indexedRoot.size());
+  writer.Key("directories");
+  writer.StartArray();
+  for (const auto& directory : directories) {
+    writer.StartObject();
+    writer.Key("path"); writer.String(directory.path.c_str(), directory.path.size());
+    writer.Key("mtime"); writer.Int64(directory.mtime);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.Key("modules");
+  writer.StartArray();
+  for (const auto& entry : modules) {
+    writer.StartObject();
+    writer.Key("name"); writer.String(entry.name.c_str(), entry.name.size());
+    writer.Key("path"); writer.String(entry.path.c_str(), entry.path.size());
+    writer.Key("mtime"); writer.Int64(entry.mtime);
+    writer.Key("size"); writer.Uint64(entry.size);
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(entry.hash));
+    writer.Key("hash"); writer.String(hash);
+    writer.Key("meta");
+    writeMetadata(writer, entry.meta);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+
+  writeAtomically(cacheFile, std::string_view(buffer.GetString(), buffer.GetSize()));
+}
@@ -0,0 +1,60 @@
+#ifndef REGISTRY_HPP
+#define REGISTRY_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include "./core.hpp"
+
+// Name -> path + metadata index of the modules under `root`. The walk prunes
+// dependency trees (node_modules, python_libs, shared_deps), and the index is
+// persisted to `cacheFile` together with the mtime of every directory walked.
+// It is reused, in memory and across runs, until one of those directories
+// changes, so a lookup costs a stat per directory plus one for the module's
+// file, not a walk of the tree. A file whose mtime or size moved has its
+// header re-read; the MetadataCache skips the parse if the header is the
+// same.
+// Thread-safe; lookups return copies.
+class ModuleRegistry {
+  public:
+    // Bump whenever ModuleMetadata or the directive parser changes, so
+    // metadata compiled by an older build is not reused.
+    static constexpr int CACHE_VERSION = 5;
+
+    ModuleRegistry(std::string root, std::string cacheFile);
+
+    bool lookup(std::string_view name, ModuleEntry& entry);
+    std::vector<ModuleEntry> entries();
+    std::vector<std::string> names();
+
+    // Forgets the in-memory index; the next call revalidates the cache file.
+    void invalidate();
+
+  private:
+    struct Directory {
+      std::string path;
+      int64_t mtime;
+    };
+
+    void ensureFresh();
+    bool directoriesFresh() const;
+    bool refreshEntry(ModuleEntry& entry);
+    void scan();
+    bool load();
+    void save() const;
+    void reindex();
+
+    std::string root;
+    std::string cacheFile;
+    std::string indexedRoot;
+    bool loaded = false;
+    std::vector<ModuleEntry> modules;
+    std::map<std::string, size_t, std::less<>> byName;
+    std::vector<Directory> directories;
+    std::mutex mutex;
+};
+
+#endif
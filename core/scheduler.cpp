@@ -0,0 +1,187 @@
+#include "./scheduler.hpp"
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <algorithm>
+
+namespace {
+
+bool overlaps(const std::set<std::string>& a, bool aAll, const std::set<std::string>& b, bool bAll) {
+  if (aAll && (bAll || !b.empty())) return true;
+  if (bAll && !a.empty()) return true;
+  for (const auto& format : a) {
+    if (b.count(format)) return true;
+  }
+  return false;
+}
+
+// A replace/delete module's output for its format is only final once it
+// exits, so it cannot be streamed to readers of that format.
+bool appendsOnly(const ModuleMetadata& meta) {
+  bool rewrites = meta.storageBehavior == "replace" || meta.storageBehavior == "delete";
+  return !(rewrites && !meta.consumes.empty() && meta.consumes != "*" && meta.provides == meta.consumes);
+}
+
+}
+
+StorageAccess StorageAccess::fromMetadata(const ModuleMetadata& meta) {
+  StorageAccess access;
+
+  if (meta.consumes == "*") {
+    access.readsAll = true;
+  } else if (!meta.consumes.empty()) {
+    access.reads.insert(meta.consumes);
+  }
+
+  if (meta.provides.empty()) {
+    access.writesAll = true;
+  } else {
+    access.writes.insert(meta.provides);
+  }
+
+  return access;
+}
+
+bool StorageAccess::conflictsWith(const StorageAccess& other) const {
+  // Replace/delete only ever touch the consumed format when it is also the
+  // provided one, so they are covered by the write set.
+  return overlaps(writes, writesAll, other.reads, other.readsAll) ||
+         overlaps(reads, readsAll, other.writes, other.writesAll) ||
+         overlaps(writes, writesAll, other.writes, other.writesAll);
+}
+
+ModuleScheduler::ModuleScheduler(size_t jobs, bool streaming) : jobs(jobs > 0 ? jobs : 1), streaming(streaming) {}
+
+size_t ModuleScheduler::add(ScheduledModule module) {
+  size_t index = modules.size();
+  StorageAccess current = StorageAccess::fromMetadata(module.meta);
+
+  std::vector<size_t> before;
+  std::vector<size_t> streamed;
+  bool barrierWriter = false;
+  // A sharded module splits its whole input up front, so it has to wait.
+  bool streamable = streaming && moduleParallelism(module.meta) == 1;
+  for (size_t i = 0; i < index; ++i) {
+    if (!access[i].conflictsWith(current)) continue;
+
+    bool feedsInput = overlaps(access[i].writes, access[i].writesAll, current.reads, current.readsAll);
+    if (streamable && feedsInput && appendsOnly(modules[i].meta)) {
+      streamed.push_back(i);
+    } else {
+      before.push_back(i);
+      barrierWriter = barrierWriter || feedsInput;
+    }
+  }
+
+  // Input comes either all from storage or partly through the channel with a
+  // storage snapshot taken before any streamed writer merged; mixing in a
+  // barrier writer would split one format across both.
+  if (barrierWriter && !streamed.empty()) {
+    before.insert(before.end(), streamed.begin(), streamed.end());
+    std::sort(before.begin(), before.end());
+    streamed.clear();
+  }
+
+  modules.push_back(std::move(module));
+  access.push_back(std::move(current));
+  deps.push_back(std::move(before));
+  streamDeps.push_back(std::move(streamed));
+  return index;
+}
+
+void ModuleScheduler::wireStreams() {
+  for (size_t i = 0; i < modules.size(); ++i) {
+    if (streamDeps[i].empty() || modules[i].streams.input) continue;
+    channels.push_back(std::make_unique<StreamChannel>(modules[i].meta.consumes, streamDeps[i].size()));
+    modules[i].streams.input = channels.back().get();
+    for (size_t producer : streamDeps[i]) {
+      modules[producer].streams.outputs.push_back(channels.back().get());
+    }
+  }
+}
+
+void ModuleScheduler::run(const Executor& execute) {
+  bool anyStreams = std::any_of(streamDeps.begin(), streamDeps.end(), [](const auto& d) { return !d.empty(); });
+  if (jobs == 1 && !anyStreams) {
+    for (const auto& module : modules) {
+      execute(module);
+    }
+    return;
+  }
+
+  wireStreams();
+
+  std::vector<size_t> waiting(modules.size());
+  std::vector<size_t> waitingStart(modules.size());
+  std::vector<std::vector<size_t>> dependents(modules.size());
+  std::vector<std::vector<size_t>> streamDependents(modules.size());
+  std::set<size_t> ready;
+  for (size_t i = 0; i < modules.size(); ++i) {
+    waiting[i] = deps[i].size();
+    waitingStart[i] = streamDeps[i].size();
+    for (size_t dep : deps[i]) dependents[dep].push_back(i);
+    for (size_t dep : streamDeps[i]) streamDependents[dep].push_back(i);
+    if (waiting[i] == 0 && waitingStart[i] == 0) ready.insert(i);
+  }
+
+  std::mutex mutex;
+  std::condition_variable finishedCv;
+  std::vector<size_t> finished;
+  std::vector<std::thread> workers;
+  size_t running = 0;
+  size_t done = 0;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (done < modules.size()) {
+    // Lowest index first, so ties resolve in program order. Starting a
+    // module can make its stream consumers ready; they have higher indices,
+    // so this same pass picks them up.
+    for (auto it = ready.begin(); it != ready.end();) {
+      size_t index = *it;
+      bool needsSlot = streamDeps[index].empty();
+      if (needsSlot && running >= jobs) {
+        ++it;
+        continue;
+      }
+      ready.erase(it);
+      if (needsSlot) running++;
+      workers.emplace_back([&, index]() {
+        try {
+          execute(modules[index]);
+        } catch (const std::exception& e) {
+          std::cout << "[-] Module " << modules[index].moduleName << " failed: " << e.what() << std::endl;
+        }
+        // A consumer that bailed out must not leave its producers blocked.
+        if (modules[index].streams.input) modules[index].streams.input->detach();
+        for (StreamChannel* channel : modules[index].streams.outputs) {
+          channel->producerDone();
+        }
+        std::lock_guard<std::mutex> guard(mutex);
+        finished.push_back(index);
+        finishedCv.notify_one();
+      });
+
+      for (size_t next : streamDependents[index]) {
+        if (--waitingStart[next] == 0 && waiting[next] == 0) ready.insert(next);
+      }
+      it = ready.upper_bound(index);
+    }
+
+    finishedCv.wait(lock, [&]() { return !finished.empty(); });
+    for (size_t index : finished) {
+      if (streamDeps[index].empty()) running--;
+      done++;
+      for (size_t next : dependents[index]) {
+        if (--waiting[next] == 0 && waitingStart[next] == 0) ready.insert(next);
+      }
+    }
+    finished.clear();
+  }
+  lock.unlock();
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
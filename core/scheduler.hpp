@@ -0,0 +1,74 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <string>
+#include <vector>
+#include <set>
+#include <functional>
+#include <memory>
+#include <cstddef>
+#include "./core.hpp"
+#include "./channel.hpp"
+
+struct ScheduledModule {
+  std::string moduleName;
+  std::vector<std::string> args;
+  ModuleMetadata meta;
+  ModuleStreams streams;
+};
+
+// Formats a module reads from and writes to the shared storage, derived from
+// its Consumes/Provides/Storage metadata. A module without Provides may emit
+// any format, so it is treated as writing everything.
+struct StorageAccess {
+  std::set<std::string> reads;
+  std::set<std::string> writes;
+  bool readsAll = false;
+  bool writesAll = false;
+
+  static StorageAccess fromMetadata(const ModuleMetadata& meta);
+  bool conflictsWith(const StorageAccess& other) const;
+};
+
+// Runs modules as a DAG instead of a fixed sequence. Modules are added in
+// program order (profile order, or stage order); a module depends on every
+// earlier one it has a read/write, write/read or write/write hazard with, so
+// results match a sequential run while unrelated modules overlap, up to
+// `jobs` at a time. With jobs == 1 everything runs inline, in order.
+//
+// With streaming on, a read-after-write edge becomes a stream edge instead
+// of a barrier when the writer only appends: the reader starts once its
+// writers have started and gets their items through a StreamChannel while
+// they run. Writers that replace/delete their format only have a final
+// result, so readers of it keep waiting, and a reader with any such writer
+// waits for all of them. A module sharded across workers (Parallel) splits
+// its whole input before it starts, so it always waits too. Streaming
+// readers do not take one of the `jobs` slots; they would only sit blocked
+// on their producers.
+class ModuleScheduler {
+  public:
+    using Executor = std::function<void(const ScheduledModule& module)>;
+
+    explicit ModuleScheduler(size_t jobs, bool streaming = false);
+
+    size_t add(ScheduledModule module);
+    void run(const Executor& execute);
+
+    size_t size() const { return modules.size(); }
+    const ScheduledModule& module(size_t index) const { return modules[index]; }
+    const std::vector<size_t>& dependencies(size_t index) const { return deps[index]; }
+    const std::vector<size_t>& streamDependencies(size_t index) const { return streamDeps[index]; }
+
+  private:
+    void wireStreams();
+
+    size_t jobs;
+    bool streaming;
+    std::vector<ScheduledModule> modules;
+    std::vector<StorageAccess> access;
+    std::vector<std::vector<size_t>> deps;
+    std::vector<std::vector<size_t>> streamDeps;
+    std::vector<std::unique_ptr<StreamChannel>> channels;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "./storage.hpp"
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+void FormatColumn::append(std::string_view value) {
+  if (value.size() > std::numeric_limits<uint32_t>::max()) {
+    throw std::length_error("FormatColumn: value exceeds 4GiB");
+  }
+  offsets.push_back(arena.size());
+  lengths.push_back(static_cast<uint32_t>(value.size()));
+  arena.insert(arena.end(), value.begin(), value.end());
+}
+
+void FormatColumn::append(const FormatColumn& other) {
+  if (&other == this) {
+    FormatColumn copy = other;
+    append(copy);
+    return;
+  }
+  uint64_t base = arena.size();
+  arena.insert(arena.end(), other.arena.begin(), other.arena.end());
+  offsets.reserve(offsets.size() + other.offsets.size());
+  for (uint64_t offset : other.offsets) {
+    offsets.push_back(base + offset);
+  }
+  lengths.insert(lengths.end(), other.lengths.begin(), other.lengths.end());
+}
+
+void FormatColumn::reserve(size_t items, size_t valueBytes) {
+  offsets.reserve(items);
+  lengths.reserve(items);
+  arena.reserve(valueBytes);
+}
+
+void FormatColumn::clear() {
+  arena.clear();
+  offsets.clear();
+  lengths.clear();
+}
+
+void FormatColumn::shrink_to_fit() {
+  arena.shrink_to_fit();
+  offsets.shrink_to_fit();
+  lengths.shrink_to_fit();
+}
+
+FormatId Storage::intern(std::string_view format) {
+  auto it = index.find(format);
+  if (it != index.end()) return it->second;
+
+  FormatId id = static_cast<FormatId>(columns.size());
+  columns.emplace_back(id, std::string(format));
+  live.push_back(false);
+  index.emplace(std::string(format), id);
+  return id;
+}
+
+bool Storage::lookup(std::string_view format, FormatId& id) const {
+  auto it = index.find(format);
+  if (it == index.end()) return false;
+  id = it->second;
+  return true;
+}
+
+FormatColumn& Storage::column(FormatId id) {
+  if (!live[id]) {
+    live[id] = true;
+    liveCount++;
+  }
+  return columns[id];
+}
+
+size_t Storage::count(std::string_view format) const {
+  FormatId id;
+  return (lookup(format, id) && live[id]) ? 1 : 0;
+}
+
+size_t Storage::totalItems() const {
+  size_t total = 0;
+  for (size_t id = 0; id < columns.size(); ++id) {
+    if (live[id]) total += columns[id].size();
+  }
+  return total;
+}
+
+size_t Storage::totalBytes() const {
+  size_t total = 0;
+  for (size_t id = 0; id < columns.size(); ++id) {
+    if (live[id]) total += columns[id].bytes();
+  }
+  return total;
+}
+
+Storage::iterator Storage::find(std::string_view format) {
+  auto it = index.find(format);
+  if (it == index.end() || !live[it->second]) return end();
+  return iterator(this, it);
+}
+
+Storage::const_iterator Storage::find(std::string_view format) const {
+  auto it = index.find(format);
+  if (it == index.end() || !live[it->second]) return end();
+  return const_iterator(this, it);
+}
+
+size_t Storage::erase(std::string_view format) {
+  FormatId id;
+  if (!lookup(format, id) || !live[id]) return 0;
+  columns[id].clear();
+  columns[id].shrink_to_fit();
+  live[id] = false;
+  liveCount--;
+  return 1;
+}
+
+void Storage::clear() {
+  for (size_t id = 0; id < columns.size(); ++id) {
+    if (live[id]) {
+      columns[id].clear();
+      columns[id].shrink_to_fit();
+      live[id] = false;
+    }
+  }
+  liveCount = 0;
+}
@@ -0,0 +1,177 @@
+#ifndef STORAGE_HPP
+#define STORAGE_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <type_traits>
+
+using FormatId = uint32_t;
+
+struct DataItem {
+  std::string format;
+  std::string value;
+};
+
+struct DataItemView {
+  std::string_view format;
+  std::string_view value;
+};
+
+// Values of a single format live back to back in one append-only arena.
+// Items are addressed by (offset, length) so an item costs its bytes plus
+// 12 bytes of bookkeeping. Views returned by operator[] are invalidated by
+// the next append to the same column, like std::vector references.
+class FormatColumn {
+  public:
+    class const_iterator {
+      public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = DataItemView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = DataItemView;
+
+        const_iterator() : column(nullptr), index(0) {}
+        const_iterator(const FormatColumn* column, size_t index) : column(column), index(index) {}
+
+        DataItemView operator*() const { return (*column)[index]; }
+        const_iterator& operator++() { ++index; return *this; }
+        const_iterator operator++(int) { const_iterator tmp = *this; ++index; return tmp; }
+        const_iterator& operator+=(difference_type n) { index += n; return *this; }
+        difference_type operator-(const const_iterator& other) const { return static_cast<difference_type>(index) - static_cast<difference_type>(other.index); }
+        bool operator==(const const_iterator& other) const { return index == other.index && column == other.column; }
+        bool operator!=(const const_iterator& other) const { return !(*this == other); }
+
+      private:
+        const FormatColumn* column;
+        size_t index;
+    };
+
+    FormatColumn(FormatId id, std::string name) : formatId(id), formatName(std::move(name)) {}
+
+    FormatId id() const { return formatId; }
+    const std::string& name() const { return formatName; }
+
+    size_t size() const { return lengths.size(); }
+    bool empty() const { return lengths.empty(); }
+    size_t bytes() const { return arena.size(); }
+
+    DataItemView operator[](size_t i) const {
+      return {formatName, std::string_view(arena.data() + offsets[i], lengths[i])};
+    }
+    std::string_view value(size_t i) const {
+      return std::string_view(arena.data() + offsets[i], lengths[i]);
+    }
+
+    template <typename T> requires std::is_convertible_v<const T&, std::string_view>
+    void push_back(const T& value) { append(std::string_view(value)); }
+    void push_back(const DataItem& item) { append(std::string_view(item.value)); }
+    void append(std::string_view value);
+    void append(const FormatColumn& other);
+    void reserve(size_t items, size_t valueBytes);
+    void clear();
+    void shrink_to_fit();
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+  private:
+    FormatId formatId;
+    std::string formatName;
+    std::vector<char> arena;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> lengths;
+};
+
+// Pipeline storage. Format names are interned once to a FormatId; hot paths
+// (batch ingestion, egress) resolve the id up front and then address the
+// column directly instead of hashing/copying the format per item.
+// Iteration is in format-name order, matching the previous std::map layout.
+class Storage {
+  private:
+    using Index = std::map<std::string, FormatId, std::less<>>;
+
+  public:
+    template <bool Const>
+    class basic_iterator {
+      public:
+        using column_ref = std::conditional_t<Const, const FormatColumn&, FormatColumn&>;
+        using storage_ptr = std::conditional_t<Const, const Storage*, Storage*>;
+        using value_type = std::pair<const std::string&, column_ref>;
+        using reference = value_type;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::forward_iterator_tag;
+
+        struct arrow_proxy {
+          value_type entry;
+          const value_type* operator->() const { return &entry; }
+        };
+
+        basic_iterator() : storage(nullptr) {}
+        basic_iterator(storage_ptr storage, Index::const_iterator it) : storage(storage), it(it) { skipDead(); }
+
+        reference operator*() const { return {it->first, storage->columns[it->second]}; }
+        arrow_proxy operator->() const { return {**this}; }
+        basic_iterator& operator++() { ++it; skipDead(); return *this; }
+        basic_iterator operator++(int) { basic_iterator tmp = *this; ++*this; return tmp; }
+        bool operator==(const basic_iterator& other) const { return it == other.it; }
+        bool operator!=(const basic_iterator& other) const { return it != other.it; }
+
+        FormatId id() const { return it->second; }
+
+      private:
+        void skipDead() {
+          while (it != storage->index.end() && !storage->live[it->second]) ++it;
+        }
+
+        storage_ptr storage;
+        Index::const_iterator it;
+
+        friend class Storage;
+    };
+
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    FormatId intern(std::string_view format);
+    bool lookup(std::string_view format, FormatId& id) const;
+
+    FormatColumn& column(FormatId id);
+    const FormatColumn& column(FormatId id) const { return columns[id]; }
+
+    FormatColumn& operator[](std::string_view format) { return column(intern(format)); }
+
+    void append(FormatId id, std::string_view value) { column(id).append(value); }
+    void append(std::string_view format, std::string_view value) { append(intern(format), value); }
+
+    size_t size() const { return liveCount; }
+    bool empty() const { return liveCount == 0; }
+    size_t count(std::string_view format) const;
+    size_t totalItems() const;
+    size_t totalBytes() const;
+
+    iterator find(std::string_view format);
+    const_iterator find(std::string_view format) const;
+    size_t erase(std::string_view format);
+    void clear();
+
+    iterator begin() { return iterator(this, index.begin()); }
+    iterator end() { return iterator(this, index.end()); }
+    const_iterator begin() const { return const_iterator(this, index.begin()); }
+    const_iterator end() const { return const_iterator(this, index.end()); }
+
+  private:
+    Index index;
+    std::deque<FormatColumn> columns;
+    std::vector<bool> live;
+    size_t liveCount = 0;
+};
+
+#endif
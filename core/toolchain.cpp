@@ -0,0 +1,181 @@
+#include "./toolchain.hpp"
+#include "./launcher.hpp"
+#include "./fileio.hpp"
+#include "../include/rapidjson/document.h"
+#include "../include/rapidjson/stringbuffer.h"
+#include "../include/rapidjson/writer.h"
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+namespace {
+
+// One line each: version, whether pip is importable, first site-packages.
+const char* PYTHON_PROBE = R"PY(
+import importlib.util, site, sys
+print(sys.version.split()[0])
+print(importlib.util.find_spec("pip") is not None)
+print((site.getsitepackages() or [""])[0])
+)PY";
+
+// Runs `argv` with stdin and stderr on /dev/null; its stdout split in lines.
+// False if it could not start or did not exit 0.
+bool captureLines(const std::vector<std::string>& argv, std::vector<std::string>& lines) {
+  int out[2];
+  if (pipe2(out, O_CLOEXEC) != 0) return false;
+  int null = open("/dev/null", O_RDWR | O_CLOEXEC);
+
+  ProcessSpec spec;
+  spec.argv = argv;
+  spec.env = currentEnvironment();
+  spec.fds = {{out[1], STDOUT_FILENO}};
+  if (null >= 0) {
+    spec.fds.emplace_back(null, STDIN_FILENO);
+    spec.fds.emplace_back(null, STDERR_FILENO);
+  }
+  pid_t pid = launchProcess(spec);
+  close(out[1]);
+  if (null >= 0) close(null);
+  if (pid < 0) {
+    close(out[0]);
+    return false;
+  }
+
+  std::string text;
+  char buffer[4096];
+  for (;;) {
+    ssize_t n = read(out[0], buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    text.append(buffer, static_cast<size_t>(n));
+  }
+  close(out[0]);
+
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return false;
+
+  std::istringstream stream(text);
+  std::string line;
+  while (std::getline(stream, line)) lines.push_back(line);
+  return true;
+}
+
+}
+
+ToolchainCache::ToolchainCache(std::string cacheFile) : cacheFile(std::move(cacheFile)) {}
+
+bool ToolchainCache::python(const std::string& command, Toolchain& toolchain) {
+  return lookup(command, true, toolchain);
+}
+
+bool ToolchainCache::npm(Toolchain& toolchain) {
+  return lookup("npm", false, toolchain);
+}
+
+bool ToolchainCache::lookup(const std::string& command, bool isPython, Toolchain& toolchain) {
+  const char* path = std::getenv("PATH");
+  std::string binary = resolveExecutable(command, path ? path : "/bin:/usr/bin");
+  if (binary.empty()) return false;
+  int64_t mtime = statPath(binary);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!loaded) load();
+  if (auto it = toolchains.find(binary); it != toolchains.end() && it->second.mtime == mtime) {
+    toolchain = it->second;
+    return toolchain.ok;
+  }
+
+  Toolchain probed;
+  probed.path = binary;
+  probed.mtime = mtime;
+  std::vector<std::string> lines;
+  if (isPython) {
+    probed.ok = captureLines({binary, "-c", PYTHON_PROBE}, lines) && lines.size() >= 3;
+    if (probed.ok) {
+      probed.version = lines[0];
+      probed.pip = lines[1] == "True";
+      probed.modulesRoot = lines[2];
+    }
+  } else {
+    probed.ok = captureLines({binary, "root", "-g"}, lines) && !lines.empty();
+    if (probed.ok) probed.modulesRoot = lines[0];
+  }
+
+  toolchains[binary] = probed;
+  save();
+  toolchain = probed;
+  return probed.ok;
+}
+
+void ToolchainCache::setPip(const std::string& command, bool available) {
+  const char* path = std::getenv("PATH");
+  std::string binary = resolveExecutable(command, path ? path : "/bin:/usr/bin");
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = toolchains.find(binary);
+  if (it == toolchains.end() || it->second.pip == available) return;
+  it->second.pip = available;
+  save();
+}
+
+void ToolchainCache::load() {
+  loaded = true;
+  std::ifstream file(cacheFile);
+  if (!file.is_open()) return;
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  std::string json = buffer.str();
+
+  rapidjson::Document doc;
+  doc.Parse(json.c_str(), json.size());
+  if (doc.HasParseError() || !doc.IsObject()) return;
+  auto version = doc.FindMember("version");
+  if (version == doc.MemberEnd() || !version->value.IsInt() || version->value.GetInt() != CACHE_VERSION) return;
+  auto list = doc.FindMember("toolchains");
+  if (list == doc.MemberEnd() || !list->value.IsArray()) return;
+
+  for (const auto& item : list->value.GetArray()) {
+    if (!item.IsObject()) continue;
+    auto mtime = item.FindMember("mtime");
+    auto pip = item.FindMember("pip");
+    if (mtime == item.MemberEnd() || !mtime->value.IsInt64()) continue;
+    Toolchain toolchain;
+    toolchain.path = getString(item, "path");
+    toolchain.mtime = mtime->value.GetInt64();
+    auto ok = item.FindMember("ok");
+    toolchain.ok = ok == item.MemberEnd() || !ok->value.IsBool() || ok->value.GetBool();
+    toolchain.version = getString(item, "version");
+    toolchain.pip = pip != item.MemberEnd() && pip->value.IsBool() && pip->value.GetBool();
+    toolchain.modulesRoot = getString(item, "root");
+    if (!toolchain.path.empty()) toolchains[toolchain.path] = toolchain;
+  }
+}
+
+// Best effort, like the module index: without it the next run probes again.
+void ToolchainCache::save() const {
+  rapidjson::StringBuffer buffer;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
+  writer.StartObject();
+  writer.Key("version"); writer.Int(CACHE_VERSION);
+  writer.Key("toolchains");
+  writer.StartArray();
+  for (const auto& [binary, toolchain] : toolchains) {
+    writer.StartObject();
+    writer.Key("path"); writer.String(toolchain.path.c_str(), toolchain.path.size());
+    writer.Key("mtime"); writer.Int64(toolchain.mtime);
+    writer.Key("ok"); writer.Bool(toolchain.ok);
+    writer.Key("version"); writer.String(toolchain.version.c_str(), toolchain.version.size());
+    writer.Key("pip"); writer.Bool(toolchain.pip);
+    writer.Key("root"); writer.String(toolchain.modulesRoot.c_str(), toolchain.modulesRoot.size());
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+
+  writeAtomically(cacheFile, std::string_view(buffer.GetString(), buffer.GetSize()));
+}
@@ -0,0 +1,58 @@
+#ifndef TOOLCHAIN_HPP
+#define TOOLCHAIN_HPP
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+// What running an interpreter or package manager once told us about it.
+struct Toolchain {
+  // The binary, as found in PATH, and the mtime of what it points to.
+  std::string path;
+  int64_t mtime = -1;
+  // False if the probe failed (a broken interpreter, npm that will not run);
+  // remembered like a success, so it is not retried until the binary changes.
+  bool ok = true;
+  // Python: sys.version, e.g. "3.11.7".
+  std::string version;
+  // Python: `-m pip` is there.
+  bool pip = false;
+  // Python: the first site-packages directory. npm: `npm root -g`.
+  std::string modulesRoot;
+};
+
+// Probes pythonX and npm once per binary instead of spawning them for every
+// install and every global-scope module run. Results are keyed by the
+// binary's path and mtime, persisted to `cacheFile`, and reused across runs
+// until the binary is replaced (an upgrade, a new venv in PATH), failed
+// probes included. One Python probe answers version, pip and site-packages
+// together.
+// Thread-safe.
+class ToolchainCache {
+  public:
+    static constexpr int CACHE_VERSION = 1;
+
+    explicit ToolchainCache(std::string cacheFile);
+
+    // `command` is "python3", "python3.11", ... False if it is not in PATH
+    // or the probe failed.
+    bool python(const std::string& command, Toolchain& toolchain);
+    bool npm(Toolchain& toolchain);
+
+    // Records that pip was just installed for `command`: its binary did not
+    // change, so the cached answer would not be revisited.
+    void setPip(const std::string& command, bool available);
+
+  private:
+    bool lookup(const std::string& command, bool isPython, Toolchain& toolchain);
+    void load();
+    void save() const;
+
+    std::string cacheFile;
+    bool loaded = false;
+    std::map<std::string, Toolchain> toolchains;
+    std::mutex mutex;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "./workerpool.hpp"
+#include "./limits.hpp"
+#include "./ratelimit.hpp"
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include <sys/resource.h>
+
+bool sampleProcessUsage(pid_t pid, ProcessUsage& usage) {
+  std::string dir = "/proc/" + std::to_string(pid);
+  std::ifstream stat(dir + "/stat");
+  std::string line;
+  if (!std::getline(stat, line)) return false;
+
+  // The command name may hold spaces and parentheses; fields resume after
+  // the last ')'. utime and stime are fields 14 and 15, in clock ticks.
+  size_t close = line.rfind(')');
+  if (close == std::string::npos) return false;
+  std::istringstream fields(line.substr(close + 2));
+  std::string skip;
+  for (int field = 3; field < 14; ++field) fields >> skip;
+  unsigned long long utime = 0, stime = 0;
+  if (!(fields >> utime >> stime)) return false;
+  double msPerTick = 1000.0 / static_cast<double>(sysconf(_SC_CLK_TCK));
+  usage.userCpuMs = utime * msPerTick;
+  usage.sysCpuMs = stime * msPerTick;
+
+  std::ifstream status(dir + "/status");
+  while (std::getline(status, line)) {
+    if (line.starts_with("VmHWM:")) {
+      usage.peakRssKb = std::stol(line.substr(6));
+      break;
+    }
+  }
+  return true;
+}
+
+WorkerPool& WorkerPool::shared() {
+  static WorkerPool pool;
+  return pool;
+}
+
+// Built after the rate limiter, so it is still there when we shut down.
+WorkerPool::WorkerPool() {
+  RateLimiter::shared();
+}
+
+WorkerPool::~WorkerPool() {
+  shutdown();
+}
+
+std::unique_ptr<PersistentWorker> WorkerPool::acquire(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = workers.find(key);
+  if (it == workers.end() || it->second.empty()) return nullptr;
+  std::unique_ptr<PersistentWorker> worker = std::move(it->second.back());
+  it->second.pop_back();
+  return worker;
+}
+
+void WorkerPool::release(const std::string& key, std::unique_ptr<PersistentWorker> worker) {
+  std::lock_guard<std::mutex> lock(mutex);
+  workers[key].push_back(std::move(worker));
+}
+
+size_t WorkerPool::idle() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t count = 0;
+  for (const auto& [key, list] : workers) count += list.size();
+  return count;
+}
+
+void WorkerPool::shutdown() {
+  std::map<std::string, std::vector<std::unique_ptr<PersistentWorker>>> retiring;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    retiring.swap(workers);
+  }
+
+  // EOF to all of them first, so they wind down together.
+  for (auto& [key, list] : retiring) {
+    for (auto& worker : list) {
+      close(worker->stdinFd);
+      worker->stdinFd = -1;
+    }
+  }
+  for (auto& [key, list] : retiring) {
+    for (auto& worker : list) {
+      int status = 0;
+      struct rusage usage{};
+      reapProcess(worker->pid, status, usage, KILL_GRACE_MS);
+      close(worker->stdoutFd);
+      close(worker->stderrFd);
+      if (worker->rateConnection >= 0) RateLimiter::shared().disconnect(worker->rateConnection);
+    }
+  }
+}
@@ -0,0 +1,78 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <string>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <sys/types.h>
+#include "./bmop.hpp"
+
+// CPU and peak RSS of a live process, from /proc.
+struct ProcessUsage {
+  double userCpuMs = 0;
+  double sysCpuMs = 0;
+  long peakRssKb = 0;
+};
+
+// False if the process is gone or /proc is not there.
+bool sampleProcessUsage(pid_t pid, ProcessUsage& usage);
+
+// A warm process of a `Persistent: true` module, between jobs. It was
+// started with BMOP_PERSISTENT=1 and reads one job after another from the
+// same stdin:
+//
+//   {"t":"job","id":1}       then the job's input, as for any module
+//   {"t":"job_end","id":1}   in place of EOF
+//
+// and answers each with its output followed by {"t":"job_done","id":1} on
+// stdout, after which it must stay quiet until the next job. On a binary
+// wire the control messages are JSON frames, and both ends keep their
+// format tables across jobs. EOF on stdin means there is no more work.
+struct PersistentWorker {
+  pid_t pid = -1;
+  int stdinFd = -1;
+  int stdoutFd = -1;
+  int stderrFd = -1;
+  // Its RateLimiter connection, or -1.
+  int rateConnection = -1;
+  uint64_t jobs = 0;
+  // Set by the header line of the first job; later jobs get no header.
+  BmopWire wire = BmopWire::JSONL;
+  BmopBinaryEncoder encoder;
+  BmopBinaryDecoder decoder;
+  // What it had used when its last job ended, so each job reports its own.
+  ProcessUsage usage;
+  uint64_t rateTokens = 0;
+  double rateWaitMs = 0;
+};
+
+// Idle persistent workers of this process, keyed by what started them
+// (command line and module version), so successive invocations of a
+// module - twice in a profile, once per profile of a multi-profile run -
+// skip the interpreter start and whatever the module sets up once.
+class WorkerPool {
+  public:
+    static WorkerPool& shared();
+    ~WorkerPool();
+
+    // An idle worker started for `key`, or nullptr.
+    std::unique_ptr<PersistentWorker> acquire(const std::string& key);
+    // Hands back a worker whose job is done, for the next invocation.
+    void release(const std::string& key, std::unique_ptr<PersistentWorker> worker);
+    size_t idle() const;
+
+    // Closes every idle worker's stdin and reaps it (SIGTERM, then SIGKILL,
+    // if it does not exit within KILL_GRACE_MS).
+    void shutdown();
+
+  private:
+    WorkerPool();
+
+    mutable std::mutex mutex;
+    std::map<std::string, std::vector<std::unique_ptr<PersistentWorker>>> workers;
+};
+
+#endif
@@ -0,0 +1,516 @@
+#include "./zygote.hpp"
+#include "./launcher.hpp"
+#include "./eventloop.hpp"
+#include "../include/rapidjson/document.h"
+#include "../include/rapidjson/stringbuffer.h"
+#include "../include/rapidjson/writer.h"
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+namespace {
+
+// argv: control fd, then the libraries to preload. Requests are one
+// SOCK_SEQPACKET message each: JSON plus stdin, stdout, stderr and
+// optionally the rate limiter socket.
+const char* PYTHON_FORK_SERVER = R"PY(
+import array, fcntl, importlib, json, os, runpy, select, signal, socket, sys, traceback
+
+control = socket.socket(fileno=int(sys.argv[1]))
+for name in sys.argv[2:]:
+    try:
+        importlib.import_module(name)
+    except Exception:
+        pass
+
+def send(message):
+    try:
+        control.send(json.dumps(message).encode())
+    except OSError:
+        pass
+
+def reap():
+    while True:
+        try:
+            pid, status, usage = os.wait4(-1, os.WNOHANG)
+        except ChildProcessError:
+            return
+        if pid == 0:
+            return
+        send({"t": "exit", "pid": pid, "status": status, "utime": usage.ru_utime,
+              "stime": usage.ru_stime, "maxrss": usage.ru_maxrss})
+
+def run(request, fds):
+    control.close()
+    signal.set_wakeup_fd(-1)
+    signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+    os.close(wake_r)
+    os.close(wake_w)
+    # Out of the way first: a received fd may already sit on 0-3.
+    high = [fcntl.fcntl(fd, fcntl.F_DUPFD, 10) for fd in fds]
+    for fd in fds:
+        os.close(fd)
+    for target, fd in enumerate(high):
+        os.dup2(fd, target)
+        os.close(fd)
+
+    os.chdir(request["cwd"])
+    os.environ.clear()
+    os.environ.update(request["env"])
+    sys.path[:0] = [p for p in os.environ.get("PYTHONPATH", "").split(os.pathsep) if p]
+    sys.path.insert(0, os.path.dirname(os.path.abspath(request["path"])))
+    if request.get("cgroup"):
+        try:
+            with open(request["cgroup"], "w") as procs:
+                procs.write("0")
+        except OSError:
+            pass
+    import resource
+    if request.get("maxMemory"):
+        resource.setrlimit(resource.RLIMIT_DATA, (request["maxMemory"], request["maxMemory"]))
+    if request.get("maxCpu"):
+        resource.setrlimit(resource.RLIMIT_CPU, (request["maxCpu"], request["maxCpu"] + 1))
+
+    sys.argv = [request["path"]] + request["args"]
+    code = 0
+    try:
+        runpy.run_path(request["path"], run_name="__main__")
+    except SystemExit as exit:
+        if exit.code is None or isinstance(exit.code, int):
+            code = exit.code or 0
+        else:
+            print(exit.code, file=sys.stderr)
+            code = 1
+    except BaseException:
+        traceback.print_exc()
+        code = 1
+    for stream in (sys.stdout, sys.stderr):
+        try:
+            stream.flush()
+        except Exception:
+            pass
+    os._exit(code)
+
+wake_r, wake_w = os.pipe()
+os.set_blocking(wake_r, False)
+os.set_blocking(wake_w, False)
+signal.set_wakeup_fd(wake_w)
+signal.signal(signal.SIGCHLD, lambda *args: None)
+
+while True:
+    ready, _, _ = select.select([control, wake_r], [], [])
+    if wake_r in ready:
+        try:
+            os.read(wake_r, 512)
+        except BlockingIOError:
+            pass
+        reap()
+    if control not in ready:
+        continue
+    fds = array.array("i")
+    message, ancillary, _, _ = control.recvmsg(1 << 20, socket.CMSG_LEN(4 * fds.itemsize))
+    for level, kind, data in ancillary:
+        if level == socket.SOL_SOCKET and kind == socket.SCM_RIGHTS:
+            fds.frombytes(data[:len(data) - len(data) % fds.itemsize])
+    if not message:
+        break
+    request = json.loads(message)
+    try:
+        pid = os.fork()
+    except OSError:
+        pid = -1
+    if pid == 0:
+        run(request, list(fds))
+    for fd in fds:
+        os.close(fd)
+    send({"t": "spawned", "id": request["id"], "pid": pid})
+
+# The core is done with us; let what is still running finish.
+while True:
+    try:
+        os.wait()
+    except ChildProcessError:
+        break
+)PY";
+
+// argv after "--": the libraries to preload. Blocks on WARM_CONTROL_FD for
+// {"path","args","cwd","env"}, then becomes `node path args...`. EOF there
+// without a spec means it is not needed any more.
+const char* NODE_BOOTSTRAP = R"JS(
+const fs = require('fs');
+const Module = require('module');
+for (const name of process.argv.slice(1)) {
+  try { require(name); } catch (e) {}
+}
+let spec;
+try { spec = JSON.parse(fs.readFileSync(4, 'utf8')); } catch (e) { process.exit(0); }
+fs.closeSync(4);
+process.chdir(spec.cwd);
+for (const key of Object.keys(process.env)) delete process.env[key];
+Object.assign(process.env, spec.env);
+Module._initPaths();
+process.execArgv = [];
+process.argv = [process.argv[0], spec.path, ...spec.args];
+Module.runMain();
+)JS";
+
+void closeFds(std::initializer_list<int> fds) {
+  for (int fd : fds) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+struct timeval toTimeval(double seconds) {
+  struct timeval tv;
+  tv.tv_sec = static_cast<time_t>(seconds);
+  tv.tv_usec = static_cast<suseconds_t>((seconds - static_cast<double>(tv.tv_sec)) * 1e6);
+  return tv;
+}
+
+void writeStrings(rapidjson::Writer<rapidjson::StringBuffer>& writer, const std::vector<std::string>& values) {
+  writer.StartArray();
+  for (const auto& value : values) writer.String(value.c_str(), value.size());
+  writer.EndArray();
+}
+
+void writeEnvironment(rapidjson::Writer<rapidjson::StringBuffer>& writer, const std::vector<std::string>& env) {
+  writer.StartObject();
+  for (const auto& entry : env) {
+    size_t eq = entry.find('=');
+    if (eq == std::string::npos) continue;
+    writer.Key(entry.c_str(), eq);
+    writer.String(entry.c_str() + eq + 1, entry.size() - eq - 1);
+  }
+  writer.EndObject();
+}
+
+}
+
+InterpreterPool& InterpreterPool::shared() {
+  static InterpreterPool pool;
+  return pool;
+}
+
+InterpreterPool::~InterpreterPool() {
+  shutdown();
+}
+
+bool InterpreterPool::enable(const std::string& language, const std::vector<std::string>& libraries) {
+  if (language != "python" && language != "node") return false;
+  std::lock_guard<std::mutex> lock(mutex);
+  preloads[language] = libraries;
+  // Start booting now, while the run is still being planned.
+  if (language == "python") {
+    forkServer("python3");
+  } else {
+    while (nodes.size() < WARM_NODES) {
+      WarmNode node;
+      if (!startNode(node)) break;
+      nodes.push_back(node);
+    }
+  }
+  return true;
+}
+
+bool InterpreterPool::enabled(const std::string& language) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return preloads.count(language) > 0;
+}
+
+InterpreterPool::ForkServer* InterpreterPool::forkServer(const std::string& interpreter) {
+  if (auto it = servers.find(interpreter); it != servers.end()) {
+    return it->second->dead ? nullptr : it->second.get();
+  }
+
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0) return nullptr;
+  ProcessSpec spec;
+  spec.argv = {interpreter, "-u", "-c", PYTHON_FORK_SERVER, std::to_string(WARM_CONTROL_FD)};
+  for (const auto& library : preloads["python"]) spec.argv.push_back(library);
+  spec.env = currentEnvironment();
+  spec.fds = {{fds[1], WARM_CONTROL_FD}};
+
+  pid_t pid = launchProcess(spec);
+  close(fds[1]);
+  auto server = std::make_unique<ForkServer>();
+  if (pid < 0) {
+    close(fds[0]);
+    server->dead = true;
+  } else {
+    server->pid = pid;
+    server->control = fds[0];
+    server->reader = std::thread(&InterpreterPool::readServer, this, server.get());
+  }
+  ForkServer* result = server->dead ? nullptr : server.get();
+  servers[interpreter] = std::move(server);
+  return result;
+}
+
+void InterpreterPool::readServer(ForkServer* server) {
+  std::vector<char> buffer(64 * 1024);
+  for (;;) {
+    ssize_t n = recv(server->control, buffer.data(), buffer.size(), 0);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+
+    rapidjson::Document doc;
+    if (doc.Parse(buffer.data(), static_cast<size_t>(n)).HasParseError() || !doc.IsObject()) continue;
+    auto type = doc.FindMember("t");
+    auto pid = doc.FindMember("pid");
+    if (type == doc.MemberEnd() || !type->value.IsString() || pid == doc.MemberEnd() || !pid->value.IsInt()) continue;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (std::strcmp(type->value.GetString(), "spawned") == 0) {
+      auto id = doc.FindMember("id");
+      if (id != doc.MemberEnd() && id->value.IsUint64()) server->spawned[id->value.GetUint64()] = pid->value.GetInt();
+    } else if (std::strcmp(type->value.GetString(), "exit") == 0) {
+      Exit& exit = server->exits[pid->value.GetInt()];
+      if (doc.HasMember("status") && doc["status"].IsInt()) exit.status = doc["status"].GetInt();
+      if (doc.HasMember("utime") && doc["utime"].IsNumber()) exit.usage.ru_utime = toTimeval(doc["utime"].GetDouble());
+      if (doc.HasMember("stime") && doc["stime"].IsNumber()) exit.usage.ru_stime = toTimeval(doc["stime"].GetDouble());
+      if (doc.HasMember("maxrss") && doc["maxrss"].IsInt64()) exit.usage.ru_maxrss = doc["maxrss"].GetInt64();
+    }
+    changed.notify_all();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  server->dead = true;
+  changed.notify_all();
+}
+
+bool InterpreterPool::startNode(WarmNode& node) {
+  int in[2] = {-1, -1}, out[2] = {-1, -1}, err[2] = {-1, -1}, control[2] = {-1, -1};
+  if (pipe2(in, O_CLOEXEC) != 0 || pipe2(out, O_CLOEXEC) != 0 ||
+      pipe2(err, O_CLOEXEC) != 0 || pipe2(control, O_CLOEXEC) != 0) {
+    closeFds({in[0], in[1], out[0], out[1], err[0], err[1], control[0], control[1]});
+    return false;
+  }
+#ifdef F_SETPIPE_SZ
+  fcntl(in[1], F_SETPIPE_SZ, 1024 * 1024);
+#endif
+
+  ProcessSpec spec;
+  spec.argv = {"node", "-e", NODE_BOOTSTRAP, "--"};
+  for (const auto& library : preloads["node"]) spec.argv.push_back(library);
+  spec.env = currentEnvironment();
+  spec.fds = {{in[0], STDIN_FILENO}, {out[1], STDOUT_FILENO}, {err[1], STDERR_FILENO}, {control[0], WARM_CONTROL_FD}};
+
+  pid_t pid = launchProcess(spec);
+  closeFds({in[0], out[1], err[1], control[0]});
+  if (pid < 0) {
+    closeFds({in[1], out[0], err[0], control[1]});
+    return false;
+  }
+  node = WarmNode{pid, in[1], out[0], err[0], control[1]};
+  return true;
+}
+
+pid_t InterpreterPool::launch(const Launch& request, int& stdinFd, int& stdoutFd, int& stderrFd) {
+  if (request.language == "python") return launchPython(request, stdinFd, stdoutFd, stderrFd);
+  if (request.language == "node") return launchNode(request, stdinFd, stdoutFd, stderrFd);
+  return -1;
+}
+
+pid_t InterpreterPool::launchPython(const Launch& request, int& stdinFd, int& stdoutFd, int& stderrFd) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!preloads.count("python")) return -1;
+  ForkServer* server = forkServer(request.interpreter);
+  if (!server) return -1;
+
+  int in[2] = {-1, -1}, out[2] = {-1, -1}, err[2] = {-1, -1};
+  if ((request.withStdin && pipe2(in, O_CLOEXEC) != 0) || pipe2(out, O_CLOEXEC) != 0 || pipe2(err, O_CLOEXEC) != 0) {
+    closeFds({in[0], in[1], out[0], out[1], err[0], err[1]});
+    return -1;
+  }
+#ifdef F_SETPIPE_SZ
+  if (request.withStdin) fcntl(in[1], F_SETPIPE_SZ, 1024 * 1024);
+#endif
+
+  rapidjson::StringBuffer json;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(json);
+  uint64_t id = server->nextRequest++;
+  writer.StartObject();
+  writer.Key("id"); writer.Uint64(id);
+  writer.Key("path"); writer.String(request.path.c_str(), request.path.size());
+  writer.Key("args"); writeStrings(writer, request.args);
+  writer.Key("cwd"); writer.String(request.cwd.c_str(), request.cwd.size());
+  writer.Key("env"); writeEnvironment(writer, request.env);
+  if (request.cgroupProcs) { writer.Key("cgroup"); writer.String(request.cgroupProcs); }
+  writer.Key("maxMemory"); writer.Uint64(request.limits.maxMemoryBytes);
+  writer.Key("maxCpu"); writer.Int(request.limits.maxCpuSeconds);
+  writer.EndObject();
+
+  // Without a pipe the module reads our stdin, as a cold start would.
+  int passed[4] = {request.withStdin ? in[0] : STDIN_FILENO, out[1], err[1], request.rateLimitFd};
+  size_t count = request.rateLimitFd >= 0 ? 4 : 3;
+  struct iovec iov = {const_cast<char*>(json.GetString()), json.GetSize()};
+  char control[CMSG_SPACE(sizeof(passed))] = {};
+  struct msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), passed, count * sizeof(int));
+
+  ssize_t sent;
+  while ((sent = sendmsg(server->control, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR) {}
+  closeFds({in[0], out[1], err[1]});
+  if (sent < 0) {
+    closeFds({in[1], out[0], err[0]});
+    return -1;
+  }
+
+  changed.wait(lock, [server, id]() { return server->spawned.count(id) > 0 || server->dead; });
+  auto answer = server->spawned.find(id);
+  pid_t pid = answer == server->spawned.end() ? -1 : answer->second;
+  if (answer != server->spawned.end()) server->spawned.erase(answer);
+  if (pid < 0) {
+    closeFds({in[1], out[0], err[0]});
+    return -1;
+  }
+  children[pid] = server;
+  stdinFd = request.withStdin ? in[1] : -1;
+  stdoutFd = out[0];
+  stderrFd = err[0];
+  return pid;
+}
+
+pid_t InterpreterPool::launchNode(const Launch& request, int& stdinFd, int& stdoutFd, int& stderrFd) {
+  std::unique_lock<std::mutex> lock(mutex);
+  // The socket would have to be there from the start.
+  if (!preloads.count("node") || request.rateLimitFd >= 0 || nodes.empty()) return -1;
+  WarmNode node = nodes.front();
+  nodes.pop_front();
+  WarmNode spare;
+  if (startNode(spare)) nodes.push_back(spare);
+  lock.unlock();
+
+  // Still idle, so the limits can be put on it from out here.
+  if (request.limits.maxMemoryBytes > 0) {
+    struct rlimit memory = {request.limits.maxMemoryBytes, request.limits.maxMemoryBytes};
+    prlimit(node.pid, RLIMIT_DATA, &memory, nullptr);
+  }
+  if (request.limits.maxCpuSeconds > 0) {
+    struct rlimit cpu = {static_cast<rlim_t>(request.limits.maxCpuSeconds), static_cast<rlim_t>(request.limits.maxCpuSeconds) + 1};
+    prlimit(node.pid, RLIMIT_CPU, &cpu, nullptr);
+  }
+  if (request.cgroupProcs) {
+    int fd = open(request.cgroupProcs, O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+      std::string pid = std::to_string(node.pid);
+      ssize_t ignored = write(fd, pid.data(), pid.size());
+      (void)ignored;
+      close(fd);
+    }
+  }
+
+  rapidjson::StringBuffer json;
+  rapidjson::Writer<rapidjson::StringBuffer> writer(json);
+  writer.StartObject();
+  writer.Key("path"); writer.String(request.path.c_str(), request.path.size());
+  writer.Key("args"); writeStrings(writer, request.args);
+  writer.Key("cwd"); writer.String(request.cwd.c_str(), request.cwd.size());
+  writer.Key("env"); writeEnvironment(writer, request.env);
+  writer.EndObject();
+
+  const char* data = json.GetString();
+  size_t left = json.GetSize();
+  // It may have died while idle.
+  ScopedSigpipeBlock sigpipe;
+  while (left > 0) {
+    ssize_t n = write(node.control, data, left);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    data += n;
+    left -= static_cast<size_t>(n);
+  }
+  close(node.control);
+  if (left > 0) {
+    // It died while idle.
+    closeFds({node.stdinFd, node.stdoutFd, node.stderrFd});
+    waitpid(node.pid, nullptr, 0);
+    return -1;
+  }
+
+  if (!request.withStdin) {
+    close(node.stdinFd);
+    node.stdinFd = -1;
+  }
+  stdinFd = node.stdinFd;
+  stdoutFd = node.stdoutFd;
+  stderrFd = node.stderrFd;
+  return node.pid;
+}
+
+bool InterpreterPool::forked(pid_t pid) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return children.count(pid) > 0;
+}
+
+bool InterpreterPool::reap(pid_t pid, int& status, struct rusage& usage, int timeoutMs) {
+  std::unique_lock<std::mutex> lock(mutex);
+  auto owner = children.find(pid);
+  if (owner == children.end()) return false;
+  ForkServer* server = owner->second;
+  auto done = [server, pid]() { return server->exits.count(pid) > 0 || server->dead; };
+
+  bool signalled = false;
+  if (timeoutMs > 0) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (!changed.wait_until(lock, deadline, done)) {
+      // As reapProcess: SIGTERM first, SIGKILL if it will not go.
+      kill(pid, signalled ? SIGKILL : SIGTERM);
+      if (signalled) break;
+      signalled = true;
+      deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(KILL_GRACE_MS);
+    }
+  }
+  changed.wait(lock, done);
+
+  if (auto exit = server->exits.find(pid); exit != server->exits.end()) {
+    status = exit->second.status;
+    usage = exit->second.usage;
+    server->exits.erase(exit);
+  } else {
+    // The server died and took the status with it.
+    status = 1 << 8;
+    usage = {};
+  }
+  children.erase(owner);
+  return signalled;
+}
+
+void InterpreterPool::shutdown() {
+  std::map<std::string, std::unique_ptr<ForkServer>> stopping;
+  std::deque<WarmNode> idle;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping.swap(servers);
+    idle.swap(nodes);
+    children.clear();
+    preloads.clear();
+  }
+
+  for (auto& node : idle) {
+    close(node.control);
+    closeFds({node.stdinFd, node.stdoutFd, node.stderrFd});
+  }
+  for (auto& [interpreter, server] : stopping) {
+    if (server->control >= 0) ::shutdown(server->control, SHUT_WR);
+  }
+  for (auto& node : idle) waitpid(node.pid, nullptr, 0);
+  for (auto& [interpreter, server] : stopping) {
+    if (server->reader.joinable()) server->reader.join();
+    if (server->control >= 0) close(server->control);
+    if (server->pid > 0) waitpid(server->pid, nullptr, 0);
+  }
+}
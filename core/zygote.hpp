@@ -0,0 +1,116 @@
+#ifndef ZYGOTE_HPP
+#define ZYGOTE_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <memory>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <sys/types.h>
+#include <sys/resource.h>
+#include "./limits.hpp"
+
+// Interpreters started ahead of time (--warm), so a Python or Node module
+// starts in milliseconds instead of paying for interpreter boot and its
+// hot imports on every invocation and every shard.
+//
+// Python: one fork server per interpreter (python3, python3.11, ...) that
+// has imported the --preload libraries. Each launch sends it the module's
+// argv, environment and pipes over a socket (SCM_RIGHTS); it forks, and the
+// child runs the module with runpy as `__main__`. The children are the
+// server's, so it reports their exit status back and reap() waits for that.
+//
+// Node cannot fork, so it gets a few idle processes instead, each booted
+// with the preloads and its pipes already attached, blocked reading a spec
+// from fd WARM_CONTROL_FD. Launching one hands it the module, which it runs
+// with Module.runMain(); it is then an ordinary child. They have no rate
+// limiter socket, so rate-limited Node modules start cold.
+class InterpreterPool {
+  public:
+    struct Launch {
+      std::string language;     // "python" or "node"
+      std::string interpreter;  // what a cold start would exec
+      std::string path;
+      std::vector<std::string> args;
+      std::string cwd;
+      // "NAME=value", the whole environment the module gets.
+      std::vector<std::string> env;
+      ModuleLimits limits;
+      const char* cgroupProcs = nullptr;
+      int rateLimitFd = -1;
+      bool withStdin = false;
+    };
+
+    static constexpr int WARM_CONTROL_FD = 4;
+    static constexpr size_t WARM_NODES = 2;
+
+    static InterpreterPool& shared();
+    ~InterpreterPool();
+
+    // Starts warming `language` ("python" or "node"), preloading `libraries`.
+    // False for a language we cannot warm.
+    bool enable(const std::string& language, const std::vector<std::string>& libraries);
+    bool enabled(const std::string& language) const;
+
+    // Starts the module on a warm interpreter; -1 if none could take it (the
+    // caller then execs it as usual).
+    pid_t launch(const Launch& request, int& stdinFd, int& stdoutFd, int& stderrFd);
+
+    // True for a module process a fork server started: reap it with reap(),
+    // not wait4.
+    bool forked(pid_t pid) const;
+    // reapProcess for those, from the exit status the server reports.
+    bool reap(pid_t pid, int& status, struct rusage& usage, int timeoutMs);
+
+    // Stops the fork servers (after their modules exit) and the idle Node
+    // processes, and forgets what was enabled.
+    void shutdown();
+
+  private:
+    struct Exit {
+      int status = 0;
+      struct rusage usage{};
+    };
+
+    struct ForkServer {
+      pid_t pid = -1;
+      int control = -1;
+      std::thread reader;
+      // Launches answered so far, by the id sent with the request: launches
+      // run concurrently, and replies need not come back in order.
+      std::map<uint64_t, pid_t> spawned;
+      uint64_t nextRequest = 0;
+      std::map<pid_t, Exit> exits;
+      bool dead = false;
+    };
+
+    struct WarmNode {
+      pid_t pid = -1;
+      int stdinFd = -1;
+      int stdoutFd = -1;
+      int stderrFd = -1;
+      int control = -1;
+    };
+
+    InterpreterPool() = default;
+    // Caller holds mutex.
+    ForkServer* forkServer(const std::string& interpreter);
+    bool startNode(WarmNode& node);
+    void readServer(ForkServer* server);
+    pid_t launchPython(const Launch& request, int& stdinFd, int& stdoutFd, int& stderrFd);
+    pid_t launchNode(const Launch& request, int& stdinFd, int& stdoutFd, int& stderrFd);
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+    std::map<std::string, std::vector<std::string>> preloads;
+    std::map<std::string, std::unique_ptr<ForkServer>> servers;
+    std::map<pid_t, ForkServer*> children;
+    std::deque<WarmNode> nodes;
+};
+
+#endif
@@ -8,17 +8,62 @@
 // Provides: domain
 // Storage: replace
 // InstallScope: shared
-// RateLimit: 200
+// RateLimit: dns 200
 // Timeout: 10000
 
 const { Resolver } = require('dns').promises;
 const pLimit = require('p-limit');
+const net = require('net');
 
-const resolver = new Resolver();
+// Two tries of 5s keep one lookup within the declared Timeout.
+const resolver = new Resolver({ timeout: 5000, tries: 2 });
 resolver.setServers(['1.1.1.1', '8.8.8.8']);
 
 const limit = pLimit(200);
 
+// Lookups draw from the core's "dns" bucket, shared with every other
+// module resolving at the same time, when it hands us a limiter socket.
+const rateLimiter = (() => {
+  const fd = parseInt(process.env.BMOP_RATELIMIT_FD, 10);
+  if (Number.isNaN(fd)) return { acquire: async () => {}, backoff: () => {} };
+
+  const socket = new net.Socket({ fd, readable: true, writable: true });
+  const waiting = new Map();
+  let nextId = 0;
+  let pending = '';
+  socket.unref();
+  socket.on('data', chunk => {
+    pending += chunk.toString();
+    const lines = pending.split('\n');
+    pending = lines.pop();
+    for (const line of lines) {
+      try {
+        const msg = JSON.parse(line);
+        const grant = waiting.get(msg.id);
+        if (!grant) continue;
+        waiting.delete(msg.id);
+        if (waiting.size === 0) socket.unref();
+        grant();
+      } catch (e) {}
+    }
+  });
+  // Without the core there is nothing to wait for.
+  socket.on('error', () => {
+    for (const grant of waiting.values()) grant();
+    waiting.clear();
+  });
+
+  return {
+    acquire: () => new Promise(resolve => {
+      const id = nextId++;
+      waiting.set(id, resolve);
+      socket.ref();
+      socket.write(JSON.stringify({t:"acquire",id,k:"dns"}) + '\n');
+    }),
+    backoff: () => socket.write(JSON.stringify({t:"backoff",k:"dns"}) + '\n')
+  };
+})();
+
 console.log(JSON.stringify({bmop:"1.0",module:"dns-validator",pid:process.pid}));
 
 let buffer = '';
@@ -27,13 +72,29 @@ let aliveCount = 0;
 let deadCount = 0;
 let jsonErrors = 0;
 let processingQueue = [];
+let checkedCount = 0;
+let lastProgress = 0;
+
+// Lets the core's watchdog see that lookups are still completing.
+const reportProgress = () => {
+  const now = Date.now();
+  if (now - lastProgress < 1000) return;
+  lastProgress = now;
+  console.error(JSON.stringify({t:"progress",c:checkedCount,T:inputCount}));
+};
 
 const validateDomain = async (domain) => {
+  await rateLimiter.acquire();
   try {
     await resolver.resolve(domain);
     return { domain, status: 'alive' };
   } catch (err) {
+    // The resolvers pushing back, as opposed to the domain being dead.
+    if (err.code === 'EREFUSED' || err.code === 'ETIMEOUT') rateLimiter.backoff();
     return { domain, status: 'dead' };
+  } finally {
+    checkedCount++;
+    reportProgress();
   }
 };
 
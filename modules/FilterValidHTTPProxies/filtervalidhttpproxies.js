@@ -70,6 +70,16 @@ let processingQueue = [];
 let totalBatches = 0;
 let globalStartTime = Date.now();
 let completedBatches = 0;
+let testedCount = 0;
+let lastProgress = 0;
+
+// Lets the core's watchdog see that checks are still completing.
+const reportProgress = () => {
+  const now = Date.now();
+  if (now - lastProgress < 1000) return;
+  lastProgress = now;
+  console.error(JSON.stringify({t:"progress",c:testedCount,T:inputCount}));
+};
 
 const testProxy = async (proxy) => {
   const [ip, originalPort] = proxy.split(':');
@@ -136,7 +146,10 @@ const processBatch = async (proxies, batchNumber) => {
     m: `Processing batch ${batchNumber} (${batchSize} proxies)${secureMode ? ' in SECURE mode' : ''}`
   }));
 
-  const tasks = proxies.map(proxy => () => testProxy(proxy));
+  const tasks = proxies.map(proxy => () => testProxy(proxy).finally(() => {
+    testedCount++;
+    reportProgress();
+  }));
   const results = await limitConcurrency(tasks, 50);
 
   const workingProxies = results
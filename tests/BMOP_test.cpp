@@ -10,6 +10,7 @@
 #include <array>
 #include <algorithm>
 #include "../core/core.hpp"
+#include "../core/bmop.hpp"
 #include "../include/rapidjson/document.h"
 #include "../include/rapidjson/error/en.h"
 
@@ -80,9 +81,11 @@ class BmopProtocolTest : public ::testing::Test {
     }
 
     std::string simulateParse(const std::string& input) {
-      std::map<std::string, std::vector<DataItem>> storage;
+      Storage storage;
       std::istringstream stream(input);
       std::string line;
+      BmopDecoder decoder;
+      BmopEvent event;
 
       bool inBatch = false;
       std::string batchFormat;
@@ -97,7 +100,7 @@ class BmopProtocolTest : public ::testing::Test {
           if (line[0] == '{') {
             parseBMOPLine(line, storage);
 
-            if (line.find("batch_end") != std::string::npos) {
+            if (decoder.decode(line, event) && event.type == BmopEventType::BATCH_END) {
               inBatch = false;
               batchFormat.clear();
               batchItemsExpected = 0;
@@ -115,18 +118,10 @@ class BmopProtocolTest : public ::testing::Test {
         } else {
           parseBMOPLine(line, storage);
 
-          if (!storage["__batch_format__"].empty()) {
+          if (decoder.decode(line, event) && event.type == BmopEventType::BATCH_START) {
             inBatch = true;
-            batchFormat = storage["__batch_format__"][0].format;
-
-            rapidjson::Document doc;
-            doc.Parse(line.c_str());
-
-            if (doc.HasMember("c") && doc["c"].IsInt()) {
-              batchItemsExpected = doc["c"].GetInt();
-            }
-
-            storage["__batch_format__"].clear();
+            batchFormat = event.format;
+            batchItemsExpected = event.count > 0 ? static_cast<int>(event.count) : 0;
             batchItemsRead = 0;
           }
         }
@@ -134,7 +129,6 @@ class BmopProtocolTest : public ::testing::Test {
 
       std::string result;
       for (const auto& [format, items] : storage) {
-        if (format == "__batch_format__") continue;
         result += format + ": [";
         for (size_t i = 0; i < items.size(); ++i) {
           if (i > 0) result += ", ";
@@ -148,7 +142,7 @@ class BmopProtocolTest : public ::testing::Test {
 };
 
 TEST_F(BmopProtocolTest, ParseDataMessages) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"domain","v":"example.com"})", storage);
   parseBMOPLine(R"({"t":"d","f":"url","v":"https://example.com"})", storage);
@@ -170,7 +164,7 @@ TEST_F(BmopProtocolTest, ParseDataMessages) {
 }
 
 TEST_F(BmopProtocolTest, IgnoreLogMessages) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"log","l":"info","m":"Starting module"})", storage);
   parseBMOPLine(R"({"t":"log","l":"debug","m":"Debug info"})", storage);
@@ -181,7 +175,7 @@ TEST_F(BmopProtocolTest, IgnoreLogMessages) {
 }
 
 TEST_F(BmopProtocolTest, IgnoreProgressMessages) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"progress","c":10,"T":100})", storage);
   parseBMOPLine(R"({"t":"progress","c":50,"T":100,"m":"Halfway"})", storage);
@@ -190,7 +184,7 @@ TEST_F(BmopProtocolTest, IgnoreProgressMessages) {
 }
 
 TEST_F(BmopProtocolTest, IgnoreResultMessages) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"result","ok":true,"count":42})", storage);
   parseBMOPLine(R"({"t":"result","ok":false,"error":"Failed"})", storage);
@@ -199,7 +193,7 @@ TEST_F(BmopProtocolTest, IgnoreResultMessages) {
 }
 
 TEST_F(BmopProtocolTest, IgnoreErrorMessages) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"error","code":"AUTH_FAILED","m":"Auth failed"})", storage);
   parseBMOPLine(R"({"t":"error","code":"NETWORK","m":"Timeout","fatal":true})", storage);
@@ -208,13 +202,10 @@ TEST_F(BmopProtocolTest, IgnoreErrorMessages) {
 }
 
 TEST_F(BmopProtocolTest, ParseBatchControlMessages) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"batch","f":"domain","c":1000})", storage);
-  EXPECT_EQ(storage.size(), 1);
-  EXPECT_EQ(storage["__batch_format__"].size(), 1);
-  EXPECT_EQ(storage["__batch_format__"][0].format, "domain");
-  EXPECT_EQ(storage["__batch_format__"][0].value, "domain");
+  EXPECT_TRUE(storage.empty());
 
   storage.clear();
   parseBMOPLine(R"({"t":"batch_end"})", storage);
@@ -222,7 +213,7 @@ TEST_F(BmopProtocolTest, ParseBatchControlMessages) {
 }
 
 TEST_F(BmopProtocolTest, ParseProtocolHeader) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"bmop":"1.0","module":"test","pid":12345})", storage);
   EXPECT_TRUE(storage.empty());
@@ -232,7 +223,7 @@ TEST_F(BmopProtocolTest, ParseProtocolHeader) {
 }
 
 TEST_F(BmopProtocolTest, InvalidJSONHandling) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine("", storage);
   parseBMOPLine("not json", storage);
@@ -244,7 +235,7 @@ TEST_F(BmopProtocolTest, InvalidJSONHandling) {
 }
 
 TEST_F(BmopProtocolTest, MixedMessageTypes) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"bmop":"1.0","module":"mixed"})", storage);
   parseBMOPLine(R"({"t":"log","l":"info","m":"Start"})", storage);
@@ -382,7 +373,7 @@ TEST_F(BmopProtocolTest, ParseModuleMetadataBash) {
 }
 
 TEST_F(BmopProtocolTest, DataItemStorageAndRetrieval) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   DataItem item1{"domain", "example.com"};
   DataItem item2{"domain", "test.com"};
@@ -409,7 +400,7 @@ TEST_F(BmopProtocolTest, DataItemStorageAndRetrieval) {
 }
 
 TEST_F(BmopProtocolTest, ParseComplexDataFormats) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"vulnerability","v":"{\"type\":\"XSS\",\"severity\":\"high\"}"})", storage);
   parseBMOPLine(R"({"t":"d","f":"certificate","v":"{\"cn\":\"example.com\",\"expires\":\"2025-12-31\"}"})", storage);
@@ -424,7 +415,7 @@ TEST_F(BmopProtocolTest, ParseComplexDataFormats) {
 }
 
 TEST_F(BmopProtocolTest, ParseWithTrailingCommas) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"bmop":"1.0","module":"test",})", storage);
   parseBMOPLine(R"({"t":"d","f":"domain","v":"example.com",})", storage);
@@ -436,7 +427,7 @@ TEST_F(BmopProtocolTest, ParseWithTrailingCommas) {
 }
 
 TEST_F(BmopProtocolTest, ParseWithComments) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"domain","v":"example.com" /* comment */})", storage);
   parseBMOPLine(R"({/* comment */ "t":"d","f":"domain","v":"test.com"})", storage);
@@ -449,7 +440,7 @@ line */ "f":"url","v":"https://test.com"})", storage);
 }
 
 TEST_F(BmopProtocolTest, LargeDatasetParsing) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   for (int i = 0; i < 1000; ++i) {
     std::string json = R"({"t":"d","f":"domain","v":")" + 
@@ -467,7 +458,7 @@ TEST_F(BmopProtocolTest, LargeDatasetParsing) {
 }
 
 TEST_F(BmopProtocolTest, MultipleFormatsLarge) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   std::vector<std::string> formats = {"domain", "url", "ip", "email", "subdomain"};
 
@@ -524,7 +515,7 @@ TEST_F(BmopProtocolTest, SimulateMixedBatchAndSingle) {
 }
 
 TEST_F(BmopProtocolTest, EmptyValuesHandling) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"domain","v":""})", storage);
   parseBMOPLine(R"({"t":"d","f":"","v":"test"})", storage);
@@ -537,7 +528,7 @@ TEST_F(BmopProtocolTest, EmptyValuesHandling) {
 }
 
 TEST_F(BmopProtocolTest, SpecialCharactersInValues) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"url","v":"https://example.com/path?query=test&param=value"})", storage);
   parseBMOPLine(R"({"t":"d","f":"email","v":"test\"quotes\"@example.com"})", storage);
@@ -554,7 +545,7 @@ TEST_F(BmopProtocolTest, SpecialCharactersInValues) {
 }
 
 TEST_F(BmopProtocolTest, UnicodeCharacters) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"domain","v":"exämple.com"})", storage);
   parseBMOPLine(R"({"t":"d","f":"domain","v":"例子.com"})", storage);
@@ -570,7 +561,7 @@ TEST_F(BmopProtocolTest, UnicodeCharacters) {
 }
 
 TEST_F(BmopProtocolTest, VeryLongValues) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   std::string longValue(10000, 'a');
   std::string json = R"({"t":"d","f":"data","v":")" + longValue + R"("})";
@@ -584,7 +575,7 @@ TEST_F(BmopProtocolTest, VeryLongValues) {
 }
 
 TEST_F(BmopProtocolTest, MalformedJSONRecovery) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine("", storage);
   parseBMOPLine("{", storage);
@@ -600,7 +591,7 @@ TEST_F(BmopProtocolTest, MalformedJSONRecovery) {
 }
 
 TEST_F(BmopProtocolTest, NestedJSONInValues) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"complex","v":"{\"nested\":{\"level1\":{\"level2\":\"value\"}}}"})", storage);
   parseBMOPLine(R"({"t":"d","f":"array","v":"[1,2,3,4,5]"})", storage);
@@ -671,7 +662,7 @@ TEST_F(BmopProtocolTest, SimulateFullWorkflow) {
 }
 
 TEST_F(BmopProtocolTest, StorageOverwriteBehavior) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"domain","v":"old1.com"})", storage);
   parseBMOPLine(R"({"t":"d","f":"domain","v":"old2.com"})", storage);
@@ -689,7 +680,7 @@ TEST_F(BmopProtocolTest, StorageOverwriteBehavior) {
 }
 
 TEST_F(BmopProtocolTest, StorageDeleteBehavior) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"domain","v":"test1.com"})", storage);
   parseBMOPLine(R"({"t":"d","f":"url","v":"https://test1.com"})", storage);
@@ -704,7 +695,7 @@ TEST_F(BmopProtocolTest, StorageDeleteBehavior) {
 }
 
 TEST_F(BmopProtocolTest, StorageAddBehavior) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"domain","v":"existing1.com"})", storage);
   parseBMOPLine(R"({"t":"d","f":"domain","v":"existing2.com"})", storage);
@@ -871,7 +862,7 @@ console.log(JSON.stringify({t:"result","ok":true,"count":3}));)";
 }
 
 TEST_F(BmopProtocolTest, PerformanceTestLargeDataset) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   const int ITEM_COUNT = 5000;
 
@@ -916,13 +907,11 @@ TEST_F(BmopProtocolTest, MultipleBatchProcessing) {
 }
 
 TEST_F(BmopProtocolTest, MixedSingleAndBatch) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"t":"d","f":"type","v":"single"})", storage);
   parseBMOPLine(R"({"t":"batch","f":"items","c":2})", storage);
 
-  storage.erase("__batch_format__");
-
   DataItem item1{"items", "batch1"};
   DataItem item2{"items", "batch2"};
   storage["items"].push_back(item1);
@@ -953,7 +942,7 @@ TEST_F(BmopProtocolTest, EdgeCaseEmptyBatch) {
 }
 
 TEST_F(BmopProtocolTest, ProtocolVersionVariations) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   parseBMOPLine(R"({"bmop":"1.0","module":"test"})", storage);
   parseBMOPLine(R"({"bmop":"1.1","module":"test"})", storage);
@@ -989,7 +978,7 @@ TEST_F(BmopProtocolTest, RealWorldSimulation) {
   
   input << R"({"t":"result","ok":true,"count":45})" << "\n";
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   std::string line;
   
   while (std::getline(input, line)) {
@@ -1006,7 +995,7 @@ TEST_F(BmopProtocolTest, RealWorldSimulation) {
 
 TEST_F(BmopProtocolTest, StressTestParsing) {
   const int TOTAL_MESSAGES = 10000;
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   std::vector<std::string> formats = {"A", "B", "C", "D", "E"};
 
@@ -1082,7 +1071,7 @@ console.log(JSON.stringify({t:"result","ok":true,"count":data.length}));)";
   EXPECT_TRUE(output.find("tenth") != std::string::npos);
   EXPECT_TRUE(output.find("\"t\":\"result\"") != std::string::npos);
 
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   std::istringstream stream(output);
   std::string line;
 
@@ -1132,7 +1121,7 @@ TEST_F(BmopProtocolTest, ComprehensiveProtocolCoverage) {
     R"({"t":"error","code":"FATAL","m":"fatal","fatal":true})"
   };
 
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   int dataCount = 0;
 
   for (const auto& testCase : testCases) {
@@ -1143,7 +1132,7 @@ TEST_F(BmopProtocolTest, ComprehensiveProtocolCoverage) {
     }
   }
 
-  EXPECT_EQ(storage.size(), 10);
+  EXPECT_EQ(storage.size(), 9);
   EXPECT_EQ(dataCount, 9);
 
   EXPECT_EQ(storage["domain"].size(), 1);
@@ -1155,7 +1144,6 @@ TEST_F(BmopProtocolTest, ComprehensiveProtocolCoverage) {
   EXPECT_EQ(storage["vulnerability"].size(), 1);
   EXPECT_EQ(storage["credential"].size(), 1);
   EXPECT_EQ(storage["certificate"].size(), 1);
-  EXPECT_EQ(storage["__batch_format__"].size(), 1);
 
   EXPECT_EQ(storage["domain"][0].value, "test.com");
   EXPECT_EQ(storage["url"][0].value, "https://test.com");
@@ -1166,7 +1154,319 @@ TEST_F(BmopProtocolTest, ComprehensiveProtocolCoverage) {
   EXPECT_EQ(storage["vulnerability"][0].value, "XSS");
   EXPECT_EQ(storage["credential"][0].value, "admin:password");
   EXPECT_EQ(storage["certificate"][0].value, "test");
-  EXPECT_EQ(storage["__batch_format__"][0].format, "domain");
+}
+
+TEST(BmopDecoderTest, DecodesDataFrameWithoutCopying) {
+  BmopDecoder decoder;
+  BmopEvent event;
+  std::string line = R"({"t":"d","f":"domain","v":"example.com"})";
+
+  ASSERT_TRUE(decoder.decode(line, event));
+  EXPECT_EQ(event.type, BmopEventType::DATA);
+  EXPECT_EQ(event.format, "domain");
+  EXPECT_EQ(event.value, "example.com");
+  EXPECT_GE(event.value.data(), line.data());
+  EXPECT_LT(event.value.data(), line.data() + line.size());
+}
+
+TEST(BmopDecoderTest, DecodesEscapesAndAnyKeyOrder) {
+  BmopDecoder decoder;
+  BmopEvent event;
+
+  ASSERT_TRUE(decoder.decode(R"({ "v" : "a\"b\\c\n\u00e9\ud83d\ude00", "f":"note", "t":"d" })", event));
+  EXPECT_EQ(event.type, BmopEventType::DATA);
+  EXPECT_EQ(event.format, "note");
+  EXPECT_EQ(event.value, "a\"b\\c\n\xc3\xa9\xf0\x9f\x98\x80");
+}
+
+TEST(BmopDecoderTest, ReturnsTypedControlEvents) {
+  BmopDecoder decoder;
+  BmopEvent event;
+
+  ASSERT_TRUE(decoder.decode(R"({"t":"batch","f":"domain","c":1000})", event));
+  EXPECT_EQ(event.type, BmopEventType::BATCH_START);
+  EXPECT_EQ(event.format, "domain");
+  EXPECT_EQ(event.count, 1000);
+
+  ASSERT_TRUE(decoder.decode(R"({"t":"batch_end"})", event));
+  EXPECT_EQ(event.type, BmopEventType::BATCH_END);
+
+  ASSERT_TRUE(decoder.decode(R"({"bmop":"1.0","module":"test"})", event));
+  EXPECT_EQ(event.type, BmopEventType::HEADER);
+  EXPECT_EQ(event.module, "test");
+
+  ASSERT_TRUE(decoder.decode(R"({"t":"progress","c":5,"T":10,"m":"halfway"})", event));
+  EXPECT_EQ(event.type, BmopEventType::PROGRESS);
+  EXPECT_EQ(event.count, 5);
+  EXPECT_EQ(event.total, 10);
+  EXPECT_EQ(event.message, "halfway");
+
+  ASSERT_TRUE(decoder.decode(R"({"t":"error","code":"NETWORK","m":"Timeout","fatal":true})", event));
+  EXPECT_EQ(event.type, BmopEventType::ERROR);
+  EXPECT_EQ(event.code, "NETWORK");
+  EXPECT_TRUE(event.fatal);
+
+  ASSERT_TRUE(decoder.decode(R"({"t":"result","ok":true,"count":35386,"time":2.3})", event));
+  EXPECT_EQ(event.type, BmopEventType::RESULT);
+  EXPECT_TRUE(event.ok);
+  EXPECT_EQ(event.count, 35386);
+}
+
+TEST(BmopDecoderTest, FallsBackForNestedAndRelaxedJson) {
+  BmopDecoder decoder;
+  BmopEvent event;
+
+  ASSERT_TRUE(decoder.decode(R"({"t":"d","f":"tag","v":"x","meta":{"a":[1,2]}})", event));
+  EXPECT_EQ(event.type, BmopEventType::DATA);
+  EXPECT_EQ(event.value, "x");
+
+  ASSERT_TRUE(decoder.decode(R"({"t":"d","f":"tag","v":"y",})", event));
+  EXPECT_EQ(event.value, "y");
+
+  EXPECT_FALSE(decoder.decode(R"({"t":"d","f":"tag","v":)", event));
+  EXPECT_STRNE(decoder.errorReason(), "");
+  EXPECT_FALSE(decoder.decode("not json", event));
+}
+
+TEST(BmopBinaryTest, DecoderWaitsForCompleteFrames) {
+  BmopBinaryEncoder encoder;
+  std::string stream;
+  uint32_t id = encoder.defineFormat(stream, "domain");
+  encoder.writeData(stream, id, std::string(300, 'a'));
+
+  BmopBinaryDecoder decoder;
+  BmopEvent event;
+  size_t used = decoder.decode(stream, event);
+  ASSERT_NE(used, BmopBinaryDecoder::INCOMPLETE);
+  ASSERT_NE(used, BmopBinaryDecoder::CORRUPT);
+  EXPECT_EQ(event.type, BmopEventType::NONE);
+
+  std::string_view rest = std::string_view(stream).substr(used);
+  for (size_t prefix = 0; prefix < rest.size(); ++prefix) {
+    EXPECT_EQ(decoder.decode(rest.substr(0, prefix), event), BmopBinaryDecoder::INCOMPLETE);
+  }
+  EXPECT_EQ(decoder.decode(rest, event), rest.size());
+  EXPECT_EQ(event.type, BmopEventType::DATA);
+  EXPECT_EQ(event.format, "domain");
+  EXPECT_EQ(event.value.size(), 300u);
+
+  EXPECT_EQ(decoder.decode("\x7f", event), BmopBinaryDecoder::CORRUPT);
+}
+
+TEST(BmopBinaryTest, RebindingFormatIdIsCorrupt) {
+  std::string stream = R"({"bmop":"2.0","module":"bin"})" "\n";
+  std::string frames;
+  auto format = [&frames](uint64_t id, std::string_view name) {
+    frames += static_cast<char>(BMOP_FRAME_FORMAT);
+    appendVarint(frames, id);
+    appendVarint(frames, name.size());
+    frames.append(name);
+  };
+  auto data = [&frames](uint64_t id, std::string_view value) {
+    frames += static_cast<char>(BMOP_FRAME_DATA);
+    appendVarint(frames, id);
+    appendVarint(frames, value.size());
+    frames.append(value);
+  };
+  format(0, "domain");
+  data(0, "a.com");
+  format(0, "domain");  // The same binding again is fine.
+  data(0, "b.com");
+  format(0, "url");
+  data(0, "https://c.com/");
+
+  BmopBinaryDecoder decoder;
+  BmopEvent event;
+  std::string_view rest = frames;
+  for (int frame = 0; frame < 4; ++frame) {
+    size_t used = decoder.decode(rest, event);
+    ASSERT_NE(used, BmopBinaryDecoder::CORRUPT);
+    rest.remove_prefix(used);
+  }
+  EXPECT_EQ(decoder.decode(rest, event), BmopBinaryDecoder::CORRUPT);
+
+  // The collector keeps what came before and files nothing under the old name.
+  stream += frames;
+  FILE* pipe = fmemopen(stream.data(), stream.size(), "r");
+  ASSERT_NE(pipe, nullptr);
+  Storage storage;
+  collectModuleOutput("bin", pipe, storage);
+  fclose(pipe);
+  ASSERT_EQ(storage["domain"].size(), 2);
+  EXPECT_EQ(storage["domain"][1].value, "b.com");
+  EXPECT_TRUE(storage["url"].empty());
+}
+
+TEST(BmopBinaryTest, CollectsBinaryStreamAfterV2Header) {
+  BmopBinaryEncoder encoder;
+  std::string stream = R"({"bmop":"2.0","module":"bin"})" "\n";
+  uint32_t domain = encoder.defineFormat(stream, "domain");
+  uint32_t url = encoder.defineFormat(stream, "url");
+  encoder.writeData(stream, domain, "example.com");
+  encoder.writeBatchHeader(stream, url, 3);
+  encoder.writeBatchItem(stream, "https://a.com/\"quoted\"");
+  encoder.writeBatchItem(stream, "https://b.com/line\nbreak");
+  encoder.writeBatchItem(stream, "");
+  encoder.writeJson(stream, R"({"t":"d","f":"domain","v":"json.com"})");
+  encoder.writeJson(stream, R"({"t":"result","ok":true,"count":5})");
+
+  FILE* pipe = fmemopen(stream.data(), stream.size(), "r");
+  ASSERT_NE(pipe, nullptr);
+  Storage storage;
+  collectModuleOutput("bin", pipe, storage);
+  fclose(pipe);
+
+  ASSERT_EQ(storage["domain"].size(), 2);
+  EXPECT_EQ(storage["domain"][0].value, "example.com");
+  EXPECT_EQ(storage["domain"][1].value, "json.com");
+  ASSERT_EQ(storage["url"].size(), 3);
+  EXPECT_EQ(storage["url"][0].value, "https://a.com/\"quoted\"");
+  EXPECT_EQ(storage["url"][1].value, "https://b.com/line\nbreak");
+  EXPECT_EQ(storage["url"][2].value, "");
+}
+
+TEST_F(BmopProtocolTest, NegotiatesBinaryWireWithModule) {
+  createTestModule("modules/processors/binecho.py", R"(#!/usr/bin/env python3
+# Name: Binary Echo
+# Consumes: domain
+# Provides: subdomain
+import json, os, sys
+
+def varint(n):
+  out = bytearray()
+  while n >= 0x80:
+    out.append((n & 0x7f) | 0x80)
+    n >>= 7
+  out.append(n)
+  return bytes(out)
+
+def read_varint(f):
+  shift = value = 0
+  while True:
+    b = f.read(1)[0]
+    value |= (b & 0x7f) << shift
+    shift += 7
+    if not b & 0x80:
+      return value
+
+out = sys.stdout.buffer
+inp = open(sys.stdin.fileno(), "rb", buffering=65536, closefd=False)
+binary = "2" in os.environ.get("BMOP_ACCEPT", "")
+out.write(json.dumps({"bmop": "2.0" if binary else "1.0", "module": "binecho"}).encode() + b"\n")
+out.flush()
+
+values = []
+mode = "jsonl"
+first = inp.readline()
+if first.strip() == b'{"bmop":"2.0"}':
+  mode = "binary"
+  while True:
+    t = inp.read(1)
+    if not t:
+      break
+    if t[0] == 1:
+      read_varint(inp)
+      inp.read(read_varint(inp))
+    elif t[0] == 2:
+      read_varint(inp)
+      values.append(inp.read(read_varint(inp)))
+    elif t[0] == 3:
+      read_varint(inp)
+      for _ in range(read_varint(inp)):
+        values.append(inp.read(read_varint(inp)))
+else:
+  for line in [first] + inp.readlines():
+    if line.strip():
+      values.append(json.loads(line)["v"].encode())
+
+if binary:
+  out.write(b"\x01" + varint(0) + varint(9) + b"subdomain")
+  out.write(b"\x01" + varint(1) + varint(4) + b"mode")
+  out.write(b"\x02" + varint(1) + varint(len(mode)) + mode.encode())
+  out.write(b"\x03" + varint(0) + varint(len(values)))
+  for v in values:
+    w = b"www." + v
+    out.write(varint(len(w)) + w)
+  result = json.dumps({"t": "result", "ok": True, "count": len(values)}).encode()
+  out.write(b"\x04" + varint(len(result)) + result)
+else:
+  for v in values:
+    print(json.dumps({"t": "d", "f": "subdomain", "v": "www." + v.decode()}))
+)");
+
+  const int TOTAL = 5000;
+  Storage storage;
+  FormatId id = storage.intern("domain");
+  for (int i = 0; i < TOTAL; i++) {
+    storage.append(id, "host" + std::to_string(i) + ".com");
+  }
+  storage.append(id, "odd\"value");
+
+  testing::internal::CaptureStdout();
+  runModuleWithPipe("binecho.py", {}, storage, "domain");
+  testing::internal::GetCapturedStdout();
+
+  ASSERT_EQ(storage["mode"].size(), 1);
+  EXPECT_EQ(storage["mode"][0].value, "binary");
+  ASSERT_EQ(storage["subdomain"].size(), TOTAL + 1);
+  EXPECT_EQ(storage["subdomain"][0].value, "www.host0.com");
+  EXPECT_EQ(storage["subdomain"][TOTAL].value, "www.odd\"value");
+}
+
+TEST(BmopEgressTest, EscapedValuesRoundTrip) {
+  std::vector<std::string> values = {
+    "plain.example.com",
+    "quote\"inside",
+    "back\\slash",
+    "tab\tnew\nline\r",
+    std::string("nul\0byte", 8),
+    std::string(40, 'a') + "\"" + std::string(20, 'b') + "\x01",
+    "\xc3\xa9t\xc3\xa9"
+  };
+
+  BmopDecoder decoder;
+  BmopEvent event;
+  std::string prefix = bmopDataPrefix("we\"ird");
+  for (const auto& value : values) {
+    std::string line = prefix;
+    appendJsonEscaped(line, value);
+    line += "\"}";
+
+    ASSERT_TRUE(decoder.decode(line, event)) << line;
+    EXPECT_EQ(event.type, BmopEventType::DATA);
+    EXPECT_EQ(event.format, "we\"ird");
+    EXPECT_EQ(event.value, value);
+  }
+}
+
+TEST(BmopEgressTest, PipeDataToModuleWritesOneValidLinePerItem) {
+  Storage storage;
+  storage.append("domain", "a.com");
+  storage.append("domain", "b\"c.com");
+  storage.append("url", "https://x/\ny");
+
+  char* buffer = nullptr;
+  size_t size = 0;
+  FILE* pipe = open_memstream(&buffer, &size);
+  ASSERT_NE(pipe, nullptr);
+  pipeDataToModule(pipe, storage, "*");
+  fclose(pipe);
+  std::string written(buffer, size);
+  free(buffer);
+
+  Storage decoded;
+  std::istringstream stream(written);
+  std::string line;
+  int lines = 0;
+  while (std::getline(stream, line)) {
+    parseBMOPLine(line, decoded);
+    lines++;
+  }
+  EXPECT_EQ(lines, 3);
+  ASSERT_EQ(decoded["domain"].size(), 2);
+  EXPECT_EQ(decoded["domain"][1].value, "b\"c.com");
+  ASSERT_EQ(decoded["url"].size(), 1);
+  EXPECT_EQ(decoded["url"][0].value, "https://x/\ny");
 }
 
 int main(int argc, char **argv) {
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "../core/core.hpp"
+#include "../core/capture.hpp"
+#include "./module_fixture.hpp"
+
+namespace fs = std::filesystem;
+
+class CaptureTest : public ModuleFixture {
+  protected:
+    CaptureTest() : ModuleFixture("capture") {}
+
+    void TearDown() override {
+      setCapture(CaptureMode::NONE, "");
+      ModuleFixture::TearDown();
+    }
+};
+
+TEST_F(CaptureTest, WriterAndLoaderRoundTrip) {
+  CaptureWriter writer;
+  ASSERT_TRUE(writer.open("caps/mod.js.1.cap"));
+  writer.write(0, CaptureStream::STDOUT, "{\"bmop\":\"1.0\"}\n{\"t\":\"d\",");
+  writer.write(1, CaptureStream::STDOUT, std::string("\0binary\n", 8));
+  writer.write(0, CaptureStream::STDERR, "warning\n");
+  writer.write(0, CaptureStream::STDOUT, "\"f\":\"domain\",\"v\":\"a.com\"}\n");
+  writer.exit(0, 0);
+  writer.exit(1, 137);
+  ASSERT_TRUE(writer.close());
+
+  Capture capture;
+  std::string error;
+  ASSERT_TRUE(loadCapture("caps/mod.js.1.cap", capture, error)) << error;
+  EXPECT_EQ(capture.shards, 2);
+  ASSERT_EQ(capture.chunks.size(), 4);
+  EXPECT_EQ(capture.chunks[1].shard, 1);
+  EXPECT_EQ(capture.chunks[1].data, std::string("\0binary\n", 8));
+  EXPECT_EQ(capture.chunks[2].stream, CaptureStream::STDERR);
+  EXPECT_LE(capture.chunks[0].offsetUs, capture.chunks[3].offsetUs);
+  EXPECT_EQ(capture.exitCodes, std::vector<int>({0, 137}));
+  EXPECT_EQ(capture.stderrBytes, 8);
+
+  // A capture cut short is rejected rather than half-replayed.
+  fs::resize_file("caps/mod.js.1.cap", fs::file_size("caps/mod.js.1.cap") - 10);
+  EXPECT_FALSE(loadCapture("caps/mod.js.1.cap", capture, error));
+  EXPECT_FALSE(loadCapture("caps/missing.cap", capture, error));
+}
+
+TEST_F(CaptureTest, ReplayRebuildsStorageWithoutRunningModule) {
+  createTestModule("modules/collect.sh", R"(#!/bin/bash
+# Provides: domain
+touch ran.marker
+echo '{"bmop":"1.0","module":"collect"}'
+echo '{"t":"batch","f":"domain","c":2}'
+echo 'a.example.com'
+echo 'b.example.com'
+echo '{"t":"batch_end"}'
+echo '{"t":"d","f":"ip","v":"10.0.0.1"}'
+)");
+  createTestModule("modules/keepfirst.sh", R"(#!/bin/bash
+# Consumes: domain
+# Provides: domain
+# Storage: replace
+touch ran.marker
+echo '{"bmop":"1.0","module":"keepfirst"}'
+read -r line
+echo "$line"
+cat > /dev/null
+)");
+
+  setCapture(CaptureMode::RECORD, "caps");
+  Storage recorded;
+  runModuleWithPipe("collect.sh", {}, recorded, "");
+  runModuleWithPipe("keepfirst.sh", {}, recorded, "domain");
+  ASSERT_TRUE(fs::exists("caps/collect.sh.1.cap"));
+  ASSERT_TRUE(fs::exists("caps/keepfirst.sh.1.cap"));
+  ASSERT_EQ(recorded["domain"].size(), 1);
+
+  fs::remove("ran.marker");
+  setCapture(CaptureMode::REPLAY, "caps");
+  Storage replayed;
+  runModuleWithPipe("collect.sh", {}, replayed, "");
+  ASSERT_EQ(replayed["domain"].size(), 2);
+  runModuleWithPipe("keepfirst.sh", {}, replayed, "domain");
+
+  EXPECT_FALSE(fs::exists("ran.marker"));
+  ASSERT_EQ(replayed["domain"].size(), 1);
+  EXPECT_EQ(replayed["domain"][0].value, recorded["domain"][0].value);
+  EXPECT_EQ(replayed["ip"].size(), 1);
+
+  // A module that was never recorded is reported, not run.
+  createTestModule("modules/other.sh", "#!/bin/bash\ntouch ran.marker\n");
+  runModuleWithPipe("other.sh", {}, replayed, "");
+  EXPECT_FALSE(fs::exists("ran.marker"));
+}
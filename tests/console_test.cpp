@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "../core/core.hpp"
+#include "../core/console.hpp"
+#include "./module_fixture.hpp"
+
+class ConsoleTest : public ModuleFixture {
+  protected:
+    ConsoleTest() : ModuleFixture("console") {}
+
+    void SetUp() override {
+      ModuleFixture::SetUp();
+      createTestModule("modules/emit.sh", R"(#!/bin/bash
+# Provides: domain
+echo '{"bmop":"1.0","module":"emit"}'
+echo '{"t":"batch","f":"domain","c":3}'
+echo 'a.example.com'
+echo 'b.example.com'
+echo 'c.example.com'
+echo '{"t":"batch_end"}'
+)");
+    }
+
+    void TearDown() override {
+      setConsoleMode("summary");
+      ModuleFixture::TearDown();
+    }
+
+    std::string runEmit() {
+      Storage storage;
+      testing::internal::CaptureStdout();
+      runModuleWithPipe("emit.sh", {}, storage, "");
+      std::string out = testing::internal::GetCapturedStdout();
+      EXPECT_EQ(storage["domain"].size(), 3);
+      return out;
+    }
+};
+
+TEST_F(ConsoleTest, ParsesModeNames) {
+  ConsoleMode mode;
+  ASSERT_TRUE(parseConsoleMode("quiet", mode));
+  EXPECT_EQ(mode, ConsoleMode::QUIET);
+  ASSERT_TRUE(parseConsoleMode("raw", mode));
+  EXPECT_EQ(mode, ConsoleMode::RAW);
+  EXPECT_FALSE(parseConsoleMode("verbose", mode));
+  EXPECT_FALSE(setConsoleMode(""));
+}
+
+TEST_F(ConsoleTest, SummaryPrintsCountsInsteadOfModuleOutput) {
+  ASSERT_TRUE(setConsoleMode("summary"));
+  std::string out = runEmit();
+  EXPECT_EQ(out.find("b.example.com"), std::string::npos);
+  EXPECT_NE(out.find("[+] emit.sh: 3 items in "), std::string::npos) << out;
+}
+
+TEST_F(ConsoleTest, RawPassesModuleOutputThroughInOrder) {
+  ASSERT_TRUE(setConsoleMode("raw"));
+  std::string out = runEmit();
+  size_t running = out.find("Running (");
+  size_t header = out.find("{\"bmop\":\"1.0\",\"module\":\"emit\"}\n");
+  size_t last = out.find("{\"t\":\"batch_end\"}\n");
+  ASSERT_NE(running, std::string::npos);
+  ASSERT_NE(header, std::string::npos) << out;
+  ASSERT_NE(last, std::string::npos) << out;
+  EXPECT_LT(running, header);
+  EXPECT_LT(header, last);
+  EXPECT_EQ(out.find("items in"), std::string::npos);
+}
+
+TEST_F(ConsoleTest, BoundedQueueDeliversEverythingWritten) {
+  ASSERT_TRUE(setConsoleMode("raw"));
+  std::string line(1000, 'x');
+  line += '\n';
+  size_t chunks = ConsoleRenderer::QUEUE_LIMIT / (64 * 1024) * 3;
+  std::string chunk;
+  for (size_t i = 0; i < 64; ++i) chunk += line;
+
+  testing::internal::CaptureStdout();
+  for (size_t i = 0; i < chunks; ++i) ConsoleRenderer::shared().write(std::string(chunk));
+  ConsoleRenderer::shared().flush();
+  std::string out = testing::internal::GetCapturedStdout();
+  EXPECT_EQ(out.size(), chunks * chunk.size());
+}
@@ -6,6 +6,8 @@
 #include <map>
 #include <set>
 #include "../core/core.hpp"
+#include "../core/metadata.hpp"
+#include "../core/launcher.hpp"
 
 namespace fs = std::filesystem;
 
@@ -185,6 +187,62 @@ TEST_F(BahamutTest, ParseModuleMetadataStorageBehaviors) {
   EXPECT_EQ(parseModuleMetadata("modules/invalid.js").storageBehavior, "add");
 }
 
+TEST_F(BahamutTest, ParseModuleMetadataParallel) {
+  createTestModule("modules/fixed.js", "#!/usr/bin/env node\n// Parallel: 4\n");
+  createTestModule("modules/auto.js", "#!/usr/bin/env node\n// Parallel: auto\n");
+  createTestModule("modules/invalid.js", "#!/usr/bin/env node\n// Parallel: lots\n");
+  createTestModule("modules/none.js", "#!/usr/bin/env node\n");
+
+  EXPECT_EQ(parseModuleMetadata("modules/fixed.js").parallel, 4);
+  EXPECT_EQ(parseModuleMetadata("modules/auto.js").parallel, 0);
+  EXPECT_EQ(parseModuleMetadata("modules/invalid.js").parallel, 1);
+  EXPECT_EQ(parseModuleMetadata("modules/none.js").parallel, 1);
+
+  EXPECT_EQ(parseParallelSpec("3"), 3);
+  EXPECT_EQ(parseParallelSpec("auto"), 0);
+  EXPECT_EQ(parseParallelSpec("0"), -1);
+  EXPECT_EQ(parseParallelSpec("-2"), -1);
+}
+
+TEST_F(BahamutTest, ParseModuleMetadataStopsAtFirstLineOfCode) {
+  std::string content = R"(#!/usr/bin/env node
+
+// Name: Header Module
+// Stage: 2
+
+// Consumes: domain
+const usage = "Name: not a directive";
+// Provides: overwritten
+// Stage: 7
+)";
+
+  createTestModule("modules/header.js", content);
+
+  ModuleMetadata meta = parseModuleMetadata("modules/header.js");
+  EXPECT_EQ(meta.name, "Header Module");
+  EXPECT_EQ(meta.stage, 2);
+  EXPECT_EQ(meta.consumes, "domain");
+  EXPECT_EQ(meta.provides, "");
+}
+
+TEST_F(BahamutTest, ModuleMetadataIsCachedByHeaderHash) {
+  std::string header = "#!/usr/bin/env python3\n# Name: Cached\n# Provides: domain\n";
+  createTestModule("modules/one.py", header + "print('one')\n");
+  createTestModule("modules/two.py", header + "print('two, different body')\n");
+
+  uint64_t first = 0;
+  uint64_t second = 0;
+  ModuleMetadata a = MetadataCache::shared().load("modules/one.py", &first);
+  size_t cached = MetadataCache::shared().size();
+  ModuleMetadata b = MetadataCache::shared().load("modules/two.py", &second);
+
+  // Same header, different code: one compiled entry serves both.
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(MetadataCache::shared().size(), cached);
+  EXPECT_EQ(b.name, "Cached");
+  EXPECT_EQ(b.provides, a.provides);
+}
+
 TEST_F(BahamutTest, GetPythonVersion) {
   std::string python39 = "#!/usr/bin/env python3.9";
   std::string python311 = "#!/usr/bin/env python3.11";
@@ -246,7 +304,7 @@ TEST_F(BahamutTest, LoadProfileEmpty) {
 }
 
 TEST_F(BahamutTest, ParseBMOPLineData) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   parseBMOPLine(R"({"t":"d","f":"domain","v":"example.com"})", storage);
   EXPECT_EQ(storage["domain"].size(), 1);
@@ -255,16 +313,14 @@ TEST_F(BahamutTest, ParseBMOPLineData) {
 }
 
 TEST_F(BahamutTest, ParseBMOPLineBatch) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   parseBMOPLine(R"({"t":"batch","f":"domain","c":1000})", storage);
-  EXPECT_EQ(storage["__batch_format__"].size(), 1);
-  EXPECT_EQ(storage["__batch_format__"][0].format, "domain");
-  EXPECT_EQ(storage["__batch_format__"][0].value, "domain");
+  EXPECT_TRUE(storage.empty());
 }
 
 TEST_F(BahamutTest, ParseBMOPLineInvalidJson) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   parseBMOPLine("invalid json", storage);
   parseBMOPLine("", storage);
@@ -276,7 +332,7 @@ TEST_F(BahamutTest, ParseBMOPLineInvalidJson) {
 }
 
 TEST_F(BahamutTest, ParseBMOPLineNonDataTypes) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   parseBMOPLine(R"({"t":"log","l":"info","m":"test"})", storage);
   parseBMOPLine(R"({"t":"progress","c":1,"T":10})", storage);
@@ -296,8 +352,11 @@ TEST_F(BahamutTest, SetupNodeEnvironmentShared) {
   
   EXPECT_TRUE(fs::exists("modules/node_modules") || fs::is_symlink("modules/node_modules"));
   
-  char* node_path = std::getenv("NODE_PATH");
-  EXPECT_TRUE(node_path != nullptr);
+  // Handed to the module, not set on the core.
+  auto env = moduleEnvironment("modules/test.js", source, false);
+  const char* node_path = findEnvironment(*env, "NODE_PATH");
+  ASSERT_TRUE(node_path != nullptr);
+  EXPECT_EQ(std::string(node_path), fs::absolute(source).string());
 }
 
 TEST_F(BahamutTest, SetupNodeEnvironmentIsolated) {
@@ -315,8 +374,13 @@ TEST_F(BahamutTest, SetupPythonEnvironmentShared) {
   std::string source = setupPythonEnvironment("modules/test.py", "shared", "modules");
   EXPECT_EQ(source, "./modules/shared_deps/python_libs");
   
-  char* python_path = std::getenv("PYTHONPATH");
-  EXPECT_TRUE(python_path != nullptr);
+  // Built once, so running it again does not grow PYTHONPATH.
+  auto env = moduleEnvironment("modules/test.py", source, false);
+  const char* python_path = findEnvironment(*env, "PYTHONPATH");
+  ASSERT_TRUE(python_path != nullptr);
+  EXPECT_TRUE(std::string(python_path).starts_with(fs::absolute(source).string()));
+  EXPECT_EQ(moduleEnvironment("modules/test.py", source, false), env);
+  EXPECT_STREQ(findEnvironment(*env, "BMOP_ACCEPT"), "2");
 }
 
 TEST_F(BahamutTest, SetupPythonEnvironmentIsolated) {
@@ -341,7 +405,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:2}));)";
   
   createTestModule("modules/test.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("test.js", {}, storage, "");
   
   EXPECT_EQ(storage["domain"].size(), 2);
@@ -364,7 +428,7 @@ print(json.dumps({"t":"result","ok":True,"count":1})))";
   
   createTestModule("modules/test.py", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("test.py", {}, storage, "");
   
   EXPECT_EQ(storage["domain"].size(), 1);
@@ -384,7 +448,7 @@ echo '{"t":"result","ok":true,"count":1}')";
   
   createTestModule("modules/test.sh", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("test.sh", {}, storage, "");
   
   EXPECT_EQ(storage["domain"].size(), 1);
@@ -408,7 +472,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:3}));)";
   
   createTestModule("modules/batch.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("batch.js", {}, storage, "");
   
   EXPECT_EQ(storage["domain"].size(), 3);
@@ -452,7 +516,7 @@ process.stdin.on('end', () => {
   createTestModule("modules/collector.js", collector);
   createTestModule("modules/processor.js", processor);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   runModuleWithPipe("collector.js", {}, storage, "");
   EXPECT_EQ(storage["domain"].size(), 2);
@@ -507,7 +571,7 @@ process.stdin.on('end', () => {
   createTestModule("modules/collector2.js", collector2);
   createTestModule("modules/processor.js", processor);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   runModuleWithPipe("collector1.js", {}, storage, "");
   runModuleWithPipe("collector2.js", {}, storage, "");
@@ -551,7 +615,7 @@ process.stdin.on('end', () => {
   
   createTestModule("modules/cleaner.js", processor);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   storage["domain"].push_back({"domain", "EXAMPLE.COM"});
   storage["domain"].push_back({"domain", "Example.Com"});
@@ -564,6 +628,90 @@ process.stdin.on('end', () => {
   EXPECT_EQ(storage["domain"].size(), 2);
 }
 
+TEST_F(BahamutTest, ParallelModuleShardsInputAcrossWorkers) {
+  std::string processor = R"(#!/usr/bin/env node
+// Consumes: domain
+// Provides: domain
+// Storage: replace
+// Parallel: 4
+console.log(JSON.stringify({bmop:"1.0",module:"upper"}));
+let buffer = '';
+process.stdin.on('data', chunk => { buffer += chunk.toString(); });
+process.stdin.on('end', () => {
+  for (const line of buffer.split('\n')) {
+    if (!line.trim()) continue;
+    const msg = JSON.parse(line);
+    if (msg.t === 'd') console.log(JSON.stringify({t:"d",f:"domain",v:msg.v.toUpperCase()}));
+  }
+  console.log(JSON.stringify({t:"d",f:"worker",v:String(process.pid)}));
+});)";
+
+  createTestModule("modules/upper.js", processor);
+
+  Storage storage;
+  for (int i = 0; i < 200; i++) {
+    storage["domain"].push_back("host" + std::to_string(i) + ".com");
+  }
+
+  runModuleWithPipe("upper.js", {}, storage, "domain");
+
+  // Replace applied once for the whole module, every item handled once.
+  ASSERT_EQ(storage["domain"].size(), 200);
+  std::set<std::string> seen;
+  for (const auto& item : storage["domain"]) seen.insert(std::string(item.value));
+  EXPECT_EQ(seen.size(), 200);
+  EXPECT_TRUE(seen.count("HOST0.COM"));
+  EXPECT_TRUE(seen.count("HOST199.COM"));
+  EXPECT_EQ(storage["worker"].size(), 4);
+}
+
+TEST_F(BahamutTest, ParallelOverrideNeverExceedsInputItems) {
+  std::string processor = R"(#!/usr/bin/env node
+// Consumes: domain
+// Provides: worker
+process.stdin.resume();
+process.stdin.on('end', () => {
+  console.log(JSON.stringify({t:"d",f:"worker",v:String(process.pid)}));
+});)";
+
+  createTestModule("modules/counter.js", processor);
+
+  Storage storage;
+  storage["domain"].push_back("a.com");
+  storage["domain"].push_back("b.com");
+
+  setParallelOverride(8);
+  runModuleWithPipe("counter.js", {}, storage, "domain");
+  setParallelOverride(-1);
+
+  EXPECT_EQ(storage["worker"].size(), 2);
+  EXPECT_EQ(storage["domain"].size(), 2);
+}
+
+TEST_F(BahamutTest, ParallelOverrideNeverShardsOutputModules) {
+  std::string exporter = R"(#!/usr/bin/env bash
+# Type: output
+# Consumes: *
+echo header >> export.csv
+cat > /dev/null
+)";
+
+  createTestModule("modules/export.sh", exporter);
+
+  Storage storage;
+  for (int i = 0; i < 6; ++i) storage["num"].push_back(std::to_string(i));
+
+  setParallelOverride(3);
+  runModuleWithPipe("export.sh", {}, storage, "*");
+  setParallelOverride(-1);
+
+  std::ifstream file("export.csv");
+  std::string line;
+  int headers = 0;
+  while (std::getline(file, line)) headers += line == "header";
+  EXPECT_EQ(headers, 1);
+}
+
 TEST_F(BahamutTest, StorageBehaviorDelete) {
   std::string filter = R"(#!/usr/bin/env node
 // Consumes: domain
@@ -579,7 +727,7 @@ process.stdin.on('end', () => {
   
   createTestModule("modules/filter.js", filter);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   storage["domain"].push_back({"domain", "bad.com"});
   storage["domain"].push_back({"domain", "evil.com"});
@@ -610,7 +758,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:1}));)";
   createTestModule("modules/collector1.js", collector1);
   createTestModule("modules/collector2.js", collector2);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   runModuleWithPipe("collector1.js", {}, storage, "");
   EXPECT_EQ(storage["domain"].size(), 1);
@@ -643,7 +791,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:1}));)";
 module1.js
 module3.js)");
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   auto modules = loadProfile("test_order");
   for (const auto& module : modules) {
@@ -708,7 +856,7 @@ process.stdin.on('end', () => {
   createTestModule("modules/stage2.js", stage2);
   createTestModule("modules/stage99.js", stage99);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   auto modules = getModules();
   std::map<int, std::vector<std::pair<std::string, ModuleMetadata>>> stageModules;
@@ -743,7 +891,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:1}));)";
   
   createTestModule("modules/logger.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("logger.js", {}, storage, "");
   
   EXPECT_EQ(storage["test"].size(), 1);
@@ -760,7 +908,7 @@ process.exit(1);)";
   
   createTestModule("modules/error.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("error.js", {}, storage, "");
   
   EXPECT_TRUE(storage.empty());
@@ -778,7 +926,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:3}));)";
   
   createTestModule("modules/mixed.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("mixed.js", {}, storage, "");
   
   EXPECT_EQ(storage["domain"].size(), 3);
@@ -891,7 +1039,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:3}));)";
   
   createTestModule("modules/custom.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("custom.js", {}, storage, "");
   
   EXPECT_EQ(storage["custom-format"].size(), 1);
@@ -979,7 +1127,7 @@ process.stdin.on('end', () => {
   createTestModule("modules/cleaner.js", cleaner);
   createTestModule("modules/subdomain_gen.js", subdomain_gen);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   runModuleWithPipe("collector.js", {}, storage, "");
   EXPECT_EQ(storage["domain"].size(), 3);
@@ -1014,7 +1162,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:args.length}));)";
   
   createTestModule("modules/args.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   std::vector<std::string> args = {"--target", "example.com", "--verbose"};
   
   runModuleWithPipe("args.js", args, storage, "");
@@ -1038,7 +1186,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:count}));)";
   
   createTestModule("modules/large.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("large.js", {}, storage, "");
   
   EXPECT_EQ(storage["number"].size(), 1000);
@@ -1060,7 +1208,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:1}));)";
   
   createTestModule("modules/malformed.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("malformed.js", {}, storage, "");
   
   EXPECT_EQ(storage["good"].size(), 1);
@@ -1098,7 +1246,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:1}));)";
   createTestModule("modules/filter.js", filter);
   createTestModule("modules/source2.js", source2);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   runModuleWithPipe("source1.js", {}, storage, "");
   EXPECT_EQ(storage["data"].size(), 3);
@@ -1183,7 +1331,7 @@ process.stdin.on('end', () => {
   createProfile("integration", R"(first.js
 second.js)");
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   auto modules = loadProfile("integration");
   for (const auto& module : modules) {
@@ -1241,7 +1389,7 @@ echo "{\"t\":\"result\",\"ok\":true,\"count\":$count}")";
   createTestModule("modules/python.py", python_processor);
   createTestModule("modules/bash.sh", bash_output);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   runModuleWithPipe("node.js", {}, storage, "");
   EXPECT_EQ(storage["domain"].size(), 1);
@@ -1262,7 +1410,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:1,}));)";
   
   createTestModule("modules/trailing.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("trailing.js", {}, storage, "");
   
   EXPECT_EQ(storage["test"].size(), 1);
@@ -1277,7 +1425,7 @@ console.log('{"t":"result","ok":true,"count":1}');)";
   
   createTestModule("modules/comments.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("comments.js", {}, storage, "");
   
   EXPECT_EQ(storage["test"].size(), 1);
@@ -1296,7 +1444,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:5}));)";
   
   createTestModule("modules/edge.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("edge.js", {}, storage, "");
   
   EXPECT_EQ(storage["empty"].size(), 1);
@@ -1315,7 +1463,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:4}));)";
   
   createTestModule("modules/multi.js", content);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("multi.js", {}, storage, "");
   
   EXPECT_EQ(storage["domain"].size(), 1);
@@ -1330,7 +1478,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:4}));)";
 }
 
 TEST_F(BahamutTest, ModuleNotFoundError) {
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   testing::internal::CaptureStdout();
   runModuleWithPipe("nonexistent.js", {}, storage, "");
@@ -1349,7 +1497,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:0}));)";
   
   createTestModule("modules/existing.js", module);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   testing::internal::CaptureStdout();
   auto modules = loadProfile("missing");
@@ -1420,7 +1568,7 @@ process.stdin.on('end', () => {
   createTestModule("modules/c2.js", collector2);
   createTestModule("modules/p.js", processor);
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   runModuleWithPipe("c1.js", {}, storage, "");
   EXPECT_EQ(storage["domain"].size(), 1);
@@ -1566,7 +1714,7 @@ cleaner.js
 subdomain_gen.py
 csv.sh)");
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   auto modules = loadProfile("full_workflow");
   for (const auto& module : modules) {
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <csignal>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "../core/core.hpp"
+#include "../core/eventloop.hpp"
+#include "./module_fixture.hpp"
+
+class EventLoopTest : public ModuleFixture {
+  protected:
+    EventLoopTest() : ModuleFixture("eventloop") {}
+
+    pid_t spawnFilter(const char* program, int& stdinFd, int& stdoutFd) {
+      int in[2];
+      int out[2];
+      if (pipe2(in, O_CLOEXEC) != 0 || pipe2(out, O_CLOEXEC) != 0) return -1;
+
+      pid_t pid = fork();
+      if (pid == 0) {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        execlp(program, program, static_cast<char*>(nullptr));
+        _exit(127);
+      }
+      close(in[0]);
+      close(out[1]);
+      stdinFd = in[1];
+      stdoutFd = out[0];
+      return pid;
+    }
+};
+
+TEST_F(EventLoopTest, StreamsInputLargerThanPipeBuffers) {
+  int stdinFd = -1;
+  int stdoutFd = -1;
+  pid_t pid = spawnFilter("cat", stdinFd, stdoutFd);
+  ASSERT_GT(pid, 0);
+
+  // Far beyond the 64KiB pipe capacity in both directions: with a
+  // write-everything-then-read strategy this would deadlock.
+  const size_t CHUNKS = 512;
+  const std::string chunk(16 * 1024, 'x');
+  size_t produced = 0;
+  std::string received;
+
+  ModuleIOLoop::Handlers handlers;
+  handlers.produce = [&](std::string& out) {
+    if (produced == CHUNKS) return false;
+    out += chunk;
+    produced++;
+    return true;
+  };
+  handlers.stdoutChunk = [&](const char* data, size_t len) { received.append(data, len); };
+  ModuleIOLoop loop;
+  size_t child = loop.addChild(stdinFd, stdoutFd, -1, std::move(handlers));
+  loop.run();
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  EXPECT_EQ(received.size(), CHUNKS * chunk.size());
+  EXPECT_EQ(loop.stats(child).bytesIn, CHUNKS * chunk.size());
+  EXPECT_EQ(loop.stats(child).bytesOut, CHUNKS * chunk.size());
+  EXPECT_FALSE(loop.stats(child).inputTruncated);
+}
+
+TEST_F(EventLoopTest, ChildThatStopsReadingDoesNotKillParent) {
+  int stdinFd = -1;
+  int stdoutFd = -1;
+  pid_t pid = spawnFilter("true", stdinFd, stdoutFd);
+  ASSERT_GT(pid, 0);
+
+  ModuleIOLoop::Handlers handlers;
+  handlers.produce = [](std::string& out) {
+    out.append(64 * 1024, 'y');
+    return true;
+  };
+  ModuleIOLoop loop;
+  size_t child = loop.addChild(stdinFd, stdoutFd, -1, std::move(handlers));
+  loop.run();
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(loop.stats(child).inputTruncated);
+
+  // Without ignoring SIGPIPE process-wide: install scripts and modules must
+  // still start with the default.
+  struct sigaction action{};
+  sigaction(SIGPIPE, nullptr, &action);
+  EXPECT_EQ(action.sa_handler, SIG_DFL);
+  sigset_t mask;
+  pthread_sigmask(SIG_BLOCK, nullptr, &mask);
+  EXPECT_EQ(sigismember(&mask, SIGPIPE), 0);
+}
+
+TEST_F(EventLoopTest, ConsumerEchoingLargeInputDoesNotDeadlock) {
+  createTestModule("modules/echo.js", R"(#!/usr/bin/env node
+// Name: Echo
+// Consumes: domain
+// Provides: subdomain
+const rl = require('readline').createInterface({ input: process.stdin });
+rl.on('line', (line) => {
+  const msg = JSON.parse(line);
+  process.stdout.write(JSON.stringify({t:"d",f:"subdomain",v:"www." + msg.v}) + "\n");
+});
+)");
+
+  const int TOTAL = 50000;
+  Storage storage;
+  FormatId id = storage.intern("domain");
+  for (int i = 0; i < TOTAL; i++) {
+    storage.append(id, "host" + std::to_string(i) + ".example.com");
+  }
+
+  testing::internal::CaptureStdout();
+  runModuleWithPipe("echo.js", {}, storage, "domain");
+  testing::internal::GetCapturedStdout();
+
+  ASSERT_EQ(storage["subdomain"].size(), TOTAL);
+  EXPECT_EQ(storage["subdomain"][0].value, "www.host0.example.com");
+  EXPECT_EQ(storage["subdomain"][TOTAL - 1].value, "www.host49999.example.com");
+  EXPECT_EQ(storage["domain"].size(), TOTAL);
+}
+
+TEST(LineReaderTest, FramesLinesAcrossChunks) {
+  LineReader reader(16);
+  std::string_view line;
+
+  reader.append("alpha\nbr", 8);
+  ASSERT_TRUE(reader.next(line));
+  EXPECT_EQ(line, "alpha");
+  EXPECT_FALSE(reader.next(line));
+
+  reader.append("avo\ncharlie", 11);
+  ASSERT_TRUE(reader.next(line));
+  EXPECT_EQ(line, "bravo");
+  EXPECT_FALSE(reader.next(line));
+
+  ASSERT_TRUE(reader.takeRemainder(line));
+  EXPECT_EQ(line, "charlie");
+  EXPECT_FALSE(reader.takeRemainder(line));
+}
+
+TEST(LineReaderTest, GrowsForLinesLongerThanCapacity) {
+  LineReader reader(8);
+  const std::string longLine(100000, 'z');
+  std::string_view line;
+
+  for (size_t i = 0; i < longLine.size(); i += 1000) {
+    reader.append(longLine.data() + i, 1000);
+    EXPECT_FALSE(reader.next(line));
+  }
+  reader.append("\n", 1);
+  ASSERT_TRUE(reader.next(line));
+  EXPECT_EQ(line.size(), longLine.size());
+  EXPECT_EQ(reader.buffered(), 0u);
+}
+
+TEST(LineReaderTest, FindNewlineMatchesMemchr) {
+  std::string text(200, 'a');
+  for (size_t pos : {0u, 15u, 16u, 31u, 32u, 33u, 199u}) {
+    std::string probe = text;
+    probe[pos] = '\n';
+    EXPECT_EQ(findNewline(probe.data(), probe.data() + probe.size()), probe.data() + pos);
+  }
+  EXPECT_EQ(findNewline(text.data(), text.data() + text.size()), nullptr);
+}
@@ -301,7 +301,7 @@ console.log(JSON.stringify({t:"result",ok:true,count:1}));)";
   
   installModule("env_test.js");
   
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   
   runModuleWithPipe("env_test.js", {}, storage, "");
   
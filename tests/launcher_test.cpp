@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "../core/core.hpp"
+#include "../core/launcher.hpp"
+#include "../core/eventloop.hpp"
+#include "./module_fixture.hpp"
+
+namespace fs = std::filesystem;
+
+class LauncherTest : public ModuleFixture {
+  protected:
+    LauncherTest() : ModuleFixture("launcher") {}
+
+    void SetUp() override {
+      ModuleFixture::SetUp();
+      fs::create_directories("profiles");
+    }
+};
+
+TEST_F(LauncherTest, ProfileArgumentsReachModuleUnsplit) {
+  createTestModule("modules/args.sh", R"(#!/bin/bash
+# Provides: seen
+printf '[%s]\n' "$@" > args.txt
+)");
+  createTestModule("profiles/bahamut_quoted.txt", "args.sh --path '/tmp/test path' --name=\"a b\" $HOME;true\n");
+
+  runModulesFromProfile("quoted", {"--global arg"});
+
+  EXPECT_EQ(readFile("args.txt"), "[--path]\n[/tmp/test path]\n[--name=a b]\n[$HOME;true]\n[--global arg]\n");
+}
+
+TEST_F(LauncherTest, ChildGetsExactlyItsEnvironmentAndFds) {
+  int out[2], extra[2];
+  ASSERT_EQ(pipe2(out, O_CLOEXEC), 0);
+  ASSERT_EQ(pipe2(extra, O_CLOEXEC), 0);
+
+  ProcessSpec spec;
+  spec.argv = {"sh", "-c", "echo \"$ONLY:${HOME-unset}\"; echo side >&3"};
+  spec.env = {"PATH=/usr/bin:/bin", "ONLY=yes"};
+  // Targets that collide with each other's sources must still land right.
+  spec.fds = {{out[1], STDOUT_FILENO}, {extra[1], 3}};
+  pid_t pid = launchProcess(spec);
+  ASSERT_GT(pid, 0);
+  close(out[1]);
+  close(extra[1]);
+
+  auto drain = [](int fd) {
+    std::string text;
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) text.append(buffer, static_cast<size_t>(n));
+    close(fd);
+    return text;
+  };
+  EXPECT_EQ(drain(out[0]), "yes:unset\n");
+  EXPECT_EQ(drain(extra[0]), "side\n");
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+TEST_F(LauncherTest, MissingProgramFailsInParent) {
+  ProcessSpec spec;
+  spec.argv = {"bahamut-no-such-runner"};
+  spec.env = {"PATH=/usr/bin:/bin"};
+  errno = 0;
+  EXPECT_EQ(launchProcess(spec), -1);
+  EXPECT_EQ(errno, ENOENT);
+  EXPECT_EQ(resolveExecutable("sh", "/nonexistent:/bin"), "/bin/sh");
+}
+
+TEST_F(LauncherTest, ChildStartsWithEmptySignalMask) {
+  ScopedSigpipeBlock block;
+  for (int cpuLimit : {0, 60}) {
+    int out[2];
+    ASSERT_EQ(pipe2(out, O_CLOEXEC), 0);
+    ProcessSpec spec;
+    spec.argv = {"grep", "SigBlk", "/proc/self/status"};
+    spec.env = {"PATH=/usr/bin:/bin"};
+    spec.fds = {{out[1], STDOUT_FILENO}};
+    // With a limit it goes through vfork instead of posix_spawn.
+    spec.limits.maxCpuSeconds = cpuLimit;
+    pid_t pid = launchProcess(spec);
+    ASSERT_GT(pid, 0);
+    close(out[1]);
+
+    std::string text;
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(out[0], buffer, sizeof(buffer))) > 0) text.append(buffer, static_cast<size_t>(n));
+    close(out[0]);
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_EQ(text, "SigBlk:\t0000000000000000\n") << "cpu limit " << cpuLimit;
+  }
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include "../core/core.hpp"
+#include "../core/limits.hpp"
+#include "../core/metadata.hpp"
+#include "../include/rapidjson/document.h"
+#include "./module_fixture.hpp"
+
+class LimitsTest : public ModuleFixture {
+  protected:
+    LimitsTest() : ModuleFixture("limits") {}
+
+    void TearDown() override {
+      setRunReport("", "");
+      setDefaultModuleTimeout("");
+      ModuleFixture::TearDown();
+    }
+
+    // The one module entry of the JSON run report `runModule` wrote.
+    void readReport(rapidjson::Document& doc) {
+      ASSERT_FALSE(doc.Parse(readFile("run.json").c_str()).HasParseError());
+      ASSERT_EQ(doc["modules"].Size(), 1);
+    }
+};
+
+TEST_F(LimitsTest, ParsesDurationsAndSizes) {
+  int ms = 0;
+  EXPECT_TRUE(parseDuration("10000", ms));
+  EXPECT_EQ(ms, 10000);
+  EXPECT_TRUE(parseDuration("250ms", ms));
+  EXPECT_EQ(ms, 250);
+  EXPECT_TRUE(parseDuration("30s", ms));
+  EXPECT_EQ(ms, 30000);
+  EXPECT_TRUE(parseDuration("2m", ms));
+  EXPECT_EQ(ms, 120000);
+  EXPECT_FALSE(parseDuration("soon", ms));
+  EXPECT_FALSE(parseDuration("5h", ms));
+  EXPECT_FALSE(parseDuration("99999999999", ms));
+
+  uint64_t bytes = 0;
+  EXPECT_TRUE(parseByteSize("4096", bytes));
+  EXPECT_EQ(bytes, 4096);
+  EXPECT_TRUE(parseByteSize("512K", bytes));
+  EXPECT_EQ(bytes, 512u << 10);
+  EXPECT_TRUE(parseByteSize("256MB", bytes));
+  EXPECT_EQ(bytes, 256u << 20);
+  EXPECT_TRUE(parseByteSize("2GiB", bytes));
+  EXPECT_EQ(bytes, 2ull << 30);
+  EXPECT_FALSE(parseByteSize("lots", bytes));
+}
+
+TEST_F(LimitsTest, MetadataDirectivesAreParsed) {
+  ModuleMetadata meta = compileModuleMetadata(
+    "#!/usr/bin/env node\n"
+    "// RateLimit: 200\n"
+    "// Timeout: 10000\n"
+    "// MaxMemory: 512M\n"
+    "// MaxCPU: 90\n");
+  EXPECT_EQ(meta.rateLimit, 200);
+  EXPECT_EQ(meta.timeoutMs, 10000);
+  EXPECT_EQ(meta.maxMemoryBytes, 512u << 20);
+  EXPECT_EQ(meta.maxCpuSeconds, 90);
+
+  meta = compileModuleMetadata("#!/usr/bin/env node\n// Timeout: 30s\n// MaxCPU: 2m\n// MaxMemory: a lot\n");
+  EXPECT_EQ(meta.timeoutMs, 30000);
+  EXPECT_EQ(meta.maxCpuSeconds, 120);
+  EXPECT_EQ(meta.maxMemoryBytes, 0);
+}
+
+TEST_F(LimitsTest, HungModuleIsKilledAndReported) {
+  createTestModule("modules/hang.sh", R"(#!/bin/bash
+# Provides: domain
+# Timeout: 250
+echo '{"bmop":"1.0","module":"hang"}'
+echo '{"t":"d","f":"domain","v":"before.com"}'
+sleep 20
+echo '{"t":"d","f":"domain","v":"after.com"}'
+)");
+
+  setRunReport("run.json", "");
+  auto start = std::chrono::steady_clock::now();
+  runModule("hang.sh", {});
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_LT(elapsed, std::chrono::seconds(10));
+
+  rapidjson::Document doc;
+  readReport(doc);
+  const rapidjson::Value& module = doc["modules"][0];
+  ASSERT_TRUE(module["killed"].IsString());
+  EXPECT_STREQ(module["killed"].GetString(), "timeout");
+  EXPECT_EQ(module["items_out"].GetUint64(), 1);
+}
+
+TEST_F(LimitsTest, KilledConsumerKeepsItsInput) {
+  createTestModule("modules/stall.sh", R"(#!/bin/bash
+# Consumes: domain
+# Provides: domain
+# Storage: replace
+# Timeout: 250
+echo '{"bmop":"1.0","module":"stall"}'
+read -r first
+echo '{"t":"d","f":"domain","v":"salvaged.com"}'
+sleep 20
+)");
+
+  Storage storage;
+  for (const char* domain : {"a.com", "b.com", "c.com"}) storage.append("domain", domain);
+  runModuleWithPipe("stall.sh", {}, storage, "domain");
+
+  // The replace is skipped: the input it never got through stays.
+  ASSERT_EQ(storage["domain"].size(), 4);
+  EXPECT_EQ(storage["domain"][3].value, "salvaged.com");
+}
+
+TEST_F(LimitsTest, CpuLimitStopsBusyModule) {
+  createTestModule("modules/spin.sh", R"(#!/bin/bash
+# Provides: domain
+# MaxCPU: 1
+echo '{"bmop":"1.0","module":"spin"}'
+while :; do :; done
+)");
+
+  setRunReport("run.json", "");
+  auto start = std::chrono::steady_clock::now();
+  runModule("spin.sh", {});
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+
+  rapidjson::Document doc;
+  readReport(doc);
+  const rapidjson::Value& module = doc["modules"][0];
+  ASSERT_TRUE(module["killed"].IsString());
+  EXPECT_STREQ(module["killed"].GetString(), "cpu");
+  EXPECT_EQ(module["exit_code"].GetInt(), 128 + SIGXCPU);
+}
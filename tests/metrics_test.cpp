@@ -0,0 +1,146 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <set>
+#include "../core/core.hpp"
+#include "../core/metrics.hpp"
+#include "../include/rapidjson/document.h"
+#include "./module_fixture.hpp"
+
+namespace fs = std::filesystem;
+
+class MetricsTest : public ModuleFixture {
+  protected:
+    MetricsTest() : ModuleFixture("metrics") {}
+
+    void TearDown() override {
+      setRunReport("", "");
+      setTraceFile("");
+      ModuleFixture::TearDown();
+    }
+};
+
+TEST_F(MetricsTest, RendersJsonAndPrometheus) {
+  RunReport report;
+  report.begin("profile:recon");
+
+  ModuleRunStats stats;
+  stats.moduleName = "get\"domains\".py";
+  stats.stage = 1;
+  stats.startMs = 5;
+  stats.endMs = 125;
+  stats.wallMs = 120;
+  stats.peakRssKb = 2048;
+  stats.bytesOut = 300;
+  stats.itemsOut = 10;
+  report.record(stats);
+
+  rapidjson::Document doc;
+  std::string json = report.toJson();
+  ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError());
+  EXPECT_STREQ(doc["run"].GetString(), "profile:recon");
+  EXPECT_DOUBLE_EQ(doc["wall_ms"].GetDouble(), 125);
+  ASSERT_EQ(doc["modules"].Size(), 1);
+  EXPECT_EQ(doc["modules"][0]["items_out"].GetUint64(), 10);
+  EXPECT_EQ(doc["modules"][0]["peak_rss_kb"].GetInt64(), 2048);
+
+  std::string prom = report.toPrometheus();
+  EXPECT_NE(prom.find("# TYPE bahamut_module_wall_seconds gauge"), std::string::npos);
+  EXPECT_NE(prom.find("bahamut_module_peak_rss_bytes{run=\"profile:recon\",module=\"get\\\"domains\\\".py\",stage=\"1\",invocation=\"0\"} 2097152"),
+    std::string::npos);
+}
+
+TEST_F(MetricsTest, ModuleRunIsRecordedInReport) {
+  createTestModule("modules/emit.sh", R"(#!/bin/bash
+# Provides: domain
+echo '{"bmop":"1.0","module":"emit"}'
+for i in 1 2 3; do echo "{\"t\":\"d\",\"f\":\"domain\",\"v\":\"host$i.com\"}"; done
+echo 'diagnostic' >&2
+exit 3
+)");
+
+  setRunReport("run.json", "run.prom");
+  runModule("emit.sh", {});
+
+  ASSERT_TRUE(fs::exists("run.json"));
+  ASSERT_TRUE(fs::exists("run.prom"));
+
+  rapidjson::Document doc;
+  std::string json = readFile("run.json");
+  ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError());
+  EXPECT_STREQ(doc["run"].GetString(), "module:emit.sh");
+  ASSERT_EQ(doc["modules"].Size(), 1);
+
+  const rapidjson::Value& module = doc["modules"][0];
+  EXPECT_STREQ(module["module"].GetString(), "emit.sh");
+  EXPECT_EQ(module["items_out"].GetUint64(), 3);
+  EXPECT_EQ(module["items_in"].GetUint64(), 0);
+  EXPECT_GT(module["bytes_out"].GetUint64(), 0);
+  EXPECT_GT(module["bytes_err"].GetUint64(), 0);
+  EXPECT_GT(module["peak_rss_kb"].GetInt64(), 0);
+  EXPECT_EQ(module["exit_code"].GetInt(), 3);
+  EXPECT_GE(module["end_ms"].GetDouble(), module["start_ms"].GetDouble());
+
+  EXPECT_NE(readFile("run.prom").find("bahamut_module_items_out{run=\"module:emit.sh\",module=\"emit.sh\""), std::string::npos);
+}
+
+TEST_F(MetricsTest, MalformedDataLinesAreNotCounted) {
+  createTestModule("modules/partial.sh", R"(#!/bin/bash
+# Provides: domain
+echo '{"bmop":"1.0","module":"partial"}'
+echo '{"t":"d","f":"domain","v":"a.com"}'
+echo '{"t":"d","f":"domain"}'
+echo '{"t":"d","v":"b.com"}'
+)");
+
+  Storage storage;
+  runModuleWithPipe("partial.sh", {}, storage, "");
+  EXPECT_EQ(storage.totalItems(), 1);
+
+  setRunReport("run.json", "");
+  runModule("partial.sh", {});
+
+  rapidjson::Document doc;
+  std::string json = readFile("run.json");
+  ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError());
+  ASSERT_EQ(doc["modules"].Size(), 1);
+  EXPECT_EQ(doc["modules"][0]["items_out"].GetUint64(), 1);
+}
+
+TEST_F(MetricsTest, TraceShowsModulePhasesAndStorageCounters) {
+  createTestModule("modules/emit.sh", R"(#!/bin/bash
+# Provides: domain
+echo '{"bmop":"1.0","module":"emit"}'
+echo '{"t":"d","f":"domain","v":"example.com"}'
+)");
+
+  setTraceFile("trace.json");
+  runModule("emit.sh", {});
+  setTraceFile("");
+  ASSERT_TRUE(fs::exists("trace.json"));
+
+  rapidjson::Document doc;
+  std::string json = readFile("trace.json");
+  ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError());
+  ASSERT_TRUE(doc["traceEvents"].IsArray());
+
+  std::set<std::string> spans;
+  std::set<std::string> tracks;
+  bool counted = false;
+  for (const auto& event : doc["traceEvents"].GetArray()) {
+    std::string phase = event["ph"].GetString();
+    if (phase == "X") {
+      spans.insert(event["name"].GetString());
+      EXPECT_GE(event["dur"].GetDouble(), 0);
+    } else if (phase == "M" && std::string(event["name"].GetString()) == "thread_name") {
+      tracks.insert(event["args"]["name"].GetString());
+    } else if (phase == "C") {
+      counted = event["args"].HasMember("domain") && event["args"]["domain"].GetDouble() == 1;
+    }
+  }
+  for (const char* name : {"emit.sh", "discover", "spawn", "stdout ingestion", "wait"}) {
+    EXPECT_TRUE(spans.count(name)) << name;
+  }
+  EXPECT_TRUE(tracks.count("emit.sh stdout"));
+  EXPECT_TRUE(counted);
+  EXPECT_FALSE(TraceRecorder::shared().enabled());
+}
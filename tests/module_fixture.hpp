@@ -0,0 +1,59 @@
+#ifndef MODULE_FIXTURE_HPP
+#define MODULE_FIXTURE_HPP
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <ctime>
+
+// Base of the suites that run modules. Each test runs in a fresh
+// bahamut_<suite>_test_<time> directory under the system temp dir, with an
+// empty modules/ in it, and is back in the original directory with that one
+// removed afterwards. Suites reset whatever global state they touched in
+// their own TearDown before calling this one.
+class ModuleFixture : public ::testing::Test {
+  protected:
+    explicit ModuleFixture(std::string suite) : suite(std::move(suite)) {}
+
+    void SetUp() override {
+      std::string timestamp = std::to_string(time(nullptr));
+      test_dir = (std::filesystem::temp_directory_path() / ("bahamut_" + suite + "_test_" + timestamp)).string();
+
+      original_cwd = std::filesystem::current_path();
+      std::filesystem::remove_all(test_dir);
+      std::filesystem::create_directories(test_dir);
+      std::filesystem::current_path(test_dir);
+      std::filesystem::create_directories("modules");
+    }
+
+    void TearDown() override {
+      std::filesystem::current_path(original_cwd);
+      std::filesystem::remove_all(test_dir);
+    }
+
+    // Writes any file under the test directory, creating its parents.
+    void createTestModule(const std::string& filename, const std::string& content) {
+      std::filesystem::path path(filename);
+      if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path());
+      std::ofstream file(filename);
+      file << content;
+      file.close();
+    }
+
+    std::string readFile(const std::string& filename) {
+      std::ifstream file(filename);
+      std::stringstream buffer;
+      buffer << file.rdbuf();
+      return buffer.str();
+    }
+
+    std::string test_dir;
+    std::string original_cwd;
+
+  private:
+    std::string suite;
+};
+
+#endif
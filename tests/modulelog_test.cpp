@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <chrono>
+#include "../core/core.hpp"
+#include "../core/modulelog.hpp"
+#include "./module_fixture.hpp"
+
+class ModuleLogTest : public ModuleFixture {
+  protected:
+    ModuleLogTest() : ModuleFixture("modulelog") {}
+
+    void SetUp() override {
+      ModuleFixture::SetUp();
+      ModuleLog::shared().begin();
+    }
+
+    void TearDown() override {
+      setModuleLogFile("");
+      ModuleFixture::TearDown();
+    }
+};
+
+TEST_F(ModuleLogTest, ParserRoutesLevelsAndPassesOtherLinesThrough) {
+  StderrParser parser("mod.py");
+  EXPECT_FALSE(parser.feed(R"({"t":"log","l":"info","m":"starting"})"));
+  EXPECT_FALSE(parser.feed(R"({"t":"log","l":"WARNING","m":"slow down"})"));
+  EXPECT_FALSE(parser.feed(R"({"t":"log","l":"debug","m":"item 42"})"));
+  EXPECT_FALSE(parser.feed(R"({"t":"progress","c":5,"T":10})"));
+  EXPECT_FALSE(parser.feed(R"({"t":"error","code":"NET","m":"timeout"})"));
+  EXPECT_FALSE(parser.feed("Traceback (most recent call last):"));
+  EXPECT_FALSE(parser.feed(R"({"t":"d","f":"domain","v":"stray.com"})"));
+  EXPECT_FALSE(parser.sawFatal());
+  EXPECT_TRUE(parser.feed(R"({"t":"error","code":"AUTH","m":"bad key","fatal":true})"));
+  EXPECT_TRUE(parser.sawFatal());
+
+  const LogCounts& seen = parser.counts();
+  EXPECT_EQ(seen[LogLevel::INFO], 1);
+  EXPECT_EQ(seen[LogLevel::WARN], 1);
+  EXPECT_EQ(seen[LogLevel::DEBUG], 1);
+  EXPECT_EQ(seen[LogLevel::ERROR], 1);
+  EXPECT_EQ(seen[LogLevel::CRITICAL], 1);
+  EXPECT_EQ(seen.progress, 1);
+  EXPECT_EQ(seen.raw, 2);
+
+  LogCounts shared = ModuleLog::shared().counts("mod.py");
+  EXPECT_EQ(shared[LogLevel::WARN], 1);
+  EXPECT_EQ(shared[LogLevel::CRITICAL], 1);
+  ModuleProgress progress = ModuleLog::shared().lastProgress("mod.py");
+  EXPECT_EQ(progress.current, 5);
+  EXPECT_EQ(progress.total, 10);
+}
+
+TEST_F(ModuleLogTest, StderrIsParsedAndWrittenToLogFile) {
+  createTestModule("modules/chatty.sh", R"(#!/bin/bash
+# Provides: domain
+echo '{"bmop":"1.0","module":"chatty"}'
+echo '{"t":"log","l":"info","m":"starting"}' >&2
+echo '{"t":"d","f":"domain","v":"a.com"}'
+echo '{"t":"log","l":"warn","m":"rate \"limited\""}' >&2
+echo '{"t":"progress","c":1,"T":1}' >&2
+echo '{"t":"error","code":"PARTIAL","m":"one source failed"}' >&2
+printf 'no newline at the end' >&2
+)");
+  ASSERT_TRUE(setModuleLogFile("logs.jsonl"));
+
+  Storage storage;
+  runModuleWithPipe("chatty.sh", {}, storage, "");
+  ASSERT_EQ(storage["domain"].size(), 1);
+
+  LogCounts counts = ModuleLog::shared().counts("chatty.sh");
+  EXPECT_EQ(counts[LogLevel::INFO], 1);
+  EXPECT_EQ(counts[LogLevel::WARN], 1);
+  EXPECT_EQ(counts[LogLevel::ERROR], 1);
+  EXPECT_EQ(counts.progress, 1);
+  EXPECT_EQ(counts.raw, 1);
+
+  setModuleLogFile("");
+  std::ifstream file("logs.jsonl");
+  std::vector<std::string> lines;
+  for (std::string line; std::getline(file, line);) lines.push_back(line);
+  ASSERT_EQ(lines.size(), 3);
+  EXPECT_NE(lines[0].find(R"("module":"chatty.sh","level":"info","m":"starting")"), std::string::npos);
+  EXPECT_NE(lines[1].find(R"("level":"warn","m":"rate \"limited\"")"), std::string::npos);
+  EXPECT_NE(lines[2].find(R"("level":"error","code":"PARTIAL")"), std::string::npos);
+}
+
+TEST_F(ModuleLogTest, FatalErrorTerminatesModule) {
+  createTestModule("modules/doomed.sh", R"(#!/bin/bash
+# Provides: domain
+echo '{"bmop":"1.0","module":"doomed"}'
+echo '{"t":"d","f":"domain","v":"before.com"}'
+echo '{"t":"error","code":"AUTH","m":"invalid key","fatal":true}' >&2
+sleep 20
+echo '{"t":"d","f":"domain","v":"after.com"}'
+)");
+
+  Storage storage;
+  auto start = std::chrono::steady_clock::now();
+  runModuleWithPipe("doomed.sh", {}, storage, "");
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  EXPECT_LT(elapsed, std::chrono::seconds(10));
+  ASSERT_EQ(storage["domain"].size(), 1);
+  EXPECT_EQ(storage["domain"][0].value, "before.com");
+  EXPECT_EQ(ModuleLog::shared().counts("doomed.sh")[LogLevel::CRITICAL], 1);
+}
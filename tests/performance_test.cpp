@@ -12,6 +12,7 @@
 #include <queue>
 #include <atomic>
 #include <future>
+#include <sys/resource.h>
 #include "../core/core.hpp"
 
 namespace fs = std::filesystem;
@@ -95,8 +96,11 @@ class PerformanceTest : public ::testing::Test {
         << " | Rate: " << (items_processed * 1000.0 / duration_ms) << " items/sec" << std::endl;
     }
 
+    // Peak RSS of the test process in KB (ru_maxrss is KB on Linux).
     long long getMemoryUsage() {
-      return 0; // Placeholder
+      struct rusage usage{};
+      getrusage(RUSAGE_SELF, &usage);
+      return usage.ru_maxrss;
     }
 
     void createTestModule(const std::string& filename, const std::string& content) {
@@ -153,7 +157,7 @@ console.log('{"t":"result","ok":true,"count":1000}');)";
 
   auto start = steady_clock::now();
 
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("basic_perf.js", {}, storage, "");
 
   auto end = steady_clock::now();
@@ -194,7 +198,7 @@ console.log(JSON.stringify({t:"batch",f:"domain",c:)" + std::to_string(test.batc
 
     auto start = steady_clock::now();
 
-    std::map<std::string, std::vector<DataItem>> storage;
+    Storage storage;
     runModuleWithPipe("batch_perf_" + std::to_string(test.batch_size) + ".js", {}, storage, "");
 
     auto end = steady_clock::now();
@@ -243,7 +247,7 @@ process.stdin.on('end', () => {
 
     createTestModule("modules/node_large_" + std::to_string(size) + ".js", content);
 
-    std::map<std::string, std::vector<DataItem>> input_storage;
+    Storage input_storage;
     auto domains = generateRandomDomains(size);
     for (const auto& domain : domains) {
       DataItem item;
@@ -254,7 +258,7 @@ process.stdin.on('end', () => {
 
 auto start = steady_clock::now();
 
-std::map<std::string, std::vector<DataItem>> output_storage;
+Storage output_storage;
 runModuleWithPipe("node_large_" + std::to_string(size) + ".js", {}, 
     output_storage, "domain");
 
@@ -295,7 +299,7 @@ auto start = steady_clock::now();
 std::vector<std::future<void>> futures;
 for (int i = 0; i < num_modules; i++) {
   futures.push_back(std::async(std::launch::async, [i, this]() {
-        std::map<std::string, std::vector<DataItem>> storage;
+        Storage storage;
         runModuleWithPipe("concurrent_" + std::to_string(i) + ".js", {}, storage, "");
         }));
 }
@@ -391,7 +395,7 @@ process.stdin.on('end', () => {
 
   auto start = steady_clock::now();
 
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   runModuleWithPipe("collector.js", {}, storage, "");
   runModuleWithPipe("processor.js", {}, storage, "raw_data");
@@ -446,7 +450,7 @@ createTestModule("modules/bmop_parser_" + std::to_string(count) + ".js", content
 
 auto start = steady_clock::now();
 
-std::map<std::string, std::vector<DataItem>> storage;
+Storage storage;
 runModuleWithPipe("bmop_parser_" + std::to_string(count) + ".js", {}, storage, "");
 
 auto end = steady_clock::now();
@@ -482,7 +486,7 @@ console.log(JSON.stringify({t:"batch",f:"mixed_data",c:)" + std::to_string(data_
 
   auto start = steady_clock::now();
 
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("memory_test.js", {}, storage, "");
 
   auto end = steady_clock::now();
@@ -557,7 +561,7 @@ print(json.dumps({"t":"batch","f":"python_data","c":)" + std::to_string(data_siz
   createTestModule("modules/python_perf.py", python_content);
 
   auto node_start = steady_clock::now();
-  std::map<std::string, std::vector<DataItem>> node_storage;
+  Storage node_storage;
   runModuleWithPipe("node_perf.js", {}, node_storage, "");
   auto node_end = steady_clock::now();
   auto node_duration = duration_cast<milliseconds>(node_end - node_start).count();
@@ -565,7 +569,7 @@ print(json.dumps({"t":"batch","f":"python_data","c":)" + std::to_string(data_siz
   addPerfLog("NodeJS_Perf", node_duration, data_size);
 
   auto python_start = steady_clock::now();
-  std::map<std::string, std::vector<DataItem>> python_storage;
+  Storage python_storage;
   runModuleWithPipe("python_perf.py", {}, python_storage, "");
   auto python_end = steady_clock::now();
   auto python_duration = duration_cast<milliseconds>(python_end - python_start).count();
@@ -618,7 +622,7 @@ process.stdin.on('end', () => {
 
     createTestModule("modules/storage_" + behavior + ".js", content);
 
-    std::map<std::string, std::vector<DataItem>> storage;
+    Storage storage;
     for (int i = 0; i < data_size; i++) {
       DataItem item;
       item.format = "test_data";
@@ -772,7 +776,7 @@ process.stdin.on('end', () => {
 
   auto start = steady_clock::now();
 
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
 
   runModuleWithPipe("generator.js", {}, storage, "");
   runModuleWithPipe("filter.js", {}, storage, "raw_numbers");
@@ -825,7 +829,7 @@ const formats = )" + formats_array + R"(;
 
     auto start = steady_clock::now();
 
-    std::map<std::string, std::vector<DataItem>> storage;
+    Storage storage;
     runModuleWithPipe("multi_format.js", {}, storage, "");
 
     auto end = steady_clock::now();
@@ -919,7 +923,7 @@ createTestModule("modules/regression_baseline.js", content);
 
 auto start_time = steady_clock::now();
 
-std::map<std::string, std::vector<DataItem>> storage;
+Storage storage;
 runModuleWithPipe("regression_baseline.js", {}, storage, "");
 
 auto end_time = steady_clock::now();
@@ -959,7 +963,7 @@ console.log(JSON.stringify({t:"batch",f:"worker_output",c:)" + std::to_string(it
   std::vector<std::future<void>> futures;
   for (int i = 0; i < num_workers; i++) {
     futures.push_back(std::async(std::launch::async, [i, this]() {
-          std::map<std::string, std::vector<DataItem>> storage;
+          Storage storage;
           runModuleWithPipe("worker_" + std::to_string(i) + ".js", {}, storage, "");
           }));
   }
@@ -997,7 +1001,7 @@ console.log('{"t":"result","ok":true,"count":1000}');)";
 
   auto start = steady_clock::now();
 
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("uuid_generator.js", {}, storage, "");
 
   auto end = steady_clock::now();
@@ -1051,7 +1055,7 @@ process.stdin.on('end', () => {
 
 createTestModule("modules/network_sim_" + std::to_string(delay) + ".js", content);
 
-std::map<std::string, std::vector<DataItem>> storage;
+Storage storage;
 for (int i = 0; i < 100; i++) {
   DataItem item;
   item.format = "input_data";
@@ -1120,7 +1124,7 @@ process.stdin.on('end', () => {
 
   createTestModule("modules/cache_test.js", content);
 
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   for (int i = 0; i < data_size; i++) {
     DataItem item;
     item.format = "cache_input";
@@ -1177,7 +1181,7 @@ console.log(JSON.stringify({t:"result","ok":true,"count":)" +
 
     auto start = steady_clock::now();
 
-    std::map<std::string, std::vector<DataItem>> storage;
+    Storage storage;
     runModuleWithPipe("memory_leak_test.js", {}, storage, "");
 
     auto end = steady_clock::now();
@@ -1217,7 +1221,7 @@ console.log('{"t":"result","ok":true,"count":5000}');)";
 
       auto start = steady_clock::now();
 
-      std::map<std::string, std::vector<DataItem>> storage;
+      Storage storage;
       runModuleWithPipe("system_load_test.js", {}, storage, "");
 
       auto end = steady_clock::now();
@@ -1250,7 +1254,7 @@ console.log('{"t":"result","ok":true,"count":100}');)";
                                          createTestModule("modules/bench_small.js", content);
 
                                          auto start = steady_clock::now();
-                                         std::map<std::string, std::vector<DataItem>> storage;
+                                         Storage storage;
                                          runModuleWithPipe("bench_small.js", {}, storage, "");
                                          auto end = steady_clock::now();
 
@@ -1270,7 +1274,7 @@ console.log('{"t":"result","ok":true,"count":5000}');)";
   createTestModule("modules/bench_medium.js", content);
 
   auto start = steady_clock::now();
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("bench_medium.js", {}, storage, "");
   auto end = steady_clock::now();
 
@@ -1290,7 +1294,7 @@ console.log('{"t":"result","ok":true,"count":50000}');)";
   createTestModule("modules/bench_large.js", content);
 
   auto start = steady_clock::now();
-  std::map<std::string, std::vector<DataItem>> storage;
+  Storage storage;
   runModuleWithPipe("bench_large.js", {}, storage, "");
   auto end = steady_clock::now();
 
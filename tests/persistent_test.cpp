@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include "../core/core.hpp"
+#include "../core/metadata.hpp"
+#include "../core/workerpool.hpp"
+#include "./module_fixture.hpp"
+
+class PersistentTest : public ModuleFixture {
+  protected:
+    PersistentTest() : ModuleFixture("persistent") {}
+
+    void TearDown() override {
+      shutdownPersistentWorkers();
+      ModuleFixture::TearDown();
+    }
+
+    // "<pid>:<value>" items the modules below produce.
+    static std::string_view pidOf(std::string_view item) {
+      return item.substr(0, item.find(':'));
+    }
+};
+
+TEST_F(PersistentTest, DirectiveIsParsed) {
+  EXPECT_TRUE(compileModuleMetadata("#!/usr/bin/env node\n// Persistent: true\n").persistent);
+  EXPECT_FALSE(compileModuleMetadata("#!/usr/bin/env node\n// Persistent: false\n").persistent);
+  EXPECT_FALSE(compileModuleMetadata("#!/usr/bin/env node\n// Provides: domain\n").persistent);
+}
+
+TEST_F(PersistentTest, WarmWorkerHandlesSuccessiveJobs) {
+  createTestModule("modules/warm.sh", R"(#!/bin/bash
+# Consumes: domain
+# Provides: seen
+# Persistent: true
+echo '{"bmop":"1.0","module":"warm"}'
+while read -r line; do
+  case "$line" in
+    *'"t":"job_end"'*) echo '{"t":"job_done"}' ;;
+    *'"t":"d"'*) v=${line#*\"v\":\"}; echo "{\"t\":\"d\",\"f\":\"seen\",\"v\":\"$$:${v%\"\}}\"}" ;;
+  esac
+done
+)");
+
+  Storage first;
+  first.append("domain", "a.com");
+  first.append("domain", "b.com");
+  runModuleWithPipe("warm.sh", {}, first, "domain");
+  ASSERT_EQ(first["seen"].size(), 2);
+  EXPECT_EQ(WorkerPool::shared().idle(), 1);
+
+  Storage second;
+  second.append("domain", "c.com");
+  runModuleWithPipe("warm.sh", {}, second, "domain");
+  ASSERT_EQ(second["seen"].size(), 1);
+  EXPECT_EQ(second["seen"][0].value.substr(second["seen"][0].value.find(':') + 1), "c.com");
+  EXPECT_EQ(pidOf(second["seen"][0].value), pidOf(first["seen"][0].value));
+
+  shutdownPersistentWorkers();
+  EXPECT_EQ(WorkerPool::shared().idle(), 0);
+}
+
+TEST_F(PersistentTest, WorkerThatExitsIsReplaced) {
+  // Answers one job, then quits without saying so.
+  createTestModule("modules/once.sh", R"(#!/bin/bash
+# Provides: seen
+# Persistent: true
+echo '{"bmop":"1.0","module":"once"}'
+read -r job
+echo "{\"t\":\"d\",\"f\":\"seen\",\"v\":\"$$:$BMOP_PERSISTENT\"}"
+)");
+
+  Storage first;
+  runModuleWithPipe("once.sh", {}, first, "");
+  ASSERT_EQ(first["seen"].size(), 1);
+  EXPECT_EQ(first["seen"][0].value.substr(first["seen"][0].value.find(':') + 1), "1");
+  EXPECT_EQ(WorkerPool::shared().idle(), 0);
+
+  Storage second;
+  runModuleWithPipe("once.sh", {}, second, "");
+  ASSERT_EQ(second["seen"].size(), 1);
+  EXPECT_NE(pidOf(second["seen"][0].value), pidOf(first["seen"][0].value));
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include "../core/core.hpp"
+#include "../core/metadata.hpp"
+#include "../core/ratelimit.hpp"
+#include "./module_fixture.hpp"
+
+class RateLimitTest : public ModuleFixture {
+  protected:
+    RateLimitTest() : ModuleFixture("ratelimit") {}
+
+    void TearDown() override {
+      RateLimiter::shared().reset();
+      ModuleFixture::TearDown();
+    }
+};
+
+TEST_F(RateLimitTest, BucketPacesReservationsInOrder) {
+  using namespace std::chrono_literals;
+  auto start = TokenBucket::Clock::now();
+  TokenBucket bucket(10, start);
+
+  // One second's worth goes at once, then one token every 100ms.
+  for (int i = 0; i < 10; ++i) EXPECT_EQ(bucket.reserve(1, start), start);
+  EXPECT_EQ(bucket.reserve(1, start), start + 100ms);
+  EXPECT_EQ(bucket.reserve(1, start), start + 200ms);
+
+  bucket.backoff(start);
+  EXPECT_DOUBLE_EQ(bucket.rate(), 5);
+  EXPECT_EQ(bucket.reserve(1, start), start + 600ms);
+
+  // Recovers towards the ceiling once nobody complains.
+  bucket.reserve(0, start + 10s);
+  EXPECT_DOUBLE_EQ(bucket.rate(), 10);
+}
+
+TEST_F(RateLimitTest, ParsesSpecsAndDirectives) {
+  std::string bucket;
+  double rate = 0;
+  ASSERT_TRUE(parseRateLimitSpec("crt.sh=2.5", bucket, rate));
+  EXPECT_EQ(bucket, "crt.sh");
+  EXPECT_DOUBLE_EQ(rate, 2.5);
+  EXPECT_FALSE(parseRateLimitSpec("dns", bucket, rate));
+  EXPECT_FALSE(parseRateLimitSpec("dns=0", bucket, rate));
+  EXPECT_FALSE(setRateLimits("dns=100,oops"));
+  EXPECT_FALSE(RateLimiter::shared().anyConfigured());
+
+  ModuleMetadata shared = compileModuleMetadata("#!/usr/bin/env node\n// RateLimit: dns 200\n");
+  EXPECT_EQ(shared.rateLimit, 200);
+  EXPECT_EQ(shared.rateLimitKey, "dns");
+  ModuleMetadata own = compileModuleMetadata("#!/usr/bin/env node\n// RateLimit: 50\n");
+  EXPECT_EQ(own.rateLimit, 50);
+  EXPECT_EQ(own.rateLimitKey, "");
+}
+
+TEST_F(RateLimitTest, WorkersShareOneBucket) {
+  createTestModule("modules/paced.sh", R"(#!/bin/bash
+# Consumes: domain
+# Provides: checked
+# Parallel: 2
+# RateLimit: ratelimit-test 20
+echo '{"bmop":"1.0","module":"paced"}'
+while read -r line; do
+  case "$line" in *'"t":"d"'*) ;; *) continue ;; esac
+  echo '{"t":"acquire","id":1}' >&$BMOP_RATELIMIT_FD
+  read -r grant <&$BMOP_RATELIMIT_FD
+  echo '{"t":"d","f":"checked","v":"ok"}'
+done
+)");
+
+  Storage storage;
+  for (int i = 0; i < 40; ++i) storage.append("domain", "host" + std::to_string(i) + ".com");
+
+  auto start = std::chrono::steady_clock::now();
+  runModuleWithPipe("paced.sh", {}, storage, "domain");
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  // 20 at once, the other 20 at 20/s across both workers, not per worker.
+  EXPECT_EQ(storage["checked"].size(), 40);
+  EXPECT_GE(elapsed, std::chrono::milliseconds(900));
+  EXPECT_DOUBLE_EQ(RateLimiter::shared().rate("ratelimit-test"), 20);
+}
+
+TEST_F(RateLimitTest, PinnedRateOverridesDeclaration) {
+  ASSERT_TRUE(setRateLimits("ratelimit-test=1000, other=5"));
+  RateLimiter::shared().declare("ratelimit-test", 20);
+  EXPECT_DOUBLE_EQ(RateLimiter::shared().rate("ratelimit-test"), 1000);
+  EXPECT_DOUBLE_EQ(RateLimiter::shared().rate("other"), 5);
+  EXPECT_DOUBLE_EQ(RateLimiter::shared().rate("unknown"), 0);
+}
+
+TEST_F(RateLimitTest, LinesBeforeEofAreStillHandled) {
+  int childFd = -1;
+  int connection = RateLimiter::shared().connect("ratelimit-test", childFd);
+  ASSERT_GE(connection, 0);
+
+  // A worker's last words: written, then it exits.
+  std::string last = "{\"t\":\"acquire\",\"id\":1,\"n\":3}\n{\"t\":\"backoff\"}\n";
+  ASSERT_EQ(write(childFd, last.data(), last.size()), static_cast<ssize_t>(last.size()));
+  close(childFd);
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (RateLimiter::shared().usage(connection).granted == 0 && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(RateLimiter::shared().disconnect(connection).granted, 3);
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include "../core/core.hpp"
+#include "../core/registry.hpp"
+#include "./module_fixture.hpp"
+
+namespace fs = std::filesystem;
+
+class RegistryTest : public ModuleFixture {
+  protected:
+    RegistryTest() : ModuleFixture("registry") {}
+};
+
+TEST_F(RegistryTest, IndexesModulesAndPrunesDependencyTrees) {
+  createTestModule("modules/collectors/getdomains.py", "#!/usr/bin/env python3\n# Provides: domain\n");
+  createTestModule("modules/filters/filter.js", "#!/usr/bin/env node\n// Consumes: domain\n// Stage: 2\n");
+  createTestModule("modules/filters/node_modules/dep/index.js", "module.exports = {};\n");
+  createTestModule("modules/shared_deps/python_libs/lib.py", "\n");
+  createTestModule("modules/filters/README.md", "docs\n");
+
+  ModuleRegistry registry("./modules", "./cache/modules.json");
+  std::vector<std::string> names = registry.names();
+  std::sort(names.begin(), names.end());
+  EXPECT_EQ(names, std::vector<std::string>({"filter.js", "getdomains.py"}));
+
+  ModuleEntry entry;
+  ASSERT_TRUE(registry.lookup("filter.js", entry));
+  EXPECT_EQ(fs::path(entry.path), fs::path("./modules/filters/filter.js"));
+  EXPECT_EQ(entry.meta.consumes, "domain");
+  EXPECT_EQ(entry.meta.stage, 2);
+  EXPECT_FALSE(registry.lookup("index.js", entry));
+}
+
+TEST_F(RegistryTest, ReusesPersistedIndexUntilTreeChanges) {
+  createTestModule("modules/a/first.js", "// Provides: domain\n");
+
+  {
+    ModuleRegistry registry("./modules", "./cache/modules.json");
+    EXPECT_EQ(registry.names().size(), 1);
+  }
+  ASSERT_TRUE(fs::exists("cache/modules.json"));
+
+  // The next run loads the cache; a module added in a new directory shows
+  // up through the mtime of its parent.
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  createTestModule("modules/b/second.py", "# Provides: ip\n");
+
+  ModuleRegistry registry("./modules", "./cache/modules.json");
+  ModuleEntry entry;
+  EXPECT_TRUE(registry.lookup("first.js", entry));
+  ASSERT_TRUE(registry.lookup("second.py", entry));
+  EXPECT_EQ(entry.meta.provides, "ip");
+}
+
+TEST_F(RegistryTest, RereadsMetadataOfEditedModule) {
+  createTestModule("modules/mod.js", "// Provides: domain\n");
+
+  ModuleRegistry registry("./modules", "./cache/modules.json");
+  ModuleEntry entry;
+  ASSERT_TRUE(registry.lookup("mod.js", entry));
+  EXPECT_EQ(entry.meta.provides, "domain");
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  createTestModule("modules/mod.js", "// Provides: subdomain\n// Parallel: 2\n");
+
+  ASSERT_TRUE(registry.lookup("mod.js", entry));
+  EXPECT_EQ(entry.meta.provides, "subdomain");
+  EXPECT_EQ(entry.meta.parallel, 2);
+
+  // The cache written for the next run carries the new metadata too.
+  ModuleRegistry nextRun("./modules", "./cache/modules.json");
+  ASSERT_TRUE(nextRun.lookup("mod.js", entry));
+  EXPECT_EQ(entry.meta.provides, "subdomain");
+}
+
+TEST_F(RegistryTest, IgnoresCorruptCache) {
+  createTestModule("modules/mod.sh", "# Provides: file\n");
+  fs::create_directories("cache");
+  std::ofstream("cache/modules.json") << "{not json";
+
+  ModuleRegistry registry("./modules", "./cache/modules.json");
+  ModuleEntry entry;
+  ASSERT_TRUE(registry.lookup("mod.sh", entry));
+  EXPECT_EQ(entry.meta.provides, "file");
+}
@@ -0,0 +1,269 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <atomic>
+#include "../core/core.hpp"
+#include "../core/scheduler.hpp"
+#include "./module_fixture.hpp"
+
+class SchedulerTest : public ModuleFixture {
+  protected:
+    SchedulerTest() : ModuleFixture("scheduler") {}
+
+    static ScheduledModule makeModule(const std::string& name, const std::string& consumes,
+        const std::string& provides, const std::string& behavior = "add") {
+      ScheduledModule module;
+      module.moduleName = name;
+      module.meta.consumes = consumes;
+      module.meta.provides = provides;
+      module.meta.storageBehavior = behavior;
+      return module;
+    }
+};
+
+TEST_F(SchedulerTest, BuildsHazardEdgesInProgramOrder) {
+  ModuleScheduler scheduler(4);
+  size_t domains = scheduler.add(makeModule("domains", "", "domain"));
+  size_t proxies = scheduler.add(makeModule("proxies", "", "httpproxy"));
+  size_t filterDomains = scheduler.add(makeModule("filterDomains", "domain", "domain", "replace"));
+  size_t filterProxies = scheduler.add(makeModule("filterProxies", "httpproxy", "httpproxy", "replace"));
+  size_t exporter = scheduler.add(makeModule("exporter", "*", "file", "delete"));
+  size_t unknown = scheduler.add(makeModule("unknown", "", ""));
+
+  EXPECT_TRUE(scheduler.dependencies(domains).empty());
+  EXPECT_TRUE(scheduler.dependencies(proxies).empty());
+  EXPECT_EQ(scheduler.dependencies(filterDomains), std::vector<size_t>({domains}));
+  EXPECT_EQ(scheduler.dependencies(filterProxies), std::vector<size_t>({proxies}));
+  EXPECT_EQ(scheduler.dependencies(exporter),
+      std::vector<size_t>({domains, proxies, filterDomains, filterProxies}));
+  // No Provides: it may write anything, so it orders after every writer and reader.
+  EXPECT_EQ(scheduler.dependencies(unknown),
+      std::vector<size_t>({domains, proxies, filterDomains, filterProxies, exporter}));
+}
+
+TEST_F(SchedulerTest, RunsIndependentModulesConcurrently) {
+  ModuleScheduler scheduler(4);
+  scheduler.add(makeModule("a", "", "domain"));
+  scheduler.add(makeModule("b", "", "httpproxy"));
+  scheduler.add(makeModule("c", "domain", "domain", "replace"));
+
+  std::mutex mutex;
+  std::map<std::string, std::pair<double, double>> spans;
+  auto origin = std::chrono::steady_clock::now();
+  auto now = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin).count(); };
+
+  scheduler.run([&](const ScheduledModule& module) {
+    double start = now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::lock_guard<std::mutex> guard(mutex);
+    spans[module.moduleName] = {start, now()};
+  });
+
+  ASSERT_EQ(spans.size(), 3u);
+  EXPECT_LT(spans["b"].first, spans["a"].second);
+  EXPECT_GE(spans["c"].first, spans["a"].second);
+  EXPECT_LT(now(), 0.6);
+}
+
+TEST_F(SchedulerTest, SingleJobRunsInProgramOrder) {
+  ModuleScheduler scheduler(1);
+  scheduler.add(makeModule("first", "", "a"));
+  scheduler.add(makeModule("second", "", "b"));
+  scheduler.add(makeModule("third", "", "c"));
+
+  std::vector<std::string> order;
+  scheduler.run([&](const ScheduledModule& module) { order.push_back(module.moduleName); });
+  EXPECT_EQ(order, std::vector<std::string>({"first", "second", "third"}));
+}
+
+TEST_F(SchedulerTest, ParallelPipelineKeepsStorageSemantics) {
+  createTestModule("modules/domains.js", R"(#!/usr/bin/env node
+// Provides: domain
+console.log(JSON.stringify({bmop:"1.0",module:"domains"}));
+setTimeout(() => {
+  for (let i = 0; i < 100; i++) console.log(JSON.stringify({t:"d",f:"domain",v:"host" + i + ".com"}));
+}, 800);
+)");
+  createTestModule("modules/proxies.js", R"(#!/usr/bin/env node
+// Provides: httpproxy
+console.log(JSON.stringify({bmop:"1.0",module:"proxies"}));
+setTimeout(() => {
+  for (let i = 0; i < 50; i++) console.log(JSON.stringify({t:"d",f:"httpproxy",v:"10.0.0." + i + ":8080"}));
+}, 800);
+)");
+  createTestModule("modules/evens.js", R"(#!/usr/bin/env node
+// Consumes: domain
+// Provides: domain
+// Storage: replace
+console.log(JSON.stringify({bmop:"1.0",module:"evens"}));
+const rl = require('readline').createInterface({ input: process.stdin });
+rl.on('line', (line) => {
+  const msg = JSON.parse(line);
+  const n = parseInt(msg.v.replace(/\D/g, ''));
+  if (n % 2 === 0) console.log(JSON.stringify({t:"d",f:"domain",v:msg.v}));
+});
+)");
+
+  ModuleScheduler scheduler(3);
+  for (const auto& name : {"domains.js", "proxies.js", "evens.js"}) {
+    ScheduledModule module;
+    module.moduleName = name;
+    module.meta = parseModuleMetadata(findModulePath(name));
+    scheduler.add(module);
+  }
+
+  Storage storage;
+  auto start = std::chrono::steady_clock::now();
+  testing::internal::CaptureStdout();
+  scheduler.run([&storage](const ScheduledModule& module) {
+    runModuleWithPipe(module.moduleName, module.args, storage, module.meta.consumes);
+  });
+  testing::internal::GetCapturedStdout();
+  double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  ASSERT_EQ(storage["domain"].size(), 50);
+  EXPECT_EQ(storage["domain"][0].value, "host0.com");
+  EXPECT_EQ(storage["httpproxy"].size(), 50);
+  // The two collectors sleep 800ms each; back to back they would need over 1.6s.
+  EXPECT_LT(elapsed, 1.5);
+}
+
+TEST_F(SchedulerTest, StreamingOnlyRelaxesAppendOnlyWriters) {
+  ModuleScheduler scheduler(4, true);
+  size_t domains = scheduler.add(makeModule("domains", "", "domain"));
+  size_t filter = scheduler.add(makeModule("filter", "domain", "domain", "replace"));
+  size_t resolver = scheduler.add(makeModule("resolver", "domain", "ip"));
+  size_t exporter = scheduler.add(makeModule("exporter", "*", "file"));
+
+  EXPECT_TRUE(scheduler.dependencies(filter).empty());
+  EXPECT_EQ(scheduler.streamDependencies(filter), std::vector<size_t>({domains}));
+  // The filter's result only exists once it exits.
+  EXPECT_EQ(scheduler.dependencies(resolver), std::vector<size_t>({domains, filter}));
+  EXPECT_TRUE(scheduler.streamDependencies(resolver).empty());
+  EXPECT_EQ(scheduler.dependencies(exporter), std::vector<size_t>({domains, filter, resolver}));
+  EXPECT_TRUE(scheduler.streamDependencies(exporter).empty());
+}
+
+TEST_F(SchedulerTest, ParallelConsumersAreNotStreamed) {
+  ModuleScheduler scheduler(4, true);
+  size_t domains = scheduler.add(makeModule("domains", "", "domain"));
+  ScheduledModule sharded = makeModule("sharded", "domain", "ip");
+  sharded.meta.parallel = 4;
+  size_t resolver = scheduler.add(sharded);
+
+  // It splits its input up front, so it needs all of it first.
+  EXPECT_EQ(scheduler.dependencies(resolver), std::vector<size_t>({domains}));
+  EXPECT_TRUE(scheduler.streamDependencies(resolver).empty());
+}
+
+TEST_F(SchedulerTest, StreamChannelAppliesBackpressureOnceAttached) {
+  StreamChannel channel("domain", 1, 64);
+  Storage batch;
+  for (int i = 0; i < 3; i++) batch.append("domain", "host" + std::to_string(i) + ".example.com");
+  channel.push(batch);
+
+  Storage other;
+  other.append("ip", "10.0.0.1");
+  EXPECT_FALSE(channel.accepts("ip"));
+  EXPECT_TRUE(channel.accepts("domain"));
+
+  ASSERT_TRUE(channel.attach());
+  Storage fill;
+  fill.append("domain", "fill.example.com");
+  channel.push(fill);
+
+  std::atomic<bool> pushed{false};
+  std::thread producer([&]() {
+    Storage more;
+    more.append("domain", "late.example.com");
+    channel.push(more);
+    pushed = true;
+    channel.producerDone();
+  });
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_FALSE(pushed);
+
+  Storage taken;
+  ASSERT_TRUE(channel.take(taken));
+  EXPECT_EQ(taken["domain"].size(), 4);
+  producer.join();
+  EXPECT_TRUE(pushed);
+
+  ASSERT_TRUE(channel.take(taken));
+  EXPECT_EQ(taken["domain"].size(), 1);
+  EXPECT_TRUE(channel.finished());
+}
+
+TEST_F(SchedulerTest, StreamChannelStaysBoundedUntilConsumerStarts) {
+  StreamChannel channel("domain", 1, 64);
+  for (int i = 0; i < 1000; i++) {
+    Storage batch;
+    batch.append("domain", "host" + std::to_string(i) + ".example.com");
+    channel.push(batch);
+    ASSERT_LE(channel.queuedBytes(), 64u);
+  }
+  channel.producerDone();
+
+  // A late consumer is turned away and reads storage instead.
+  EXPECT_FALSE(channel.attach());
+  Storage taken;
+  EXPECT_FALSE(channel.take(taken));
+  EXPECT_TRUE(channel.finished());
+}
+
+TEST_F(SchedulerTest, StreamingConsumerStartsBeforeProducerExits) {
+  createTestModule("modules/slowdomains.js", R"(#!/usr/bin/env node
+// Provides: domain
+console.log(JSON.stringify({bmop:"1.0",module:"slowdomains"}));
+let i = 0;
+const timer = setInterval(() => {
+  console.log(JSON.stringify({t:"d",f:"domain",v:"host" + i + ".com"}));
+  if (++i === 5) {
+    clearInterval(timer);
+    console.log(JSON.stringify({t:"d",f:"done",v:String(Date.now())}));
+  }
+}, 200);
+)");
+  createTestModule("modules/stamp.js", R"(#!/usr/bin/env node
+// Consumes: domain
+// Provides: domain
+// Storage: replace
+console.log(JSON.stringify({bmop:"1.0",module:"stamp"}));
+const rl = require('readline').createInterface({ input: process.stdin });
+rl.on('line', (line) => {
+  const msg = JSON.parse(line);
+  console.log(JSON.stringify({t:"d",f:"domain",v:msg.v}));
+  console.log(JSON.stringify({t:"d",f:"seen",v:String(Date.now())}));
+});
+)");
+
+  Storage storage;
+  storage.append("domain", "seed.com");
+
+  ModuleScheduler scheduler(1, true);
+  for (const auto& name : {"slowdomains.js", "stamp.js"}) {
+    ScheduledModule module;
+    module.moduleName = name;
+    module.meta = parseModuleMetadata(findModulePath(name));
+    scheduler.add(module);
+  }
+
+  testing::internal::CaptureStdout();
+  scheduler.run([&storage](const ScheduledModule& module) {
+    runModuleWithPipe(module.moduleName, module.args, storage, module.meta.consumes, &module.streams);
+  });
+  testing::internal::GetCapturedStdout();
+
+  // Every item exactly once: the seed from storage, the rest from the channel.
+  ASSERT_EQ(storage["domain"].size(), 6);
+  EXPECT_EQ(storage["domain"][0].value, "seed.com");
+  EXPECT_EQ(storage["domain"][5].value, "host4.com");
+  ASSERT_EQ(storage["seen"].size(), 6);
+  ASSERT_EQ(storage["done"].size(), 1);
+  long long producerDone = std::stoll(std::string(storage["done"][0].value));
+  long long firstSeen = std::stoll(std::string(storage["seen"][1].value));
+  EXPECT_LT(firstSeen, producerDone);
+}
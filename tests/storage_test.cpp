@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include "../core/core.hpp"
+
+TEST(StorageTest, InternReturnsStableIds) {
+  Storage storage;
+
+  FormatId domain = storage.intern("domain");
+  FormatId url = storage.intern("url");
+
+  EXPECT_NE(domain, url);
+  EXPECT_EQ(storage.intern("domain"), domain);
+
+  // Interning alone does not make a format visible
+  EXPECT_TRUE(storage.empty());
+  EXPECT_EQ(storage.count("domain"), 0);
+
+  EXPECT_EQ(storage.column(domain).name(), "domain");
+  EXPECT_EQ(storage.count("domain"), 1);
+}
+
+TEST(StorageTest, AppendAndReadBack) {
+  Storage storage;
+  FormatId id = storage.intern("domain");
+
+  storage.append(id, "example.com");
+  storage.append("domain", "test.com");
+  storage["domain"].push_back(DataItem{"domain", "another.com"});
+
+  ASSERT_EQ(storage["domain"].size(), 3);
+  EXPECT_EQ(storage["domain"][0].value, "example.com");
+  EXPECT_EQ(storage["domain"][1].value, "test.com");
+  EXPECT_EQ(storage["domain"][2].value, "another.com");
+  EXPECT_EQ(storage["domain"][2].format, "domain");
+  EXPECT_EQ(storage["domain"].bytes(), std::string("example.comtest.comanother.com").size());
+}
+
+TEST(StorageTest, EmptyAndBinaryValues) {
+  Storage storage;
+  std::string binary("a\0b\nc", 5);
+
+  storage.append("raw", "");
+  storage.append("raw", binary);
+
+  ASSERT_EQ(storage["raw"].size(), 2);
+  EXPECT_TRUE(storage["raw"][0].value.empty());
+  EXPECT_EQ(storage["raw"][1].value, binary);
+}
+
+TEST(StorageTest, IterationIsOrderedByFormatName) {
+  Storage storage;
+  storage.append("url", "https://a.com");
+  storage.append("domain", "a.com");
+  storage.append("ip", "1.1.1.1");
+
+  std::vector<std::string> formats;
+  for (const auto& [format, items] : storage) {
+    formats.push_back(format);
+    EXPECT_EQ(items.size(), 1);
+  }
+
+  EXPECT_EQ(formats, (std::vector<std::string>{"domain", "ip", "url"}));
+}
+
+TEST(StorageTest, EraseHidesFormatAndKeepsId) {
+  Storage storage;
+  FormatId id = storage.intern("domain");
+  storage.append(id, "a.com");
+  storage.append("url", "https://a.com");
+
+  EXPECT_EQ(storage.erase("domain"), 1);
+  EXPECT_EQ(storage.erase("domain"), 0);
+  EXPECT_EQ(storage.size(), 1);
+  EXPECT_TRUE(storage.find("domain") == storage.end());
+  EXPECT_EQ(storage.find("url")->second.size(), 1);
+
+  storage.append(id, "b.com");
+  EXPECT_EQ(storage.intern("domain"), id);
+  EXPECT_EQ(storage.size(), 2);
+  EXPECT_EQ(storage["domain"].size(), 1);
+  EXPECT_EQ(storage["domain"][0].value, "b.com");
+}
+
+TEST(StorageTest, ColumnAppendCopiesValues) {
+  Storage staging;
+  Storage storage;
+
+  staging.append("domain", "new1.com");
+  staging.append("domain", "new2.com");
+  storage.append("domain", "old.com");
+
+  storage["domain"].append(staging["domain"]);
+
+  ASSERT_EQ(storage["domain"].size(), 3);
+  EXPECT_EQ(storage["domain"][0].value, "old.com");
+  EXPECT_EQ(storage["domain"][1].value, "new1.com");
+  EXPECT_EQ(storage["domain"][2].value, "new2.com");
+  EXPECT_EQ(storage.totalItems(), 3);
+}
+
+TEST(StorageTest, LargeColumn) {
+  Storage storage;
+  FormatId id = storage.intern("subdomain");
+  const int TOTAL = 100000;
+
+  for (int i = 0; i < TOTAL; i++) {
+    storage.append(id, "host" + std::to_string(i) + ".example.com");
+  }
+
+  ASSERT_EQ(storage["subdomain"].size(), TOTAL);
+  EXPECT_EQ(storage["subdomain"][0].value, "host0.example.com");
+  EXPECT_EQ(storage["subdomain"][TOTAL - 1].value, "host99999.example.com");
+
+  size_t seen = 0;
+  for (const auto& item : storage["subdomain"]) {
+    EXPECT_FALSE(item.value.empty());
+    seen++;
+  }
+  EXPECT_EQ(seen, TOTAL);
+}
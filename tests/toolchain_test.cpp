@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <filesystem>
+#include <cstdlib>
+#include "../core/toolchain.hpp"
+#include "./module_fixture.hpp"
+
+namespace fs = std::filesystem;
+
+class ToolchainTest : public ModuleFixture {
+  protected:
+    ToolchainTest() : ModuleFixture("toolchain") {}
+
+    void SetUp() override {
+      ModuleFixture::SetUp();
+      fs::create_directories("bin");
+
+      // A stand-in interpreter that counts how often it is probed.
+      std::ofstream script("bin/fakepython");
+      script << "#!/bin/sh\necho probe >> " << test_dir << "/probes\necho 3.99.1\necho True\necho /opt/site\n";
+      script.close();
+      fs::permissions("bin/fakepython", fs::perms::owner_all);
+
+      original_path = std::getenv("PATH");
+      setenv("PATH", (test_dir + "/bin:" + original_path).c_str(), 1);
+    }
+
+    void TearDown() override {
+      setenv("PATH", original_path.c_str(), 1);
+      ModuleFixture::TearDown();
+    }
+
+    size_t probes() {
+      std::ifstream file("probes");
+      size_t count = 0;
+      std::string line;
+      while (std::getline(file, line)) ++count;
+      return count;
+    }
+
+    std::string original_path;
+};
+
+TEST_F(ToolchainTest, ProbesOncePerBinary) {
+  ToolchainCache cache("cache/toolchains.json");
+  Toolchain python;
+  ASSERT_TRUE(cache.python("fakepython", python));
+  EXPECT_EQ(python.path, test_dir + "/bin/fakepython");
+  EXPECT_EQ(python.version, "3.99.1");
+  EXPECT_TRUE(python.pip);
+  EXPECT_EQ(python.modulesRoot, "/opt/site");
+
+  ASSERT_TRUE(cache.python("fakepython", python));
+  EXPECT_EQ(probes(), 1);
+
+  // The next run reads it back instead of probing.
+  ToolchainCache nextRun("cache/toolchains.json");
+  ASSERT_TRUE(nextRun.python("fakepython", python));
+  EXPECT_EQ(python.version, "3.99.1");
+  EXPECT_EQ(probes(), 1);
+}
+
+TEST_F(ToolchainTest, ReplacedBinaryIsProbedAgain) {
+  ToolchainCache cache("cache/toolchains.json");
+  Toolchain python;
+  ASSERT_TRUE(cache.python("fakepython", python));
+  fs::last_write_time("bin/fakepython", fs::last_write_time("bin/fakepython") + std::chrono::seconds(5));
+  ASSERT_TRUE(cache.python("fakepython", python));
+  EXPECT_EQ(probes(), 2);
+
+  EXPECT_FALSE(cache.python("bahamut-no-such-python", python));
+}
+
+TEST_F(ToolchainTest, FailedProbeIsCachedToo) {
+  std::ofstream script("bin/brokenpython");
+  script << "#!/bin/sh\necho probe >> " << test_dir << "/probes\nexit 1\n";
+  script.close();
+  fs::permissions("bin/brokenpython", fs::perms::owner_all);
+
+  ToolchainCache cache("cache/toolchains.json");
+  Toolchain python;
+  EXPECT_FALSE(cache.python("brokenpython", python));
+  EXPECT_FALSE(cache.python("brokenpython", python));
+  EXPECT_EQ(probes(), 1);
+
+  ToolchainCache nextRun("cache/toolchains.json");
+  EXPECT_FALSE(nextRun.python("brokenpython", python));
+  EXPECT_EQ(probes(), 1);
+
+  // Fixing it (a new binary) is noticed.
+  fs::last_write_time("bin/brokenpython", fs::last_write_time("bin/brokenpython") + std::chrono::seconds(5));
+  EXPECT_FALSE(nextRun.python("brokenpython", python));
+  EXPECT_EQ(probes(), 2);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../core/core.hpp"
+#include "../core/zygote.hpp"
+#include "../include/rapidjson/document.h"
+#include "./module_fixture.hpp"
+
+namespace fs = std::filesystem;
+
+class ZygoteTest : public ModuleFixture {
+  protected:
+    ZygoteTest() : ModuleFixture("zygote") {}
+
+    void TearDown() override {
+      shutdownWarmInterpreters();
+      setRunReport("", "");
+      ModuleFixture::TearDown();
+    }
+};
+
+TEST_F(ZygoteTest, RejectsUnknownLanguagesAndPreloads) {
+  EXPECT_FALSE(setWarmInterpreters("ruby", ""));
+  EXPECT_FALSE(setWarmInterpreters("python", "node:axios"));
+  EXPECT_FALSE(setWarmInterpreters("python", "requests"));
+  EXPECT_FALSE(InterpreterPool::shared().enabled("python"));
+}
+
+TEST_F(ZygoteTest, PythonModuleRunsOnForkServer) {
+  createTestModule("modules/warm.py", R"(#!/usr/bin/env python3
+# Consumes: domain
+# Provides: seen
+import os, sys
+print('{"bmop":"1.0","module":"warm"}')
+preloaded = "decimal" in sys.modules
+for line in sys.stdin:
+    if '"t":"d"' in line:
+        print('{"t":"d","f":"seen","v":"%s %s %s"}' % (preloaded, os.getppid() != int(sys.argv[1]), sys.argv[2]))
+)");
+  createTestModule("modules/fail.py", R"(#!/usr/bin/env python3
+# Provides: seen
+import sys
+if __name__ == "__main__":
+    sys.exit(3)
+)");
+
+  ASSERT_TRUE(setWarmInterpreters("python", "python:decimal"));
+  Storage storage;
+  storage.append("domain", "a.com");
+  runModuleWithPipe("warm.py", {std::to_string(getpid()), "two words"}, storage, "domain");
+
+  // Preloaded by the server, which is its parent; argv survives intact.
+  ASSERT_EQ(storage["seen"].size(), 1);
+  EXPECT_EQ(storage["seen"][0].value, "True True two words");
+
+  // The exit status comes back through the server.
+  setRunReport("run.json", "");
+  runModule("fail.py", {});
+  std::ifstream file("run.json");
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  rapidjson::Document doc;
+  ASSERT_FALSE(doc.Parse(buffer.str().c_str()).HasParseError());
+  EXPECT_EQ(doc["modules"][0]["exit_code"].GetInt(), 3);
+}
+
+TEST_F(ZygoteTest, NodeModuleRunsOnWarmProcess) {
+  createTestModule("modules/preload.js", "globalThis.preloaded = true;\n");
+  createTestModule("modules/warm.js", R"(#!/usr/bin/env node
+// Provides: seen
+console.log('{"bmop":"1.0","module":"warm"}');
+const main = require.main === module;
+console.log(JSON.stringify({t: "d", f: "seen", v: `${globalThis.preloaded} ${main} ${process.argv[2]}`}));
+)");
+
+  ASSERT_TRUE(setWarmInterpreters("node", "node:" + fs::absolute("modules/preload.js").string()));
+  Storage storage;
+  runModuleWithPipe("warm.js", {"arg"}, storage, "");
+
+  ASSERT_EQ(storage["seen"].size(), 1);
+  EXPECT_EQ(storage["seen"][0].value, "true true arg");
+}
+
+TEST_F(ZygoteTest, ConcurrentLaunchesGetTheirOwnPid) {
+  createTestModule("modules/code.py", "import sys\nsys.exit(int(sys.argv[1]))\n");
+  ASSERT_TRUE(setWarmInterpreters("python", ""));
+  InterpreterPool& pool = InterpreterPool::shared();
+
+  constexpr int LAUNCHES = 6;
+  std::vector<std::thread> threads;
+  std::vector<int> codes(LAUNCHES, -1);
+  for (int i = 0; i < LAUNCHES; ++i) {
+    threads.emplace_back([&, i]() {
+      InterpreterPool::Launch launch;
+      launch.language = "python";
+      launch.interpreter = "python3";
+      launch.path = fs::absolute("modules/code.py").string();
+      launch.args = {std::to_string(10 + i)};
+      launch.cwd = fs::current_path().string();
+      launch.env = {"PATH=/usr/bin:/bin"};
+      int in = -1, out = -1, err = -1;
+      pid_t pid = pool.launch(launch, in, out, err);
+      if (pid < 0) return;
+      close(out);
+      close(err);
+      int status = 0;
+      struct rusage usage{};
+      pool.reap(pid, status, usage, 0);
+      codes[i] = WIFEXITED(status) ? WEXITSTATUS(status) : -2;
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  for (int i = 0; i < LAUNCHES; ++i) EXPECT_EQ(codes[i], 10 + i);
+}